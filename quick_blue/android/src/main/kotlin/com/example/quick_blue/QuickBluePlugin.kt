@@ -341,6 +341,7 @@ class QuickBluePlugin: FlutterPlugin, MethodCallHandler, EventChannel.StreamHand
       if (status == BluetoothGatt.GATT_SUCCESS) {
         sendMessage(messageConnector, mapOf(
           "type" to "mtuChanged",
+          "deviceId" to gatt?.device?.address,
           "mtuConfig" to mtu,
           "status" to status,
         ))
@@ -167,6 +167,7 @@ public class SwiftQuickBluePlugin: NSObject, FlutterPlugin {
 		  print("peripheral.maximumWriteValueLengthForType:CBCharacteristicWriteWithoutResponse \(mtu)")
 		  messageConnector.sendMessage([
             "type": "mtuChanged",
+            "deviceId": deviceId,
             "mtuConfig": mtu + GATT_HEADER_LENGTH])
     case "readRssi":
         let arguments = call.arguments as! Dictionary<String, Any>
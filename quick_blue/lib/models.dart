@@ -9,6 +9,18 @@ class BlueScanResult {
   Uint8List? _manufacturerData;
   int rssi;
 
+  /// Manufacturer specific data by company identifier, without the prefix.
+  Map<int, Uint8List> manufacturerSpecificData;
+
+  List<String> serviceUuids;
+
+  /// Service data by service UUID.
+  Map<String, Uint8List> serviceData;
+
+  int? txPowerLevel;
+
+  int? advertisementFlags;
+
   Uint8List get manufacturerDataHead => _manufacturerDataHead ?? _empty;
 
   Uint8List get manufacturerData => _manufacturerData ?? manufacturerDataHead;
@@ -18,7 +30,13 @@ class BlueScanResult {
         deviceId = map['deviceId'],
         _manufacturerDataHead = map['manufacturerDataHead'],
         _manufacturerData = map['manufacturerData'],
-        rssi = map['rssi'];
+        rssi = map['rssi'],
+        manufacturerSpecificData =
+            (map['manufacturerSpecificData'] as Map? ?? {}).cast(),
+        serviceUuids = (map['serviceUuids'] as List? ?? []).cast(),
+        serviceData = (map['serviceData'] as Map? ?? {}).cast(),
+        txPowerLevel = map['txPowerLevel'],
+        advertisementFlags = map['advertisementFlags'];
 
   Map toMap() => {
         'name': name,
@@ -26,6 +44,11 @@ class BlueScanResult {
         'manufacturerDataHead': _manufacturerDataHead,
         'manufacturerData': _manufacturerData,
         'rssi': rssi,
+        'manufacturerSpecificData': manufacturerSpecificData,
+        'serviceUuids': serviceUuids,
+        'serviceData': serviceData,
+        'txPowerLevel': txPowerLevel,
+        'advertisementFlags': advertisementFlags,
       };
 
   @override
@@ -51,14 +51,19 @@ class QuickBlue {
 
   static reinit() => _platform.reinit();
 
-  static void startScan({String? serviceId}) =>
-      _platform.startScan(serviceId: serviceId);
+  static void startScan({String? serviceId, ScanSettings? settings}) =>
+      _platform.startScan(serviceId: serviceId, settings: settings);
 
   static void stopScan() => _platform.stopScan();
 
   static Stream<BlueScanResult> get scanResultStream =>
       _platform.scanResultStream.map((item) => BlueScanResult.fromMap(item));
 
+  static Stream<List<BlueScanResult>> get scanSnapshotStream =>
+      _platform.scanSnapshotStream.map((items) => (items as List)
+          .map((item) => BlueScanResult.fromMap(item))
+          .toList());
+
   static Stream<BleEventMessage> get eventStream => _platform.bleEventStream;
 
   static Future<void> connect(String deviceId, {bool? auto}) {
@@ -115,4 +120,80 @@ class QuickBlue {
   /// The behaviour can vary from platfrom to platform
   static void requestLatency(String deviceId, BlePackageLatency latency) =>
       _platform.requestLatency(deviceId, latency);
+
+  // Only implemented on Windows, see MethodChannelQuickBlue.
+
+  static Stream<Map<dynamic, dynamic>> get gattTreeStream =>
+      _platform.gattTreeStream;
+
+  static Future<void> writeReliable(String deviceId, List<GattWrite> writes,
+          {Duration? deadline}) =>
+      _platform.writeReliable(deviceId, writes, deadline: deadline);
+
+  static Future<Map<dynamic, dynamic>> writeStream(
+          String deviceId,
+          String service,
+          String characteristic,
+          Uint8List value,
+          BleOutputProperty bleOutputProperty,
+          {int? window,
+          int? maxChunkSize,
+          Duration progressInterval = const Duration(milliseconds: 100),
+          Duration? deadline,
+          void Function(int bytesWritten, int totalBytes)? onProgress}) =>
+      _platform.writeStream(
+          deviceId, service, characteristic, value, bleOutputProperty,
+          window: window,
+          maxChunkSize: maxChunkSize,
+          progressInterval: progressInterval,
+          deadline: deadline,
+          onProgress: onProgress);
+
+  static Future<void> setWritePipeline(String deviceId,
+          {int? queueCapacity, int? window}) =>
+      _platform.setWritePipeline(deviceId,
+          queueCapacity: queueCapacity, window: window);
+
+  static Future<void> setGattScheduler(String deviceId, {int? concurrency}) =>
+      _platform.setGattScheduler(deviceId, concurrency: concurrency);
+
+  static Future<void> setTimeouts(
+          {Duration? connect,
+          Duration? discoverServices,
+          Duration? setNotifiable,
+          Duration? requestMtu,
+          Duration? readValue,
+          Duration? writeValue}) =>
+      _platform.setTimeouts(
+          connect: connect,
+          discoverServices: discoverServices,
+          setNotifiable: setNotifiable,
+          requestMtu: requestMtu,
+          readValue: readValue,
+          writeValue: writeValue);
+
+  static Future<void> setOutboundQueue(
+          {OutboundOverflowPolicy? overflowPolicy}) =>
+      _platform.setOutboundQueue(overflowPolicy: overflowPolicy);
+
+  static Future<void> setNotificationBatching(
+          String deviceId, Duration interval, {int? maxEntries}) =>
+      _platform.setNotificationBatching(deviceId, interval,
+          maxEntries: maxEntries);
+
+  static Future<void> setNotificationWireFormat(String deviceId,
+          {bool binary = true}) =>
+      _platform.setNotificationWireFormat(deviceId, binary: binary);
+
+  static Future<void> setGattCache({bool enabled = true, String? directory}) =>
+      _platform.setGattCache(enabled: enabled, directory: directory);
+
+  static Future<void> setGattCachePolicy(
+          {Map<String, GattCacheMode?> characteristics = const {},
+          GattCacheMode? defaultMode}) =>
+      _platform.setGattCachePolicy(
+          characteristics: characteristics, defaultMode: defaultMode);
+
+  static Future<Map<dynamic, dynamic>> getStatistics() =>
+      _platform.getStatistics();
 }
@@ -52,7 +52,7 @@ class QuickBlueLinux extends QuickBluePlatform {
   void reinit() {}
 
   @override
-  void startScan({String? serviceId}) async {
+  void startScan({String? serviceId, ScanSettings? settings}) async {
     await _ensureInitialized();
     _log('startScan invoke success');
 
@@ -140,7 +140,9 @@ public class QuickBlueMacosPlugin: NSObject, FlutterPlugin {
       result(nil)
       let mtu = peripheral.maximumWriteValueLength(for: .withoutResponse)
       print("peripheral.maximumWriteValueLengthForType:CBCharacteristicWriteWithoutResponse \(mtu)")
-      messageConnector.sendMessage(["mtuConfig": mtu + GATT_HEADER_LENGTH])
+      messageConnector.sendMessage([
+        "deviceId": deviceId,
+        "mtuConfig": mtu + GATT_HEADER_LENGTH])
     case "readValue":
       let arguments = call.arguments as! Dictionary<String, Any>
       let deviceId = arguments["deviceId"] as! String
@@ -6,6 +6,7 @@ import 'package:flutter/services.dart';
 import 'package:logging/logging.dart';
 import 'package:quick_blue_platform_interface/ble_events.dart';
 
+import 'notification_frame.dart';
 import 'quick_blue_platform_interface.dart';
 
 class MethodChannelQuickBlue extends QuickBluePlatform {
@@ -14,9 +15,44 @@ class MethodChannelQuickBlue extends QuickBluePlatform {
       const EventChannel('quick_blue/event.scanResult');
   static const _message_connector = const BasicMessageChannel(
       'quick_blue/message.connector', StandardMessageCodec());
+  static const _binary_notification = 'quick_blue/binary.notification';
 
   MethodChannelQuickBlue() {
     _message_connector.setMessageHandler(_handleConnectorMessage);
+    ServicesBinding.instance.defaultBinaryMessenger
+        .setMessageHandler(_binary_notification, _handleBinaryNotification);
+  }
+
+  /// Native handles, where the platform hands them out. Device handles come
+  /// with the connected message, characteristic handles with discovery.
+  /// Calls pass them along so the platform can skip parsing IDs and UUIDs.
+  final Map<String, int> _deviceHandles = {};
+  final Map<int, String> _deviceIdsByHandle = {};
+  final Map<String, Map<String, int>> _characteristicHandles = {};
+  final Map<String, Map<int, String>> _characteristicsByHandle = {};
+
+  int? _characteristicHandle(
+          String deviceId, String service, String characteristic) =>
+      _characteristicHandles[deviceId]
+          ?['${service.toLowerCase()}/${characteristic.toLowerCase()}'];
+
+  Map<String, int> _handleArgs(
+      String deviceId, String service, String characteristic) {
+    final deviceHandle = _deviceHandles[deviceId];
+    final characteristicHandle =
+        _characteristicHandle(deviceId, service, characteristic);
+    return {
+      if (deviceHandle != null) 'deviceHandle': deviceHandle,
+      if (characteristicHandle != null)
+        'characteristicHandle': characteristicHandle,
+    };
+  }
+
+  void _forgetHandles(String deviceId) {
+    final deviceHandle = _deviceHandles.remove(deviceId);
+    if (deviceHandle != null) _deviceIdsByHandle.remove(deviceHandle);
+    _characteristicHandles.remove(deviceId);
+    _characteristicsByHandle.remove(deviceId);
   }
 
   QuickLogger? _logger;
@@ -37,9 +73,10 @@ class MethodChannelQuickBlue extends QuickBluePlatform {
   }
 
   @override
-  Future<void> startScan({String? serviceId}) {
+  Future<void> startScan({String? serviceId, ScanSettings? settings}) {
     return _method.invokeMethod('startScan', {
       'serviceId': serviceId,
+      ...?settings?.toMap(),
     }).onError((error, stackTrace) {
       _log('stopScan invocation failed with $error');
     }).then((_) => _log('startScan invokeMethod success'));
@@ -52,9 +89,19 @@ class MethodChannelQuickBlue extends QuickBluePlatform {
         .then((_) => print('stopScan invokeMethod success'));
   }
 
-  Stream<dynamic> scanResultStream =
+  static final Stream<dynamic> _scanEvents =
       _event_scanResult.receiveBroadcastStream({'name': 'scanResult'});
 
+  // Batched scan results arrive as a list and are flattened here.
+  Stream<dynamic> scanResultStream = _scanEvents
+      .where((event) => event is! Map || !event.containsKey('snapshot'))
+      .expand((event) => event is List ? event : [event]);
+
+  @override
+  Stream<dynamic> get scanSnapshotStream => _scanEvents
+      .where((event) => event is Map && event.containsKey('snapshot'))
+      .map((event) => event['snapshot']);
+
   StreamController<BleEventMessage> _eventMessageController =
       StreamController.broadcast();
 
@@ -86,10 +133,13 @@ class MethodChannelQuickBlue extends QuickBluePlatform {
     }).then((_) => _log('disconnect invokeMethod success'));
   }
 
+  /// [cacheMode] is only implemented on Windows. Without it, the platform
+  /// default applies.
   @override
-  void discoverServices(String deviceId) {
+  void discoverServices(String deviceId, {GattCacheMode? cacheMode}) {
     _method.invokeMethod('discoverServices', {
       'deviceId': deviceId,
+      if (cacheMode != null) 'cacheMode': cacheMode.value,
     }).then((_) => _log('discoverServices invokeMethod success'));
   }
 
@@ -98,24 +148,67 @@ class MethodChannelQuickBlue extends QuickBluePlatform {
       String deviceId = message['deviceId'];
       BlueConnectionState connectionState =
           BlueConnectionState.parse(message['ConnectionState']);
+      _forgetHandles(deviceId);
+      int? deviceHandle = message['deviceHandle'];
+      if (deviceHandle != null) {
+        _deviceHandles[deviceId] = deviceHandle;
+        _deviceIdsByHandle[deviceHandle] = deviceId;
+      }
       onConnectionChanged?.call(deviceId, connectionState);
     } else if (message['ServiceState'] != null) {
       if (message['ServiceState'] == 'discovered') {
         String deviceId = message['deviceId'];
-        String service = message['service'];
-        List<String> characteristics =
-            (message['characteristics'] as List).cast();
-        onServiceDiscovered?.call(deviceId, service, characteristics);
+        if (message['services'] != null) {
+          // The whole GATT tree in one message
+          for (Map node in message['services']) {
+            List<Map> characteristics =
+                (node['characteristics'] as List).cast();
+            _serviceDiscovered(
+                deviceId,
+                node['service'],
+                <String>[for (final c in characteristics) c['characteristic']],
+                <int>[for (final c in characteristics) c['handle']]);
+          }
+          _gattTreeController.add(message);
+        } else if (message['service'] != null) {
+          _serviceDiscovered(
+              deviceId,
+              message['service'],
+              (message['characteristics'] as List? ?? []).cast(),
+              (message['characteristicHandles'] as List?)?.cast());
+        }
       }
     } else if (message['characteristicValue'] != null) {
       String deviceId = message['deviceId'];
       var characteristicValue = message['characteristicValue'];
-      String characteristic = characteristicValue['characteristic'];
+      // Windows notifications only carry the handle
+      String? characteristic = characteristicValue['characteristic'] ??
+          _characteristicOf(
+              deviceId, characteristicValue['characteristicHandle']);
+      if (characteristic == null) return;
       Uint8List value = Uint8List.fromList(
           characteristicValue['value']); // In case of _Uint8ArrayView
       onValueChanged?.call(deviceId, characteristic, value);
+    } else if (message['characteristicValues'] != null) {
+      // Batched notifications: [characteristicHandle, timestampUs, value]
+      String deviceId = message['deviceId'];
+      for (List entry in message['characteristicValues']) {
+        final characteristic = _characteristicOf(deviceId, entry[0]);
+        if (characteristic == null) continue;
+        onValueChanged?.call(
+            deviceId, characteristic, Uint8List.fromList(entry[2]));
+      }
+    } else if (message['characteristicHandle'] != null) {
+      // Sent on subscribing, ahead of the notifications using the handle
+      _characteristicsByHandle.putIfAbsent(message['deviceId'], () => {})[
+          message['characteristicHandle']] = message['characteristic'];
+    } else if (message['writeStreamProgress'] != null) {
+      final progress = message['writeStreamProgress'];
+      _writeStreamProgress[progress['transferId']]
+          ?.call(progress['bytesWritten'], progress['totalBytes']);
     } else if (message['mtuConfig'] != null) {
-      _mtuConfigController.add(message['mtuConfig']);
+      _mtuConfigController
+          .add((deviceId: message['deviceId'], mtu: message['mtuConfig']));
     } else if (message['type'] == "rssiRead") {
       onRssiRead?.call(message['deviceId'], message["rssi"]);
     } else if (message['type'] == "repopulatePeripherals") {
@@ -128,6 +221,56 @@ class MethodChannelQuickBlue extends QuickBluePlatform {
     }
   }
 
+  void _serviceDiscovered(String deviceId, String service,
+      List<String> characteristics, List<int>? handles) {
+    if (handles != null) {
+      final byHandle = _characteristicsByHandle.putIfAbsent(deviceId, () => {});
+      final byUuid = _characteristicHandles.putIfAbsent(deviceId, () => {});
+      for (var i = 0; i < handles.length; i++) {
+        byHandle[handles[i]] = characteristics[i];
+        byUuid['${service.toLowerCase()}/'
+            '${characteristics[i].toLowerCase()}'] = handles[i];
+      }
+    }
+    onServiceDiscovered?.call(deviceId, service, characteristics);
+  }
+
+  String? _characteristicOf(String deviceId, int handle) {
+    final characteristic = _characteristicsByHandle[deviceId]?[handle];
+    if (characteristic == null) {
+      _log('notification for unknown handle $handle of $deviceId');
+    }
+    return characteristic;
+  }
+
+  final _gattTreeController =
+      StreamController<Map<dynamic, dynamic>>.broadcast();
+
+  /// Complete [discoverServices] results: `deviceId` and `services`, a list
+  /// of `service` UUIDs with their `characteristics`, each carrying its
+  /// `characteristic` UUID, `handle`, `properties` bits and `descriptors`.
+  /// [onServiceDiscovered] is still called per service.
+  /// Only implemented on Windows.
+  @override
+  Stream<Map<dynamic, dynamic>> get gattTreeStream =>
+      _gattTreeController.stream;
+
+  Future<ByteData?> _handleBinaryNotification(ByteData? data) async {
+    if (data == null) return null;
+    for (final frame in NotificationFrame.decodeAll(data)) {
+      final deviceId = _deviceIdsByHandle[frame.deviceHandle];
+      if (deviceId == null) {
+        _log('binary notification for unknown device ${frame.deviceHandle}');
+        continue;
+      }
+      final characteristic =
+          _characteristicOf(deviceId, frame.characteristicHandle);
+      if (characteristic == null) continue;
+      onValueChanged?.call(deviceId, characteristic, frame.value);
+    }
+    return null;
+  }
+
   @override
   Future<void> setNotifiable(String deviceId, String service,
       String characteristic, BleInputProperty bleInputProperty) async {
@@ -135,66 +278,318 @@ class MethodChannelQuickBlue extends QuickBluePlatform {
       'deviceId': deviceId,
       'service': service,
       'characteristic': characteristic,
+      ..._handleArgs(deviceId, service, characteristic),
       'bleInputProperty': bleInputProperty.value,
     }).then((_) => _log('setNotifiable invokeMethod success'));
   }
 
+  /// [cacheMode] is only implemented on Windows. Without it, the mode set by
+  /// [setGattCachePolicy] applies.
+  ///
+  /// On Windows, the returned future completes once the value has been read
+  /// and fails with a [PlatformException] if the read does, e.g. coded
+  /// `ReadFailed` with the ATT `protocolError` in its details, or
+  /// `Disconnected`. The value itself is delivered by [onValueChanged].
+  /// A read still waiting for its turn after [deadline], see
+  /// [setGattScheduler], fails with `DeadlineExceeded`, and one that has
+  /// started but not finished by then, or within its timeout, see
+  /// [setTimeouts], fails with `Timeout`.
   @override
   Future<void> readValue(
-      String deviceId, String service, String characteristic) async {
-    _method.invokeMethod('readValue', {
+      String deviceId, String service, String characteristic,
+      {GattCacheMode? cacheMode, Duration? deadline}) {
+    return _method.invokeMethod('readValue', {
       'deviceId': deviceId,
       'service': service,
       'characteristic': characteristic,
+      ..._handleArgs(deviceId, service, characteristic),
+      if (cacheMode != null) 'cacheMode': cacheMode.value,
+      if (deadline != null) 'deadlineMs': deadline.inMilliseconds,
     }).then((_) => _log('readValue invokeMethod success'));
   }
 
+  /// On Windows, writes to one characteristic are queued in call order. The
+  /// returned future completes once the write has been carried out, and fails
+  /// with a [PlatformException] coded `QueueFull` if the queue has no room,
+  /// see [setWritePipeline], `WriteFailed` with the ATT `protocolError` in
+  /// its details, `DeadlineExceeded` if it has not started by [deadline], or
+  /// `Timeout` if it has not finished by then, see [setTimeouts].
   @override
   Future<void> writeValue(
       String deviceId,
       String service,
       String characteristic,
       Uint8List value,
-      BleOutputProperty bleOutputProperty) async {
-    _method.invokeMethod('writeValue', {
-      'deviceId': deviceId,
-      'service': service,
-      'characteristic': characteristic,
-      'value': value,
-      'bleOutputProperty': bleOutputProperty.value,
-    }).then((_) {
+      BleOutputProperty bleOutputProperty,
+      {Duration? deadline}) async {
+    try {
+      await _method.invokeMethod('writeValue', {
+        'deviceId': deviceId,
+        'service': service,
+        'characteristic': characteristic,
+        ..._handleArgs(deviceId, service, characteristic),
+        'value': value,
+        'bleOutputProperty': bleOutputProperty.value,
+        if (deadline != null) 'deadlineMs': deadline.inMilliseconds,
+      });
       _log('writeValue invokeMethod success', logLevel: Level.ALL);
-    }).catchError((onError) {
+    } catch (error, stackTrace) {
       // sometimes android reports a fialed write, but writes the value anyways
-      if (Platform.isAndroid) {
-        bleEventStream.firstWhere((x) {
-          return x.data is CharacteristicWriteEvent &&
-              listEquals(value, (x.data as CharacteristicWriteEvent).value);
-        }).timeout(Duration(milliseconds: 1250), onTimeout: () {
-          throw onError;
-        });
-      } else {
-        throw onError;
-      }
+      if (!Platform.isAndroid) rethrow;
+      await bleEventStream.firstWhere((x) {
+        return x.data is CharacteristicWriteEvent &&
+            listEquals(value, (x.data as CharacteristicWriteEvent).value);
+      }).timeout(Duration(milliseconds: 1250), onTimeout: () {
+        Error.throwWithStackTrace(error, stackTrace);
+      });
+    }
+  }
+
+  /// Write all of [writes] atomically: the device applies them together when
+  /// the transaction is committed, or none of them. Completes once with the
+  /// outcome of the commit; a failure carries the ATT `protocolError` in its
+  /// details. The characteristics must support reliable writes. Fails with
+  /// `DeadlineExceeded` if the transaction has not started by [deadline],
+  /// or `Timeout` if it has not been committed by then.
+  /// Only implemented on Windows.
+  @override
+  Future<void> writeReliable(String deviceId, List<GattWrite> writes,
+      {Duration? deadline}) {
+    return _method.invokeMethod('writeReliable', {
+      'deviceId': deviceId,
+      if (_deviceHandles[deviceId] case final deviceHandle?)
+        'deviceHandle': deviceHandle,
+      'writes': [
+        for (final write in writes)
+          {
+            'service': write.service,
+            'characteristic': write.characteristic,
+            if (_characteristicHandle(
+                    deviceId, write.service, write.characteristic)
+                case final characteristicHandle?)
+              'characteristicHandle': characteristicHandle,
+            'value': write.value,
+          }
+      ],
+      if (deadline != null) 'deadlineMs': deadline.inMilliseconds,
     });
   }
 
-  // FIXME Close
-  final _mtuConfigController = StreamController<int>.broadcast();
+  final Map<int, void Function(int bytesWritten, int totalBytes)>
+      _writeStreamProgress = {};
+  int _nextTransferId = 0;
 
+  /// Write [value] to [characteristic] in chunks as large as the negotiated
+  /// MTU allows, or [maxChunkSize], with up to [window] chunks in flight.
+  /// [onProgress] is called at most once per [progressInterval] and when
+  /// done. Completes once with `bytesWritten`, `chunks`, `chunkSize` and
+  /// `elapsedUs`, or fails with the first chunk that could not be written,
+  /// could not start by [deadline], or timed out, see [setTimeouts].
+  /// Only implemented on Windows.
   @override
-  Future<int> requestMtu(String deviceId, int expectedMtu) async {
-    _method.invokeMethod('requestMtu', {
+  Future<Map<dynamic, dynamic>> writeStream(
+      String deviceId,
+      String service,
+      String characteristic,
+      Uint8List value,
+      BleOutputProperty bleOutputProperty,
+      {int? window,
+      int? maxChunkSize,
+      Duration progressInterval = const Duration(milliseconds: 100),
+      Duration? deadline,
+      void Function(int bytesWritten, int totalBytes)? onProgress}) async {
+    final transferId = _nextTransferId++;
+    if (onProgress != null) _writeStreamProgress[transferId] = onProgress;
+    try {
+      return await _method.invokeMethod('writeStream', {
+        'deviceId': deviceId,
+        'service': service,
+        'characteristic': characteristic,
+        ..._handleArgs(deviceId, service, characteristic),
+        'value': value,
+        'bleOutputProperty': bleOutputProperty.value,
+        'transferId': transferId,
+        'progressIntervalMs': progressInterval.inMilliseconds,
+        if (window != null) 'window': window,
+        if (maxChunkSize != null) 'maxChunkSize': maxChunkSize,
+        if (deadline != null) 'deadlineMs': deadline.inMilliseconds,
+      });
+    } finally {
+      _writeStreamProgress.remove(transferId);
+    }
+  }
+
+  /// Size the write queue of each characteristic of [deviceId] to
+  /// [queueCapacity] writes, of which up to [window] writes without response
+  /// are in flight at once. Writes with response are always issued one at a
+  /// time. Defaults are 64 and 4.
+  /// Only implemented on Windows.
+  @override
+  Future<void> setWritePipeline(String deviceId,
+      {int? queueCapacity, int? window}) {
+    return _method.invokeMethod('setWritePipeline', {
+      'deviceId': deviceId,
+      if (queueCapacity != null) 'queueCapacity': queueCapacity,
+      if (window != null) 'window': window,
+    });
+  }
+
+  /// Let up to [concurrency] GATT operations of [deviceId] run at once,
+  /// 4 by default. The others wait for their turn by class: MTU and
+  /// discovery first, then notification subscriptions, reads, and writes
+  /// last. Per-device queue and service times are reported by
+  /// `getStatistics` under `gattSchedulers`.
+  /// Only implemented on Windows.
+  @override
+  Future<void> setGattScheduler(String deviceId, {int? concurrency}) {
+    return _method.invokeMethod('setGattScheduler', {
       'deviceId': deviceId,
-      'expectedMtu': expectedMtu,
-    }).then((_) => _log('requestMtu invokeMethod success'));
-    return await _mtuConfigController.stream.first;
+      if (concurrency != null) 'concurrency': concurrency,
+    });
+  }
+
+  /// Limit how long each kind of GATT operation may run once started. An
+  /// operation past its limit is cancelled and fails with `Timeout`, its
+  /// kind under `operation` in the details; a connection attempt ends with
+  /// a disconnection whose `error` is `Timeout`, and a discovery with a
+  /// `discovered` service state whose `error` is `Timeout`. Omitted kinds
+  /// keep their limit, [Duration.zero] removes it. Defaults are 10 seconds
+  /// to [connect], 15 seconds to [discoverServices] and 5 seconds for the
+  /// others. The limits apply to all devices.
+  /// Only implemented on Windows.
+  @override
+  Future<void> setTimeouts(
+      {Duration? connect,
+      Duration? discoverServices,
+      Duration? setNotifiable,
+      Duration? requestMtu,
+      Duration? readValue,
+      Duration? writeValue}) {
+    return _method.invokeMethod('setTimeouts', {
+      'timeouts': {
+        if (connect != null) 'connect': connect.inMilliseconds,
+        if (discoverServices != null)
+          'discoverServices': discoverServices.inMilliseconds,
+        if (setNotifiable != null)
+          'setNotifiable': setNotifiable.inMilliseconds,
+        if (requestMtu != null) 'requestMtu': requestMtu.inMilliseconds,
+        if (readValue != null) 'readValue': readValue.inMilliseconds,
+        if (writeValue != null) 'writeValue': writeValue.inMilliseconds,
+      },
+    });
+  }
+
+  /// Choose what happens to notifications, scan results and progress
+  /// reports when Dart falls behind and the native queue of messages to it
+  /// is full, [OutboundOverflowPolicy.dropNewest] by default. Its counters
+  /// are reported by `getStatistics` as `outboundPosted`, `outboundDropped`
+  /// and so on.
+  /// Only implemented on Windows.
+  @override
+  Future<void> setOutboundQueue({OutboundOverflowPolicy? overflowPolicy}) {
+    return _method.invokeMethod('setOutboundQueue', {
+      if (overflowPolicy != null) 'overflowPolicy': overflowPolicy.value,
+    });
+  }
+
+  // FIXME Close
+  final _mtuConfigController =
+      StreamController<({String? deviceId, int mtu})>.broadcast();
+
+  /// Windows answers the call itself with the negotiated MTU; other
+  /// platforms report it through an `mtuConfig` message. [deadline] is only
+  /// implemented on Windows.
+  @override
+  Future<int> requestMtu(String deviceId, int expectedMtu,
+      {Duration? deadline}) async {
+    final mtuConfig = Completer<int>();
+    // Only the answer for this device, as other calls may be pending
+    final subscription = _mtuConfigController.stream
+        .where((config) => config.deviceId == deviceId)
+        .listen((config) {
+      if (!mtuConfig.isCompleted) mtuConfig.complete(config.mtu);
+    });
+    try {
+      final mtu = await _method.invokeMethod<int>('requestMtu', {
+        'deviceId': deviceId,
+        'expectedMtu': expectedMtu,
+        if (deadline != null) 'deadlineMs': deadline.inMilliseconds,
+      });
+      _log('requestMtu invokeMethod success');
+      return mtu ?? await mtuConfig.future;
+    } finally {
+      await subscription.cancel();
+    }
   }
 
   Future<void> readRssi(String deviceId) async {
     await _method.invokeMethod('readRssi', {'deviceId': deviceId});
   }
 
+  /// Deliver notifications of [deviceId] in one message per [interval], or
+  /// as soon as [maxEntries] are pending. [Duration.zero] turns batching off.
+  /// Only implemented on Windows.
+  @override
+  Future<void> setNotificationBatching(String deviceId, Duration interval,
+      {int? maxEntries}) {
+    return _method.invokeMethod('setNotificationBatching', {
+      'deviceId': deviceId,
+      'intervalMs': interval.inMilliseconds,
+      if (maxEntries != null) 'maxEntries': maxEntries,
+    });
+  }
+
+  /// Deliver notifications of [deviceId] as packed [NotificationFrame]s on a
+  /// raw binary channel instead of StandardMessageCodec maps. Requires
+  /// [discoverServices] to map characteristic handles back to UUIDs.
+  /// Only implemented on Windows.
+  @override
+  Future<void> setNotificationWireFormat(String deviceId,
+      {bool binary = true}) {
+    return _method.invokeMethod('setNotificationWireFormat', {
+      'deviceId': deviceId,
+      'format': binary ? 'binary' : 'map',
+    });
+  }
+
+  /// Persist the GATT layout of connected devices, so reconnects report
+  /// [discoverServices] results without enumerating the device again. The
+  /// layouts are stored in [directory], by default in the local app data
+  /// folder. A layout is dropped when the device signals a service change.
+  /// Only implemented on Windows.
+  @override
+  Future<void> setGattCache({bool enabled = true, String? directory}) {
+    return _method.invokeMethod('setGattCache', {
+      'enabled': enabled,
+      if (directory != null) 'directory': directory,
+    });
+  }
+
+  /// Choose the [GattCacheMode] of [readValue] calls without one, per
+  /// characteristic UUID. A null mode reverts the characteristic to
+  /// [defaultMode]. By default the Device Information strings, appearance
+  /// and PnP ID are read from the cache and everything else from the device.
+  /// Only implemented on Windows.
+  @override
+  Future<void> setGattCachePolicy(
+      {Map<String, GattCacheMode?> characteristics = const {},
+      GattCacheMode? defaultMode}) {
+    return _method.invokeMethod('setGattCachePolicy', {
+      'characteristics': {
+        for (final entry in characteristics.entries)
+          entry.key: entry.value?.value,
+      },
+      if (defaultMode != null) 'defaultMode': defaultMode.value,
+    });
+  }
+
+  /// Native counters of the plugin, e.g. `nameLookupsAvoided` while scanning.
+  /// Only implemented on Windows.
+  @override
+  Future<Map<dynamic, dynamic>> getStatistics() async {
+    return await _method.invokeMethod('getStatistics');
+  }
+
   @override
   void reinit() {
     if (Platform.isAndroid) {
@@ -1,4 +1,5 @@
 import 'dart:io';
+import 'dart:typed_data';
 
 import 'package:equatable/equatable.dart';
 
@@ -34,6 +35,82 @@ class BlueConnectionState extends Equatable {
   bool? get stringify => true;
 }
 
+/// Native scan tuning. Options a platform does not support are ignored.
+class ScanSettings {
+  /// Deliver scan results in batches that are flushed at least every
+  /// [batchInterval] (Windows only).
+  final Duration? batchInterval;
+
+  /// Flush a batch as soon as it holds [batchSize] results (Windows only).
+  final int? batchSize;
+
+  /// Only report devices advertising any of these services (Windows only).
+  final List<String>? serviceIds;
+
+  /// Only report devices whose manufacturer data carries any of these
+  /// company identifiers (Windows only).
+  final List<int>? manufacturerIds;
+
+  /// Drop advertisements received below this signal strength in dBm
+  /// (Windows only).
+  final int? minRssi;
+
+  /// Only report devices whose name starts with any of these prefixes
+  /// (Windows only).
+  final List<String>? namePrefixes;
+
+  /// Suppress repeated advertisements of a device until its RSSI moved by at
+  /// least [rssiDelta] dBm or its payload changed (Windows only).
+  final int? rssiDelta;
+
+  /// When suppressing repeats, still report an unchanged device once per
+  /// [heartbeatInterval] (Windows only).
+  final Duration? heartbeatInterval;
+
+  /// Switch to nearest-N mode: instead of individual results, publish a
+  /// ranked snapshot of the [snapshotTopK] strongest devices on
+  /// `scanSnapshotStream` (Windows only).
+  final int? snapshotTopK;
+
+  /// Snapshot publishing period in nearest-N mode, 100ms by default.
+  final Duration? snapshotInterval;
+
+  /// Weight of a new RSSI sample in the moving average used to rank devices
+  /// in nearest-N mode, between 0 and 1.
+  final double? rssiSmoothing;
+
+  const ScanSettings({
+    this.batchInterval,
+    this.batchSize,
+    this.serviceIds,
+    this.manufacturerIds,
+    this.minRssi,
+    this.namePrefixes,
+    this.rssiDelta,
+    this.heartbeatInterval,
+    this.snapshotTopK,
+    this.snapshotInterval,
+    this.rssiSmoothing,
+  });
+
+  Map<String, dynamic> toMap() => {
+        if (batchInterval != null)
+          'batchIntervalMs': batchInterval!.inMilliseconds,
+        if (batchSize != null) 'batchSize': batchSize,
+        if (serviceIds != null) 'serviceIds': serviceIds,
+        if (manufacturerIds != null) 'manufacturerIds': manufacturerIds,
+        if (minRssi != null) 'minRssi': minRssi,
+        if (namePrefixes != null) 'namePrefixes': namePrefixes,
+        if (rssiDelta != null) 'rssiDelta': rssiDelta,
+        if (heartbeatInterval != null)
+          'heartbeatIntervalMs': heartbeatInterval!.inMilliseconds,
+        if (snapshotTopK != null) 'snapshotTopK': snapshotTopK,
+        if (snapshotInterval != null)
+          'snapshotIntervalMs': snapshotInterval!.inMilliseconds,
+        if (rssiSmoothing != null) 'rssiSmoothing': rssiSmoothing,
+      };
+}
+
 class BleInputProperty {
   static const disabled = BleInputProperty._('disabled');
   static const notification = BleInputProperty._('notification');
@@ -53,6 +130,43 @@ class BleOutputProperty {
   const BleOutputProperty._(this.value);
 }
 
+/// A value to write to a characteristic as part of a batch.
+class GattWrite {
+  final String service;
+  final String characteristic;
+  final Uint8List value;
+
+  const GattWrite(this.service, this.characteristic, this.value);
+}
+
+/// Where GATT discovery and reads are answered from.
+class GattCacheMode {
+  /// The system GATT cache, or the device if nothing is cached.
+  static const cached = GattCacheMode._('cached');
+
+  /// Always the device.
+  static const uncached = GattCacheMode._('uncached');
+
+  final String value;
+
+  const GattCacheMode._(this.value);
+}
+
+/// What happens to a notification, scan result or progress report when the
+/// native queue of messages to Dart is full. Connection and service state
+/// changes and method call results are never dropped.
+class OutboundOverflowPolicy {
+  /// The new message is dropped.
+  static const dropNewest = OutboundOverflowPolicy._('dropNewest');
+
+  /// The oldest queued droppable message is dropped to make room.
+  static const dropOldest = OutboundOverflowPolicy._('dropOldest');
+
+  final String value;
+
+  const OutboundOverflowPolicy._(this.value);
+}
+
 enum BlePackageLatency {
   low,
   medium,
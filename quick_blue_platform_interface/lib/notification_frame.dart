@@ -0,0 +1,46 @@
+import 'dart:typed_data';
+
+/// A characteristic value received on the binary notification channel.
+///
+/// Frames are packed little-endian and may be concatenated:
+///
+/// | offset | size | field                                          |
+/// |--------|------|------------------------------------------------|
+/// | 0      | 8    | device handle, as reported on connect          |
+/// | 8      | 2    | characteristic handle, as reported by discovery|
+/// | 10     | 2    | payload length                                 |
+/// | 12     | 8    | timestamp, microseconds since the Unix epoch   |
+/// | 20     | n    | payload                                        |
+class NotificationFrame {
+  static const headerSize = 20;
+
+  final int deviceHandle;
+  final int characteristicHandle;
+  final int timestampUs;
+  final Uint8List value;
+
+  NotificationFrame(this.deviceHandle, this.characteristicHandle,
+      this.timestampUs, this.value);
+
+  /// Decodes every complete frame in [data]. The values are views into
+  /// [data], not copies.
+  static List<NotificationFrame> decodeAll(ByteData data) {
+    final frames = <NotificationFrame>[];
+    var offset = 0;
+    while (data.lengthInBytes - offset >= headerSize) {
+      final length = data.getUint16(offset + 10, Endian.little);
+      if (data.lengthInBytes - offset - headerSize < length) {
+        break;
+      }
+      frames.add(NotificationFrame(
+        data.getUint64(offset, Endian.little),
+        data.getUint16(offset + 8, Endian.little),
+        data.getInt64(offset + 12, Endian.little),
+        data.buffer
+            .asUint8List(data.offsetInBytes + offset + headerSize, length),
+      ));
+      offset += headerSize + length;
+    }
+    return frames;
+  }
+}
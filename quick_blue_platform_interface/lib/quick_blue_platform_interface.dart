@@ -10,6 +10,7 @@ import 'models.dart';
 
 export 'method_channel_quick_blue.dart';
 export 'models.dart';
+export 'notification_frame.dart';
 
 typedef QuickLogger = Logger;
 
@@ -44,7 +45,7 @@ abstract class QuickBluePlatform extends PlatformInterface {
 
   void reinit();
 
-  void startScan({String? serviceId});
+  void startScan({String? serviceId, ScanSettings? settings});
 
   void stopScan();
 
@@ -52,6 +53,9 @@ abstract class QuickBluePlatform extends PlatformInterface {
 
   Stream<dynamic> get scanResultStream;
 
+  /// Ranked device lists of the nearest-N scan mode, see [ScanSettings].
+  Stream<dynamic> get scanSnapshotStream => const Stream.empty();
+
   Future<void> connect(String deviceId, {bool? auto});
 
   Future<void> disconnect(String deviceId);
@@ -84,4 +88,79 @@ abstract class QuickBluePlatform extends PlatformInterface {
   Future<void> readRssi(String deviceId);
 
   Future<int> requestMtu(String deviceId, int expectedMtu);
+
+  // The calls below are only implemented on some platforms, see
+  // [MethodChannelQuickBlue] for their documentation. The others throw an
+  // [UnimplementedError].
+
+  /// Complete [discoverServices] results, one map per device.
+  Stream<Map<dynamic, dynamic>> get gattTreeStream => const Stream.empty();
+
+  Future<void> writeReliable(String deviceId, List<GattWrite> writes,
+      {Duration? deadline}) {
+    throw UnimplementedError('writeReliable() has not been implemented.');
+  }
+
+  Future<Map<dynamic, dynamic>> writeStream(
+      String deviceId,
+      String service,
+      String characteristic,
+      Uint8List value,
+      BleOutputProperty bleOutputProperty,
+      {int? window,
+      int? maxChunkSize,
+      Duration progressInterval = const Duration(milliseconds: 100),
+      Duration? deadline,
+      void Function(int bytesWritten, int totalBytes)? onProgress}) {
+    throw UnimplementedError('writeStream() has not been implemented.');
+  }
+
+  Future<void> setWritePipeline(String deviceId,
+      {int? queueCapacity, int? window}) {
+    throw UnimplementedError('setWritePipeline() has not been implemented.');
+  }
+
+  Future<void> setGattScheduler(String deviceId, {int? concurrency}) {
+    throw UnimplementedError('setGattScheduler() has not been implemented.');
+  }
+
+  Future<void> setTimeouts(
+      {Duration? connect,
+      Duration? discoverServices,
+      Duration? setNotifiable,
+      Duration? requestMtu,
+      Duration? readValue,
+      Duration? writeValue}) {
+    throw UnimplementedError('setTimeouts() has not been implemented.');
+  }
+
+  Future<void> setOutboundQueue({OutboundOverflowPolicy? overflowPolicy}) {
+    throw UnimplementedError('setOutboundQueue() has not been implemented.');
+  }
+
+  Future<void> setNotificationBatching(String deviceId, Duration interval,
+      {int? maxEntries}) {
+    throw UnimplementedError(
+        'setNotificationBatching() has not been implemented.');
+  }
+
+  Future<void> setNotificationWireFormat(String deviceId,
+      {bool binary = true}) {
+    throw UnimplementedError(
+        'setNotificationWireFormat() has not been implemented.');
+  }
+
+  Future<void> setGattCache({bool enabled = true, String? directory}) {
+    throw UnimplementedError('setGattCache() has not been implemented.');
+  }
+
+  Future<void> setGattCachePolicy(
+      {Map<String, GattCacheMode?> characteristics = const {},
+      GattCacheMode? defaultMode}) {
+    throw UnimplementedError('setGattCachePolicy() has not been implemented.');
+  }
+
+  Future<Map<dynamic, dynamic>> getStatistics() {
+    throw UnimplementedError('getStatistics() has not been implemented.');
+  }
 }
@@ -128,7 +128,7 @@ class QuickBlueWeb extends QuickBluePlatform {
   BluetoothLEScan? _scan;
 
   @override
-  void startScan({String? serviceId}) {
+  void startScan({String? serviceId, ScanSettings? settings}) {
     ble.FlutterWebBluetooth.instance
         .requestDevice(serviceId == null
             ? ble.RequestOptionsBuilder.acceptAllDevices()
@@ -0,0 +1,297 @@
+#ifndef QUICK_BLUE_WINDOWS_ADVERTISEMENT_PARSER_H_
+#define QUICK_BLUE_WINDOWS_ADVERTISEMENT_PARSER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#include "ble_uuid.h"
+#include "fnv1a.h"
+
+namespace quick_blue {
+
+// Advertisement data decoded in a single pass into a fixed layout. The raw
+// AD structures are copied into an inline buffer and every field refers into
+// it, so decoding never touches the heap. Entries that do not fit their
+// table are counted in |truncated| instead of growing it.
+class ParsedAdvertisement {
+public:
+  // Largest advertising data of a Bluetooth 5 extended advertisement.
+  static constexpr size_t kMaxPayload = 1650;
+  static constexpr size_t kMaxManufacturerData = 4;
+  static constexpr size_t kMaxServiceUuids = 8;
+  static constexpr size_t kMaxServiceData = 4;
+
+  // AD types handled by the parser.
+  static constexpr uint8_t kFlags = 0x01;
+  static constexpr uint8_t kIncomplete16BitUuids = 0x02;
+  static constexpr uint8_t kComplete16BitUuids = 0x03;
+  static constexpr uint8_t kIncomplete32BitUuids = 0x04;
+  static constexpr uint8_t kComplete32BitUuids = 0x05;
+  static constexpr uint8_t kIncomplete128BitUuids = 0x06;
+  static constexpr uint8_t kComplete128BitUuids = 0x07;
+  static constexpr uint8_t kShortenedLocalName = 0x08;
+  static constexpr uint8_t kCompleteLocalName = 0x09;
+  static constexpr uint8_t kTxPowerLevel = 0x0A;
+  static constexpr uint8_t kServiceData16BitUuid = 0x16;
+  static constexpr uint8_t kServiceData32BitUuid = 0x20;
+  static constexpr uint8_t kServiceData128BitUuid = 0x21;
+  static constexpr uint8_t kManufacturerSpecificData = 0xFF;
+
+  struct Bytes {
+    const uint8_t *data;
+    size_t size;
+  };
+
+  struct ManufacturerData {
+    uint16_t companyId;
+    // Offset of the section, starting with the little-endian company ID.
+    uint16_t offset;
+    uint16_t length;
+  };
+
+  struct ServiceData {
+    BleUuid uuid;
+    // Offset of the data following the UUID.
+    uint16_t offset;
+    uint16_t length;
+  };
+
+  ParsedAdvertisement() = default;
+
+  void Reset() {
+    payloadLength = 0;
+    hasFlags = false;
+    hasTxPower = false;
+    nameOffset = nameLength = 0;
+    nameComplete = false;
+    manufacturerDataCount = serviceUuidCount = serviceDataCount = 0;
+    truncated = 0;
+    payloadHash = fnv1a(nullptr, 0);
+  }
+
+  // Decodes a blob of AD structures (length, type, data...). Returns false if
+  // the blob is malformed or too large; whatever was decoded up to that point
+  // is kept.
+  bool Parse(const uint8_t *data, size_t length) {
+    Reset();
+    size_t position = 0;
+    while (position < length) {
+      size_t structureLength = data[position];
+      if (structureLength == 0) {
+        // Zero length marks the end of significant data.
+        return true;
+      }
+      if (position + 1 + structureLength > length) {
+        return false;
+      }
+      if (!Append(data[position + 1], data + position + 2,
+                  structureLength - 1)) {
+        return false;
+      }
+      position += 1 + structureLength;
+    }
+    return true;
+  }
+
+  // Appends a single AD structure, e.g. one WinRT data section. Returns
+  // false if it does not fit into the payload buffer.
+  bool Append(uint8_t type, const uint8_t *data, size_t length) {
+    if (length > 0xFE || payloadLength + 2 + length > kMaxPayload) {
+      ++truncated;
+      return false;
+    }
+    payload[payloadLength] = uint8_t(length + 1);
+    payload[payloadLength + 1] = type;
+    auto offset = uint16_t(payloadLength + 2);
+    if (length > 0) {
+      std::memcpy(payload + offset, data, length);
+    }
+    payloadLength = uint16_t(offset + length);
+    Index(type, offset, uint16_t(length));
+    return true;
+  }
+
+  // Raw AD structures as received.
+  Bytes Payload() const { return {payload, payloadLength}; }
+
+  bool HasFlags() const { return hasFlags; }
+  uint8_t Flags() const { return flags; }
+
+  bool HasTxPower() const { return hasTxPower; }
+  int8_t TxPower() const { return txPower; }
+
+  // Complete name if advertised, otherwise the shortened one.
+  std::string_view LocalName() const {
+    return std::string_view(reinterpret_cast<const char *>(payload) +
+                                nameOffset,
+                            nameLength);
+  }
+
+  size_t ManufacturerDataCount() const { return manufacturerDataCount; }
+  const ManufacturerData &ManufacturerDataAt(size_t i) const {
+    return manufacturerData[i];
+  }
+  // Section including the company ID, the layout of `manufacturerDataHead`.
+  Bytes ManufacturerSection(size_t i) const {
+    return {payload + manufacturerData[i].offset, manufacturerData[i].length};
+  }
+  bool HasCompanyId(uint16_t companyId) const {
+    for (size_t i = 0; i < manufacturerDataCount; ++i) {
+      if (manufacturerData[i].companyId == companyId) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  size_t ServiceUuidCount() const { return serviceUuidCount; }
+  const BleUuid &ServiceUuidAt(size_t i) const { return serviceUuids[i]; }
+  // True if |uuid| is listed as a service or carries service data.
+  bool HasServiceUuid(const BleUuid &uuid) const {
+    for (size_t i = 0; i < serviceUuidCount; ++i) {
+      if (serviceUuids[i] == uuid) {
+        return true;
+      }
+    }
+    for (size_t i = 0; i < serviceDataCount; ++i) {
+      if (serviceData[i].uuid == uuid) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  size_t ServiceDataCount() const { return serviceDataCount; }
+  const ServiceData &ServiceDataAt(size_t i) const { return serviceData[i]; }
+  Bytes ServiceDataBytes(size_t i) const {
+    return {payload + serviceData[i].offset, serviceData[i].length};
+  }
+
+  // Number of entries dropped because a table or the payload was full.
+  size_t Truncated() const { return truncated; }
+
+  // Fingerprint of the manufacturer and service data sections.
+  uint64_t PayloadHash() const { return payloadHash; }
+
+private:
+  void Index(uint8_t type, uint16_t offset, uint16_t length) {
+    const uint8_t *data = payload + offset;
+    switch (type) {
+    case kFlags:
+      if (length >= 1) {
+        hasFlags = true;
+        flags = data[0];
+      }
+      break;
+    case kTxPowerLevel:
+      if (length >= 1) {
+        hasTxPower = true;
+        txPower = int8_t(data[0]);
+      }
+      break;
+    case kShortenedLocalName:
+    case kCompleteLocalName:
+      if (!nameComplete) {
+        nameOffset = offset;
+        nameLength = length;
+        nameComplete = type == kCompleteLocalName;
+      }
+      break;
+    case kIncomplete16BitUuids:
+    case kComplete16BitUuids:
+      IndexServiceUuids(data, length, 2);
+      break;
+    case kIncomplete32BitUuids:
+    case kComplete32BitUuids:
+      IndexServiceUuids(data, length, 4);
+      break;
+    case kIncomplete128BitUuids:
+    case kComplete128BitUuids:
+      IndexServiceUuids(data, length, 16);
+      break;
+    case kServiceData16BitUuid:
+      IndexServiceData(type, offset, length, 2);
+      break;
+    case kServiceData32BitUuid:
+      IndexServiceData(type, offset, length, 4);
+      break;
+    case kServiceData128BitUuid:
+      IndexServiceData(type, offset, length, 16);
+      break;
+    case kManufacturerSpecificData:
+      if (length < 2) {
+        break;
+      }
+      HashSection(type, data, length);
+      if (manufacturerDataCount == kMaxManufacturerData) {
+        ++truncated;
+        break;
+      }
+      manufacturerData[manufacturerDataCount++] = {
+          uint16_t(data[0] | data[1] << 8), offset, length};
+      break;
+    default:
+      break;
+    }
+  }
+
+  void IndexServiceUuids(const uint8_t *data, uint16_t length,
+                         size_t uuidSize) {
+    for (size_t i = 0; i + uuidSize <= length; i += uuidSize) {
+      if (serviceUuidCount == kMaxServiceUuids) {
+        ++truncated;
+        return;
+      }
+      serviceUuids[serviceUuidCount++] =
+          *BleUuid::FromLittleEndian(data + i, uuidSize);
+    }
+  }
+
+  void IndexServiceData(uint8_t type, uint16_t offset, uint16_t length,
+                        size_t uuidSize) {
+    if (length < uuidSize) {
+      return;
+    }
+    const uint8_t *data = payload + offset;
+    HashSection(type, data, length);
+    if (serviceDataCount == kMaxServiceData) {
+      ++truncated;
+      return;
+    }
+    serviceData[serviceDataCount++] = {
+        *BleUuid::FromLittleEndian(data, uuidSize),
+        uint16_t(offset + uuidSize), uint16_t(length - uuidSize)};
+  }
+
+  void HashSection(uint8_t type, const uint8_t *data, uint16_t length) {
+    payloadHash = fnv1a(&type, 1, payloadHash);
+    payloadHash = fnv1a(data, length, payloadHash);
+  }
+
+  uint8_t payload[kMaxPayload];
+  uint16_t payloadLength = 0;
+
+  bool hasFlags = false;
+  uint8_t flags = 0;
+  bool hasTxPower = false;
+  int8_t txPower = 0;
+  bool nameComplete = false;
+  uint16_t nameOffset = 0;
+  uint16_t nameLength = 0;
+
+  uint8_t manufacturerDataCount = 0;
+  uint8_t serviceUuidCount = 0;
+  uint8_t serviceDataCount = 0;
+  ManufacturerData manufacturerData[kMaxManufacturerData];
+  BleUuid serviceUuids[kMaxServiceUuids];
+  ServiceData serviceData[kMaxServiceData];
+
+  size_t truncated = 0;
+  uint64_t payloadHash = fnv1a(nullptr, 0);
+};
+
+} // namespace quick_blue
+
+#endif // QUICK_BLUE_WINDOWS_ADVERTISEMENT_PARSER_H_
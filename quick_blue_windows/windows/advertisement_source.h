@@ -0,0 +1,42 @@
+#ifndef QUICK_BLUE_WINDOWS_ADVERTISEMENT_SOURCE_H_
+#define QUICK_BLUE_WINDOWS_ADVERTISEMENT_SOURCE_H_
+
+#include <cstdint>
+#include <functional>
+
+#include "advertisement_parser.h"
+
+namespace quick_blue {
+
+struct ScanFilter;
+
+// Platform independent view of a received advertisement.
+struct Advertisement {
+  uint64_t address = 0;
+  int16_t rssi = 0;
+  bool scanResponse = false;
+  ParsedAdvertisement data;
+};
+
+// Producer of advertisements. The plugin only talks to this interface, so the
+// scan path can be driven by a fake source without a Bluetooth radio.
+class AdvertisementSource {
+public:
+  using Handler = std::function<void(const Advertisement &)>;
+
+  virtual ~AdvertisementSource() = default;
+
+  // Starts delivering advertisements to |handler|, possibly from several
+  // threads at once.
+  virtual void Start(Handler handler) = 0;
+  virtual void Stop() = 0;
+
+  // Hint to drop advertisements that cannot match |filter| as early as the
+  // source is able to. Takes effect on the next Start(); the caller still
+  // applies the filter itself.
+  virtual void SetFilter(const ScanFilter &filter) = 0;
+};
+
+} // namespace quick_blue
+
+#endif // QUICK_BLUE_WINDOWS_ADVERTISEMENT_SOURCE_H_
@@ -0,0 +1,123 @@
+#ifndef QUICK_BLUE_WINDOWS_ADVERTISEMENT_SUPPRESSOR_H_
+#define QUICK_BLUE_WINDOWS_ADVERTISEMENT_SUPPRESSOR_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+namespace quick_blue {
+
+// Remembers what was last forwarded per advertiser and suppresses repeats.
+// An advertisement is forwarded when its payload changed, its RSSI moved by
+// at least |rssiDelta|, or |heartbeat| passed since the last forward. Records
+// are kept in LRU order and dropped once unseen for |ttl| or when the table
+// exceeds |capacity|.
+class AdvertisementSuppressor {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Options {
+    // Unset means RSSI changes alone never cause a forward.
+    std::optional<int> rssiDelta;
+    Clock::duration heartbeat = std::chrono::seconds(1);
+    Clock::duration ttl = std::chrono::seconds(30);
+    size_t capacity = 512;
+  };
+
+  AdvertisementSuppressor() = default;
+
+  void Configure(const Options &options) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->options = options;
+    records.clear();
+    index.clear();
+  }
+
+  // |key| identifies the advertiser, e.g. its address.
+  bool ShouldForward(uint64_t key, uint64_t payloadHash, int16_t rssi,
+                     Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto forward = UpdateLocked(key, payloadHash, rssi, now);
+    // Only once the record is no longer used, as it may be evicted itself.
+    EvictLocked(now);
+    ++(forward ? forwarded : suppressed);
+    return forward;
+  }
+
+  size_t Size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return records.size();
+  }
+
+  uint64_t Forwarded() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return forwarded;
+  }
+
+  uint64_t Suppressed() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return suppressed;
+  }
+
+private:
+  struct Record {
+    uint64_t key;
+    uint64_t payloadHash;
+    int16_t rssi;
+    Clock::time_point lastForwarded;
+    Clock::time_point lastSeen;
+  };
+
+  // Records the advertisement and moves its record to the front. Returns
+  // whether it is to be forwarded.
+  bool UpdateLocked(uint64_t key, uint64_t payloadHash, int16_t rssi,
+                    Clock::time_point now) {
+    auto it = index.find(key);
+    if (it == index.end()) {
+      records.push_front(Record{key, payloadHash, rssi, now, now});
+      index.emplace(key, records.begin());
+      return true;
+    }
+
+    auto &record = *it->second;
+    records.splice(records.begin(), records, it->second);
+    record.lastSeen = now;
+    bool changed = record.payloadHash != payloadHash ||
+                   (options.rssiDelta &&
+                    std::abs(rssi - record.rssi) >= *options.rssiDelta) ||
+                   now - record.lastForwarded >= options.heartbeat;
+    if (!changed) {
+      return false;
+    }
+    record.payloadHash = payloadHash;
+    record.rssi = rssi;
+    record.lastForwarded = now;
+    return true;
+  }
+
+  // The list is ordered by lastSeen, so expired records sit at the back.
+  void EvictLocked(Clock::time_point now) {
+    while (!records.empty() &&
+           (records.size() > options.capacity ||
+            now - records.back().lastSeen >= options.ttl)) {
+      index.erase(records.back().key);
+      records.pop_back();
+    }
+  }
+
+  mutable std::mutex mutex;
+  Options options;
+  std::list<Record> records;
+  std::unordered_map<uint64_t, std::list<Record>::iterator> index;
+  uint64_t forwarded = 0;
+  uint64_t suppressed = 0;
+};
+
+} // namespace quick_blue
+
+#endif // QUICK_BLUE_WINDOWS_ADVERTISEMENT_SUPPRESSOR_H_
@@ -0,0 +1,57 @@
+#ifndef QUICK_BLUE_WINDOWS_BATCHER_H_
+#define QUICK_BLUE_WINDOWS_BATCHER_H_
+
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace quick_blue {
+
+// Thread-safe accumulator that turns a stream of items into batches. A batch
+// is handed out as soon as it holds |maxItems| items; the owner is expected to
+// Drain() the remainder on a timer so no item waits longer than one interval.
+template <typename T> class Batcher {
+public:
+  explicit Batcher(size_t maxItems) : maxItems(maxItems > 0 ? maxItems : 1) {
+    pending.reserve(this->maxItems);
+  }
+
+  // Appends |item| and returns the full batch if it reached |maxItems|,
+  // otherwise an empty vector.
+  std::vector<T> Add(T item) {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.push_back(std::move(item));
+    if (pending.size() < maxItems) {
+      return {};
+    }
+    return TakeLocked();
+  }
+
+  // Returns everything accumulated so far.
+  std::vector<T> Drain() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return TakeLocked();
+  }
+
+  void SetMaxItems(size_t maxItems) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->maxItems = maxItems > 0 ? maxItems : 1;
+  }
+
+private:
+  std::vector<T> TakeLocked() {
+    std::vector<T> batch;
+    batch.reserve(maxItems);
+    batch.swap(pending);
+    return batch;
+  }
+
+  std::mutex mutex;
+  size_t maxItems;
+  std::vector<T> pending;
+};
+
+} // namespace quick_blue
+
+#endif // QUICK_BLUE_WINDOWS_BATCHER_H_
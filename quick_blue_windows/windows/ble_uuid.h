@@ -0,0 +1,130 @@
+#ifndef QUICK_BLUE_WINDOWS_BLE_UUID_H_
+#define QUICK_BLUE_WINDOWS_BLE_UUID_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <optional>
+#include <string>
+
+namespace quick_blue {
+
+// 128-bit Bluetooth UUID with the same memory layout as a Windows GUID, so it
+// converts to and from winrt::guid with a plain copy.
+struct BleUuid {
+  uint32_t data1 = 0;
+  uint16_t data2 = 0;
+  uint16_t data3 = 0;
+  uint8_t data4[8] = {};
+
+  // Expands a 16 or 32-bit assigned number using the Bluetooth base UUID
+  // 00000000-0000-1000-8000-00805f9b34fb.
+  static BleUuid FromShort(uint32_t value) {
+    return BleUuid{value, 0x0000, 0x1000,
+                   {0x80, 0x00, 0x00, 0x80, 0x5f, 0x9b, 0x34, 0xfb}};
+  }
+
+  // Expands a little-endian 16, 32 or 128-bit UUID as found in advertisement
+  // data. Returns nullopt for any other length.
+  static std::optional<BleUuid> FromLittleEndian(const uint8_t *bytes,
+                                                 size_t length) {
+    if (length == 2) {
+      return FromShort(uint32_t(bytes[0] | bytes[1] << 8));
+    }
+    if (length == 4) {
+      return FromShort(uint32_t(bytes[0]) | uint32_t(bytes[1]) << 8 |
+                       uint32_t(bytes[2]) << 16 | uint32_t(bytes[3]) << 24);
+    }
+    if (length != 16) {
+      return std::nullopt;
+    }
+    BleUuid uuid;
+    for (int i = 0; i < 8; ++i) {
+      uuid.data4[i] = bytes[7 - i];
+    }
+    uuid.data3 = uint16_t(bytes[8] | bytes[9] << 8);
+    uuid.data2 = uint16_t(bytes[10] | bytes[11] << 8);
+    uuid.data1 = uint32_t(bytes[12]) | uint32_t(bytes[13]) << 8 |
+                 uint32_t(bytes[14]) << 16 | uint32_t(bytes[15]) << 24;
+    return uuid;
+  }
+
+  // Parses the canonical 36 character form, or a 4/8 digit short form.
+  static std::optional<BleUuid> Parse(const std::string &text) {
+    uint8_t nibbles[32];
+    size_t count = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+      char c = text[i];
+      if (c == '-' && (i == 8 || i == 13 || i == 18 || i == 23)) {
+        continue;
+      }
+      if (count == sizeof(nibbles)) {
+        return std::nullopt;
+      }
+      if (c >= '0' && c <= '9') {
+        nibbles[count++] = uint8_t(c - '0');
+      } else if (c >= 'a' && c <= 'f') {
+        nibbles[count++] = uint8_t(c - 'a' + 10);
+      } else if (c >= 'A' && c <= 'F') {
+        nibbles[count++] = uint8_t(c - 'A' + 10);
+      } else {
+        return std::nullopt;
+      }
+    }
+    auto read = [&nibbles](size_t offset, size_t digits) {
+      uint32_t value = 0;
+      for (size_t i = 0; i < digits; ++i) {
+        value = value << 4 | nibbles[offset + i];
+      }
+      return value;
+    };
+    if ((count == 4 || count == 8) && text.size() == count) {
+      return FromShort(read(0, count));
+    }
+    if (count != 32 || text.size() != 36) {
+      return std::nullopt;
+    }
+    BleUuid uuid;
+    uuid.data1 = read(0, 8);
+    uuid.data2 = uint16_t(read(8, 4));
+    uuid.data3 = uint16_t(read(12, 4));
+    for (size_t i = 0; i < 8; ++i) {
+      uuid.data4[i] = uint8_t(read(16 + i * 2, 2));
+    }
+    return uuid;
+  }
+
+  std::string ToString() const {
+    char chars[36 + 1];
+    std::snprintf(chars, sizeof(chars),
+                  "%08x-%04x-%04x-%02x%02x-%02x%02x%02x%02x%02x%02x", data1,
+                  data2, data3, data4[0], data4[1], data4[2], data4[3],
+                  data4[4], data4[5], data4[6], data4[7]);
+    return std::string{chars};
+  }
+
+  bool operator==(const BleUuid &other) const {
+    return data1 == other.data1 && data2 == other.data2 &&
+           data3 == other.data3 &&
+           std::memcmp(data4, other.data4, sizeof(data4)) == 0;
+  }
+
+  bool operator!=(const BleUuid &other) const { return !(*this == other); }
+};
+
+static_assert(sizeof(BleUuid) == 16, "BleUuid must match the GUID layout");
+
+struct BleUuidHash {
+  size_t operator()(const BleUuid &uuid) const {
+    uint64_t high, low;
+    std::memcpy(&high, &uuid, sizeof(high));
+    std::memcpy(&low, reinterpret_cast<const uint8_t *>(&uuid) + sizeof(high),
+                sizeof(low));
+    return std::hash<uint64_t>()(high ^ (low * 0x9e3779b97f4a7c15ull));
+  }
+};
+
+} // namespace quick_blue
+
+#endif // QUICK_BLUE_WINDOWS_BLE_UUID_H_
@@ -0,0 +1,172 @@
+#ifndef QUICK_BLUE_WINDOWS_BOUNDED_EXECUTOR_H_
+#define QUICK_BLUE_WINDOWS_BOUNDED_EXECUTOR_H_
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace quick_blue {
+
+// Fixed-size worker pool with a bounded queue. Tasks posted with the same key
+// run one at a time in posting order; tasks with different keys run in
+// parallel up to |concurrency|. When the queue is full the oldest queued task
+// is dropped so a burst cannot delay fresh work indefinitely.
+class BoundedExecutor {
+public:
+  using Task = std::function<void()>;
+
+  struct Options {
+    size_t concurrency = 4;
+    size_t capacity = 256;
+    // Run on each worker thread before and after it processes tasks, e.g. to
+    // set up the threading apartment.
+    std::function<void()> onWorkerStart;
+    std::function<void()> onWorkerStop;
+  };
+
+  explicit BoundedExecutor(Options options) : options(std::move(options)) {
+    this->options.concurrency = std::max<size_t>(this->options.concurrency, 1);
+    this->options.capacity = std::max<size_t>(this->options.capacity, 1);
+    workers.reserve(this->options.concurrency);
+    for (size_t i = 0; i < this->options.concurrency; ++i) {
+      workers.emplace_back([this] { WorkerLoop(); });
+    }
+  }
+
+  ~BoundedExecutor() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+      queue.clear();
+    }
+    wakeup.notify_all();
+    for (auto &worker : workers) {
+      worker.join();
+    }
+  }
+
+  BoundedExecutor(const BoundedExecutor &) = delete;
+  BoundedExecutor &operator=(const BoundedExecutor &) = delete;
+
+  // Queues |task| behind earlier tasks posted with |key|. Returns false if an
+  // older task had to be dropped to make room.
+  bool Post(uint64_t key, Task task) {
+    bool dropped = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (stopping) {
+        return false;
+      }
+      if (queue.size() >= options.capacity) {
+        queue.pop_front();
+        ++droppedCount;
+        dropped = true;
+      }
+      queue.push_back(Item{key, std::move(task)});
+      maxQueueDepth = std::max(maxQueueDepth, queue.size());
+    }
+    wakeup.notify_one();
+    return !dropped;
+  }
+
+  // Discards all queued tasks. Tasks already running are not interrupted.
+  void Clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    queue.clear();
+  }
+
+  size_t QueueDepth() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return queue.size();
+  }
+
+  size_t MaxQueueDepth() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return maxQueueDepth;
+  }
+
+  uint64_t Dropped() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return droppedCount;
+  }
+
+  uint64_t Executed() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return executedCount;
+  }
+
+private:
+  struct Item {
+    uint64_t key;
+    Task task;
+  };
+
+  // First queued task whose key is not running. The queue is bounded, so the
+  // scan is too.
+  std::deque<Item>::iterator NextRunnableLocked() {
+    return std::find_if(queue.begin(), queue.end(), [this](const Item &item) {
+      return runningKeys.count(item.key) == 0;
+    });
+  }
+
+  void WorkerLoop() {
+    if (options.onWorkerStart) {
+      options.onWorkerStart();
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      auto next = queue.end();
+      wakeup.wait(lock, [this, &next] {
+        next = NextRunnableLocked();
+        return stopping || next != queue.end();
+      });
+      if (stopping) {
+        break;
+      }
+
+      auto item = std::move(*next);
+      queue.erase(next);
+      runningKeys.insert(item.key);
+      lock.unlock();
+      try {
+        item.task();
+      } catch (...) {
+        // A failing task must not take the worker down.
+      }
+      lock.lock();
+      runningKeys.erase(item.key);
+      ++executedCount;
+      // Queued tasks of this key may have become runnable for another worker.
+      wakeup.notify_all();
+    }
+    lock.unlock();
+    if (options.onWorkerStop) {
+      options.onWorkerStop();
+    }
+  }
+
+  Options options;
+
+  mutable std::mutex mutex;
+  std::condition_variable wakeup;
+  std::deque<Item> queue;
+  std::unordered_set<uint64_t> runningKeys;
+  bool stopping = false;
+  size_t maxQueueDepth = 0;
+  uint64_t droppedCount = 0;
+  uint64_t executedCount = 0;
+
+  std::vector<std::thread> workers;
+};
+
+} // namespace quick_blue
+
+#endif // QUICK_BLUE_WINDOWS_BOUNDED_EXECUTOR_H_
@@ -0,0 +1,73 @@
+#ifndef QUICK_BLUE_WINDOWS_BYTE_BUFFER_POOL_H_
+#define QUICK_BLUE_WINDOWS_BYTE_BUFFER_POOL_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace quick_blue {
+
+// Thread-safe free list of byte vectors for the notification path. Acquire()
+// hands out a vector of the requested size, reusing the storage of a
+// previously Release()d one when possible, so steady-state traffic does not
+// touch the heap. Buffers that grew beyond |maxCapacity| are dropped on
+// release so one large read does not pin memory forever.
+class ByteBufferPool {
+public:
+  explicit ByteBufferPool(size_t maxBuffers = 16, size_t maxCapacity = 4096)
+      : maxBuffers(maxBuffers), maxCapacity(maxCapacity) {}
+
+  // Returns a vector of |size| bytes. The contents are unspecified.
+  std::vector<uint8_t> Acquire(size_t size) {
+    std::vector<uint8_t> buffer;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!free.empty()) {
+        buffer = std::move(free.back());
+        free.pop_back();
+      }
+    }
+    if (buffer.capacity() < size) {
+      allocations.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      reuses.fetch_add(1, std::memory_order_relaxed);
+    }
+    buffer.resize(size);
+    return buffer;
+  }
+
+  // Returns |buffer| to the pool.
+  void Release(std::vector<uint8_t> buffer) {
+    if (buffer.capacity() == 0 || buffer.capacity() > maxCapacity) {
+      return;
+    }
+    buffer.clear();
+    std::lock_guard<std::mutex> lock(mutex);
+    if (free.size() < maxBuffers) {
+      free.push_back(std::move(buffer));
+    }
+  }
+
+  // Number of Acquire() calls that had to allocate.
+  uint64_t Allocations() const {
+    return allocations.load(std::memory_order_relaxed);
+  }
+
+  // Number of Acquire() calls served from pooled storage.
+  uint64_t Reuses() const { return reuses.load(std::memory_order_relaxed); }
+
+private:
+  std::mutex mutex;
+  size_t maxBuffers;
+  size_t maxCapacity;
+  std::vector<std::vector<uint8_t>> free;
+  std::atomic<uint64_t> allocations{0};
+  std::atomic<uint64_t> reuses{0};
+};
+
+} // namespace quick_blue
+
+#endif // QUICK_BLUE_WINDOWS_BYTE_BUFFER_POOL_H_
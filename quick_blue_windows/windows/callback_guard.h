@@ -0,0 +1,74 @@
+#ifndef QUICK_BLUE_WINDOWS_CALLBACK_GUARD_H_
+#define QUICK_BLUE_WINDOWS_CALLBACK_GUARD_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+
+namespace quick_blue {
+
+// Lets callbacks on other threads, such as thread pool timers, use their
+// owner only while it is alive. A callback runs inside a Scope from Enter();
+// Close() refuses new scopes and waits for the open ones to end, so the
+// owner may be destroyed once it returns. Callbacks keep the guard itself
+// alive by holding it in a shared_ptr. Close() must not be called from
+// inside a scope. Thread-safe.
+class CallbackGuard {
+public:
+  class Scope {
+  public:
+    Scope(Scope &&other) noexcept : guard(other.guard) {
+      other.guard = nullptr;
+    }
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+    Scope &operator=(Scope &&) = delete;
+
+    ~Scope() {
+      if (guard) {
+        guard->Leave();
+      }
+    }
+
+    // False once the guard was closed: the callback must return right away.
+    explicit operator bool() const { return guard != nullptr; }
+
+  private:
+    friend class CallbackGuard;
+    explicit Scope(CallbackGuard *guard) : guard(guard) {}
+
+    CallbackGuard *guard;
+  };
+
+  Scope Enter() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (closed) {
+      return Scope(nullptr);
+    }
+    ++active;
+    return Scope(this);
+  }
+
+  void Close() {
+    std::unique_lock<std::mutex> lock(mutex);
+    closed = true;
+    left.wait(lock, [this] { return active == 0; });
+  }
+
+private:
+  void Leave() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (--active == 0) {
+      left.notify_all();
+    }
+  }
+
+  std::mutex mutex;
+  std::condition_variable left;
+  size_t active = 0;
+  bool closed = false;
+};
+
+} // namespace quick_blue
+
+#endif // QUICK_BLUE_WINDOWS_CALLBACK_GUARD_H_
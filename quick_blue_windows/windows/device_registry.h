@@ -0,0 +1,116 @@
+#ifndef QUICK_BLUE_WINDOWS_DEVICE_REGISTRY_H_
+#define QUICK_BLUE_WINDOWS_DEVICE_REGISTRY_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace quick_blue {
+
+// Connected devices by Bluetooth address. Lookups load the current table
+// with one atomic operation and never wait for a writer; connects and
+// disconnects, which are rare, copy the table, change the copy and publish
+// it under a lock. Agents are shared, so an operation that looked one up
+// keeps it alive across a disconnect. Each registration has a generation,
+// so a late event of an earlier connection cannot remove a later one.
+// Thread-safe.
+template <typename Agent> class DeviceRegistry {
+public:
+  // Matches every registration in Remove(). Generations are never 0.
+  static constexpr uint64_t kAnyGeneration = 0;
+
+  struct Entry {
+    std::shared_ptr<Agent> agent;
+    uint64_t generation;
+  };
+  using Table = std::unordered_map<uint64_t, Entry>;
+
+  DeviceRegistry() = default;
+  DeviceRegistry(const DeviceRegistry &) = delete;
+  DeviceRegistry &operator=(const DeviceRegistry &) = delete;
+
+  // A new generation to register a device with.
+  uint64_t NextGeneration() {
+    return lastGeneration.fetch_add(1, std::memory_order_relaxed) + 1;
+  }
+
+  // The agent of |address|, or nullptr if it is not connected.
+  std::shared_ptr<Agent> Find(uint64_t address) const {
+    auto current = Load();
+    auto it = current->find(address);
+    return it != current->end() ? it->second.agent : nullptr;
+  }
+
+  // The agent of |address| if it is still registration |generation|.
+  std::shared_ptr<Agent> Find(uint64_t address, uint64_t generation) const {
+    auto current = Load();
+    auto it = current->find(address);
+    if (it == current->end() || it->second.generation != generation) {
+      return nullptr;
+    }
+    return it->second.agent;
+  }
+
+  // All connected devices at one point in time, unaffected by later
+  // changes.
+  std::shared_ptr<const Table> Snapshot() const { return Load(); }
+
+  size_t Size() const { return Load()->size(); }
+
+  // Registers |agent| as generation |generation| of |address|. Returns
+  // false, leaving the registry as is, if |address| is registered already.
+  bool Insert(uint64_t address, uint64_t generation,
+              std::shared_ptr<Agent> agent) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    auto current = Load();
+    if (current->count(address) != 0) {
+      return false;
+    }
+    auto next = std::make_shared<Table>(*current);
+    next->emplace(address, Entry{std::move(agent), generation});
+    Store(std::move(next));
+    return true;
+  }
+
+  // Unregisters |address| if it is registration |generation|, or whatever
+  // registration it is with kAnyGeneration. Returns the agent removed, or
+  // nullptr if there was none.
+  std::shared_ptr<Agent> Remove(uint64_t address,
+                                uint64_t generation = kAnyGeneration) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    auto current = Load();
+    auto it = current->find(address);
+    if (it == current->end() || (generation != kAnyGeneration &&
+                                 it->second.generation != generation)) {
+      return nullptr;
+    }
+    auto removed = it->second.agent;
+    auto next = std::make_shared<Table>(*current);
+    next->erase(address);
+    Store(std::move(next));
+    return removed;
+  }
+
+private:
+  std::shared_ptr<const Table> Load() const {
+    return std::atomic_load_explicit(&table, std::memory_order_acquire);
+  }
+
+  void Store(std::shared_ptr<const Table> next) {
+    std::atomic_store_explicit(&table, std::move(next),
+                               std::memory_order_release);
+  }
+
+  // Serializes writers only; readers go through the atomic |table|.
+  std::mutex writeMutex;
+  std::shared_ptr<const Table> table = std::make_shared<const Table>();
+  std::atomic<uint64_t> lastGeneration{0};
+};
+
+} // namespace quick_blue
+
+#endif // QUICK_BLUE_WINDOWS_DEVICE_REGISTRY_H_
@@ -0,0 +1,21 @@
+#ifndef QUICK_BLUE_WINDOWS_FNV1A_H_
+#define QUICK_BLUE_WINDOWS_FNV1A_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace quick_blue {
+
+// 64-bit FNV-1a, used to fingerprint advertisement payloads and to checksum
+// cache files.
+inline uint64_t fnv1a(const uint8_t *data, size_t length,
+                      uint64_t hash = 0xcbf29ce484222325ull) {
+  for (size_t i = 0; i < length; ++i) {
+    hash = (hash ^ data[i]) * 0x100000001b3ull;
+  }
+  return hash;
+}
+
+} // namespace quick_blue
+
+#endif // QUICK_BLUE_WINDOWS_FNV1A_H_
@@ -0,0 +1,109 @@
+#ifndef QUICK_BLUE_WINDOWS_GATT_CACHE_POLICY_H_
+#define QUICK_BLUE_WINDOWS_GATT_CACHE_POLICY_H_
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include "ble_uuid.h"
+
+namespace quick_blue {
+
+enum class GattCacheMode {
+  // Served from the system GATT cache, from the device on a miss.
+  Cached,
+  // Always read from the device.
+  Uncached,
+};
+
+// Parses the `cacheMode` argument of method calls.
+inline std::optional<GattCacheMode> ParseGattCacheMode(const std::string &s) {
+  if (s == "cached") {
+    return GattCacheMode::Cached;
+  }
+  if (s == "uncached") {
+    return GattCacheMode::Uncached;
+  }
+  return std::nullopt;
+}
+
+// Cache mode of characteristic reads that do not ask for one, by
+// characteristic UUID. Values that cannot change while connected, such as
+// the Device Information strings, are served from the cache; everything
+// else is read live. Thread-safe.
+class GattCachePolicy {
+public:
+  GattCachePolicy() {
+    for (uint16_t uuid : {
+             0x2A01, // Appearance
+             0x2A23, // System ID
+             0x2A24, // Model Number String
+             0x2A25, // Serial Number String
+             0x2A26, // Firmware Revision String
+             0x2A27, // Hardware Revision String
+             0x2A28, // Software Revision String
+             0x2A29, // Manufacturer Name String
+             0x2A50, // PnP ID
+         }) {
+      modes.emplace(BleUuid::FromShort(uuid), GattCacheMode::Cached);
+    }
+  }
+
+  GattCacheMode Mode(const BleUuid &characteristic) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = modes.find(characteristic);
+    return it != modes.end() ? it->second : defaultMode;
+  }
+
+  void Set(const BleUuid &characteristic, GattCacheMode mode) {
+    std::lock_guard<std::mutex> lock(mutex);
+    modes[characteristic] = mode;
+  }
+
+  // Reverts |characteristic| to the default mode.
+  void Reset(const BleUuid &characteristic) {
+    std::lock_guard<std::mutex> lock(mutex);
+    modes.erase(characteristic);
+  }
+
+  // The mode of characteristics without an entry.
+  void SetDefault(GattCacheMode mode) {
+    std::lock_guard<std::mutex> lock(mutex);
+    defaultMode = mode;
+  }
+
+private:
+  mutable std::mutex mutex;
+  std::unordered_map<BleUuid, GattCacheMode, BleUuidHash> modes;
+  GattCacheMode defaultMode = GattCacheMode::Uncached;
+};
+
+// Discovery steps and reads with a cache mode of one device, answered from
+// the system GATT cache (hits) or by the device (misses). A cached request
+// that failed went to the device after all, so it counts as a miss.
+// Thread-safe.
+class GattCacheCounters {
+public:
+  void Count(GattCacheMode mode, bool succeeded) {
+    if (mode == GattCacheMode::Cached && succeeded) {
+      hits++;
+    } else {
+      misses++;
+    }
+  }
+
+  uint64_t Hits() const { return hits.load(); }
+
+  uint64_t Misses() const { return misses.load(); }
+
+private:
+  std::atomic<uint64_t> hits{0};
+  std::atomic<uint64_t> misses{0};
+};
+
+} // namespace quick_blue
+
+#endif // QUICK_BLUE_WINDOWS_GATT_CACHE_POLICY_H_
@@ -0,0 +1,274 @@
+#ifndef QUICK_BLUE_WINDOWS_GATT_LAYOUT_CACHE_H_
+#define QUICK_BLUE_WINDOWS_GATT_LAYOUT_CACHE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <system_error>
+#include <vector>
+
+#include "ble_uuid.h"
+#include "fnv1a.h"
+
+namespace quick_blue {
+
+// The services and characteristics of a device, in enumeration order.
+struct GattLayout {
+  struct Characteristic {
+    BleUuid uuid;
+    // Attribute handle, telling apart characteristics that share a UUID.
+    uint16_t instance = 0;
+    // GattCharacteristicProperties bits.
+    uint32_t properties = 0;
+    std::vector<BleUuid> descriptors;
+  };
+
+  struct Service {
+    BleUuid uuid;
+    std::vector<Characteristic> characteristics;
+  };
+
+  std::vector<Service> services;
+
+  static constexpr uint32_t kMagic = 0x43474251; // "QBGC"
+  static constexpr uint16_t kVersion = 2;
+
+  // Little-endian:
+  //   magic u32, version u16, service count u16, address u64,
+  //   per service: uuid, characteristic count u16,
+  //     per characteristic: uuid, instance u16, properties u32,
+  //       descriptor count u16, per descriptor: uuid,
+  //   FNV-1a of all preceding bytes u64.
+  // A uuid is written as data1 u32, data2 u16, data3 u16, data4[8].
+  std::vector<uint8_t> Serialize(uint64_t address) const {
+    std::vector<uint8_t> out;
+    Write(out, kMagic, 4);
+    Write(out, kVersion, 2);
+    Write(out, services.size(), 2);
+    Write(out, address, 8);
+    for (const auto &service : services) {
+      WriteUuid(out, service.uuid);
+      Write(out, service.characteristics.size(), 2);
+      for (const auto &characteristic : service.characteristics) {
+        WriteUuid(out, characteristic.uuid);
+        Write(out, characteristic.instance, 2);
+        Write(out, characteristic.properties, 4);
+        Write(out, characteristic.descriptors.size(), 2);
+        for (const auto &descriptor : characteristic.descriptors) {
+          WriteUuid(out, descriptor);
+        }
+      }
+    }
+    Write(out, fnv1a(out.data(), out.size()), 8);
+    return out;
+  }
+
+  // Returns nullopt unless |data| is a complete, intact layout of the
+  // current version for |address|.
+  static std::optional<GattLayout> Deserialize(const uint8_t *data,
+                                               size_t length,
+                                               uint64_t address) {
+    if (length < 24 ||
+        Read(data + length - 8, 8) != fnv1a(data, length - 8)) {
+      return std::nullopt;
+    }
+    size_t offset = 0;
+    auto end = length - 8;
+    auto take = [&](size_t size, uint64_t &value) {
+      if (end - offset < size) {
+        return false;
+      }
+      value = Read(data + offset, size);
+      offset += size;
+      return true;
+    };
+    auto takeUuid = [&](BleUuid &uuid) {
+      if (end - offset < 16) {
+        return false;
+      }
+      uuid.data1 = uint32_t(Read(data + offset, 4));
+      uuid.data2 = uint16_t(Read(data + offset + 4, 2));
+      uuid.data3 = uint16_t(Read(data + offset + 6, 2));
+      for (size_t i = 0; i < 8; ++i) {
+        uuid.data4[i] = data[offset + 8 + i];
+      }
+      offset += 16;
+      return true;
+    };
+    uint64_t magic = 0, version = 0, serviceCount = 0, storedAddress = 0;
+    if (!take(4, magic) || magic != kMagic || !take(2, version) ||
+        version != kVersion || !take(2, serviceCount) ||
+        !take(8, storedAddress) || storedAddress != address) {
+      return std::nullopt;
+    }
+    GattLayout layout;
+    layout.services.resize(serviceCount);
+    for (auto &service : layout.services) {
+      uint64_t characteristicCount = 0;
+      if (!takeUuid(service.uuid) || !take(2, characteristicCount)) {
+        return std::nullopt;
+      }
+      service.characteristics.resize(characteristicCount);
+      for (auto &characteristic : service.characteristics) {
+        uint64_t instance = 0, properties = 0, descriptorCount = 0;
+        if (!takeUuid(characteristic.uuid) || !take(2, instance) ||
+            !take(4, properties) || !take(2, descriptorCount)) {
+          return std::nullopt;
+        }
+        characteristic.instance = uint16_t(instance);
+        characteristic.properties = uint32_t(properties);
+        characteristic.descriptors.resize(descriptorCount);
+        for (auto &descriptor : characteristic.descriptors) {
+          if (!takeUuid(descriptor)) {
+            return std::nullopt;
+          }
+        }
+      }
+    }
+    if (offset != end) {
+      return std::nullopt;
+    }
+    return layout;
+  }
+
+  bool operator==(const GattLayout &other) const {
+    if (services.size() != other.services.size()) {
+      return false;
+    }
+    for (size_t i = 0; i < services.size(); ++i) {
+      const auto &a = services[i];
+      const auto &b = other.services[i];
+      if (a.uuid != b.uuid ||
+          a.characteristics.size() != b.characteristics.size()) {
+        return false;
+      }
+      for (size_t j = 0; j < a.characteristics.size(); ++j) {
+        const auto &x = a.characteristics[j];
+        const auto &y = b.characteristics[j];
+        if (x.uuid != y.uuid || x.instance != y.instance ||
+            x.properties != y.properties ||
+            x.descriptors.size() != y.descriptors.size()) {
+          return false;
+        }
+        for (size_t k = 0; k < x.descriptors.size(); ++k) {
+          if (x.descriptors[k] != y.descriptors[k]) {
+            return false;
+          }
+        }
+      }
+    }
+    return true;
+  }
+
+  bool operator!=(const GattLayout &other) const { return !(*this == other); }
+
+private:
+  static void Write(std::vector<uint8_t> &out, uint64_t value, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+      out.push_back(uint8_t(value >> (8 * i)));
+    }
+  }
+
+  static void WriteUuid(std::vector<uint8_t> &out, const BleUuid &uuid) {
+    Write(out, uuid.data1, 4);
+    Write(out, uuid.data2, 2);
+    Write(out, uuid.data3, 2);
+    out.insert(out.end(), uuid.data4, uuid.data4 + 8);
+  }
+
+  static uint64_t Read(const uint8_t *in, size_t size) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < size; ++i) {
+      value |= uint64_t(in[i]) << (8 * i);
+    }
+    return value;
+  }
+};
+
+// GATT layouts persisted across connections, one small file per device
+// address in |directory|. Files are replaced atomically and verified on
+// load, so a torn or stale file reads as a miss. Disabled while the directory
+// is empty. Thread-safe.
+class GattLayoutCache {
+public:
+  void SetDirectory(std::filesystem::path directory) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->directory = std::move(directory);
+  }
+
+  bool Enabled() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return !directory.empty();
+  }
+
+  std::optional<GattLayout> Load(uint64_t address) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (directory.empty()) {
+      return std::nullopt;
+    }
+    std::ifstream file(PathOf(address), std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+                              std::istreambuf_iterator<char>());
+    auto layout = GattLayout::Deserialize(data.data(), data.size(), address);
+    (layout ? hits : misses).fetch_add(1, std::memory_order_relaxed);
+    return layout;
+  }
+
+  bool Store(uint64_t address, const GattLayout &layout) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (directory.empty()) {
+      return false;
+    }
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    auto path = PathOf(address);
+    auto temporary = path;
+    temporary += ".tmp";
+    {
+      auto data = layout.Serialize(address);
+      std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+      file.write(reinterpret_cast<const char *>(data.data()),
+                 std::streamsize(data.size()));
+      if (!file) {
+        return false;
+      }
+    }
+    std::filesystem::rename(temporary, path, error);
+    return !error;
+  }
+
+  void Remove(uint64_t address) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (directory.empty()) {
+      return;
+    }
+    std::error_code error;
+    std::filesystem::remove(PathOf(address), error);
+  }
+
+  uint64_t Hits() const { return hits.load(std::memory_order_relaxed); }
+  uint64_t Misses() const { return misses.load(std::memory_order_relaxed); }
+
+private:
+  std::filesystem::path PathOf(uint64_t address) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%012llx.gatt",
+                  static_cast<unsigned long long>(address));
+    return directory / name;
+  }
+
+  mutable std::mutex mutex;
+  std::filesystem::path directory;
+  std::atomic<uint64_t> hits{0};
+  std::atomic<uint64_t> misses{0};
+};
+
+} // namespace quick_blue
+
+#endif // QUICK_BLUE_WINDOWS_GATT_LAYOUT_CACHE_H_
@@ -0,0 +1,311 @@
+#ifndef QUICK_BLUE_WINDOWS_GATT_SCHEDULER_H_
+#define QUICK_BLUE_WINDOWS_GATT_SCHEDULER_H_
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "latency_histogram.h"
+
+namespace quick_blue {
+
+// Classes of GATT operations, most urgent first.
+enum class GattPriority {
+  // MTU, discovery and other link-level requests.
+  Control,
+  // Client Characteristic Configuration writes.
+  Subscription,
+  Read,
+  // Writes, which tend to come in bursts.
+  BulkWrite,
+};
+
+// Admission control for the GATT operations of one device. At most
+// |concurrency| operations hold a slot at once; queued operations are
+// granted the next free slot strictly by priority, then in submission
+// order. An operation still queued at its deadline expires instead of
+// running late, and Cancel() turns every queued operation away when the
+// device disconnects. Operations already running are not interrupted.
+// Thread-safe; owned by a shared_ptr.
+class GattScheduler : public std::enable_shared_from_this<GattScheduler> {
+public:
+  using Clock = std::chrono::steady_clock;
+  static constexpr Clock::time_point kNoDeadline = Clock::time_point::max();
+
+  enum class State { Queued, Granted, Expired, Cancelled };
+
+  // Called exactly once for a Queued operation, with its ticket id and
+  // Granted, Expired or Cancelled, on the thread that decided it. Never
+  // called with the scheduler's lock held.
+  using Callback = std::function<void(uint64_t id, State state)>;
+
+  struct Ticket {
+    uint64_t id;
+    // Queued, or the final state if decided right away, in which case the
+    // callback is dropped.
+    State state;
+  };
+
+  struct Counters {
+    uint64_t granted = 0;
+    uint64_t expired = 0;
+    uint64_t cancelled = 0;
+    size_t running = 0;
+    size_t queued = 0;
+    size_t maxQueueDepth = 0;
+  };
+
+  // A granted slot, released when destroyed. Movable; also carries the
+  // state of an operation that was turned away.
+  class Slot {
+  public:
+    Slot() = default;
+    Slot(std::shared_ptr<GattScheduler> scheduler, uint64_t id, State state)
+        : scheduler(std::move(scheduler)), id(id), state(state) {}
+    Slot(Slot &&other) noexcept { *this = std::move(other); }
+    Slot &operator=(Slot &&other) noexcept {
+      if (this != &other) {
+        Release();
+        scheduler = std::move(other.scheduler);
+        id = other.id;
+        state = std::exchange(other.state, State::Cancelled);
+      }
+      return *this;
+    }
+    Slot(const Slot &) = delete;
+    Slot &operator=(const Slot &) = delete;
+    ~Slot() { Release(); }
+
+    explicit operator bool() const { return state == State::Granted; }
+    State GetState() const { return state; }
+
+    void Release() {
+      if (state == State::Granted && scheduler) {
+        scheduler->Release(id);
+      }
+      state = State::Cancelled;
+    }
+
+  private:
+    std::shared_ptr<GattScheduler> scheduler;
+    uint64_t id = 0;
+    State state = State::Cancelled;
+  };
+
+  explicit GattScheduler(size_t concurrency = 4)
+      : concurrency(std::max<size_t>(concurrency, 1)) {}
+
+  GattScheduler(const GattScheduler &) = delete;
+  GattScheduler &operator=(const GattScheduler &) = delete;
+
+  Ticket Submit(GattPriority priority, Clock::time_point deadline,
+                Callback callback) {
+    Ticket ticket{};
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      ticket.id = ++lastId;
+      auto now = Clock::now();
+      if (cancelled) {
+        counters.cancelled++;
+        ticket.state = State::Cancelled;
+      } else if (deadline <= now) {
+        counters.expired++;
+        ticket.state = State::Expired;
+      } else if (running.size() < concurrency && QueuedLocked() == 0) {
+        GrantLocked(ticket.id, now, now);
+        ticket.state = State::Granted;
+      } else {
+        queues[size_t(priority)].push_back(
+            Waiter{ticket.id, deadline, now, std::move(callback)});
+        counters.maxQueueDepth =
+            std::max(counters.maxQueueDepth, QueuedLocked());
+        ticket.state = State::Queued;
+      }
+    }
+    return ticket;
+  }
+
+  // A slot if one is free and nothing is queued, or an empty Slot. Never
+  // waits, so a caller already holding slots cannot deadlock on more.
+  Slot TryAcquire() {
+    uint64_t id = 0;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (cancelled || running.size() >= concurrency || QueuedLocked() > 0) {
+        return Slot();
+      }
+      id = ++lastId;
+      auto now = Clock::now();
+      GrantLocked(id, now, now);
+    }
+    return Slot(shared_from_this(), id, State::Granted);
+  }
+
+  // Frees the slot of granted operation |id| and grants queued operations.
+  void Release(uint64_t id) {
+    std::vector<Decision> decisions;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto it = running.find(id);
+      if (it == running.end()) {
+        return;
+      }
+      serviceTime.Record(std::chrono::duration_cast<std::chrono::microseconds>(
+          Clock::now() - it->second));
+      running.erase(it);
+      DispatchLocked(decisions);
+    }
+    Run(decisions);
+  }
+
+  // Expires operation |id| if it is still queued, e.g. from a timer armed
+  // for its deadline.
+  void Expire(uint64_t id) {
+    std::vector<Decision> decisions;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (auto &queue : queues) {
+        auto it = std::find_if(queue.begin(), queue.end(),
+                               [id](const Waiter &w) { return w.id == id; });
+        if (it != queue.end()) {
+          counters.expired++;
+          decisions.push_back({std::move(*it), State::Expired});
+          queue.erase(it);
+          break;
+        }
+      }
+    }
+    Run(decisions);
+  }
+
+  // Turns away every queued operation and everything submitted later.
+  void Cancel() {
+    std::vector<Decision> decisions;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      cancelled = true;
+      for (auto &queue : queues) {
+        for (auto &waiter : queue) {
+          counters.cancelled++;
+          decisions.push_back({std::move(waiter), State::Cancelled});
+        }
+        queue.clear();
+      }
+    }
+    Run(decisions);
+  }
+
+  void SetConcurrency(size_t value) {
+    std::vector<Decision> decisions;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      concurrency = std::max<size_t>(value, 1);
+      DispatchLocked(decisions);
+    }
+    Run(decisions);
+  }
+
+  size_t Concurrency() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return concurrency;
+  }
+
+  Counters GetCounters() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto snapshot = counters;
+    snapshot.running = running.size();
+    snapshot.queued = QueuedLocked();
+    return snapshot;
+  }
+
+  // Time from submission to grant.
+  LatencyHistogram QueueWait() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return queueWait;
+  }
+
+  // Time from grant to release.
+  LatencyHistogram ServiceTime() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return serviceTime;
+  }
+
+private:
+  struct Waiter {
+    uint64_t id;
+    Clock::time_point deadline;
+    Clock::time_point submitted;
+    Callback callback;
+  };
+
+  struct Decision {
+    Waiter waiter;
+    State state;
+  };
+
+  size_t QueuedLocked() const {
+    size_t queued = 0;
+    for (const auto &queue : queues) {
+      queued += queue.size();
+    }
+    return queued;
+  }
+
+  void GrantLocked(uint64_t id, Clock::time_point submitted,
+                   Clock::time_point now) {
+    running.emplace(id, now);
+    counters.granted++;
+    queueWait.Record(
+        std::chrono::duration_cast<std::chrono::microseconds>(now - submitted));
+  }
+
+  // Fills free slots from the queues, expiring overdue waiters on the way.
+  void DispatchLocked(std::vector<Decision> &decisions) {
+    auto now = Clock::now();
+    for (auto &queue : queues) {
+      while (!queue.empty() && running.size() < concurrency) {
+        auto waiter = std::move(queue.front());
+        queue.pop_front();
+        if (waiter.deadline <= now) {
+          counters.expired++;
+          decisions.push_back({std::move(waiter), State::Expired});
+          continue;
+        }
+        GrantLocked(waiter.id, waiter.submitted, now);
+        decisions.push_back({std::move(waiter), State::Granted});
+      }
+    }
+  }
+
+  static void Run(std::vector<Decision> &decisions) {
+    for (auto &decision : decisions) {
+      if (decision.waiter.callback) {
+        decision.waiter.callback(decision.waiter.id, decision.state);
+      }
+    }
+  }
+
+  mutable std::mutex mutex;
+  size_t concurrency;
+  bool cancelled = false;
+  uint64_t lastId = 0;
+  std::array<std::deque<Waiter>, 4> queues;
+  // Granted operations and when they were granted.
+  std::unordered_map<uint64_t, Clock::time_point> running;
+  Counters counters;
+  LatencyHistogram queueWait;
+  LatencyHistogram serviceTime;
+};
+
+} // namespace quick_blue
+
+#endif // QUICK_BLUE_WINDOWS_GATT_SCHEDULER_H_
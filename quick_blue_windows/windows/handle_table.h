@@ -0,0 +1,224 @@
+#ifndef QUICK_BLUE_WINDOWS_HANDLE_TABLE_H_
+#define QUICK_BLUE_WINDOWS_HANDLE_TABLE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ble_uuid.h"
+
+namespace quick_blue {
+
+constexpr uint32_t kInvalidHandle = 0xFFFFFFFF;
+
+// Compact handles for the GATT characteristics of one device, keyed by
+// (service UUID, characteristic UUID, instance). The instance is the
+// characteristic's attribute handle, which tells apart several
+// characteristics sharing a UUID. Entries live in one contiguous array
+// indexed by handle, so resolving a handle is a bounds check; UUID lookups
+// probe an open-addressing index, so no strings are built or compared and no
+// lists are walked. Handles stay valid until Clear(). Not thread-safe.
+template <typename T> class GattHandleTable {
+public:
+  struct Entry {
+    BleUuid service;
+    BleUuid characteristic;
+    uint16_t instance;
+    T value;
+  };
+
+  // Returns the handle of the key, adding it or replacing its value.
+  uint32_t Insert(const BleUuid &service, const BleUuid &characteristic,
+                  uint16_t instance, T value) {
+    auto handle = Find(service, characteristic, instance);
+    if (handle != kInvalidHandle) {
+      entries[handle].value = std::move(value);
+      return handle;
+    }
+    handle = uint32_t(entries.size());
+    entries.push_back(
+        Entry{service, characteristic, instance, std::move(value)});
+    if (entries.size() * 2 > slots.size()) {
+      Rehash(slots.empty() ? 16 : slots.size() * 2);
+    } else {
+      Place(handle);
+    }
+    return handle;
+  }
+
+  // Returns the handle of the exact instance, or kInvalidHandle.
+  uint32_t Find(const BleUuid &service, const BleUuid &characteristic,
+                uint16_t instance) const {
+    return Probe(service, characteristic, &instance);
+  }
+
+  // Returns the handle of the first registered instance of the UUID pair, or
+  // kInvalidHandle.
+  uint32_t Find(const BleUuid &service, const BleUuid &characteristic) const {
+    return Probe(service, characteristic, nullptr);
+  }
+
+  // A copy of the entry of |handle|, or nullopt. Entries move when the table
+  // grows, so no reference into the table is handed out, and a caller that
+  // guards the table with a lock can release it and keep the result.
+  std::optional<Entry> Get(uint32_t handle) const {
+    if (handle >= entries.size()) {
+      return std::nullopt;
+    }
+    return entries[handle];
+  }
+
+  bool Contains(uint32_t handle) const { return handle < entries.size(); }
+
+  void Clear() {
+    entries.clear();
+    slots.clear();
+  }
+
+  size_t Size() const { return entries.size(); }
+
+  typename std::vector<Entry>::iterator begin() { return entries.begin(); }
+  typename std::vector<Entry>::iterator end() { return entries.end(); }
+
+private:
+  // The index hashes only the UUID pair, so all instances of a pair share a
+  // probe sequence and are met in insertion order.
+  uint32_t Probe(const BleUuid &service, const BleUuid &characteristic,
+                 const uint16_t *instance) const {
+    if (slots.empty()) {
+      return kInvalidHandle;
+    }
+    auto mask = slots.size() - 1;
+    for (auto i = Hash(service, characteristic) & mask;; i = (i + 1) & mask) {
+      auto handle = slots[i];
+      if (handle == kInvalidHandle) {
+        return kInvalidHandle;
+      }
+      const auto &entry = entries[handle];
+      if (entry.characteristic == characteristic &&
+          entry.service == service &&
+          (!instance || entry.instance == *instance)) {
+        return handle;
+      }
+    }
+  }
+
+  static size_t Hash(const BleUuid &service, const BleUuid &characteristic) {
+    BleUuidHash hash;
+    return hash(characteristic) ^ (hash(service) * 31);
+  }
+
+  void Place(uint32_t handle) {
+    const auto &entry = entries[handle];
+    auto mask = slots.size() - 1;
+    auto i = Hash(entry.service, entry.characteristic) & mask;
+    while (slots[i] != kInvalidHandle) {
+      i = (i + 1) & mask;
+    }
+    slots[i] = handle;
+  }
+
+  void Rehash(size_t capacity) {
+    slots.assign(capacity, kInvalidHandle);
+    for (uint32_t handle = 0; handle < entries.size(); ++handle) {
+      Place(handle);
+    }
+  }
+
+  std::vector<Entry> entries;
+  // Power-of-two sized, at most half full.
+  std::vector<uint32_t> slots;
+};
+
+// Compact handles for connected devices, so method calls and notifications
+// carry an integer instead of a decimal address string. A handle holds a
+// slot index in its low 32 bits and the slot's generation in the high bits.
+// Slots are reused, but each reuse bumps the generation, so a handle kept
+// past its device's disconnect is rejected instead of resolving to the next
+// device in that slot. Handles stay below 2^63, as Dart ints are signed.
+// Thread-safe.
+class DeviceHandleTable {
+public:
+  static constexpr uint64_t kInvalidHandle = ~uint64_t(0);
+
+  // Returns the handle of |address|, allocating one if needed.
+  uint64_t Acquire(uint64_t address) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = handles.find(address);
+    if (it != handles.end()) {
+      return it->second;
+    }
+    uint32_t index;
+    if (!freeSlots.empty()) {
+      index = freeSlots.back();
+      freeSlots.pop_back();
+    } else {
+      index = uint32_t(slots.size());
+      slots.push_back(Slot{});
+    }
+    auto &slot = slots[index];
+    slot.generation = slot.generation == kMaxGeneration ? 1
+                                                        : slot.generation + 1;
+    slot.address = address;
+    slot.used = true;
+    auto handle = uint64_t(slot.generation) << 32 | index;
+    handles.emplace(address, handle);
+    return handle;
+  }
+
+  void Release(uint64_t address) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = handles.find(address);
+    if (it == handles.end()) {
+      return;
+    }
+    auto index = uint32_t(it->second);
+    slots[index].used = false;
+    freeSlots.push_back(index);
+    handles.erase(it);
+  }
+
+  // Returns the address of a live handle, or nullopt if the handle was
+  // released or never handed out.
+  std::optional<uint64_t> Address(uint64_t handle) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto index = uint32_t(handle);
+    if (index >= slots.size()) {
+      return std::nullopt;
+    }
+    const auto &slot = slots[index];
+    if (!slot.used || slot.generation != handle >> 32) {
+      return std::nullopt;
+    }
+    return slot.address;
+  }
+
+  uint64_t Handle(uint64_t address) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = handles.find(address);
+    return it != handles.end() ? it->second : kInvalidHandle;
+  }
+
+private:
+  static constexpr uint32_t kMaxGeneration = 0x7FFFFFFF;
+
+  struct Slot {
+    uint64_t address = 0;
+    // 0 until first used, so no valid handle has a zero generation.
+    uint32_t generation = 0;
+    bool used = false;
+  };
+
+  mutable std::mutex mutex;
+  std::vector<Slot> slots;
+  std::vector<uint32_t> freeSlots;
+  std::unordered_map<uint64_t, uint64_t> handles;
+};
+
+} // namespace quick_blue
+
+#endif // QUICK_BLUE_WINDOWS_HANDLE_TABLE_H_
@@ -0,0 +1,65 @@
+#ifndef QUICK_BLUE_WINDOWS_LATENCY_HISTOGRAM_H_
+#define QUICK_BLUE_WINDOWS_LATENCY_HISTOGRAM_H_
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace quick_blue {
+
+// Latencies in power-of-two buckets of microseconds: bucket 0 holds 0us and
+// bucket i holds [2^(i-1), 2^i) us, so quantiles are exact to within a
+// factor of two at a fixed, small size. Not thread-safe.
+class LatencyHistogram {
+public:
+  static constexpr size_t kBuckets = 32;
+
+  void Record(std::chrono::microseconds latency) {
+    auto us = static_cast<uint64_t>(std::max<int64_t>(latency.count(), 0));
+    size_t bucket = 0;
+    while (bucket + 1 < kBuckets && (us >> bucket) != 0) {
+      ++bucket;
+    }
+    buckets[bucket]++;
+    count++;
+    max = std::max(max, us);
+  }
+
+  uint64_t Count() const { return count; }
+
+  std::chrono::microseconds Max() const {
+    return std::chrono::microseconds(max);
+  }
+
+  // Upper bound of the bucket holding quantile |q| of the recorded
+  // latencies, capped at the maximum; 0 if nothing was recorded.
+  std::chrono::microseconds Quantile(double q) const {
+    if (count == 0) {
+      return std::chrono::microseconds(0);
+    }
+    auto rank = static_cast<uint64_t>(q * double(count - 1)) + 1;
+    uint64_t seen = 0;
+    size_t bucket = 0;
+    for (; bucket + 1 < kBuckets; ++bucket) {
+      seen += buckets[bucket];
+      if (seen >= rank) {
+        break;
+      }
+    }
+    auto upper = bucket == 0 ? 0 : (uint64_t(1) << bucket) - 1;
+    return std::chrono::microseconds(std::min(upper, max));
+  }
+
+  const std::array<uint64_t, kBuckets> &Buckets() const { return buckets; }
+
+private:
+  std::array<uint64_t, kBuckets> buckets{};
+  uint64_t count = 0;
+  uint64_t max = 0;
+};
+
+} // namespace quick_blue
+
+#endif // QUICK_BLUE_WINDOWS_LATENCY_HISTOGRAM_H_
@@ -0,0 +1,126 @@
+#ifndef QUICK_BLUE_WINDOWS_MPSC_QUEUE_H_
+#define QUICK_BLUE_WINDOWS_MPSC_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace quick_blue {
+
+// Bounded lock-free ring buffer for many producers and one consumer. Each
+// cell carries a sequence number telling whose turn it is, so producers
+// claim cells with one compare-and-swap and never wait for each other or
+// for the consumer: a full queue fails the push instead. TryPop() is safe
+// from any thread too, which lets a producer evict the oldest entry to
+// make room. The capacity is rounded up to a power of two. |T| must be
+// default-constructible and movable.
+template <typename T> class MpscQueue {
+public:
+  explicit MpscQueue(size_t capacity)
+      : cells(new Cell[RoundUp(capacity)]), mask(RoundUp(capacity) - 1) {
+    for (size_t i = 0; i <= mask; ++i) {
+      cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  MpscQueue(const MpscQueue &) = delete;
+  MpscQueue &operator=(const MpscQueue &) = delete;
+
+  // Moves |value| into the queue and returns true, or returns false and
+  // leaves |value| as is if the queue is full.
+  bool TryPush(T &value) {
+    auto pos = enqueuePos.load(std::memory_order_relaxed);
+    Cell *cell;
+    while (true) {
+      cell = &cells[pos & mask];
+      auto sequence = cell->sequence.load(std::memory_order_acquire);
+      auto diff = intptr_t(sequence) - intptr_t(pos);
+      if (diff == 0) {
+        if (enqueuePos.compare_exchange_weak(pos, pos + 1,
+                                             std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = enqueuePos.load(std::memory_order_relaxed);
+      }
+    }
+    cell->value = std::move(value);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Moves the oldest entry into |value| and returns true, or returns false
+  // if the queue is empty. An entry whose producer is still writing it
+  // counts as not there yet.
+  bool TryPop(T &value) {
+    auto pos = dequeuePos.load(std::memory_order_relaxed);
+    Cell *cell;
+    while (true) {
+      cell = &cells[pos & mask];
+      auto sequence = cell->sequence.load(std::memory_order_acquire);
+      auto diff = intptr_t(sequence) - intptr_t(pos + 1);
+      if (diff == 0) {
+        if (dequeuePos.compare_exchange_weak(pos, pos + 1,
+                                             std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = dequeuePos.load(std::memory_order_relaxed);
+      }
+    }
+    value = std::move(cell->value);
+    // Let go of what the moved-from entry may still hold
+    cell->value = T();
+    cell->sequence.store(pos + mask + 1, std::memory_order_release);
+    return true;
+  }
+
+  size_t Capacity() const { return mask + 1; }
+
+  // Pushes so far, counting those whose producer is still writing.
+  size_t Pushed() const { return enqueuePos.load(std::memory_order_acquire); }
+
+  // Pops so far.
+  size_t Popped() const { return dequeuePos.load(std::memory_order_acquire); }
+
+  // Entries queued, approximate while producers or the consumer are busy.
+  size_t Size() const {
+    auto pushed = Pushed();
+    auto popped = Popped();
+    return pushed > popped ? pushed - popped : 0;
+  }
+
+private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  static size_t RoundUp(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    return size;
+  }
+
+  std::unique_ptr<Cell[]> cells;
+  const size_t mask;
+  // Kept on separate cache lines, as producers and the consumer update
+  // them concurrently. Padded rather than aligned, which MSVC warns about.
+  char padding0[64];
+  std::atomic<size_t> enqueuePos{0};
+  char padding1[64 - sizeof(std::atomic<size_t>)];
+  std::atomic<size_t> dequeuePos{0};
+  char padding2[64 - sizeof(std::atomic<size_t>)];
+};
+
+} // namespace quick_blue
+
+#endif // QUICK_BLUE_WINDOWS_MPSC_QUEUE_H_
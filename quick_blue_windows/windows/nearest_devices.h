@@ -0,0 +1,105 @@
+#ifndef QUICK_BLUE_WINDOWS_NEAREST_DEVICES_H_
+#define QUICK_BLUE_WINDOWS_NEAREST_DEVICES_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace quick_blue {
+
+// Device table for the nearest-N scan mode. RSSI is smoothed with an
+// exponential moving average and Snapshot() ranks the K strongest devices,
+// so the caller can publish at a fixed rate no matter how many advertisements
+// arrive in between.
+class NearestDevices {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Device {
+    uint64_t address;
+    std::string name;
+    double rssi;
+    Clock::time_point lastSeen;
+  };
+
+  struct Options {
+    size_t topK = 10;
+    // Weight of a new sample in the moving average, in (0, 1].
+    double smoothing = 0.3;
+    // Devices not heard from for this long leave the table.
+    Clock::duration ttl = std::chrono::seconds(5);
+  };
+
+  void Configure(const Options &options) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->options = options;
+    this->options.smoothing = std::clamp(options.smoothing, 0.01, 1.0);
+    devices.clear();
+  }
+
+  void Update(uint64_t address, int16_t rssi, const std::string &name,
+              Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = devices.find(address);
+    if (it == devices.end()) {
+      devices.emplace(address, Device{address, name, double(rssi), now});
+      return;
+    }
+    auto &device = it->second;
+    device.rssi += options.smoothing * (rssi - device.rssi);
+    device.lastSeen = now;
+    device.name = name;
+  }
+
+  // Returns the strongest devices, strongest first, after dropping the ones
+  // that expired.
+  std::vector<Device> Snapshot(Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto weaker = [](const Device *a, const Device *b) {
+      return a->rssi > b->rssi;
+    };
+    // Min-heap on RSSI holding the best K seen so far.
+    std::vector<const Device *> heap;
+    heap.reserve(options.topK + 1);
+    for (auto it = devices.begin(); it != devices.end();) {
+      if (now - it->second.lastSeen >= options.ttl) {
+        it = devices.erase(it);
+        continue;
+      }
+      heap.push_back(&it->second);
+      std::push_heap(heap.begin(), heap.end(), weaker);
+      if (heap.size() > options.topK) {
+        std::pop_heap(heap.begin(), heap.end(), weaker);
+        heap.pop_back();
+      }
+      ++it;
+    }
+    std::sort_heap(heap.begin(), heap.end(), weaker);
+
+    std::vector<Device> snapshot;
+    snapshot.reserve(heap.size());
+    for (auto device : heap) {
+      snapshot.push_back(*device);
+    }
+    return snapshot;
+  }
+
+  size_t Size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return devices.size();
+  }
+
+private:
+  mutable std::mutex mutex;
+  Options options;
+  std::unordered_map<uint64_t, Device> devices;
+};
+
+} // namespace quick_blue
+
+#endif // QUICK_BLUE_WINDOWS_NEAREST_DEVICES_H_
@@ -0,0 +1,101 @@
+#ifndef QUICK_BLUE_WINDOWS_NOTIFICATION_FRAME_H_
+#define QUICK_BLUE_WINDOWS_NOTIFICATION_FRAME_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace quick_blue {
+
+// Packed little-endian frame used for high-rate characteristic values on the
+// raw `quick_blue/binary.notification` channel:
+//
+//   offset  size  field
+//        0     8  device handle, as reported on connect
+//        8     2  characteristic handle, as reported by discovery
+//       10     2  payload length
+//       12     8  timestamp, microseconds since the Unix epoch
+//       20     n  payload
+//
+// A message may hold several frames back to back.
+struct NotificationFrame {
+  static constexpr size_t kHeaderSize = 20;
+  static constexpr size_t kMaxPayload = 0xFFFF;
+  static constexpr uint32_t kMaxCharacteristicHandle = 0xFFFF;
+
+  // Whether a value of |payloadLength| bytes of |characteristicHandle| can
+  // be framed without cutting either short.
+  static bool Fits(uint32_t characteristicHandle, size_t payloadLength) {
+    return characteristicHandle <= kMaxCharacteristicHandle &&
+           payloadLength <= kMaxPayload;
+  }
+
+  uint64_t deviceHandle = 0;
+  uint16_t characteristicHandle = 0;
+  int64_t timestampUs = 0;
+  const uint8_t *payload = nullptr;
+  uint16_t payloadLength = 0;
+
+  // Size of the encoded frame in bytes.
+  size_t EncodedSize() const { return kHeaderSize + payloadLength; }
+
+  // Appends the encoded frame to |out|.
+  void EncodeTo(std::vector<uint8_t> &out) const {
+    auto offset = out.size();
+    out.resize(offset + EncodedSize());
+    WriteTo(out.data() + offset);
+  }
+
+  // Writes the encoded frame to |frame|, which must hold EncodedSize() bytes.
+  void WriteTo(uint8_t *frame) const {
+    WriteLittleEndian(frame, deviceHandle, 8);
+    WriteLittleEndian(frame + 8, characteristicHandle, 2);
+    WriteLittleEndian(frame + 10, payloadLength, 2);
+    WriteLittleEndian(frame + 12, uint64_t(timestampUs), 8);
+    if (payloadLength > 0) {
+      std::memcpy(frame + kHeaderSize, payload, payloadLength);
+    }
+  }
+
+  // Decodes the frame starting at |offset| and advances it. The payload
+  // points into |data|. Returns false if the remaining bytes are not a
+  // complete frame.
+  static bool DecodeFrom(const uint8_t *data, size_t length, size_t &offset,
+                         NotificationFrame &frame) {
+    if (offset > length || length - offset < kHeaderSize) {
+      return false;
+    }
+    const uint8_t *header = data + offset;
+    auto payloadLength = uint16_t(ReadLittleEndian(header + 10, 2));
+    if (length - offset - kHeaderSize < payloadLength) {
+      return false;
+    }
+    frame.deviceHandle = ReadLittleEndian(header, 8);
+    frame.characteristicHandle = uint16_t(ReadLittleEndian(header + 8, 2));
+    frame.payloadLength = payloadLength;
+    frame.timestampUs = int64_t(ReadLittleEndian(header + 12, 8));
+    frame.payload = header + kHeaderSize;
+    offset += kHeaderSize + payloadLength;
+    return true;
+  }
+
+private:
+  static void WriteLittleEndian(uint8_t *out, uint64_t value, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+      out[i] = uint8_t(value >> (8 * i));
+    }
+  }
+
+  static uint64_t ReadLittleEndian(const uint8_t *in, size_t size) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < size; ++i) {
+      value |= uint64_t(in[i]) << (8 * i);
+    }
+    return value;
+  }
+};
+
+} // namespace quick_blue
+
+#endif // QUICK_BLUE_WINDOWS_NOTIFICATION_FRAME_H_
@@ -0,0 +1,123 @@
+#ifndef QUICK_BLUE_WINDOWS_OPERATION_TIMEOUTS_H_
+#define QUICK_BLUE_WINDOWS_OPERATION_TIMEOUTS_H_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace quick_blue {
+
+// Kinds of operations with a timeout of their own.
+enum class GattOperation {
+  Connect,
+  DiscoverServices,
+  SetNotifiable,
+  RequestMtu,
+  ReadValue,
+  WriteValue,
+};
+
+// Parses the keys of the `setTimeouts` method call, which are the names of
+// the method calls themselves.
+inline std::optional<GattOperation> ParseGattOperation(const std::string &s) {
+  if (s == "connect") {
+    return GattOperation::Connect;
+  }
+  if (s == "discoverServices") {
+    return GattOperation::DiscoverServices;
+  }
+  if (s == "setNotifiable") {
+    return GattOperation::SetNotifiable;
+  }
+  if (s == "requestMtu") {
+    return GattOperation::RequestMtu;
+  }
+  if (s == "readValue") {
+    return GattOperation::ReadValue;
+  }
+  if (s == "writeValue") {
+    return GattOperation::WriteValue;
+  }
+  return std::nullopt;
+}
+
+inline const char *GattOperationName(GattOperation operation) {
+  switch (operation) {
+  case GattOperation::Connect:
+    return "connect";
+  case GattOperation::DiscoverServices:
+    return "discoverServices";
+  case GattOperation::SetNotifiable:
+    return "setNotifiable";
+  case GattOperation::RequestMtu:
+    return "requestMtu";
+  case GattOperation::ReadValue:
+    return "readValue";
+  case GattOperation::WriteValue:
+    return "writeValue";
+  }
+  return "unknown";
+}
+
+// How long each kind of operation may take once it has started, so a
+// device that stops answering fails the operation instead of hanging it.
+// Zero means no limit. Thread-safe.
+class OperationTimeouts {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  OperationTimeouts() {
+    Set(GattOperation::Connect, std::chrono::seconds(10));
+    Set(GattOperation::DiscoverServices, std::chrono::seconds(15));
+    Set(GattOperation::SetNotifiable, std::chrono::seconds(5));
+    Set(GattOperation::RequestMtu, std::chrono::seconds(5));
+    Set(GattOperation::ReadValue, std::chrono::seconds(5));
+    Set(GattOperation::WriteValue, std::chrono::seconds(5));
+  }
+
+  std::chrono::milliseconds Get(GattOperation operation) const {
+    return std::chrono::milliseconds(
+        timeouts[size_t(operation)].load(std::memory_order_relaxed));
+  }
+
+  void Set(GattOperation operation, std::chrono::milliseconds timeout) {
+    timeouts[size_t(operation)].store(std::max<int64_t>(timeout.count(), 0),
+                                      std::memory_order_relaxed);
+  }
+
+  // When an operation starting now must be done by: after its timeout, and
+  // no later than |limit|, e.g. the deadline of the method call.
+  Clock::time_point DeadlineOf(
+      GattOperation operation,
+      Clock::time_point limit = Clock::time_point::max()) const {
+    auto timeout = Get(operation);
+    if (timeout.count() == 0) {
+      return limit;
+    }
+    return std::min(limit, Clock::now() + timeout);
+  }
+
+private:
+  std::array<std::atomic<int64_t>, 6> timeouts{};
+};
+
+// Decides between the completion of an operation and its timeout. The
+// first of the two to call Settle() handles the outcome, and the other one
+// must do nothing, so a completion arriving after the timeout cannot answer
+// or free anything twice. Thread-safe.
+class TimeoutRace {
+public:
+  bool Settle() { return !settled.exchange(true, std::memory_order_acq_rel); }
+
+private:
+  std::atomic<bool> settled{false};
+};
+
+} // namespace quick_blue
+
+#endif // QUICK_BLUE_WINDOWS_OPERATION_TIMEOUTS_H_
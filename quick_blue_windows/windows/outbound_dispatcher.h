@@ -0,0 +1,287 @@
+#ifndef QUICK_BLUE_WINDOWS_OUTBOUND_DISPATCHER_H_
+#define QUICK_BLUE_WINDOWS_OUTBOUND_DISPATCHER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "mpsc_queue.h"
+
+namespace quick_blue {
+
+// What happens to a droppable message that finds its queue full.
+enum class OverflowPolicy {
+  // The message is dropped.
+  DropNewest,
+  // The oldest queued droppable message is dropped to make room.
+  DropOldest,
+};
+
+inline std::optional<OverflowPolicy>
+ParseOverflowPolicy(const std::string &s) {
+  if (s == "dropNewest") {
+    return OverflowPolicy::DropNewest;
+  }
+  if (s == "dropOldest") {
+    return OverflowPolicy::DropOldest;
+  }
+  return std::nullopt;
+}
+
+// Hands messages produced on any thread to one consumer thread, e.g. the
+// platform thread, which alone may talk to the engine. Producers queue
+// without waiting and wake the consumer at most once until it drains; the
+// consumer runs the messages in batches, those of each producer in the
+// order posted. Droppable messages, e.g. notifications, follow the overflow
+// policy when their queue is full. Essential ones, e.g. connection state
+// changes and method results, have a queue of their own and are never
+// dropped: on overflow they are kept in a side list, under a lock that is
+// only taken then. Thread-safe.
+class OutboundDispatcher {
+public:
+  using Message = std::function<void()>;
+
+  struct Counters {
+    uint64_t posted = 0;
+    uint64_t dropped = 0;
+    // Essential messages kept aside because their queue was full.
+    uint64_t overflowed = 0;
+    uint64_t sent = 0;
+    uint64_t batches = 0;
+    uint64_t maxBatch = 0;
+    // Wakes that did not reach the consumer, see WakeMissed().
+    uint64_t wakesMissed = 0;
+  };
+
+  // |onWake| asks the consumer to call Drain() soon; it is called from
+  // producer threads and must not block.
+  OutboundDispatcher(size_t capacity, std::function<void()> onWake)
+      : droppable(capacity), essential(capacity), wake(std::move(onWake)) {}
+
+  OutboundDispatcher(const OutboundDispatcher &) = delete;
+  OutboundDispatcher &operator=(const OutboundDispatcher &) = delete;
+
+  void SetOverflowPolicy(OverflowPolicy value) {
+    policy.store(value, std::memory_order_relaxed);
+  }
+
+  OverflowPolicy GetOverflowPolicy() const {
+    return policy.load(std::memory_order_relaxed);
+  }
+
+  void Post(Message message, bool isDroppable) {
+    posted.fetch_add(1, std::memory_order_relaxed);
+    Entry entry{std::move(message),
+                nextTicket.fetch_add(1, std::memory_order_relaxed)};
+    if (isDroppable) {
+      if (!PushDroppable(entry)) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+    } else if (overflowing.load(std::memory_order_acquire) ||
+               !essential.TryPush(entry)) {
+      // Behind those kept aside already, to stay in order
+      KeepAside(std::move(entry));
+    }
+    Wake();
+  }
+
+  // Runs up to |maxBatch| queued messages on the consumer thread, oldest
+  // first. If messages are left, wakes the consumer again so that it gets
+  // to its other work in between. Returns the number run.
+  size_t Drain(size_t maxBatch) {
+    // Cleared first, so a message queued from now on wakes the consumer
+    wakePending.store(false, std::memory_order_seq_cst);
+    size_t count = 0;
+    while (count < maxBatch) {
+      // Whichever queue is filled second is tried again, as a message
+      // posted before the one just taken is visible in it by now.
+      auto hadEssential = heldEssential.has_value();
+      FillEssential();
+      FillDroppable();
+      if (!hadEssential && !heldEssential) {
+        FillEssential();
+      }
+      auto &next = !heldDroppable ? heldEssential
+                   : !heldEssential
+                       ? heldDroppable
+                       : (heldEssential->ticket < heldDroppable->ticket
+                              ? heldEssential
+                              : heldDroppable);
+      if (!next) {
+        break;
+      }
+      // The other queue may hold an older message its producer is still
+      // writing; the next drain, a moment later, takes it.
+      if ((!heldDroppable && droppable.Size() > 0) ||
+          (!heldEssential && essential.Size() > 0)) {
+        break;
+      }
+      auto entry = std::move(*next);
+      next.reset();
+      entry.message();
+      count++;
+    }
+    if (count > 0) {
+      sent.fetch_add(count, std::memory_order_relaxed);
+      batches.fetch_add(1, std::memory_order_relaxed);
+      auto largest = maxBatchSeen.load(std::memory_order_relaxed);
+      while (count > largest && !maxBatchSeen.compare_exchange_weak(
+                                    largest, count,
+                                    std::memory_order_relaxed)) {
+      }
+    }
+    if (heldDroppable || heldEssential || QueueDepth() > 0) {
+      Wake();
+    }
+    return count;
+  }
+
+  // Tells that the consumer could not be woken, e.g. because it has no
+  // message loop yet. The messages stay queued, droppable ones subject to
+  // the overflow policy, and the next Post() tries to wake it again; a
+  // Drain() once it can be reached takes them all. Called from |onWake|.
+  void WakeMissed() {
+    wakesMissed.fetch_add(1, std::memory_order_relaxed);
+    wakePending.store(false, std::memory_order_seq_cst);
+  }
+
+  // Drops every queued message without running it, on the consumer thread,
+  // e.g. when it goes away.
+  void Clear() {
+    Entry entry;
+    while (droppable.TryPop(entry) || essential.TryPop(entry)) {
+      entry = Entry();
+    }
+    heldDroppable.reset();
+    heldEssential.reset();
+    std::lock_guard<std::mutex> lock(asideMutex);
+    aside.clear();
+  }
+
+  // Messages queued, approximately, not counting the two the consumer may
+  // hold while it decides which runs first.
+  size_t QueueDepth() const {
+    size_t depth = droppable.Size() + essential.Size();
+    if (overflowing.load(std::memory_order_acquire)) {
+      std::lock_guard<std::mutex> lock(asideMutex);
+      depth += aside.size();
+    }
+    return depth;
+  }
+
+  Counters GetCounters() const {
+    Counters counters;
+    counters.posted = posted.load(std::memory_order_relaxed);
+    counters.dropped = dropped.load(std::memory_order_relaxed);
+    counters.overflowed = overflowed.load(std::memory_order_relaxed);
+    counters.sent = sent.load(std::memory_order_relaxed);
+    counters.batches = batches.load(std::memory_order_relaxed);
+    counters.maxBatch = maxBatchSeen.load(std::memory_order_relaxed);
+    counters.wakesMissed = wakesMissed.load(std::memory_order_relaxed);
+    return counters;
+  }
+
+private:
+  struct Entry {
+    Message message;
+    // Order of posting across both queues.
+    uint64_t ticket = 0;
+    // For an entry kept aside, how many essential messages had been queued
+    // before it, all of which run first.
+    size_t after = 0;
+  };
+
+  // Queues a droppable |entry| as the overflow policy allows. Returns false,
+  // leaving |entry| as is, if it does not fit.
+  bool PushDroppable(Entry &entry) {
+    if (droppable.TryPush(entry)) {
+      return true;
+    }
+    if (GetOverflowPolicy() != OverflowPolicy::DropOldest) {
+      return false;
+    }
+    Entry oldest;
+    if (droppable.TryPop(oldest)) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    return droppable.TryPush(entry);
+  }
+
+  void KeepAside(Entry entry) {
+    overflowed.fetch_add(1, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(asideMutex);
+    entry.after = essential.Pushed();
+    aside.push_back(std::move(entry));
+    overflowing.store(true, std::memory_order_release);
+  }
+
+  void FillDroppable() {
+    Entry entry;
+    if (!heldDroppable && droppable.TryPop(entry)) {
+      heldDroppable = std::move(entry);
+    }
+  }
+
+  // The next essential message comes from the queue, or once the messages
+  // queued before it have been taken, from the side list.
+  void FillEssential() {
+    if (heldEssential) {
+      return;
+    }
+    Entry entry;
+    if (essential.TryPop(entry)) {
+      heldEssential = std::move(entry);
+      return;
+    }
+    if (!overflowing.load(std::memory_order_acquire)) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(asideMutex);
+    if (!aside.empty() && aside.front().after <= essential.Popped()) {
+      heldEssential = std::move(aside.front());
+      aside.pop_front();
+    }
+    overflowing.store(!aside.empty(), std::memory_order_release);
+  }
+
+  void Wake() {
+    if (!wakePending.exchange(true, std::memory_order_seq_cst)) {
+      wake();
+    }
+  }
+
+  MpscQueue<Entry> droppable;
+  MpscQueue<Entry> essential;
+  std::function<void()> wake;
+  std::atomic<OverflowPolicy> policy{OverflowPolicy::DropNewest};
+  std::atomic<bool> wakePending{false};
+  std::atomic<uint64_t> nextTicket{0};
+
+  // Taken from the queues by the consumer and not run yet.
+  std::optional<Entry> heldDroppable;
+  std::optional<Entry> heldEssential;
+
+  mutable std::mutex asideMutex;
+  std::deque<Entry> aside;
+  // Set while essential messages are kept aside.
+  std::atomic<bool> overflowing{false};
+
+  std::atomic<uint64_t> posted{0};
+  std::atomic<uint64_t> dropped{0};
+  std::atomic<uint64_t> overflowed{0};
+  std::atomic<uint64_t> sent{0};
+  std::atomic<uint64_t> batches{0};
+  std::atomic<uint64_t> maxBatchSeen{0};
+  std::atomic<uint64_t> wakesMissed{0};
+};
+
+} // namespace quick_blue
+
+#endif // QUICK_BLUE_WINDOWS_OUTBOUND_DISPATCHER_H_
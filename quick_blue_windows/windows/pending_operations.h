@@ -0,0 +1,79 @@
+#ifndef QUICK_BLUE_WINDOWS_PENDING_OPERATIONS_H_
+#define QUICK_BLUE_WINDOWS_PENDING_OPERATIONS_H_
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace quick_blue {
+
+// Operations started by a method call whose answer arrives later, e.g. the
+// MethodResult of a GATT read, keyed by request id. Whoever finishes the
+// operation takes it out exactly once, so a late completion after the
+// owner disconnected, or after a timeout, finds nothing and is ignored.
+// Thread-safe.
+template <typename T> class PendingOperations {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Operation {
+    // The device the operation belongs to.
+    uint64_t owner;
+    T value;
+    Clock::time_point started;
+  };
+
+  // Registers |value| and returns its request id, never 0.
+  uint64_t Add(uint64_t owner, T value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto id = ++lastId;
+    operations.emplace(id, Operation{owner, std::move(value), Clock::now()});
+    return id;
+  }
+
+  // Removes and returns the operation |id|, or nullopt if it was taken
+  // already.
+  std::optional<Operation> Take(uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = operations.find(id);
+    if (it == operations.end()) {
+      return std::nullopt;
+    }
+    auto operation = std::move(it->second);
+    operations.erase(it);
+    return operation;
+  }
+
+  // Removes and returns all operations of |owner|.
+  std::vector<Operation> TakeOwnedBy(uint64_t owner) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<Operation> taken;
+    for (auto it = operations.begin(); it != operations.end();) {
+      if (it->second.owner == owner) {
+        taken.push_back(std::move(it->second));
+        it = operations.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    return taken;
+  }
+
+  size_t Size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return operations.size();
+  }
+
+private:
+  mutable std::mutex mutex;
+  uint64_t lastId = 0;
+  std::unordered_map<uint64_t, Operation> operations;
+};
+
+} // namespace quick_blue
+
+#endif // QUICK_BLUE_WINDOWS_PENDING_OPERATIONS_H_
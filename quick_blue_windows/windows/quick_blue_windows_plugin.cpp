@@ -2,6 +2,7 @@
 
 // This must be included before many other Windows headers.
 #include <windows.h>
+#include <robuffer.h>
 #include <winrt/Windows.Devices.Bluetooth.Advertisement.h>
 #include <winrt/Windows.Devices.Bluetooth.GenericAttributeProfile.h>
 #include <winrt/Windows.Devices.Bluetooth.h>
@@ -9,6 +10,7 @@
 #include <winrt/Windows.Foundation.Collections.h>
 #include <winrt/Windows.Foundation.h>
 #include <winrt/Windows.Storage.Streams.h>
+#include <winrt/Windows.System.Threading.h>
 
 #include <flutter/basic_message_channel.h>
 #include <flutter/event_channel.h>
@@ -19,10 +21,44 @@
 #include <flutter/standard_method_codec.h>
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <filesystem>
 #include <iomanip>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
 #include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "advertisement_source.h"
+#include "advertisement_suppressor.h"
+#include "batcher.h"
+#include "ble_uuid.h"
+#include "bounded_executor.h"
+#include "byte_buffer_pool.h"
+#include "callback_guard.h"
+#include "device_registry.h"
+#include "gatt_cache_policy.h"
+#include "gatt_layout_cache.h"
+#include "gatt_scheduler.h"
+#include "handle_table.h"
+#include "latency_histogram.h"
+#include "nearest_devices.h"
+#include "notification_frame.h"
+#include "operation_timeouts.h"
+#include "outbound_dispatcher.h"
+#include "pending_operations.h"
+#include "scan_device_table.h"
+#include "scan_filter.h"
+#include "write_pipeline.h"
 
 #define GUID_FORMAT                                                            \
   "%08x-%04hx-%04hx-%02hhx%02hhx-%02hhx%02hhx%02hhx%02hhx%02hhx%02hhx"
@@ -31,12 +67,16 @@
       guid.Data4[2], guid.Data4[3], guid.Data4[4], guid.Data4[5],              \
       guid.Data4[6], guid.Data4[7]
 
+// This DLL, which registers the class of the message window.
+EXTERN_C IMAGE_DOS_HEADER __ImageBase;
+
 // Anonymous namespace for helper functions and types
 namespace {
 
 using namespace winrt::Windows::Foundation;
 using namespace winrt::Windows::Foundation::Collections;
 using namespace winrt::Windows::Storage::Streams;
+using namespace winrt::Windows::System::Threading;
 using namespace winrt::Windows::Devices::Radios;
 using namespace winrt::Windows::Devices::Bluetooth;
 using namespace winrt::Windows::Devices::Bluetooth::Advertisement;
@@ -46,22 +86,78 @@ using flutter::EncodableList;
 using flutter::EncodableMap;
 using flutter::EncodableValue;
 
-union uint16_t_union {
-  uint16_t uint16;
-  byte bytes[sizeof(uint16_t)];
-};
+using quick_blue::Advertisement;
+using quick_blue::AdvertisementSource;
+using quick_blue::AdvertisementSuppressor;
+using quick_blue::Batcher;
+using quick_blue::BleUuid;
+using quick_blue::BleUuidHash;
+using quick_blue::BoundedExecutor;
+using quick_blue::ByteBufferPool;
+using quick_blue::CallbackGuard;
+using quick_blue::DeviceHandleTable;
+using quick_blue::DeviceRegistry;
+using quick_blue::GattCacheCounters;
+using quick_blue::GattCacheMode;
+using quick_blue::GattCachePolicy;
+using quick_blue::GattHandleTable;
+using quick_blue::GattLayout;
+using quick_blue::GattLayoutCache;
+using quick_blue::GattOperation;
+using quick_blue::GattOperationName;
+using quick_blue::GattPriority;
+using quick_blue::GattScheduler;
+using quick_blue::kInvalidHandle;
+using quick_blue::LatencyHistogram;
+using quick_blue::NearestDevices;
+using quick_blue::NotificationFrame;
+using quick_blue::OperationTimeouts;
+using quick_blue::OutboundDispatcher;
+using quick_blue::ParseGattCacheMode;
+using quick_blue::ParseGattOperation;
+using quick_blue::ParseOverflowPolicy;
+using quick_blue::ParsedAdvertisement;
+using quick_blue::PendingOperations;
+using quick_blue::ScanDeviceTable;
+using quick_blue::ScanFilter;
+using quick_blue::TimeoutRace;
+using quick_blue::WritePipeline;
+
+// Direct pointer to the storage of |buffer|, without going through a
+// DataReader. Valid as long as |buffer| is alive.
+uint8_t *buffer_data(const IBuffer &buffer) {
+  uint8_t *data = nullptr;
+  winrt::check_hresult(
+      buffer.as<::Windows::Storage::Streams::IBufferByteAccess>()->Buffer(
+          &data));
+  return data;
+}
 
 std::vector<uint8_t> to_bytevc(IBuffer buffer) {
-  auto reader = DataReader::FromBuffer(buffer);
-  auto result = std::vector<uint8_t>(reader.UnconsumedBufferLength());
-  reader.ReadBytes(result);
+  auto data = buffer_data(buffer);
+  return std::vector<uint8_t>(data, data + buffer.Length());
+}
+
+// Copies |buffer| into storage taken from |pool|.
+std::vector<uint8_t> to_bytevc(IBuffer buffer, ByteBufferPool &pool) {
+  auto result = pool.Acquire(buffer.Length());
+  if (!result.empty()) {
+    std::memcpy(result.data(), buffer_data(buffer), result.size());
+  }
   return result;
 }
 
-IBuffer from_bytevc(std::vector<uint8_t> bytes) {
-  auto writer = DataWriter();
-  writer.WriteBytes(bytes);
-  return writer.DetachBuffer();
+IBuffer from_bytes(const uint8_t *data, size_t size) {
+  auto buffer = Buffer((uint32_t)size);
+  if (size > 0) {
+    std::memcpy(buffer_data(buffer), data, size);
+  }
+  buffer.Length((uint32_t)size);
+  return buffer;
+}
+
+IBuffer from_bytevc(const std::vector<uint8_t> &bytes) {
+  return from_bytes(bytes.data(), bytes.size());
 }
 
 std::string to_hexstring(std::vector<uint8_t> bytes) {
@@ -71,18 +167,381 @@ std::string to_hexstring(std::vector<uint8_t> bytes) {
   return ss.str();
 }
 
+std::vector<uint8_t> to_bytevc(ParsedAdvertisement::Bytes bytes) {
+  return std::vector<uint8_t>(bytes.data, bytes.data + bytes.size);
+}
+
 std::string to_uuidstr(winrt::guid guid) {
   char chars[36 + 1];
   sprintf_s(chars, GUID_FORMAT, GUID_ARG(guid));
   return std::string{chars};
 }
 
+static_assert(sizeof(BleUuid) == sizeof(winrt::guid),
+              "BleUuid must match the GUID layout");
+
+winrt::guid to_guid(const BleUuid &uuid) {
+  winrt::guid guid;
+  std::memcpy(&guid, &uuid, sizeof(guid));
+  return guid;
+}
+
+BleUuid to_bleuuid(const winrt::guid &guid) {
+  BleUuid uuid;
+  std::memcpy(&uuid, &guid, sizeof(uuid));
+  return uuid;
+}
+
+BluetoothCacheMode to_cachemode(GattCacheMode mode) {
+  return mode == GattCacheMode::Cached ? BluetoothCacheMode::Cached
+                                       : BluetoothCacheMode::Uncached;
+}
+
+// %LOCALAPPDATA%\quick_blue\gatt, or an empty path if it is unknown.
+std::filesystem::path defaultGattCacheDirectory() {
+  wchar_t localAppData[MAX_PATH];
+  auto length = GetEnvironmentVariableW(L"LOCALAPPDATA", localAppData,
+                                        MAX_PATH);
+  if (length == 0 || length >= MAX_PATH) {
+    return {};
+  }
+  return std::filesystem::path(localAppData) / L"quick_blue" / L"gatt";
+}
+
+// Error details of a failed GATT operation: its status and, if the device
+// answered with an ATT error, that error code.
+EncodableValue to_statusdetails(GattCommunicationStatus status,
+                                IReference<uint8_t> protocolError) {
+  return EncodableMap{
+      {"status", (int32_t)status},
+      {"protocolError", protocolError
+                            ? EncodableValue((int32_t)protocolError.Value())
+                            : EncodableValue()},
+  };
+}
+
+// Error code of an operation the scheduler did not start.
+std::string to_errorcode(GattScheduler::State state) {
+  return state == GattScheduler::State::Expired ? "DeadlineExceeded"
+                                                : "Disconnected";
+}
+
+// Summary of |histogram| for getStatistics. Bucket i of `buckets` counts
+// latencies below 2^i us, down to the previous bucket's bound.
+EncodableValue to_histogrammap(const LatencyHistogram &histogram) {
+  const auto &counts = histogram.Buckets();
+  auto used = counts.size();
+  while (used > 0 && counts[used - 1] == 0) {
+    used--;
+  }
+  EncodableList buckets;
+  for (size_t i = 0; i < used; ++i) {
+    buckets.push_back(EncodableValue((int64_t)counts[i]));
+  }
+  return EncodableMap{
+      {"count", (int64_t)histogram.Count()},
+      {"p50Us", (int64_t)histogram.Quantile(0.5).count()},
+      {"p90Us", (int64_t)histogram.Quantile(0.9).count()},
+      {"p99Us", (int64_t)histogram.Quantile(0.99).count()},
+      {"maxUs", (int64_t)histogram.Max().count()},
+      {"buckets", buckets},
+  };
+}
+
+// Expires queued operation |id| of |scheduler| at |deadline|, if it has one.
+void expireAt(std::shared_ptr<GattScheduler> scheduler, uint64_t id,
+              GattScheduler::Clock::time_point deadline) {
+  if (deadline == GattScheduler::kNoDeadline) {
+    return;
+  }
+  auto delay = std::chrono::duration_cast<TimeSpan>(
+      deadline - GattScheduler::Clock::now());
+  ThreadPoolTimer::CreateTimer(
+      [scheduler, id](ThreadPoolTimer const &) { scheduler->Expire(id); },
+      std::max(delay, TimeSpan::zero()));
+}
+
+// Awaitable slot of a GattScheduler, see BluetoothDeviceAgent::Schedule.
+struct GattSlotAwaiter {
+  std::shared_ptr<GattScheduler> scheduler;
+  GattPriority priority;
+  GattScheduler::Clock::time_point deadline;
+  uint64_t ticketId = 0;
+  GattScheduler::State ticketState = GattScheduler::State::Queued;
+
+  bool await_ready() const noexcept { return false; }
+
+  // Goes on without suspending if the slot is decided right away. Otherwise
+  // whoever decides it resumes the coroutine, possibly before Submit
+  // returns, so the awaiter is not touched after queueing.
+  template <typename Handle> bool await_suspend(Handle handle) {
+    auto owner = scheduler;
+    auto expiry = deadline;
+    auto ticket = owner->Submit(
+        priority, expiry,
+        [this, handle](uint64_t decidedId, GattScheduler::State decided) {
+          ticketId = decidedId;
+          ticketState = decided;
+          handle.resume();
+        });
+    if (ticket.state != GattScheduler::State::Queued) {
+      ticketId = ticket.id;
+      ticketState = ticket.state;
+      return false;
+    }
+    expireAt(owner, ticket.id, expiry);
+    return true;
+  }
+
+  GattScheduler::Slot await_resume() {
+    return GattScheduler::Slot(std::move(scheduler), ticketId, ticketState);
+  }
+};
+
+// Thrown by an operation awaited through within() that missed its deadline.
+class GattTimeout : public std::runtime_error {
+public:
+  explicit GattTimeout(GattOperation kind)
+      : std::runtime_error(std::string(GattOperationName(kind)) +
+                           " timed out"),
+        operation(kind) {}
+
+  GattOperation operation;
+};
+
+// Error details of a timeout: the kind of operation that timed out.
+EncodableValue to_timeoutdetails(const GattTimeout &timeout) {
+  return EncodableMap{
+      {"operation", GattOperationName(timeout.operation)},
+  };
+}
+
+// Awaitable for a WinRT operation that must complete by |deadline|, see
+// within().
+template <typename Async> struct DeadlineAwaiter {
+  Async operation;
+  GattScheduler::Clock::time_point deadline;
+  GattOperation kind;
+
+  // Completion and the deadline timer race to resume the coroutine; the
+  // first one wins and the other does nothing.
+  struct Race {
+    std::mutex mutex;
+    bool decided = false;
+    bool timedOut = false;
+    ThreadPoolTimer timer{nullptr};
+  };
+  std::shared_ptr<Race> race = std::make_shared<Race>();
+
+  bool await_ready() const noexcept { return false; }
+
+  // The coroutine may be resumed before this returns, so only copies are
+  // used after the first handler is installed.
+  template <typename Handle> void await_suspend(Handle handle) {
+    auto shared = race;
+    auto async = operation;
+    if (deadline != GattScheduler::kNoDeadline) {
+      auto delay = std::chrono::duration_cast<TimeSpan>(
+          deadline - GattScheduler::Clock::now());
+      auto timer = ThreadPoolTimer::CreateTimer(
+          [shared, async, handle](ThreadPoolTimer const &) {
+            {
+              std::lock_guard<std::mutex> lock(shared->mutex);
+              if (shared->decided) {
+                return;
+              }
+              shared->decided = shared->timedOut = true;
+            }
+            async.Cancel();
+            handle.resume();
+          },
+          std::max(delay, TimeSpan::zero()));
+      std::lock_guard<std::mutex> lock(shared->mutex);
+      if (shared->decided) {
+        timer.Cancel();
+      } else {
+        shared->timer = timer;
+      }
+    }
+    async.Completed([shared, handle](Async const &, AsyncStatus) {
+      ThreadPoolTimer timer{nullptr};
+      {
+        std::lock_guard<std::mutex> lock(shared->mutex);
+        if (shared->decided) {
+          return;
+        }
+        shared->decided = true;
+        timer = std::move(shared->timer);
+      }
+      if (timer) {
+        timer.Cancel();
+      }
+      handle.resume();
+    });
+  }
+
+  auto await_resume() {
+    if (race->timedOut) {
+      throw GattTimeout(kind);
+    }
+    return operation.GetResults();
+  }
+};
+
+// Awaits |operation|, a WinRT or coroutine IAsyncOperation, until
+// |deadline|. Past it the operation is cancelled and GattTimeout is thrown
+// right away, even if the operation never completes, so a silent device
+// cannot hang the caller.
+template <typename Async>
+DeadlineAwaiter<Async> within(Async operation,
+                              GattScheduler::Clock::time_point deadline,
+                              GattOperation kind) {
+  return DeadlineAwaiter<Async>{std::move(operation), deadline, kind};
+}
+
+// Runs |operation| holding |slot|, which is released once the operation
+// completes, even if nobody awaits it any more. Cancelling the returned
+// operation cancels |operation|.
+template <typename Result>
+IAsyncOperation<Result> holding(GattScheduler::Slot slot,
+                                IAsyncOperation<Result> operation) {
+  auto cancellation = co_await winrt::get_cancellation_token();
+  cancellation.enable_propagation();
+  co_return co_await operation;
+}
+
+// Returns the argument stored under |key|, or nullptr if it is absent or null.
+const EncodableValue *findArg(const EncodableMap &args, const char *key) {
+  auto it = args.find(EncodableValue(key));
+  if (it == args.end() || it->second.IsNull()) {
+    return nullptr;
+  }
+  return &it->second;
+}
+
+// Reads the optional `cacheMode` argument into |mode|. Returns false if it
+// is present but not a known mode.
+bool parseCacheMode(const EncodableMap &args,
+                    std::optional<GattCacheMode> &mode) {
+  auto cacheMode = findArg(args, "cacheMode");
+  if (!cacheMode) {
+    return true;
+  }
+  mode = ParseGattCacheMode(std::get<std::string>(*cacheMode));
+  return mode.has_value();
+}
+
+// The optional `deadlineMs` argument, counted from now.
+GattScheduler::Clock::time_point parseDeadline(const EncodableMap &args) {
+  auto deadlineMs = findArg(args, "deadlineMs");
+  if (!deadlineMs) {
+    return GattScheduler::kNoDeadline;
+  }
+  return GattScheduler::Clock::now() +
+         std::chrono::milliseconds(deadlineMs->LongValue());
+}
+
+// A characteristic as addressed by a method call: by the handle handed out
+// at discovery, or by its service and characteristic UUIDs.
+struct CharacteristicRef {
+  uint32_t handle = kInvalidHandle;
+  BleUuid service;
+  BleUuid characteristic;
+};
+
+std::string to_refstr(const CharacteristicRef &ref) {
+  if (ref.handle != kInvalidHandle) {
+    return "#" + std::to_string(ref.handle);
+  }
+  return ref.characteristic.ToString();
+}
+
+// Reads the characteristic of a method call: `characteristicHandle` if
+// given, otherwise the `service` and `characteristic` UUIDs. Returns nullopt
+// if neither form is valid.
+std::optional<CharacteristicRef>
+parseCharacteristicRef(const EncodableMap &args) {
+  CharacteristicRef ref;
+  if (auto handle = findArg(args, "characteristicHandle")) {
+    ref.handle = (uint32_t)handle->LongValue();
+    return ref;
+  }
+  auto service = findArg(args, "service");
+  auto characteristic = findArg(args, "characteristic");
+  if (!service || !characteristic) {
+    return std::nullopt;
+  }
+  auto serviceUuid = BleUuid::Parse(std::get<std::string>(*service));
+  auto characteristicUuid =
+      BleUuid::Parse(std::get<std::string>(*characteristic));
+  if (!serviceUuid || !characteristicUuid) {
+    return std::nullopt;
+  }
+  ref.service = *serviceUuid;
+  ref.characteristic = *characteristicUuid;
+  return ref;
+}
+
 struct BluetoothDeviceAgent {
   BluetoothLEDevice device;
   winrt::event_token connnectionStatusChangedToken;
-  std::map<std::string, GattDeviceService> gattServices;
-  std::map<std::string, GattCharacteristic> gattCharacteristics;
-  std::map<std::string, winrt::event_token> valueChangedTokens;
+  uint64_t handle = DeviceHandleTable::kInvalidHandle;
+  // Set once the device is removed from the registry. Operations may still
+  // hold the agent, and give up when they see this.
+  std::atomic<bool> disconnected{false};
+
+  // Guards the tables and flags below, down to |writePipelines|; the
+  // counters in between are atomic. Coroutines resuming on thread-pool
+  // threads and the platform thread use them at once. The lock is held for
+  // single lookups and updates, never across a co_await, and what is read
+  // under it is copied out. Methods ending in Locked expect it held.
+  std::mutex mutex;
+  std::unordered_map<BleUuid, GattDeviceService, BleUuidHash> gattServices;
+  GattHandleTable<GattCharacteristic> gattCharacteristics;
+  std::map<uint32_t, winrt::event_token> valueChangedTokens;
+  // The descriptor value each subscription in |valueChangedTokens| wrote,
+  // to write it again when the device changes its services.
+  std::map<uint32_t, GattClientCharacteristicConfigurationDescriptorValue>
+      notificationModes;
+
+  // Negative cache. Once the service list, or the characteristics of a
+  // service, have been enumerated successfully, a UUID missing from them
+  // really does not exist and is answered without GATT traffic.
+  bool servicesEnumerated = false;
+  std::unordered_set<BleUuid, BleUuidHash> enumeratedServices;
+
+  // Layouts persisted across connections, or nullptr if disabled. When
+  // discovery is served from |cachedLayout|, characteristics are registered
+  // without GATT objects, which are fetched per service on first use.
+  GattLayoutCache *layoutCache = nullptr;
+  std::optional<GattLayout> cachedLayout;
+  winrt::event_token gattServicesChangedToken;
+  // Set while the cache is brought up to date after GattServicesChanged;
+  // another change meanwhile schedules one more pass.
+  bool refreshingServices = false;
+  bool servicesChangedAgain = false;
+
+  // GATT round-trips issued, and lookups answered from the cache instead.
+  std::atomic<uint64_t> gattRequests{0};
+  std::atomic<uint64_t> gattRequestsAvoided{0};
+
+  // Discovery steps and reads with a cache mode, see CountCacheResult.
+  GattCacheCounters systemCache;
+
+  // Services dropped from the cache because the device changed them.
+  std::atomic<uint64_t> servicesInvalidated{0};
+
+  // Admits the GATT operations of the device by priority, see
+  // setGattScheduler. Shared with the slots and timers that refer to it.
+  std::shared_ptr<GattScheduler> scheduler = std::make_shared<GattScheduler>();
+
+  // Queued writes per characteristic handle, see setWritePipeline.
+  WritePipeline::Options writePipelineOptions;
+  std::map<uint32_t, std::shared_ptr<WritePipeline>> writePipelines;
+
+  void CountCacheResult(GattCacheMode mode, GattCommunicationStatus status) {
+    systemCache.Count(mode, status == GattCommunicationStatus::Success);
+  }
 
   BluetoothDeviceAgent(BluetoothLEDevice device,
                        winrt::event_token connnectionStatusChangedToken)
@@ -91,13 +550,222 @@ struct BluetoothDeviceAgent {
 
   ~BluetoothDeviceAgent() { device = nullptr; }
 
+  // Waits for a slot of |scheduler|; the coroutine resumes with a Slot that
+  // is granted, or tells why not.
+  GattSlotAwaiter Schedule(
+      GattPriority priority,
+      GattScheduler::Clock::time_point deadline = GattScheduler::kNoDeadline) {
+    return GattSlotAwaiter{scheduler, priority, deadline};
+  }
+
   bool IsConnected() const {
-    return device &&
+    return !disconnected && device &&
            device.ConnectionStatus() == BluetoothConnectionStatus::Connected;
   }
 
+  // The characteristic behind |handle|, or nullptr.
+  GattCharacteristic Characteristic(uint32_t handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return CharacteristicLocked(handle);
+  }
+
+  GattCharacteristic CharacteristicLocked(uint32_t handle) {
+    auto entry = gattCharacteristics.Get(handle);
+    return entry ? entry->value : nullptr;
+  }
+
+  // Registers a service found by enumeration.
+  void AddService(GattDeviceService service) {
+    auto uuid = to_bleuuid(service.Uuid());
+    std::lock_guard<std::mutex> lock(mutex);
+    gattServices.emplace(uuid, service);
+  }
+
+  // The handle |ref| names, if the characteristic is registered, or
+  // kInvalidHandle. Does not fetch anything.
+  uint32_t FindHandle(const CharacteristicRef &ref) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (ref.handle != kInvalidHandle) {
+      return gattCharacteristics.Contains(ref.handle) ? ref.handle
+                                                      : kInvalidHandle;
+    }
+    return gattCharacteristics.Find(ref.service, ref.characteristic);
+  }
+
+  // Whether the characteristics of |service| are all registered.
+  bool IsEnumerated(const BleUuid &service) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return enumeratedServices.count(service) > 0;
+  }
+
+  void MarkEnumerated(const BleUuid &service) {
+    std::lock_guard<std::mutex> lock(mutex);
+    enumeratedServices.insert(service);
+  }
+
+  // Marks the service list as complete.
+  void MarkServicesEnumerated() {
+    std::lock_guard<std::mutex> lock(mutex);
+    servicesEnumerated = true;
+  }
+
+  std::optional<GattLayout> CachedLayout() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return cachedLayout;
+  }
+
+  bool HasCachedLayout() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return cachedLayout.has_value();
+  }
+
+  // Starts RefreshGattServicesAsync. Returns false if it runs already; it
+  // then makes one more pass.
+  bool BeginRefresh() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (refreshingServices) {
+      servicesChangedAgain = true;
+      return false;
+    }
+    refreshingServices = true;
+    return true;
+  }
+
+  // Ends a pass of RefreshGattServicesAsync. Returns true if the services
+  // changed during the pass and another one must follow; otherwise the
+  // refresh is over.
+  bool NextRefreshPass() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (servicesChangedAgain) {
+      servicesChangedAgain = false;
+      return true;
+    }
+    refreshingServices = false;
+    return false;
+  }
+
+  void EndRefresh() {
+    std::lock_guard<std::mutex> lock(mutex);
+    refreshingServices = false;
+  }
+
+  // Removes the notification subscription of |handle|, returning the token
+  // to revoke the handler with.
+  std::optional<winrt::event_token> TakeSubscription(uint32_t handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = valueChangedTokens.find(handle);
+    if (it == valueChangedTokens.end()) {
+      return std::nullopt;
+    }
+    auto token = it->second;
+    valueChangedTokens.erase(it);
+    notificationModes.erase(handle);
+    return token;
+  }
+
+  void AddSubscription(
+      uint32_t handle, winrt::event_token token,
+      GattClientCharacteristicConfigurationDescriptorValue mode) {
+    std::lock_guard<std::mutex> lock(mutex);
+    valueChangedTokens[handle] = token;
+    notificationModes[handle] = mode;
+  }
+
+  std::map<uint32_t, winrt::event_token> Subscriptions() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return valueChangedTokens;
+  }
+
+  std::shared_ptr<WritePipeline> WritePipelineOf(uint32_t handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto &pipeline = writePipelines[handle];
+    if (!pipeline) {
+      pipeline = std::make_shared<WritePipeline>(writePipelineOptions);
+    }
+    return pipeline;
+  }
+
+  std::vector<std::shared_ptr<WritePipeline>> WritePipelines() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::shared_ptr<WritePipeline>> pipelines;
+    for (auto &pipeline : writePipelines) {
+      pipelines.push_back(pipeline.second);
+    }
+    return pipelines;
+  }
+
+  WritePipeline::Options WritePipelineOptions() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return writePipelineOptions;
+  }
+
+  // Applies |options| to the existing pipelines and those created later.
+  void SetWritePipelineOptions(WritePipeline::Options options) {
+    std::lock_guard<std::mutex> lock(mutex);
+    writePipelineOptions = options;
+    for (auto &pipeline : writePipelines) {
+      pipeline.second->SetOptions(options);
+    }
+  }
+
+  // Number of characteristics registered for |service|.
+  size_t CharacteristicCountLocked(const BleUuid &service) {
+    size_t count = 0;
+    for (auto &entry : gattCharacteristics) {
+      count += entry.service == service ? 1 : 0;
+    }
+    return count;
+  }
+
+  // Drops the GATT objects of the characteristics of |service|. Their
+  // handles stay allocated and resolve again if the characteristic is found
+  // on the next enumeration.
+  void InvalidateServiceLocked(const BleUuid &service) {
+    for (auto &entry : gattCharacteristics) {
+      if (entry.service == service) {
+        entry.value = nullptr;
+      }
+    }
+    enumeratedServices.erase(service);
+    servicesInvalidated++;
+  }
+
+  // Registers a characteristic known from the layout cache, without its
+  // GATT object, unless it is registered already. Returns its handle.
+  uint32_t AddCachedCharacteristic(const BleUuid &service,
+                                   const BleUuid &characteristic,
+                                   uint16_t instance) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto handle = gattCharacteristics.Find(service, characteristic, instance);
+    if (handle != kInvalidHandle) {
+      return handle;
+    }
+    return gattCharacteristics.Insert(service, characteristic, instance,
+                                      nullptr);
+  }
+
+  // Registers |characteristic| and returns its handle.
+  uint32_t AddCharacteristic(const BleUuid &service,
+                             GattCharacteristic characteristic) {
+    auto uuid = to_bleuuid(characteristic.Uuid());
+    auto instance = characteristic.AttributeHandle();
+    std::lock_guard<std::mutex> lock(mutex);
+    return AddCharacteristicLocked(service, uuid, instance, characteristic);
+  }
+
+  uint32_t AddCharacteristicLocked(const BleUuid &service,
+                                   const BleUuid &uuid, uint16_t instance,
+                                   GattCharacteristic characteristic) {
+    return gattCharacteristics.Insert(service, uuid, instance,
+                                      std::move(characteristic));
+  }
+
   IAsyncOperation<GattDeviceService>
-  BluetoothDeviceAgent::GetServiceAsync(std::string service) {
+  BluetoothDeviceAgent::GetServiceAsync(BleUuid service) {
+    // Cancelling the lookup, e.g. on a timeout, cancels its GATT request
+    auto cancellation = co_await winrt::get_cancellation_token();
+    cancellation.enable_propagation();
+
     // First check if device is valid
     if (!device) {
       OutputDebugString(L"GetServiceAsync: Device is null\n");
@@ -106,25 +774,45 @@ struct BluetoothDeviceAgent {
 
     try {
       // Check if we already have the service cached
-      if (gattServices.count(service) > 0) {
-        // Verify the cached service is still valid
-        auto &cachedService = gattServices.at(service);
-        if (cachedService) {
-          co_return cachedService;
+      GattDeviceService cached{nullptr};
+      bool missing = false;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = gattServices.find(service);
+        if (it != gattServices.end()) {
+          // Verify the cached service is still valid
+          if (it->second) {
+            cached = it->second;
+          } else {
+            // Remove invalid cached service
+            OutputDebugString(
+                (L"GetServiceAsync: Cached service is invalid, removing: " +
+                 winrt::to_hstring(service.ToString()) + L"\n")
+                    .c_str());
+            gattServices.erase(it);
+            servicesEnumerated = false;
+          }
         } else {
-          // Remove invalid cached service
-          OutputDebugString(
-              (L"GetServiceAsync: Cached service is invalid, removing: " +
-               winrt::to_hstring(service) + L"\n")
-                  .c_str());
-          gattServices.erase(service);
+          missing = servicesEnumerated;
         }
       }
+      if (cached) {
+        gattRequestsAvoided++;
+        co_return cached;
+      }
+      if (missing) {
+        gattRequestsAvoided++;
+        OutputDebugString((L"GetServiceAsync: Service not found (cached): " +
+                           winrt::to_hstring(service.ToString()) + L"\n")
+                              .c_str());
+        co_return nullptr;
+      }
 
       // Get services
       OutputDebugString((L"GetServiceAsync: Getting services for: " +
-                         winrt::to_hstring(service) + L"\n")
+                         winrt::to_hstring(service.ToString()) + L"\n")
                             .c_str());
+      gattRequests++;
       auto serviceResult = co_await device.GetGattServicesAsync();
 
       if (serviceResult == nullptr ||
@@ -138,17 +826,27 @@ struct BluetoothDeviceAgent {
         co_return nullptr;
       }
 
-      // Search for the requested service
+      // Cache every service, then look up the requested one
       for (auto s : serviceResult.Services()) {
-        if (s && to_uuidstr(s.Uuid()) == service) {
-          gattServices.insert(std::make_pair(service, s));
-          co_return s;
+        if (s) {
+          AddService(s);
+        }
+      }
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        servicesEnumerated = true;
+        auto it = gattServices.find(service);
+        if (it != gattServices.end()) {
+          cached = it->second;
         }
       }
+      if (cached) {
+        co_return cached;
+      }
 
       // Service not found
       OutputDebugString((L"GetServiceAsync: Service not found: " +
-                         winrt::to_hstring(service) + L"\n")
+                         winrt::to_hstring(service.ToString()) + L"\n")
                             .c_str());
       co_return nullptr;
     } catch (const winrt::hresult_error &ex) {
@@ -162,109 +860,339 @@ struct BluetoothDeviceAgent {
     }
   }
 
-  IAsyncOperation<GattCharacteristic>
-  BluetoothDeviceAgent::GetCharacteristicAsync(std::string service,
-                                               std::string characteristic) {
+  // Resolves |ref| to a characteristic handle. On a miss, all
+  // characteristics of the service are fetched and registered at once.
+  // Returns kInvalidHandle if the characteristic does not exist.
+  IAsyncOperation<uint32_t>
+  BluetoothDeviceAgent::ResolveCharacteristicAsync(CharacteristicRef ref) {
+    // Cancelling the lookup, e.g. on a timeout, cancels its GATT requests
+    auto cancellation = co_await winrt::get_cancellation_token();
+    cancellation.enable_propagation();
 
     // First check if device is valid
     if (!device) {
-      OutputDebugString(L"GetCharacteristicAsync: Device is null\n");
-      co_return nullptr;
+      OutputDebugString(L"ResolveCharacteristicAsync: Device is null\n");
+      co_return kInvalidHandle;
+    }
+
+    // A handle names one exact entry. Entries registered from the layout
+    // cache have no GATT object yet; those are fetched with their service.
+    auto requested = ref.handle;
+    if (requested != kInvalidHandle) {
+      std::optional<GattHandleTable<GattCharacteristic>::Entry> entry;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        entry = gattCharacteristics.Get(requested);
+      }
+      if (!entry) {
+        co_return kInvalidHandle;
+      }
+      if (entry->value) {
+        co_return requested;
+      }
+      ref.service = entry->service;
+      ref.characteristic = entry->characteristic;
     }
 
     try {
       // Check if we already have the characteristic cached
-      if (gattCharacteristics.count(characteristic) > 0) {
-        // Verify the cached characteristic is still valid
-        auto &cachedCharacteristic = gattCharacteristics.at(characteristic);
-        if (cachedCharacteristic) {
-          co_return cachedCharacteristic;
-        } else {
-          // Remove invalid cached characteristic
-          OutputDebugString((L"GetCharacteristicAsync: Cached characteristic "
-                             L"is invalid, removing: " +
-                             winrt::to_hstring(characteristic) + L"\n")
-                                .c_str());
-          gattCharacteristics.erase(characteristic);
-        }
+      auto handle = FindHandle(ref);
+      if (handle != kInvalidHandle && Characteristic(handle)) {
+        gattRequestsAvoided++;
+        co_return handle;
+      }
+      if (handle == kInvalidHandle && IsEnumerated(ref.service)) {
+        gattRequestsAvoided++;
+        OutputDebugString(
+            (L"ResolveCharacteristicAsync: Characteristic not found "
+             L"(cached): " +
+             winrt::to_hstring(to_refstr(ref)) + L"\n")
+                .c_str());
+        co_return kInvalidHandle;
       }
 
       // Get the service
-      auto gattService = co_await GetServiceAsync(service);
+      auto gattService = co_await GetServiceAsync(ref.service);
       if (!gattService) {
-        OutputDebugString((L"GetCharacteristicAsync: Service not found: " +
-                           winrt::to_hstring(service) + L"\n")
+        OutputDebugString((L"ResolveCharacteristicAsync: Service not found: " +
+                           winrt::to_hstring(ref.service.ToString()) + L"\n")
                               .c_str());
-        co_return nullptr;
+        co_return kInvalidHandle;
       }
 
       // Get characteristics
       OutputDebugString(
-          (L"GetCharacteristicAsync: Getting characteristics for: " +
-           winrt::to_hstring(characteristic) + L"\n")
+          (L"ResolveCharacteristicAsync: Getting characteristics for: " +
+           winrt::to_hstring(to_refstr(ref)) + L"\n")
               .c_str());
-      auto characteristicResult =
-          co_await gattService.GetCharacteristicsAsync();
+      gattRequests++;
+      // With a persisted layout the OS cache is known to be current
+      auto operation =
+          HasCachedLayout()
+              ? gattService.GetCharacteristicsAsync(BluetoothCacheMode::Cached)
+              : gattService.GetCharacteristicsAsync();
+      auto characteristicResult = co_await operation;
 
       if (characteristicResult == nullptr ||
           characteristicResult.Status() != GattCommunicationStatus::Success) {
         OutputDebugString(
-            (L"GetCharacteristicAsync: Failed to get characteristics, "
+            (L"ResolveCharacteristicAsync: Failed to get characteristics, "
              L"status: " +
              (characteristicResult
                   ? winrt::to_hstring((int32_t)characteristicResult.Status())
                   : L"null") +
              L"\n")
                 .c_str());
-        co_return nullptr;
+        co_return kInvalidHandle;
       }
 
-      // Search for the requested characteristic
       for (auto c : characteristicResult.Characteristics()) {
-        if (c && to_uuidstr(c.Uuid()) == characteristic) {
-          gattCharacteristics.insert(std::make_pair(characteristic, c));
-          co_return c;
+        if (c) {
+          AddCharacteristic(ref.service, c);
         }
       }
+      MarkEnumerated(ref.service);
+      handle = FindHandle(ref);
+      if (handle != kInvalidHandle && Characteristic(handle)) {
+        co_return handle;
+      }
+      if (handle != kInvalidHandle && layoutCache) {
+        // Registered from the layout cache, but gone from the device
+        OutputDebugString(L"ResolveCharacteristicAsync: Cached GATT layout "
+                          L"is stale, removing it\n");
+        layoutCache->Remove(device.BluetoothAddress());
+      }
 
       // Characteristic not found
-      OutputDebugString((L"GetCharacteristicAsync: Characteristic not found: " +
-                         winrt::to_hstring(characteristic) + L"\n")
-                            .c_str());
-      co_return nullptr;
+      OutputDebugString(
+          (L"ResolveCharacteristicAsync: Characteristic not found: " +
+           winrt::to_hstring(to_refstr(ref)) + L"\n")
+              .c_str());
+      co_return kInvalidHandle;
     } catch (const winrt::hresult_error &ex) {
-      OutputDebugString((L"GetCharacteristicAsync exception: " + ex.message() +
-                         L", code: " + winrt::to_hstring(ex.code()) + L"\n")
+      OutputDebugString((L"ResolveCharacteristicAsync exception: " +
+                         ex.message() + L", code: " +
+                         winrt::to_hstring(ex.code()) + L"\n")
                             .c_str());
-      co_return nullptr;
+      co_return kInvalidHandle;
     } catch (...) {
-      OutputDebugString(L"GetCharacteristicAsync unknown exception\n");
-      co_return nullptr;
+      OutputDebugString(L"ResolveCharacteristicAsync unknown exception\n");
+      co_return kInvalidHandle;
     }
   }
 };
 
-std::vector<uint8_t>
-parseManufacturerDataHead(BluetoothLEAdvertisement advertisement) {
-  if (advertisement.ManufacturerData().Size() == 0)
-    return std::vector<uint8_t>();
+// The `services` entry of the discovery message: per service its UUID and
+// characteristics, each with UUID, handle, property bits and descriptor
+// UUIDs. Registers characteristics not known to |agent| yet.
+EncodableList to_gatt_tree(BluetoothDeviceAgent &agent,
+                           const GattLayout &layout) {
+  EncodableList services;
+  services.reserve(layout.services.size());
+  for (const auto &service : layout.services) {
+    EncodableList characteristics;
+    characteristics.reserve(service.characteristics.size());
+    for (const auto &c : service.characteristics) {
+      EncodableList descriptors;
+      for (const auto &descriptor : c.descriptors) {
+        descriptors.emplace_back(descriptor.ToString());
+      }
+      auto handle =
+          agent.AddCachedCharacteristic(service.uuid, c.uuid, c.instance);
+      EncodableMap node;
+      node[EncodableValue("characteristic")] =
+          EncodableValue(c.uuid.ToString());
+      node[EncodableValue("handle")] = EncodableValue((int64_t)handle);
+      node[EncodableValue("properties")] =
+          EncodableValue((int64_t)c.properties);
+      node[EncodableValue("descriptors")] =
+          EncodableValue(std::move(descriptors));
+      characteristics.emplace_back(std::move(node));
+    }
+    EncodableMap node;
+    node[EncodableValue("service")] = EncodableValue(service.uuid.ToString());
+    node[EncodableValue("characteristics")] =
+        EncodableValue(std::move(characteristics));
+    services.emplace_back(std::move(node));
+  }
+  return services;
+}
 
-  auto manufacturerData = advertisement.ManufacturerData().GetAt(0);
-  // FIXME Compat with REG_DWORD_BIG_ENDIAN
-  uint8_t *prefix = uint16_t_union{manufacturerData.CompanyId()}.bytes;
-  auto result = std::vector<uint8_t>{prefix, prefix + sizeof(uint16_t_union)};
+// A writeStream call: one large value written in MTU-sized chunks.
+struct StreamWrite {
+  std::vector<uint8_t> value;
+  bool withResponse = true;
+  // Chunks in flight at once.
+  size_t window = 8;
+  // Upper bound of the chunk size, or 0 for as large as the MTU allows.
+  size_t maxChunkSize = 0;
+  // Echoed in progress messages, so Dart can tell transfers apart.
+  int64_t transferId = 0;
+  std::chrono::milliseconds progressInterval{100};
+  // The transfer fails if a chunk cannot start by then.
+  GattScheduler::Clock::time_point deadline = GattScheduler::kNoDeadline;
+};
 
-  auto data = to_bytevc(manufacturerData.Data());
-  result.insert(result.end(), data.begin(), data.end());
-  return result;
+// Per-device notification batch and the timer that flushes it.
+struct NotificationBatching {
+  Batcher<EncodableValue> batcher;
+  ThreadPoolTimer flushTimer{nullptr};
+
+  explicit NotificationBatching(size_t maxEntries) : batcher(maxEntries) {}
+};
+
+// Builds the scan filter from `startScan` arguments. Returns nullopt and sets
+// |invalidUuid| if a service UUID cannot be parsed.
+std::optional<ScanFilter> parseScanFilter(const EncodableMap &args,
+                                          std::string &invalidUuid) {
+  ScanFilter filter;
+  auto addServiceUuid = [&](const std::string &text) {
+    auto uuid = BleUuid::Parse(text);
+    if (!uuid) {
+      invalidUuid = text;
+      return false;
+    }
+    filter.serviceUuids.push_back(*uuid);
+    return true;
+  };
+
+  if (auto serviceId = findArg(args, "serviceId")) {
+    if (!addServiceUuid(std::get<std::string>(*serviceId))) {
+      return std::nullopt;
+    }
+  }
+  if (auto serviceIds = findArg(args, "serviceIds")) {
+    for (auto &serviceId : std::get<EncodableList>(*serviceIds)) {
+      if (!addServiceUuid(std::get<std::string>(serviceId))) {
+        return std::nullopt;
+      }
+    }
+  }
+  if (auto manufacturerIds = findArg(args, "manufacturerIds")) {
+    for (auto &manufacturerId : std::get<EncodableList>(*manufacturerIds)) {
+      filter.companyIds.push_back((uint16_t)manufacturerId.LongValue());
+    }
+  }
+  if (auto minRssi = findArg(args, "minRssi")) {
+    filter.minRssi = (int16_t)minRssi->LongValue();
+  }
+  if (auto namePrefixes = findArg(args, "namePrefixes")) {
+    for (auto &namePrefix : std::get<EncodableList>(*namePrefixes)) {
+      filter.namePrefixes.push_back(std::get<std::string>(namePrefix));
+    }
+  }
+  return filter;
 }
 
+// Reads the duplicate suppression options from `startScan` arguments.
+// Suppression stays off unless one of them is given.
+std::optional<AdvertisementSuppressor::Options>
+parseSuppressionOptions(const EncodableMap &args) {
+  auto rssiDelta = findArg(args, "rssiDelta");
+  auto heartbeatIntervalMs = findArg(args, "heartbeatIntervalMs");
+  if (!rssiDelta && !heartbeatIntervalMs) {
+    return std::nullopt;
+  }
+  AdvertisementSuppressor::Options options;
+  if (rssiDelta) {
+    options.rssiDelta = (int)rssiDelta->LongValue();
+  }
+  if (heartbeatIntervalMs) {
+    options.heartbeat =
+        std::chrono::milliseconds(heartbeatIntervalMs->LongValue());
+  }
+  return options;
+}
+
+// AdvertisementSource backed by a BluetoothLEAdvertisementWatcher.
+class WatcherAdvertisementSource : public AdvertisementSource {
+public:
+  ~WatcherAdvertisementSource() override { Stop(); }
+
+  void Start(Handler handler) override {
+    this->handler = std::move(handler);
+    if (!watcher) {
+      watcher = BluetoothLEAdvertisementWatcher();
+      receivedToken = watcher.Received(
+          {this, &WatcherAdvertisementSource::BluetoothLEWatcher_Received});
+    }
+    ApplyFilter();
+    watcher.Start();
+  }
+
+  void Stop() override {
+    if (watcher) {
+      watcher.Stop();
+      watcher.Received(receivedToken);
+    }
+    watcher = nullptr;
+  }
+
+  void SetFilter(const ScanFilter &filter) override { this->filter = filter; }
+
+private:
+  // The OS filter requires every listed UUID to be present, so it is only
+  // used when a single service is requested. Company IDs and name prefixes
+  // are left to the plugin.
+  void ApplyFilter() {
+    auto advertisementFilter = BluetoothLEAdvertisementFilter();
+    if (filter.serviceUuids.size() == 1) {
+      advertisementFilter.Advertisement().ServiceUuids().Append(
+          to_guid(filter.serviceUuids.front()));
+    }
+    watcher.AdvertisementFilter(advertisementFilter);
+
+    auto signalStrengthFilter = BluetoothSignalStrengthFilter();
+    if (filter.minRssi) {
+      signalStrengthFilter.InRangeThresholdInDBm(*filter.minRssi);
+      signalStrengthFilter.OutOfRangeThresholdInDBm(*filter.minRssi);
+    }
+    watcher.SignalStrengthFilter(signalStrengthFilter);
+  }
+
+  void
+  BluetoothLEWatcher_Received(BluetoothLEAdvertisementWatcher sender,
+                              BluetoothLEAdvertisementReceivedEventArgs args) {
+    Advertisement result;
+    result.address = args.BluetoothAddress();
+    result.rssi = args.RawSignalStrengthInDBm();
+    result.scanResponse =
+        args.AdvertisementType() == BluetoothLEAdvertisementType::ScanResponse;
+
+    // Sections are appended straight from the WinRT buffers. Sections longer
+    // than an AD structure allows are rejected (and counted) by Append
+    // without being read.
+    for (auto dataSection : args.Advertisement().DataSections()) {
+      auto buffer = dataSection.Data();
+      result.data.Append(dataSection.DataType(), buffer_data(buffer),
+                         buffer.Length());
+    }
+    handler(result);
+  }
+
+  Handler handler;
+  ScanFilter filter;
+  BluetoothLEAdvertisementWatcher watcher{nullptr};
+  winrt::event_token receivedToken;
+};
+
 } // end of anonymous namespace
 
 // Class definition outside anonymous namespace
 class QuickBlueWindowsPlugin : public flutter::Plugin,
                                public flutter::StreamHandler<EncodableValue> {
 public:
+  static constexpr size_t kDefaultScanBatchSize = 64;
+  static constexpr int64_t kDefaultScanBatchIntervalMs = 100;
+  static constexpr int64_t kDefaultSnapshotIntervalMs = 100;
+  static constexpr size_t kScanConcurrency = 4;
+  static constexpr size_t kScanQueueCapacity = 256;
+  static constexpr size_t kDefaultNotificationBatchSize = 256;
+  static constexpr size_t kOutboundQueueCapacity = 4096;
+  static constexpr size_t kOutboundDrainBatch = 256;
+  static constexpr char kBinaryNotificationChannel[] =
+      "quick_blue/binary.notification";
+
   static void RegisterWithRegistrar(flutter::PluginRegistrarWindows *registrar);
 
   QuickBlueWindowsPlugin();
@@ -290,39 +1218,209 @@ private:
 
   std::unique_ptr<flutter::EventSink<EncodableValue>> scan_result_sink_;
 
-  Radio bluetoothRadio{nullptr};
-
-  BluetoothLEAdvertisementWatcher bluetoothLEWatcher{nullptr};
-  winrt::event_token bluetoothLEWatcherReceivedToken;
+  flutter::BinaryMessenger *messenger = nullptr;
+
+  // Everything sent to Dart, from whichever thread produced it, is sent from
+  // the platform thread: producers queue it here and post a window message,
+  // whose handler drains the queue in batches.
+  OutboundDispatcher outbound{kOutboundQueueCapacity,
+                              [this] { WakePlatformThread(); }};
+  const UINT wakeMessage = RegisterWindowMessage(L"quick_blue.outbound");
+  std::atomic<HWND> dispatchWindow{nullptr};
+  flutter::PluginRegistrarWindows *windowRegistrar = nullptr;
+  int windowProcDelegate = 0;
+  // Owned window taking the wake messages when the engine has no view.
+  HWND messageWindow = nullptr;
+  void AttachToWindow(flutter::PluginRegistrarWindows *registrar);
+  HWND CreateMessageWindow();
+  static LRESULT CALLBACK MessageWindowProc(HWND window, UINT message,
+                                            WPARAM wparam, LPARAM lparam);
+  void WakePlatformThread();
+  void SendConnectorMessage(EncodableValue message, bool droppable = false);
+  void SendScanEvent(EncodableValue event);
   void
-  BluetoothLEWatcher_Received(BluetoothLEAdvertisementWatcher sender,
-                              BluetoothLEAdvertisementReceivedEventArgs args);
-  winrt::fire_and_forget
-  SendScanResultAsync(BluetoothLEAdvertisementReceivedEventArgs args);
+  PostSuccess(std::unique_ptr<flutter::MethodResult<EncodableValue>> result,
+              EncodableValue value = EncodableValue());
+  void PostError(std::unique_ptr<flutter::MethodResult<EncodableValue>> result,
+                 const std::string &code, const std::string &message,
+                 EncodableValue details = EncodableValue());
+
+  Radio bluetoothRadio{nullptr};
 
-  std::map<uint64_t, std::unique_ptr<BluetoothDeviceAgent>> connectedDevices{};
+  std::unique_ptr<AdvertisementSource> advertisementSource;
+  // Filter of the running scan, null while stopped. Replaced as a whole by
+  // startScan, so scan workers never see a half-assigned filter; each task
+  // carries the snapshot it was posted under and is dropped once that is no
+  // longer current.
+  std::shared_ptr<const ScanFilter> scanFilter;
+  std::shared_ptr<const ScanFilter> CurrentScanFilter() const {
+    return std::atomic_load_explicit(&scanFilter, std::memory_order_acquire);
+  }
+  void PublishScanFilter(std::shared_ptr<const ScanFilter> filter) {
+    std::atomic_store_explicit(&scanFilter, std::move(filter),
+                               std::memory_order_release);
+  }
+  std::atomic<bool> suppressRepeats{false};
+  AdvertisementSuppressor scanSuppressor;
+  ScanDeviceTable scanDevices;
+  void OnAdvertisement(const Advertisement &advertisement,
+                       const std::shared_ptr<const ScanFilter> &filter);
+  std::optional<std::string> ResolveName(uint64_t bluetoothAddress);
+  void SendScanResult(const Advertisement &advertisement,
+                      const std::string &name);
+
+  // Entered by the periodic timers, which Cancel() does not wait for; closed
+  // by the destructor before the members they use go away.
+  std::shared_ptr<CallbackGuard> timerGuard =
+      std::make_shared<CallbackGuard>();
+
+  // Opt-in batching of scan results, configured by `startScan` arguments.
+  std::atomic<bool> batchScanResults{false};
+  Batcher<EncodableValue> scanResultBatcher{kDefaultScanBatchSize};
+  ThreadPoolTimer scanResultFlushTimer{nullptr};
+  void StartScanResultBatching(const EncodableMap &args);
+  void StopScanResultBatching();
+  void FlushScanResults(std::vector<EncodableValue> batch);
+
+  // Nearest-N mode: scan results only update the device table, which a timer
+  // publishes as a ranked snapshot.
+  std::atomic<bool> snapshotMode{false};
+  NearestDevices nearestDevices;
+  ThreadPoolTimer snapshotTimer{nullptr};
+  void StartSnapshots(const EncodableMap &args);
+  void StopSnapshots();
+  void SendSnapshot();
+
+  // Runs the scan path off the watcher's callback thread. Keyed by address,
+  // so advertisements of one device are processed in order. Declared after
+  // the scan state it uses, so its workers are joined before that goes away.
+  BoundedExecutor scanExecutor{BoundedExecutor::Options{
+      kScanConcurrency,
+      kScanQueueCapacity,
+      [] { winrt::init_apartment(winrt::apartment_type::multi_threaded); },
+      [] { winrt::uninit_apartment(); },
+  }};
+
+  // Read from any thread without locking; the agents are shared with the
+  // operations running on them.
+  DeviceRegistry<BluetoothDeviceAgent> connectedDevices;
+  DeviceHandleTable deviceHandles;
+  // Resolves the device of a method call from `deviceHandle`, or from the
+  // decimal `deviceId` if no handle is given. Returns nullptr if the device
+  // is not connected.
+  std::shared_ptr<BluetoothDeviceAgent> FindDevice(const EncodableMap &args);
+
+  // Devices whose notifications are delivered in batches rather than one
+  // message per packet, or as packed frames on the binary channel.
+  std::mutex notificationOptionsMutex;
+  std::map<uint64_t, std::shared_ptr<NotificationBatching>>
+      notificationBatching;
+  std::set<uint64_t> binaryNotificationDevices;
+
+  // Outgoing notification payloads are copied once from the OS buffer into
+  // storage from this pool, which is reused after each send.
+  ByteBufferPool notificationBuffers;
+  std::atomic<uint64_t> notificationsReceived{0};
+  std::atomic<uint64_t> notificationBytesReceived{0};
+  // Values whose length or characteristic handle does not fit a binary
+  // frame, sent as a regular message instead.
+  std::atomic<uint64_t> notificationsOversized{0};
+
+  // GATT layouts persisted across connections, see setGattCache.
+  GattLayoutCache gattLayouts;
+  // Cache mode of reads that do not ask for one, see setGattCachePolicy.
+  GattCachePolicy readCachePolicy;
+  // How long each kind of operation may run, see setTimeouts.
+  OperationTimeouts operationTimeouts;
+
+  // Method calls answered once their GATT operation has finished, by
+  // request id. Those of a device fail when it disconnects.
+  PendingOperations<std::unique_ptr<flutter::MethodResult<EncodableValue>>>
+      pendingOperations;
+  uint64_t AddPendingOperation(
+      BluetoothDeviceAgent &bluetoothDeviceAgent,
+      std::unique_ptr<flutter::MethodResult<EncodableValue>> result);
+  void CompleteOperation(uint64_t requestId,
+                         const EncodableValue &value = EncodableValue());
+  void FailOperation(uint64_t requestId, const std::string &code,
+                     const std::string &message,
+                     const EncodableValue &details = EncodableValue());
+  // Connections waiting for their first notification, to measure latency
+  // from connect for cold starts and layout cache (warm) starts. Guarded by
+  // notificationOptionsMutex. The latencies are in microseconds, or -1.
+  struct PendingFirstNotification {
+    std::chrono::steady_clock::time_point connectStarted;
+    bool warm;
+  };
+  std::map<uint64_t, PendingFirstNotification> pendingFirstNotification;
+  std::atomic<int64_t> firstNotificationLatencyColdUs{-1};
+  std::atomic<int64_t> firstNotificationLatencyWarmUs{-1};
+  void SetNotificationBatching(uint64_t bluetoothAddress, int64_t intervalMs,
+                               size_t maxEntries);
+  void SendNotificationBatch(uint64_t bluetoothAddress,
+                             std::vector<EncodableValue> batch);
 
   winrt::fire_and_forget ConnectAsync(uint64_t bluetoothAddress);
   void BluetoothLEDevice_ConnectionStatusChanged(BluetoothLEDevice sender,
-                                                 IInspectable args);
-  void CleanConnection(uint64_t bluetoothAddress);
+                                                 uint64_t generation);
+  // Unregisters the device and releases what it holds, unless it has
+  // connected again since connection |generation|. Returns false if there
+  // was nothing to clean up.
+  bool CleanConnection(uint64_t bluetoothAddress,
+                       uint64_t generation = DeviceRegistry<
+                           BluetoothDeviceAgent>::kAnyGeneration);
+  winrt::fire_and_forget RefreshGattServicesAsync(uint64_t bluetoothAddress,
+                                                  uint64_t generation);
+  winrt::event_token
+  SubscribeValueChanged(BluetoothDeviceAgent &bluetoothDeviceAgent,
+                        uint32_t characteristicHandle,
+                        GattCharacteristic characteristic);
   winrt::fire_and_forget
-  DiscoverServicesAsync(BluetoothDeviceAgent &bluetoothDeviceAgent);
+  DiscoverServicesAsync(std::shared_ptr<BluetoothDeviceAgent> deviceAgent,
+                        std::optional<GattCacheMode> cacheMode);
+  void SendGattTree(BluetoothDeviceAgent &bluetoothDeviceAgent,
+                    const GattLayout &layout);
   winrt::fire_and_forget
-  SetNotifiableAsync(BluetoothDeviceAgent &bluetoothDeviceAgent,
-                     std::string service, std::string characteristic,
+  SetNotifiableAsync(std::shared_ptr<BluetoothDeviceAgent> deviceAgent,
+                     CharacteristicRef characteristic,
                      std::string bleInputProperty);
   winrt::fire_and_forget
-  RequestMtuAsync(BluetoothDeviceAgent &bluetoothDeviceAgent,
-                  uint64_t expectedMtu);
+  RequestMtuAsync(std::shared_ptr<BluetoothDeviceAgent> deviceAgent,
+                  uint64_t expectedMtu, uint64_t requestId,
+                  GattScheduler::Clock::time_point deadline);
+  winrt::fire_and_forget
+  ReadValueAsync(std::shared_ptr<BluetoothDeviceAgent> deviceAgent,
+                 CharacteristicRef characteristic,
+                 std::optional<GattCacheMode> cacheMode, uint64_t requestId,
+                 GattScheduler::Clock::time_point deadline);
   winrt::fire_and_forget
-  ReadValueAsync(BluetoothDeviceAgent &bluetoothDeviceAgent,
-                 std::string service, std::string characteristic);
+  WriteValueAsync(std::shared_ptr<BluetoothDeviceAgent> deviceAgent,
+                  CharacteristicRef characteristic, WritePipeline::Write write);
+  void QueueWrite(std::shared_ptr<BluetoothDeviceAgent> deviceAgent,
+                  uint32_t characteristicHandle, WritePipeline::Write write);
   winrt::fire_and_forget
-  WriteValueAsync(BluetoothDeviceAgent &bluetoothDeviceAgent,
-                  std::string service, std::string characteristic,
-                  std::vector<uint8_t> value, std::string bleOutputProperty);
-  void GattCharacteristic_ValueChanged(GattCharacteristic sender,
+  DrainWritesAsync(std::shared_ptr<BluetoothDeviceAgent> deviceAgent,
+                   uint32_t characteristicHandle);
+  void DrainWrites(std::shared_ptr<WritePipeline> pipeline,
+                   GattCharacteristic characteristic,
+                   std::shared_ptr<GattScheduler> scheduler);
+  void IssueWrite(std::shared_ptr<WritePipeline> pipeline,
+                  GattCharacteristic characteristic,
+                  std::shared_ptr<GattScheduler> scheduler, uint64_t ticketId,
+                  GattScheduler::State state, WritePipeline::Write write);
+  winrt::fire_and_forget WriteReliableAsync(
+      std::shared_ptr<BluetoothDeviceAgent> deviceAgent,
+      std::vector<std::pair<CharacteristicRef, std::vector<uint8_t>>> writes,
+      GattScheduler::Clock::time_point deadline,
+      std::unique_ptr<flutter::MethodResult<EncodableValue>> result);
+  winrt::fire_and_forget WriteStreamAsync(
+      std::shared_ptr<BluetoothDeviceAgent> deviceAgent,
+      CharacteristicRef characteristic, StreamWrite stream,
+      std::unique_ptr<flutter::MethodResult<EncodableValue>> result);
+  void GattCharacteristic_ValueChanged(uint64_t deviceAddress,
+                                       uint64_t deviceHandle,
+                                       uint32_t characteristicHandle,
+                                       GattCharacteristic sender,
                                        GattValueChangedEventArgs args);
 };
 
@@ -362,13 +1460,167 @@ void QuickBlueWindowsPlugin::RegisterWithRegistrar(
   event_scan_result->SetStreamHandler(std::move(handler));
 
   plugin->message_connector_ = std::move(message_connector_);
+  plugin->messenger = registrar->messenger();
+  plugin->AttachToWindow(registrar);
 
   registrar->AddPlugin(std::move(plugin));
 }
 
 QuickBlueWindowsPlugin::QuickBlueWindowsPlugin() { InitializeAsync(); }
 
-QuickBlueWindowsPlugin::~QuickBlueWindowsPlugin() {}
+QuickBlueWindowsPlugin::~QuickBlueWindowsPlugin() {
+  if (windowRegistrar) {
+    windowRegistrar->UnregisterTopLevelWindowProcDelegate(windowProcDelegate);
+  }
+  dispatchWindow = nullptr;
+  if (messageWindow) {
+    DestroyWindow(messageWindow);
+  }
+  if (advertisementSource) {
+    advertisementSource->Stop();
+  }
+  if (scanResultFlushTimer) {
+    scanResultFlushTimer.Cancel();
+  }
+  if (snapshotTimer) {
+    snapshotTimer.Cancel();
+  }
+  {
+    std::lock_guard<std::mutex> lock(notificationOptionsMutex);
+    for (auto &entry : notificationBatching) {
+      entry.second->flushTimer.Cancel();
+    }
+  }
+  timerGuard->Close();
+  outbound.Clear();
+}
+
+// Drains the outbound queue from the message loop of the window hosting the
+// Flutter view, which runs on the platform thread. A headless engine has no
+// view, so a message-only window of the plugin, created on the platform
+// thread during registration, is woken instead.
+void QuickBlueWindowsPlugin::AttachToWindow(
+    flutter::PluginRegistrarWindows *registrar) {
+  if (auto view = registrar->GetView()) {
+    windowRegistrar = registrar;
+    windowProcDelegate = registrar->RegisterTopLevelWindowProcDelegate(
+        [this](HWND, UINT message, WPARAM, LPARAM) -> std::optional<LRESULT> {
+          if (message != wakeMessage) {
+            return std::nullopt;
+          }
+          outbound.Drain(kOutboundDrainBatch);
+          return 0;
+        });
+    dispatchWindow = GetAncestor(view->GetNativeWindow(), GA_ROOT);
+  } else {
+    messageWindow = CreateMessageWindow();
+    if (!messageWindow) {
+      OutputDebugString((L"CreateMessageWindow failed, error: " +
+                         winrt::to_hstring((uint32_t)GetLastError()) + L"\n")
+                            .c_str());
+      return;
+    }
+    dispatchWindow = messageWindow;
+  }
+  // Whatever was queued before there was a window to wake
+  outbound.Drain(kOutboundDrainBatch);
+}
+
+HWND QuickBlueWindowsPlugin::CreateMessageWindow() {
+  const wchar_t *className = L"QuickBlueOutboundWindow";
+  auto instance = reinterpret_cast<HINSTANCE>(&__ImageBase);
+  WNDCLASSEX windowClass{};
+  windowClass.cbSize = sizeof(windowClass);
+  windowClass.lpfnWndProc = MessageWindowProc;
+  windowClass.hInstance = instance;
+  windowClass.lpszClassName = className;
+  if (!RegisterClassEx(&windowClass) &&
+      GetLastError() != ERROR_CLASS_ALREADY_EXISTS) {
+    return nullptr;
+  }
+  auto window = CreateWindowEx(0, className, L"", 0, 0, 0, 0, 0, HWND_MESSAGE,
+                               nullptr, instance, nullptr);
+  if (window) {
+    SetWindowLongPtr(window, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(this));
+  }
+  return window;
+}
+
+LRESULT CALLBACK QuickBlueWindowsPlugin::MessageWindowProc(HWND window,
+                                                           UINT message,
+                                                           WPARAM wparam,
+                                                           LPARAM lparam) {
+  auto plugin = reinterpret_cast<QuickBlueWindowsPlugin *>(
+      GetWindowLongPtr(window, GWLP_USERDATA));
+  if (plugin && message == plugin->wakeMessage) {
+    plugin->outbound.Drain(kOutboundDrainBatch);
+    return 0;
+  }
+  return DefWindowProc(window, message, wparam, lparam);
+}
+
+// Only the platform thread may talk to the engine, so the queue is never
+// drained elsewhere. Messages posted before AttachToWindow stay queued until
+// it runs; method calls are refused if it found no window at all.
+void QuickBlueWindowsPlugin::WakePlatformThread() {
+  auto window = dispatchWindow.load();
+  if (!window || !PostMessage(window, wakeMessage, 0, 0)) {
+    outbound.WakeMissed();
+  }
+}
+
+// Sends |message| on the connector channel from the platform thread. A
+// droppable message is subject to the overflow policy of the outbound queue.
+void QuickBlueWindowsPlugin::SendConnectorMessage(EncodableValue message,
+                                                  bool droppable) {
+  outbound.Post(
+      [this, message = std::move(message)] {
+        message_connector_->Send(message);
+      },
+      droppable);
+}
+
+// Sends |event| on the scan result stream from the platform thread, if Dart
+// still listens by then.
+void QuickBlueWindowsPlugin::SendScanEvent(EncodableValue event) {
+  outbound.Post(
+      [this, event = std::move(event)] {
+        if (scan_result_sink_) {
+          scan_result_sink_->Success(event);
+        }
+      },
+      true);
+}
+
+// Answers |result| from the platform thread, in order with the messages
+// queued before.
+void QuickBlueWindowsPlugin::PostSuccess(
+    std::unique_ptr<flutter::MethodResult<EncodableValue>> result,
+    EncodableValue value) {
+  if (!result) {
+    return;
+  }
+  std::shared_ptr<flutter::MethodResult<EncodableValue>> shared =
+      std::move(result);
+  outbound.Post(
+      [shared, value = std::move(value)] { shared->Success(value); }, false);
+}
+
+void QuickBlueWindowsPlugin::PostError(
+    std::unique_ptr<flutter::MethodResult<EncodableValue>> result,
+    const std::string &code, const std::string &message,
+    EncodableValue details) {
+  if (!result) {
+    return;
+  }
+  std::shared_ptr<flutter::MethodResult<EncodableValue>> shared =
+      std::move(result);
+  outbound.Post(
+      [shared, code, message, details = std::move(details)] {
+        shared->Error(code, message, details);
+      },
+      false);
+}
 
 winrt::fire_and_forget QuickBlueWindowsPlugin::InitializeAsync() {
   auto bluetoothAdapter = co_await BluetoothAdapter::GetDefaultAsync();
@@ -381,24 +1633,156 @@ void QuickBlueWindowsPlugin::HandleMethodCall(
   auto method_name = method_call.method_name();
   OutputDebugString(
       (L"HandleMethodCall " + winrt::to_hstring(method_name) + L"\n").c_str());
+  if (!dispatchWindow.load()) {
+    // Answers are sent from the queue, which nothing would ever drain; this
+    // call runs on the platform thread, so it can be refused directly.
+    result->Error("Unavailable", "No window to deliver results on");
+    return;
+  }
   if (method_name.compare("isBluetoothAvailable") == 0) {
     result->Success(EncodableValue(bluetoothRadio &&
                                    bluetoothRadio.State() == RadioState::On));
   } else if (method_name.compare("startScan") == 0) {
-    if (!bluetoothLEWatcher) {
-      bluetoothLEWatcher = BluetoothLEAdvertisementWatcher();
-      bluetoothLEWatcherReceivedToken = bluetoothLEWatcher.Received(
-          {this, &QuickBlueWindowsPlugin::BluetoothLEWatcher_Received});
+    auto arguments = method_call.arguments();
+    auto args = arguments && std::holds_alternative<EncodableMap>(*arguments)
+                    ? std::get<EncodableMap>(*arguments)
+                    : EncodableMap{};
+    std::string invalidUuid;
+    auto filter = parseScanFilter(args, invalidUuid);
+    if (!filter) {
+      result->Error("IllegalArgument", "Invalid serviceId:" + invalidUuid);
+      return;
+    }
+
+    if (advertisementSource) {
+      advertisementSource->Stop();
+    } else {
+      advertisementSource = std::make_unique<WatcherAdvertisementSource>();
     }
-    bluetoothLEWatcher.Start();
+    // Tasks of the previous scan still running see their filter retired and
+    // drop their results.
+    PublishScanFilter(nullptr);
+    scanExecutor.Clear();
+    auto scanFilterSnapshot =
+        std::make_shared<const ScanFilter>(std::move(*filter));
+    advertisementSource->SetFilter(*scanFilterSnapshot);
+    auto suppressionOptions = parseSuppressionOptions(args);
+    if (suppressionOptions) {
+      scanSuppressor.Configure(*suppressionOptions);
+    }
+    suppressRepeats = suppressionOptions.has_value();
+    StopScanResultBatching();
+    StartScanResultBatching(args);
+    StopSnapshots();
+    StartSnapshots(args);
+    PublishScanFilter(scanFilterSnapshot);
+    advertisementSource->Start(
+        [this, scanFilterSnapshot](const Advertisement &advertisement) {
+          scanExecutor.Post(advertisement.address,
+                            [this, advertisement, scanFilterSnapshot] {
+                              OnAdvertisement(advertisement,
+                                              scanFilterSnapshot);
+                            });
+        });
     result->Success(nullptr);
   } else if (method_name.compare("stopScan") == 0) {
-    if (bluetoothLEWatcher) {
-      bluetoothLEWatcher.Stop();
-      bluetoothLEWatcher.Received(bluetoothLEWatcherReceivedToken);
+    if (advertisementSource) {
+      advertisementSource->Stop();
     }
-    bluetoothLEWatcher = nullptr;
+    advertisementSource = nullptr;
+    PublishScanFilter(nullptr);
+    scanExecutor.Clear();
+    StopScanResultBatching();
+    StopSnapshots();
     result->Success(nullptr);
+  } else if (method_name.compare("getStatistics") == 0) {
+    auto devices = connectedDevices.Snapshot();
+    EncodableMap gattCache;
+    for (auto &device : *devices) {
+      auto &agent = *device.second.agent;
+      gattCache[EncodableValue(std::to_string(device.first))] = EncodableMap{
+          {"gattRequests", (int64_t)agent.gattRequests.load()},
+          {"gattRequestsAvoided", (int64_t)agent.gattRequestsAvoided.load()},
+          {"systemCacheHits", (int64_t)agent.systemCache.Hits()},
+          {"systemCacheMisses", (int64_t)agent.systemCache.Misses()},
+          {"servicesInvalidated", (int64_t)agent.servicesInvalidated.load()},
+      };
+    }
+    EncodableMap writePipelines;
+    for (auto &device : *devices) {
+      auto &agent = *device.second.agent;
+      WritePipeline::Counters total;
+      for (auto &pipeline : agent.WritePipelines()) {
+        auto counters = pipeline->GetCounters();
+        total.queued += counters.queued;
+        total.rejected += counters.rejected;
+        total.completed += counters.completed;
+        total.failed += counters.failed;
+        total.maxDepth = std::max(total.maxDepth, counters.maxDepth);
+      }
+      writePipelines[EncodableValue(std::to_string(device.first))] =
+          EncodableMap{
+              {"writesQueued", (int64_t)total.queued},
+              {"writesRejected", (int64_t)total.rejected},
+              {"writesCompleted", (int64_t)total.completed},
+              {"writesFailed", (int64_t)total.failed},
+              {"writeQueueMaxDepth", (int64_t)total.maxDepth},
+          };
+    }
+    EncodableMap gattSchedulers;
+    for (auto &device : *devices) {
+      auto &agent = *device.second.agent;
+      auto &scheduler = *agent.scheduler;
+      auto counters = scheduler.GetCounters();
+      gattSchedulers[EncodableValue(std::to_string(device.first))] =
+          EncodableMap{
+              {"concurrency", (int64_t)scheduler.Concurrency()},
+              {"running", (int64_t)counters.running},
+              {"queued", (int64_t)counters.queued},
+              {"maxQueueDepth", (int64_t)counters.maxQueueDepth},
+              {"granted", (int64_t)counters.granted},
+              {"expired", (int64_t)counters.expired},
+              {"cancelled", (int64_t)counters.cancelled},
+              {"queueWait", to_histogrammap(scheduler.QueueWait())},
+              {"serviceTime", to_histogrammap(scheduler.ServiceTime())},
+          };
+    }
+    auto outboundCounters = outbound.GetCounters();
+    result->Success(EncodableMap{
+        {"nameLookupsIssued", (int64_t)scanDevices.LookupsIssued()},
+        {"nameLookupsAvoided", (int64_t)scanDevices.LookupsAvoided()},
+        {"nameLookupsRefused", (int64_t)scanDevices.LookupsRefused()},
+        {"advertisementsForwarded", (int64_t)scanSuppressor.Forwarded()},
+        {"advertisementsSuppressed", (int64_t)scanSuppressor.Suppressed()},
+        {"scanQueueDepth", (int64_t)scanExecutor.QueueDepth()},
+        {"scanQueueMaxDepth", (int64_t)scanExecutor.MaxQueueDepth()},
+        {"scanQueueDropped", (int64_t)scanExecutor.Dropped()},
+        {"notificationsReceived", (int64_t)notificationsReceived.load()},
+        {"notificationBytesReceived",
+         (int64_t)notificationBytesReceived.load()},
+        {"notificationsOversized", (int64_t)notificationsOversized.load()},
+        {"notificationBufferAllocations",
+         (int64_t)notificationBuffers.Allocations()},
+        {"notificationBufferReuses", (int64_t)notificationBuffers.Reuses()},
+        {"gattCache", gattCache},
+        {"pendingOperations", (int64_t)pendingOperations.Size()},
+        {"writePipelines", writePipelines},
+        {"gattSchedulers", gattSchedulers},
+        {"gattLayoutHits", (int64_t)gattLayouts.Hits()},
+        {"gattLayoutMisses", (int64_t)gattLayouts.Misses()},
+        {"firstNotificationLatencyColdUs",
+         (int64_t)firstNotificationLatencyColdUs.load()},
+        {"firstNotificationLatencyWarmUs",
+         (int64_t)firstNotificationLatencyWarmUs.load()},
+        {"outboundPosted", (int64_t)outboundCounters.posted},
+        {"outboundDropped", (int64_t)outboundCounters.dropped},
+        {"outboundOverflowed", (int64_t)outboundCounters.overflowed},
+        {"outboundSent", (int64_t)outboundCounters.sent},
+        {"outboundBatches", (int64_t)outboundCounters.batches},
+        {"outboundMaxBatch", (int64_t)outboundCounters.maxBatch},
+        {"outboundQueueDepth", (int64_t)outbound.QueueDepth()},
+        {"outboundWakesMissed", (int64_t)outboundCounters.wakesMissed},
+    });
   } else if (method_name.compare("connect") == 0) {
     auto args = std::get<EncodableMap>(*method_call.arguments());
     auto deviceId = std::get<std::string>(args[EncodableValue("deviceId")]);
@@ -413,103 +1797,519 @@ void QuickBlueWindowsPlugin::HandleMethodCall(
   } else if (method_name.compare("discoverServices") == 0) {
     auto args = std::get<EncodableMap>(*method_call.arguments());
     auto deviceId = std::get<std::string>(args[EncodableValue("deviceId")]);
-    auto it = connectedDevices.find(std::stoull(deviceId));
-    if (it == connectedDevices.end()) {
+    auto deviceAgent = connectedDevices.Find(std::stoull(deviceId));
+    if (!deviceAgent) {
       result->Error("IllegalArgument", "Unknown devicesId:" + deviceId);
       return;
     }
-    DiscoverServicesAsync(*it->second);
+    std::optional<GattCacheMode> cacheMode;
+    if (!parseCacheMode(args, cacheMode)) {
+      result->Error("IllegalArgument", "Invalid cacheMode");
+      return;
+    }
+    DiscoverServicesAsync(deviceAgent, cacheMode);
     result->Success(nullptr);
   } else if (method_name.compare("setNotifiable") == 0) {
     auto args = std::get<EncodableMap>(*method_call.arguments());
-    auto deviceId = std::get<std::string>(args[EncodableValue("deviceId")]);
-    auto service = std::get<std::string>(args[EncodableValue("service")]);
-    auto characteristic =
-        std::get<std::string>(args[EncodableValue("characteristic")]);
     auto bleInputProperty =
         std::get<std::string>(args[EncodableValue("bleInputProperty")]);
-    auto it = connectedDevices.find(std::stoull(deviceId));
-    if (it == connectedDevices.end()) {
-      result->Error("IllegalArgument", "Unknown devicesId:" + deviceId);
+    auto deviceAgent = FindDevice(args);
+    if (!deviceAgent) {
+      result->Error("IllegalArgument", "Unknown device");
+      return;
+    }
+    auto characteristic = parseCharacteristicRef(args);
+    if (!characteristic) {
+      result->Error("IllegalArgument", "Invalid characteristic");
       return;
     }
 
-    SetNotifiableAsync(*it->second, service, characteristic, bleInputProperty);
+    SetNotifiableAsync(deviceAgent, *characteristic, bleInputProperty);
     result->Success(nullptr);
   } else if (method_name.compare("requestMtu") == 0) {
     auto args = std::get<EncodableMap>(*method_call.arguments());
     auto deviceId = std::get<std::string>(args[EncodableValue("deviceId")]);
     auto expectedMtu = std::get<int32_t>(args[EncodableValue("expectedMtu")]);
-    auto it = connectedDevices.find(std::stoull(deviceId));
-    if (it == connectedDevices.end()) {
+    auto deviceAgent = connectedDevices.Find(std::stoull(deviceId));
+    if (!deviceAgent) {
       result->Error("IllegalArgument", "Unknown devicesId:" + deviceId);
       return;
     }
 
-    RequestMtuAsync(*it->second, expectedMtu);
+    auto requestId = AddPendingOperation(*deviceAgent, std::move(result));
+    RequestMtuAsync(deviceAgent, expectedMtu, requestId, parseDeadline(args));
+  } else if (method_name.compare("setNotificationBatching") == 0) {
+    auto args = std::get<EncodableMap>(*method_call.arguments());
+    auto deviceId = std::get<std::string>(args[EncodableValue("deviceId")]);
+    auto intervalMs = args[EncodableValue("intervalMs")].LongValue();
+    auto maxEntries = findArg(args, "maxEntries");
+    SetNotificationBatching(std::stoull(deviceId), intervalMs,
+                            maxEntries ? (size_t)maxEntries->LongValue()
+                                       : kDefaultNotificationBatchSize);
     result->Success(nullptr);
-  } else if (method_name.compare("readValue") == 0) {
+  } else if (method_name.compare("setNotificationWireFormat") == 0) {
     auto args = std::get<EncodableMap>(*method_call.arguments());
     auto deviceId = std::get<std::string>(args[EncodableValue("deviceId")]);
-    auto service = std::get<std::string>(args[EncodableValue("service")]);
-    auto characteristic =
-        std::get<std::string>(args[EncodableValue("characteristic")]);
-    auto it = connectedDevices.find(std::stoull(deviceId));
-    if (it == connectedDevices.end()) {
-      result->Error("IllegalArgument", "Unknown devicesId:" + deviceId);
+    auto format = std::get<std::string>(args[EncodableValue("format")]);
+    std::lock_guard<std::mutex> lock(notificationOptionsMutex);
+    if (format == "binary") {
+      binaryNotificationDevices.insert(std::stoull(deviceId));
+    } else {
+      binaryNotificationDevices.erase(std::stoull(deviceId));
+    }
+    result->Success(nullptr);
+  } else if (method_name.compare("setGattCache") == 0) {
+    auto args = std::get<EncodableMap>(*method_call.arguments());
+    auto enabled = std::get<bool>(args[EncodableValue("enabled")]);
+    auto directory = findArg(args, "directory");
+    if (!enabled) {
+      gattLayouts.SetDirectory({});
+    } else if (directory) {
+      gattLayouts.SetDirectory(
+          std::filesystem::u8path(std::get<std::string>(*directory)));
+    } else {
+      gattLayouts.SetDirectory(defaultGattCacheDirectory());
+    }
+    result->Success(nullptr);
+  } else if (method_name.compare("setGattCachePolicy") == 0) {
+    auto args = std::get<EncodableMap>(*method_call.arguments());
+    std::optional<GattCacheMode> defaultMode;
+    if (auto mode = findArg(args, "defaultMode")) {
+      defaultMode = ParseGattCacheMode(std::get<std::string>(*mode));
+      if (!defaultMode) {
+        result->Error("IllegalArgument", "Invalid defaultMode");
+        return;
+      }
+    }
+    std::vector<std::pair<BleUuid, std::optional<GattCacheMode>>> modes;
+    if (auto characteristics = findArg(args, "characteristics")) {
+      for (auto &entry : std::get<EncodableMap>(*characteristics)) {
+        auto uuid = BleUuid::Parse(std::get<std::string>(entry.first));
+        if (!uuid) {
+          result->Error("IllegalArgument", "Invalid characteristic");
+          return;
+        }
+        std::optional<GattCacheMode> mode;
+        if (!entry.second.IsNull()) {
+          mode = ParseGattCacheMode(std::get<std::string>(entry.second));
+          if (!mode) {
+            result->Error("IllegalArgument", "Invalid cacheMode");
+            return;
+          }
+        }
+        modes.emplace_back(*uuid, mode);
+      }
+    }
+    if (defaultMode) {
+      readCachePolicy.SetDefault(*defaultMode);
+    }
+    for (auto &[uuid, mode] : modes) {
+      if (mode) {
+        readCachePolicy.Set(uuid, *mode);
+      } else {
+        readCachePolicy.Reset(uuid);
+      }
+    }
+    result->Success(nullptr);
+  } else if (method_name.compare("writeReliable") == 0) {
+    const auto &args = std::get<EncodableMap>(*method_call.arguments());
+    auto deviceAgent = FindDevice(args);
+    if (!deviceAgent) {
+      result->Error("IllegalArgument", "Unknown device");
       return;
     }
-
-    ReadValueAsync(*it->second, service, characteristic);
+    auto writeArgs = findArg(args, "writes");
+    if (!writeArgs) {
+      result->Error("IllegalArgument", "Missing writes");
+      return;
+    }
+    std::vector<std::pair<CharacteristicRef, std::vector<uint8_t>>> writes;
+    for (const auto &writeArg : std::get<EncodableList>(*writeArgs)) {
+      const auto &write = std::get<EncodableMap>(writeArg);
+      auto characteristic = parseCharacteristicRef(write);
+      auto value = findArg(write, "value");
+      if (!characteristic || !value) {
+        result->Error("IllegalArgument", "Invalid write");
+        return;
+      }
+      writes.emplace_back(*characteristic,
+                          std::get<std::vector<uint8_t>>(*value));
+    }
+    WriteReliableAsync(deviceAgent, std::move(writes), parseDeadline(args),
+                       std::move(result));
+  } else if (method_name.compare("writeStream") == 0) {
+    const auto &args = std::get<EncodableMap>(*method_call.arguments());
+    auto deviceAgent = FindDevice(args);
+    if (!deviceAgent) {
+      result->Error("IllegalArgument", "Unknown device");
+      return;
+    }
+    auto characteristic = parseCharacteristicRef(args);
+    if (!characteristic) {
+      result->Error("IllegalArgument", "Invalid characteristic");
+      return;
+    }
+    auto value = findArg(args, "value");
+    auto bleOutputProperty = findArg(args, "bleOutputProperty");
+    if (!value || !bleOutputProperty) {
+      result->Error("IllegalArgument", "Missing value or bleOutputProperty");
+      return;
+    }
+    StreamWrite stream;
+    stream.value = std::get<std::vector<uint8_t>>(*value);
+    stream.withResponse =
+        std::get<std::string>(*bleOutputProperty) != "withoutResponse";
+    if (auto window = findArg(args, "window")) {
+      stream.window = (size_t)window->LongValue();
+    }
+    if (auto maxChunkSize = findArg(args, "maxChunkSize")) {
+      stream.maxChunkSize = (size_t)maxChunkSize->LongValue();
+    }
+    if (auto transferId = findArg(args, "transferId")) {
+      stream.transferId = transferId->LongValue();
+    }
+    if (auto progressIntervalMs = findArg(args, "progressIntervalMs")) {
+      stream.progressInterval =
+          std::chrono::milliseconds(progressIntervalMs->LongValue());
+    }
+    stream.deadline = parseDeadline(args);
+    if (stream.window < 1) {
+      result->Error("IllegalArgument", "Window must be positive");
+      return;
+    }
+    WriteStreamAsync(deviceAgent, *characteristic, std::move(stream),
+                     std::move(result));
+  } else if (method_name.compare("setWritePipeline") == 0) {
+    auto args = std::get<EncodableMap>(*method_call.arguments());
+    auto deviceAgent = FindDevice(args);
+    if (!deviceAgent) {
+      result->Error("IllegalArgument", "Unknown device");
+      return;
+    }
+    auto options = deviceAgent->WritePipelineOptions();
+    if (auto queueCapacity = findArg(args, "queueCapacity")) {
+      options.capacity = (size_t)queueCapacity->LongValue();
+    }
+    if (auto window = findArg(args, "window")) {
+      options.window = (size_t)window->LongValue();
+    }
+    if (options.capacity < 1 || options.window < 1) {
+      result->Error("IllegalArgument", "Capacity and window must be positive");
+      return;
+    }
+    deviceAgent->SetWritePipelineOptions(options);
     result->Success(nullptr);
+  } else if (method_name.compare("setGattScheduler") == 0) {
+    auto args = std::get<EncodableMap>(*method_call.arguments());
+    auto deviceAgent = FindDevice(args);
+    if (!deviceAgent) {
+      result->Error("IllegalArgument", "Unknown device");
+      return;
+    }
+    if (auto concurrency = findArg(args, "concurrency")) {
+      if (concurrency->LongValue() < 1) {
+        result->Error("IllegalArgument", "Concurrency must be positive");
+        return;
+      }
+      deviceAgent->scheduler->SetConcurrency(
+          (size_t)concurrency->LongValue());
+    }
+    result->Success(nullptr);
+  } else if (method_name.compare("setTimeouts") == 0) {
+    auto args = std::get<EncodableMap>(*method_call.arguments());
+    auto timeouts = findArg(args, "timeouts");
+    if (!timeouts) {
+      result->Error("IllegalArgument", "Missing timeouts");
+      return;
+    }
+    std::vector<std::pair<GattOperation, std::chrono::milliseconds>> updates;
+    for (const auto &timeout : std::get<EncodableMap>(*timeouts)) {
+      auto operation = ParseGattOperation(std::get<std::string>(timeout.first));
+      if (!operation || timeout.second.LongValue() < 0) {
+        result->Error("IllegalArgument",
+                      "Invalid timeout of " +
+                          std::get<std::string>(timeout.first));
+        return;
+      }
+      updates.emplace_back(
+          *operation, std::chrono::milliseconds(timeout.second.LongValue()));
+    }
+    for (const auto &update : updates) {
+      operationTimeouts.Set(update.first, update.second);
+    }
+    result->Success(nullptr);
+  } else if (method_name.compare("setOutboundQueue") == 0) {
+    auto args = std::get<EncodableMap>(*method_call.arguments());
+    if (auto policy = findArg(args, "overflowPolicy")) {
+      auto overflowPolicy = ParseOverflowPolicy(std::get<std::string>(*policy));
+      if (!overflowPolicy) {
+        result->Error("IllegalArgument", "Invalid overflowPolicy");
+        return;
+      }
+      outbound.SetOverflowPolicy(*overflowPolicy);
+    }
+    result->Success(nullptr);
+  } else if (method_name.compare("readValue") == 0) {
+    auto args = std::get<EncodableMap>(*method_call.arguments());
+    auto deviceAgent = FindDevice(args);
+    if (!deviceAgent) {
+      result->Error("IllegalArgument", "Unknown device");
+      return;
+    }
+    auto characteristic = parseCharacteristicRef(args);
+    if (!characteristic) {
+      result->Error("IllegalArgument", "Invalid characteristic");
+      return;
+    }
+    std::optional<GattCacheMode> cacheMode;
+    if (!parseCacheMode(args, cacheMode)) {
+      result->Error("IllegalArgument", "Invalid cacheMode");
+      return;
+    }
+
+    auto requestId = AddPendingOperation(*deviceAgent, std::move(result));
+    ReadValueAsync(deviceAgent, *characteristic, cacheMode, requestId,
+                   parseDeadline(args));
   } else if (method_name.compare("writeValue") == 0) {
     auto args = std::get<EncodableMap>(*method_call.arguments());
-    auto deviceId = std::get<std::string>(args[EncodableValue("deviceId")]);
-    auto service = std::get<std::string>(args[EncodableValue("service")]);
-    auto characteristic =
-        std::get<std::string>(args[EncodableValue("characteristic")]);
     auto value = std::get<std::vector<uint8_t>>(args[EncodableValue("value")]);
     auto bleOutputProperty =
         std::get<std::string>(args[EncodableValue("bleOutputProperty")]);
-    auto it = connectedDevices.find(std::stoull(deviceId));
-    if (it == connectedDevices.end()) {
-      result->Error("IllegalArgument", "Unknown devicesId:" + deviceId);
+    auto deviceAgent = FindDevice(args);
+    if (!deviceAgent) {
+      result->Error("IllegalArgument", "Unknown device");
+      return;
+    }
+    auto characteristic = parseCharacteristicRef(args);
+    if (!characteristic) {
+      result->Error("IllegalArgument", "Invalid characteristic");
       return;
     }
 
-    WriteValueAsync(*it->second, service, characteristic, value,
-                    bleOutputProperty);
-    result->Success(nullptr);
+    WritePipeline::Write write{
+        std::move(value), bleOutputProperty != "withoutResponse",
+        AddPendingOperation(*deviceAgent, std::move(result))};
+    write.deadline = parseDeadline(args);
+    // Registered characteristics are queued right away, so writes keep the
+    // order of the calls. Others are resolved first.
+    auto handle = deviceAgent->FindHandle(*characteristic);
+    if (handle != kInvalidHandle) {
+      QueueWrite(deviceAgent, handle, std::move(write));
+    } else {
+      WriteValueAsync(deviceAgent, *characteristic, std::move(write));
+    }
   } else {
     result->NotImplemented();
   }
 }
 
-void QuickBlueWindowsPlugin::BluetoothLEWatcher_Received(
-    BluetoothLEAdvertisementWatcher sender,
-    BluetoothLEAdvertisementReceivedEventArgs args) {
-  SendScanResultAsync(args);
-}
-
-winrt::fire_and_forget QuickBlueWindowsPlugin::SendScanResultAsync(
-    BluetoothLEAdvertisementReceivedEventArgs args) {
-  auto device = co_await BluetoothLEDevice::FromBluetoothAddressAsync(
-      args.BluetoothAddress());
-  auto name = device ? device.Name() : args.Advertisement().LocalName();
-  OutputDebugString((L"Received BluetoothAddress:" +
-                     winrt::to_hstring(args.BluetoothAddress()) + L", Name:" +
-                     name + L", LocalName:" + args.Advertisement().LocalName() +
-                     L"\n")
-                        .c_str());
-  if (scan_result_sink_) {
-    scan_result_sink_->Success(EncodableMap{
-        {"name", winrt::to_string(name)},
-        {"deviceId", std::to_string(args.BluetoothAddress())},
-        {"manufacturerDataHead",
-         parseManufacturerDataHead(args.Advertisement())},
-        {"rssi", args.RawSignalStrengthInDBm()},
+std::shared_ptr<BluetoothDeviceAgent>
+QuickBlueWindowsPlugin::FindDevice(const EncodableMap &args) {
+  uint64_t bluetoothAddress;
+  if (auto handle = findArg(args, "deviceHandle")) {
+    auto address = deviceHandles.Address((uint64_t)handle->LongValue());
+    if (!address) {
+      return nullptr;
+    }
+    bluetoothAddress = *address;
+  } else if (auto deviceId = findArg(args, "deviceId")) {
+    bluetoothAddress = std::stoull(std::get<std::string>(*deviceId));
+  } else {
+    return nullptr;
+  }
+  return connectedDevices.Find(bluetoothAddress);
+}
+
+void QuickBlueWindowsPlugin::OnAdvertisement(
+    const Advertisement &advertisement,
+    const std::shared_ptr<const ScanFilter> &filter) {
+  if (CurrentScanFilter() != filter ||
+      !filter->MatchesAdvertisement(advertisement)) {
+    return;
+  }
+  auto now = ScanDeviceTable::Clock::now();
+  // Scan responses carry a different payload than the advertisement they
+  // answer, so both are tracked separately. Addresses only use 48 bits.
+  auto suppressionKey =
+      advertisement.address | (uint64_t)advertisement.scanResponse << 63;
+  if (suppressRepeats &&
+      !scanSuppressor.ShouldForward(suppressionKey,
+                                    advertisement.data.PayloadHash(),
+                                    advertisement.rssi, now)) {
+    return;
+  }
+  // kFull and kPending without a stale result fall back to the advertised
+  // name.
+  auto lookup = scanDevices.LookupName(advertisement.address, now);
+  if (lookup.status == ScanDeviceTable::NameStatus::kResolve) {
+    lookup.name = ResolveName(advertisement.address);
+    scanDevices.StoreName(advertisement.address, lookup.name,
+                          ScanDeviceTable::Clock::now());
+  }
+  auto name =
+      lookup.name.value_or(std::string(advertisement.data.LocalName()));
+  // Resolving may take a while; the scan may have been stopped meanwhile.
+  if (filter->MatchesName(name) && CurrentScanFilter() == filter) {
+    SendScanResult(advertisement, name);
+  }
+}
+
+// Blocks the calling scan worker, which bounds the number of devices opened
+// at once by the executor's concurrency.
+std::optional<std::string>
+QuickBlueWindowsPlugin::ResolveName(uint64_t bluetoothAddress) {
+  try {
+    auto device =
+        BluetoothLEDevice::FromBluetoothAddressAsync(bluetoothAddress).get();
+    if (device) {
+      return winrt::to_string(device.Name());
+    }
+  } catch (const winrt::hresult_error &ex) {
+    OutputDebugString((L"ResolveName exception: " + ex.message() +
+                       L", code: " + winrt::to_hstring(ex.code()) + L"\n")
+                          .c_str());
+  }
+  return std::nullopt;
+}
+
+void QuickBlueWindowsPlugin::SendScanResult(const Advertisement &advertisement,
+                                            const std::string &name) {
+  if (snapshotMode) {
+    nearestDevices.Update(advertisement.address, advertisement.rssi, name,
+                          NearestDevices::Clock::now());
+    return;
+  }
+
+  auto &data = advertisement.data;
+  EncodableMap manufacturerData;
+  for (size_t i = 0; i < data.ManufacturerDataCount(); ++i) {
+    auto section = data.ManufacturerSection(i);
+    manufacturerData.insert_or_assign(
+        EncodableValue((int32_t)data.ManufacturerDataAt(i).companyId),
+        std::vector<uint8_t>(section.data + 2, section.data + section.size));
+  }
+  EncodableList serviceUuids;
+  for (size_t i = 0; i < data.ServiceUuidCount(); ++i) {
+    serviceUuids.push_back(data.ServiceUuidAt(i).ToString());
+  }
+  EncodableMap serviceData;
+  for (size_t i = 0; i < data.ServiceDataCount(); ++i) {
+    serviceData.insert_or_assign(
+        EncodableValue(data.ServiceDataAt(i).uuid.ToString()),
+        to_bytevc(data.ServiceDataBytes(i)));
+  }
+
+  EncodableMap scanResult{
+      {"name", name},
+      {"deviceId", std::to_string(advertisement.address)},
+      {"manufacturerDataHead",
+       data.ManufacturerDataCount() > 0
+           ? to_bytevc(data.ManufacturerSection(0))
+           : std::vector<uint8_t>()},
+      {"manufacturerSpecificData", manufacturerData},
+      {"serviceUuids", serviceUuids},
+      {"serviceData", serviceData},
+      {"rssi", advertisement.rssi},
+  };
+  if (data.HasTxPower()) {
+    scanResult[EncodableValue("txPowerLevel")] = (int32_t)data.TxPower();
+  }
+  if (data.HasFlags()) {
+    scanResult[EncodableValue("advertisementFlags")] = (int32_t)data.Flags();
+  }
+  if (batchScanResults) {
+    auto batch = scanResultBatcher.Add(std::move(scanResult));
+    if (!batch.empty()) {
+      FlushScanResults(std::move(batch));
+    }
+  } else {
+    SendScanEvent(std::move(scanResult));
+  }
+}
+
+void QuickBlueWindowsPlugin::StartScanResultBatching(const EncodableMap &args) {
+  auto batchIntervalMs = findArg(args, "batchIntervalMs");
+  auto batchSize = findArg(args, "batchSize");
+  if (!batchIntervalMs && !batchSize) {
+    return;
+  }
+
+  auto intervalMs = batchIntervalMs ? batchIntervalMs->LongValue()
+                                    : kDefaultScanBatchIntervalMs;
+  scanResultBatcher.SetMaxItems(
+      batchSize ? (size_t)std::max<int64_t>(batchSize->LongValue(), 1)
+                : kDefaultScanBatchSize);
+  scanResultFlushTimer = ThreadPoolTimer::CreatePeriodicTimer(
+      [this, guard = timerGuard](ThreadPoolTimer const &) {
+        if (auto scope = guard->Enter()) {
+          FlushScanResults(scanResultBatcher.Drain());
+        }
+      },
+      std::chrono::milliseconds(std::max<int64_t>(intervalMs, 1)));
+  batchScanResults = true;
+}
+
+void QuickBlueWindowsPlugin::StopScanResultBatching() {
+  if (scanResultFlushTimer) {
+    scanResultFlushTimer.Cancel();
+    scanResultFlushTimer = nullptr;
+  }
+  batchScanResults = false;
+  FlushScanResults(scanResultBatcher.Drain());
+}
+
+void QuickBlueWindowsPlugin::StartSnapshots(const EncodableMap &args) {
+  auto snapshotTopK = findArg(args, "snapshotTopK");
+  if (!snapshotTopK) {
+    return;
+  }
+
+  NearestDevices::Options options;
+  options.topK = (size_t)std::max<int64_t>(snapshotTopK->LongValue(), 1);
+  if (auto smoothing = findArg(args, "rssiSmoothing")) {
+    options.smoothing = std::get<double>(*smoothing);
+  }
+  nearestDevices.Configure(options);
+
+  auto snapshotIntervalMs = findArg(args, "snapshotIntervalMs");
+  auto intervalMs = snapshotIntervalMs ? snapshotIntervalMs->LongValue()
+                                       : kDefaultSnapshotIntervalMs;
+  snapshotTimer = ThreadPoolTimer::CreatePeriodicTimer(
+      [this, guard = timerGuard](ThreadPoolTimer const &) {
+        if (auto scope = guard->Enter()) {
+          SendSnapshot();
+        }
+      },
+      std::chrono::milliseconds(std::max<int64_t>(intervalMs, 1)));
+  snapshotMode = true;
+}
+
+void QuickBlueWindowsPlugin::StopSnapshots() {
+  if (snapshotTimer) {
+    snapshotTimer.Cancel();
+    snapshotTimer = nullptr;
+  }
+  snapshotMode = false;
+}
+
+void QuickBlueWindowsPlugin::SendSnapshot() {
+  EncodableList devices;
+  for (auto &device : nearestDevices.Snapshot(NearestDevices::Clock::now())) {
+    devices.push_back(EncodableMap{
+        {"deviceId", std::to_string(device.address)},
+        {"name", device.name},
+        {"rssi", (int32_t)std::lround(device.rssi)},
     });
   }
+  SendScanEvent(EncodableMap{{"snapshot", devices}});
+}
+
+void QuickBlueWindowsPlugin::FlushScanResults(
+    std::vector<EncodableValue> batch) {
+  if (batch.empty()) {
+    return;
+  }
+  SendScanEvent(EncodableList(std::move(batch)));
 }
 
 std::unique_ptr<flutter::StreamHandlerError<EncodableValue>>
@@ -542,41 +2342,92 @@ QuickBlueWindowsPlugin::OnCancelInternal(const EncodableValue *arguments) {
 
 winrt::fire_and_forget
 QuickBlueWindowsPlugin::ConnectAsync(uint64_t bluetoothAddress) {
+  auto connectStarted = std::chrono::steady_clock::now();
+  auto deadline = operationTimeouts.DeadlineOf(GattOperation::Connect);
   try {
-    auto device =
-        co_await BluetoothLEDevice::FromBluetoothAddressAsync(bluetoothAddress);
+    auto device = co_await within(
+        BluetoothLEDevice::FromBluetoothAddressAsync(bluetoothAddress),
+        deadline, GattOperation::Connect);
 
     // Check if the device is null
 
-    auto servicesResult = co_await device.GetGattServicesAsync();
+    // With a persisted layout the OS cache is known to be current
+    auto layout = gattLayouts.Load(bluetoothAddress);
+    auto warm = layout.has_value();
+    auto servicesOperation =
+        warm ? device.GetGattServicesAsync(BluetoothCacheMode::Cached)
+             : device.GetGattServicesAsync();
+    auto servicesResult =
+        co_await within(servicesOperation, deadline, GattOperation::Connect);
     if (servicesResult.Status() != GattCommunicationStatus::Success) {
       OutputDebugString((L"GetGattServicesAsync error: " +
                          winrt::to_hstring((int32_t)servicesResult.Status()) +
                          L"\n")
                             .c_str());
-      message_connector_->Send(EncodableMap{
+      SendConnectorMessage(EncodableMap{
           {"deviceId", std::to_string(bluetoothAddress)},
           {"ConnectionState", "disconnected"},
       });
       co_return;
     }
+    // Events of this connection carry its generation, so that they are
+    // ignored once the device has connected again
+    auto generation = connectedDevices.NextGeneration();
     auto connnectionStatusChangedToken = device.ConnectionStatusChanged(
-        {this,
-         &QuickBlueWindowsPlugin::BluetoothLEDevice_ConnectionStatusChanged});
-    auto deviceAgent = std::make_unique<BluetoothDeviceAgent>(
+        [this, generation](BluetoothLEDevice sender, IInspectable) {
+          BluetoothLEDevice_ConnectionStatusChanged(sender, generation);
+        });
+    auto deviceAgent = std::make_shared<BluetoothDeviceAgent>(
         device, connnectionStatusChangedToken);
-    auto pair = std::make_pair(bluetoothAddress, std::move(deviceAgent));
-    connectedDevices.insert(std::move(pair));
+    deviceAgent->handle = deviceHandles.Acquire(bluetoothAddress);
+    // Keep the services enumerated to establish the connection, so the first
+    // lookup does not fetch them again.
+    deviceAgent->gattRequests++;
+    for (auto s : servicesResult.Services()) {
+      deviceAgent->AddService(s);
+    }
+    deviceAgent->servicesEnumerated = true;
+    deviceAgent->layoutCache = gattLayouts.Enabled() ? &gattLayouts : nullptr;
+    deviceAgent->cachedLayout = std::move(layout);
+    deviceAgent->gattServicesChangedToken = device.GattServicesChanged(
+        [this, bluetoothAddress, generation](BluetoothLEDevice, IInspectable) {
+          // The persisted layout no longer describes the device
+          gattLayouts.Remove(bluetoothAddress);
+          RefreshGattServicesAsync(bluetoothAddress, generation);
+        });
+    {
+      std::lock_guard<std::mutex> lock(notificationOptionsMutex);
+      pendingFirstNotification[bluetoothAddress] = {connectStarted, warm};
+    }
+    auto deviceHandle = deviceAgent->handle;
+    if (!connectedDevices.Insert(bluetoothAddress, generation, deviceAgent)) {
+      // Another connect call got there first; keep its connection
+      OutputDebugString((L"ConnectAsync: Device already connected: " +
+                         winrt::to_hstring(bluetoothAddress) + L"\n")
+                            .c_str());
+      device.ConnectionStatusChanged(connnectionStatusChangedToken);
+      device.GattServicesChanged(deviceAgent->gattServicesChangedToken);
+      co_return;
+    }
 
-    message_connector_->Send(EncodableMap{
+    SendConnectorMessage(EncodableMap{
         {"deviceId", std::to_string(bluetoothAddress)},
+        {"deviceHandle", (int64_t)deviceHandle},
         {"ConnectionState", "connected"},
     });
+  } catch (const GattTimeout &ex) {
+    OutputDebugString(
+        (L"ConnectAsync: " + winrt::to_hstring(ex.what()) + L"\n").c_str());
+    SendConnectorMessage(EncodableMap{
+        {"deviceId", std::to_string(bluetoothAddress)},
+        {"ConnectionState", "disconnected"},
+        {"error", "Timeout"},
+    });
   } catch (const winrt::hresult_error &ex) {
     OutputDebugString((L"ConnectAsync exception: " + ex.message() +
                        L", code: " + winrt::to_hstring(ex.code()) + L"\n")
                           .c_str());
-    message_connector_->Send(EncodableMap{
+    SendConnectorMessage(EncodableMap{
         {"deviceId", std::to_string(bluetoothAddress)},
         {"ConnectionState", "disconnected"},
     });
@@ -584,13 +2435,13 @@ QuickBlueWindowsPlugin::ConnectAsync(uint64_t bluetoothAddress) {
     OutputDebugString(
         (L"ConnectAsync std exception: " + winrt::to_hstring(ex.what()) + L"\n")
             .c_str());
-    message_connector_->Send(EncodableMap{
+    SendConnectorMessage(EncodableMap{
         {"deviceId", std::to_string(bluetoothAddress)},
         {"ConnectionState", "disconnected"},
     });
   } catch (...) {
     OutputDebugString(L"ConnectAsync unknown exception\n");
-    message_connector_->Send(EncodableMap{
+    SendConnectorMessage(EncodableMap{
         {"deviceId", std::to_string(bluetoothAddress)},
         {"ConnectionState", "disconnected"},
     });
@@ -598,7 +2449,7 @@ QuickBlueWindowsPlugin::ConnectAsync(uint64_t bluetoothAddress) {
 }
 
 void QuickBlueWindowsPlugin::BluetoothLEDevice_ConnectionStatusChanged(
-    BluetoothLEDevice sender, IInspectable args) {
+    BluetoothLEDevice sender, uint64_t generation) {
   try {
     OutputDebugString(
         (L"ConnectionStatusChanged: Device " +
@@ -607,11 +2458,14 @@ void QuickBlueWindowsPlugin::BluetoothLEDevice_ConnectionStatusChanged(
             .c_str());
 
     if (sender.ConnectionStatus() == BluetoothConnectionStatus::Disconnected) {
-      // Clean up all resources related to this device
-      CleanConnection(sender.BluetoothAddress());
+      // Clean up all resources related to this device, unless the event
+      // is a late one of an earlier connection
+      if (!CleanConnection(sender.BluetoothAddress(), generation)) {
+        return;
+      }
 
       // Notify the Dart side
-      message_connector_->Send(EncodableMap{
+      SendConnectorMessage(EncodableMap{
           {"deviceId", std::to_string(sender.BluetoothAddress())},
           {"ConnectionState", "disconnected"},
       });
@@ -624,56 +2478,67 @@ void QuickBlueWindowsPlugin::BluetoothLEDevice_ConnectionStatusChanged(
     OutputDebugString(L"ConnectionStatusChanged unknown exception\n");
   }
 }
-void QuickBlueWindowsPlugin::CleanConnection(uint64_t bluetoothAddress) {
+bool QuickBlueWindowsPlugin::CleanConnection(uint64_t bluetoothAddress,
+                                             uint64_t generation) {
   try {
-    auto it = connectedDevices.find(bluetoothAddress);
-    if (it == connectedDevices.end()) {
+    auto deviceAgent = connectedDevices.Remove(bluetoothAddress, generation);
+    if (!deviceAgent) {
       OutputDebugString((L"CleanConnection: Device not found: " +
                          winrt::to_hstring(bluetoothAddress) + L"\n")
                             .c_str());
-      return;
+      return false;
     }
 
-    auto deviceAgent = std::move(it->second);
-    connectedDevices.erase(bluetoothAddress);
+    deviceHandles.Release(bluetoothAddress);
+    for (auto &operation : pendingOperations.TakeOwnedBy(bluetoothAddress)) {
+      PostError(std::move(operation.value), "Disconnected",
+                "Device disconnected");
+    }
+    SetNotificationBatching(bluetoothAddress, 0, 0);
+    {
+      std::lock_guard<std::mutex> lock(notificationOptionsMutex);
+      binaryNotificationDevices.erase(bluetoothAddress);
+      pendingFirstNotification.erase(bluetoothAddress);
+    }
 
-    if (deviceAgent) {
-      // First unregister all event handlers to prevent any callbacks
-      if (deviceAgent->device) {
-        try {
-          deviceAgent->device.ConnectionStatusChanged(
-              deviceAgent->connnectionStatusChangedToken);
-        } catch (...) {
-          OutputDebugString(L"CleanConnection: Error unregistering "
-                            L"ConnectionStatusChanged\n");
-        }
+    // Operations still holding the agent give up, those waiting for a slot
+    // resume now to do so
+    deviceAgent->disconnected = true;
+    deviceAgent->scheduler->Cancel();
+
+    // First unregister all event handlers to prevent any callbacks
+    if (deviceAgent->device) {
+      try {
+        deviceAgent->device.ConnectionStatusChanged(
+            deviceAgent->connnectionStatusChangedToken);
+        deviceAgent->device.GattServicesChanged(
+            deviceAgent->gattServicesChangedToken);
+      } catch (...) {
+        OutputDebugString(L"CleanConnection: Error unregistering "
+                          L"device event handlers\n");
       }
+    }
 
-      // Remove all value changed handlers for characteristics
-      for (auto &tokenPair : deviceAgent->valueChangedTokens) {
-        try {
-          if (deviceAgent->gattCharacteristics.count(tokenPair.first) > 0) {
-            auto &characteristic =
-                deviceAgent->gattCharacteristics.at(tokenPair.first);
-            if (characteristic) {
-              characteristic.ValueChanged(tokenPair.second);
-            }
-          }
-        } catch (...) {
-          OutputDebugString((L"CleanConnection: Error unregistering "
-                             L"ValueChanged for characteristic: " +
-                             winrt::to_hstring(tokenPair.first) + L"\n")
-                                .c_str());
+    // Remove all value changed handlers for characteristics
+    for (auto &tokenPair : deviceAgent->Subscriptions()) {
+      try {
+        auto characteristic = deviceAgent->Characteristic(tokenPair.first);
+        if (characteristic) {
+          characteristic.ValueChanged(tokenPair.second);
         }
+      } catch (...) {
+        OutputDebugString((L"CleanConnection: Error unregistering "
+                           L"ValueChanged for characteristic: " +
+                           winrt::to_hstring(tokenPair.first) + L"\n")
+                              .c_str());
       }
+    }
 
-      // Clear all cached characteristics and services
-      deviceAgent->gattCharacteristics.clear();
-      deviceAgent->gattServices.clear();
-      deviceAgent->valueChangedTokens.clear();
-
-      // Finally, set the device to null
-      deviceAgent->device = nullptr;
+    // Writes not issued yet are lost with the connection; their requests
+    // failed above. The cached services and characteristics go with the
+    // agent once the last operation using it lets go.
+    for (auto &pipeline : deviceAgent->WritePipelines()) {
+      pipeline->Clear();
     }
 
     OutputDebugString((L"CleanConnection: Successfully cleaned up device: " +
@@ -686,56 +2551,374 @@ void QuickBlueWindowsPlugin::CleanConnection(uint64_t bluetoothAddress) {
   } catch (...) {
     OutputDebugString(L"CleanConnection unknown exception\n");
   }
+  return true;
+}
+
+// Brings the GATT cache of a device up to date after it changed its
+// services, without a disconnect. The services are listed again and the
+// characteristics of those enumerated before are fetched concurrently.
+// Services that are gone, or whose characteristics differ, are invalidated;
+// the others keep their entries and only get fresh GATT objects. Handles
+// stay the same, and subscriptions move to the new objects and are written
+// to the device again.
+winrt::fire_and_forget
+QuickBlueWindowsPlugin::RefreshGattServicesAsync(uint64_t bluetoothAddress,
+                                                 uint64_t generation) {
+  // Looked up again after every suspension, the device may be gone or
+  // connected again
+  auto findAgent = [this, bluetoothAddress, generation] {
+    return connectedDevices.Find(bluetoothAddress, generation);
+  };
+  auto agent = findAgent();
+  if (!agent) {
+    co_return;
+  }
+  if (!agent->BeginRefresh()) {
+    co_return;
+  }
+  try {
+    auto slot = co_await agent->Schedule(GattPriority::Control);
+    agent = findAgent();
+    if (!agent || !slot) {
+      co_return;
+    }
+    do {
+      // Each pass is bounded like a discovery
+      auto deadline =
+          operationTimeouts.DeadlineOf(GattOperation::DiscoverServices);
+      {
+        std::lock_guard<std::mutex> lock(agent->mutex);
+        agent->cachedLayout.reset();
+      }
+      agent->gattRequests++;
+      auto servicesResult = co_await within(
+          agent->device.GetGattServicesAsync(BluetoothCacheMode::Uncached),
+          deadline, GattOperation::DiscoverServices);
+      agent = findAgent();
+      if (!agent) {
+        co_return;
+      }
+      if (servicesResult.Status() != GattCommunicationStatus::Success) {
+        // Keep what is known; lookups of missing services go to the device
+        OutputDebugString(
+            (L"RefreshGattServicesAsync failed with status: " +
+             winrt::to_hstring((int32_t)servicesResult.Status()) + L"\n")
+                .c_str());
+        {
+          std::lock_guard<std::mutex> lock(agent->mutex);
+          agent->servicesEnumerated = false;
+        }
+        continue;
+      }
+
+      std::unordered_map<BleUuid, GattDeviceService, BleUuidHash> services;
+      for (auto s : servicesResult.Services()) {
+        services.emplace(to_bleuuid(s.Uuid()), s);
+      }
+      std::unordered_set<BleUuid, BleUuidHash> enumeratedServices;
+      {
+        std::lock_guard<std::mutex> lock(agent->mutex);
+        enumeratedServices = agent->enumeratedServices;
+      }
+      std::vector<BleUuid> enumerated;
+      std::vector<IAsyncOperation<GattCharacteristicsResult>> operations;
+      for (const auto &uuid : enumeratedServices) {
+        auto it = services.find(uuid);
+        if (it != services.end()) {
+          agent->gattRequests++;
+          enumerated.push_back(uuid);
+          operations.push_back(
+              it->second.GetCharacteristicsAsync(BluetoothCacheMode::Uncached));
+        }
+      }
+      std::vector<GattCharacteristicsResult> results;
+      for (auto &operation : operations) {
+        results.push_back(co_await within(operation, deadline,
+                                          GattOperation::DiscoverServices));
+      }
+      agent = findAgent();
+      if (!agent) {
+        co_return;
+      }
+
+      // The tables change in one step. Notification handlers do not take the
+      // agent lock, so they are moved to the new objects under it.
+      using DescriptorValue =
+          GattClientCharacteristicConfigurationDescriptorValue;
+      std::vector<std::pair<GattCharacteristic, DescriptorValue>> resubscribed;
+      {
+        std::lock_guard<std::mutex> lock(agent->mutex);
+
+        // The objects notifications are subscribed on, before replacing them
+        std::map<uint32_t, GattCharacteristic> subscribed;
+        for (auto &subscription : agent->valueChangedTokens) {
+          subscribed.emplace(subscription.first,
+                             agent->CharacteristicLocked(subscription.first));
+        }
+
+        std::vector<BleUuid> gone;
+        for (auto &service : agent->gattServices) {
+          if (services.count(service.first) == 0) {
+            gone.push_back(service.first);
+          }
+        }
+        for (const auto &uuid : gone) {
+          agent->InvalidateServiceLocked(uuid);
+        }
+        agent->gattServices = std::move(services);
+        agent->servicesEnumerated = true;
+
+        for (size_t i = 0; i < enumerated.size(); ++i) {
+          const auto &uuid = enumerated[i];
+          if (results[i].Status() != GattCommunicationStatus::Success) {
+            agent->InvalidateServiceLocked(uuid);
+            continue;
+          }
+          auto characteristics = results[i].Characteristics();
+          auto unchanged = characteristics.Size() ==
+                           agent->CharacteristicCountLocked(uuid);
+          for (auto c : characteristics) {
+            unchanged = unchanged &&
+                        agent->gattCharacteristics.Find(
+                            uuid, to_bleuuid(c.Uuid()),
+                            c.AttributeHandle()) != kInvalidHandle;
+          }
+          if (!unchanged) {
+            agent->InvalidateServiceLocked(uuid);
+          }
+          // Existing keys keep their handles; removed ones stay invalidated
+          for (auto c : characteristics) {
+            agent->AddCharacteristicLocked(uuid, to_bleuuid(c.Uuid()),
+                                           c.AttributeHandle(), c);
+          }
+          agent->enumeratedServices.insert(uuid);
+        }
+
+        // Move subscriptions to the new objects
+        for (auto &[handle, previous] : subscribed) {
+          try {
+            if (previous) {
+              previous.ValueChanged(agent->valueChangedTokens[handle]);
+            }
+          } catch (...) {
+            OutputDebugString(L"RefreshGattServicesAsync: Error removing "
+                              L"notification handler\n");
+          }
+          agent->valueChangedTokens.erase(handle);
+          auto characteristic = agent->CharacteristicLocked(handle);
+          if (!characteristic) {
+            OutputDebugString((L"RefreshGattServicesAsync: Subscribed "
+                               L"characteristic is gone: #" +
+                               winrt::to_hstring(handle) + L"\n")
+                                  .c_str());
+            agent->notificationModes.erase(handle);
+            continue;
+          }
+          agent->valueChangedTokens[handle] =
+              SubscribeValueChanged(*agent, handle, characteristic);
+          resubscribed.emplace_back(characteristic,
+                                    agent->notificationModes[handle]);
+        }
+      }
+      for (auto &subscription : resubscribed) {
+        auto status = co_await within(
+            subscription.first
+                .WriteClientCharacteristicConfigurationDescriptorAsync(
+                    subscription.second),
+            operationTimeouts.DeadlineOf(GattOperation::SetNotifiable),
+            GattOperation::SetNotifiable);
+        if (status != GattCommunicationStatus::Success) {
+          OutputDebugString(
+              (L"RefreshGattServicesAsync: Failed to write descriptor, "
+               L"status: " +
+               winrt::to_hstring((int32_t)status) + L"\n")
+                  .c_str());
+        }
+      }
+      agent = findAgent();
+      if (!agent) {
+        co_return;
+      }
+    } while (agent->NextRefreshPass());
+    co_return;
+  } catch (const winrt::hresult_error &ex) {
+    OutputDebugString((L"RefreshGattServicesAsync exception: " +
+                       ex.message() + L", code: " +
+                       winrt::to_hstring(ex.code()) + L"\n")
+                          .c_str());
+  } catch (...) {
+    OutputDebugString(L"RefreshGattServicesAsync unknown exception\n");
+  }
+  agent = findAgent();
+  if (agent) {
+    agent->EndRefresh();
+  }
+}
+
+// Routes notifications of |characteristic| to GattCharacteristic_ValueChanged.
+// The handler carries the handles, so a notification needs no lookups to be
+// routed. Notifications only carry the characteristic handle; Dart learns
+// its UUID from the message sent here, which is queued ahead of them.
+winrt::event_token QuickBlueWindowsPlugin::SubscribeValueChanged(
+    BluetoothDeviceAgent &bluetoothDeviceAgent, uint32_t characteristicHandle,
+    GattCharacteristic characteristic) {
+  auto deviceAddress = bluetoothDeviceAgent.device.BluetoothAddress();
+  auto deviceHandle = bluetoothDeviceAgent.handle;
+  SendConnectorMessage(EncodableMap{
+      {"deviceId", std::to_string(deviceAddress)},
+      {"characteristicHandle", (int64_t)characteristicHandle},
+      {"characteristic", to_uuidstr(characteristic.Uuid())},
+  });
+  return characteristic.ValueChanged(
+      [this, deviceAddress, deviceHandle, characteristicHandle](
+          GattCharacteristic sender, GattValueChangedEventArgs args) {
+        GattCharacteristic_ValueChanged(deviceAddress, deviceHandle,
+                                        characteristicHandle, sender, args);
+      });
 }
 
 winrt::fire_and_forget QuickBlueWindowsPlugin::DiscoverServicesAsync(
-    BluetoothDeviceAgent &bluetoothDeviceAgent) {
+    std::shared_ptr<BluetoothDeviceAgent> deviceAgent,
+    std::optional<GattCacheMode> cacheMode) {
+  auto &bluetoothDeviceAgent = *deviceAgent;
   try {
-    if (!bluetoothDeviceAgent.device) {
+    if (bluetoothDeviceAgent.disconnected) {
       OutputDebugString(
           L"DiscoverServicesAsync: Device is null or disconnected\n");
-      message_connector_->Send(EncodableMap{
+      SendConnectorMessage(EncodableMap{
+          {"deviceId",
+           std::to_string(bluetoothDeviceAgent.device.BluetoothAddress())},
+          {"ServiceState", "discovered"}});
+      co_return;
+    }
+
+    // Discovery registers characteristics, so it is ordered with the other
+    // control operations even when it needs no GATT traffic
+    auto slot = co_await bluetoothDeviceAgent.Schedule(GattPriority::Control);
+    if (!slot) {
+      OutputDebugString(L"DiscoverServicesAsync: Device disconnected\n");
+      SendConnectorMessage(EncodableMap{
           {"deviceId",
            std::to_string(bluetoothDeviceAgent.device.BluetoothAddress())},
           {"ServiceState", "discovered"}});
       co_return;
     }
 
-    auto serviceResult =
-        co_await bluetoothDeviceAgent.device.GetGattServicesAsync();
+    auto cachedLayout = bluetoothDeviceAgent.CachedLayout();
+    if (cachedLayout && cacheMode != GattCacheMode::Uncached) {
+      // Warm start: report the persisted layout without GATT traffic
+      SendGattTree(bluetoothDeviceAgent, *cachedLayout);
+      co_return;
+    }
+
+    auto deadline =
+        operationTimeouts.DeadlineOf(GattOperation::DiscoverServices);
+    // Without a cacheMode the WinRT default applies, and nothing is counted
+    auto mode = to_cachemode(cacheMode.value_or(GattCacheMode::Cached));
+    auto countCacheResult = [&](GattCommunicationStatus status) {
+      if (cacheMode) {
+        bluetoothDeviceAgent.CountCacheResult(*cacheMode, status);
+      }
+    };
+
+    bluetoothDeviceAgent.gattRequests++;
+    auto serviceResult = co_await within(
+        cacheMode ? bluetoothDeviceAgent.device.GetGattServicesAsync(mode)
+                  : bluetoothDeviceAgent.device.GetGattServicesAsync(),
+        deadline, GattOperation::DiscoverServices);
+    countCacheResult(serviceResult.Status());
     if (serviceResult.Status() != GattCommunicationStatus::Success) {
       OutputDebugString((L"DiscoverServicesAsync failed with status: " +
                          winrt::to_hstring((int32_t)serviceResult.Status()) +
                          L"\n")
                             .c_str());
-      message_connector_->Send(EncodableMap{
+      SendConnectorMessage(EncodableMap{
           {"deviceId",
            std::to_string(bluetoothDeviceAgent.device.BluetoothAddress())},
           {"ServiceState", "discovered"}});
       co_return;
     }
 
-    for (auto s : serviceResult.Services()) {
-      auto characteristicResult = co_await s.GetCharacteristicsAsync();
-      auto msg = EncodableMap{
-          {"deviceId",
-           std::to_string(bluetoothDeviceAgent.device.BluetoothAddress())},
-          {"ServiceState", "discovered"},
-          {"service", to_uuidstr(s.Uuid())}};
-      if (characteristicResult.Status() == GattCommunicationStatus::Success) {
-        EncodableList characteristics;
-        for (auto c : characteristicResult.Characteristics()) {
-          characteristics.push_back(to_uuidstr(c.Uuid()));
+    // Start every enumeration before awaiting any. WinRT operations run from
+    // the moment they are created, so awaiting them in turn joins them like
+    // when_all, and discovery takes about as long as the slowest service
+    // instead of the sum of all of them.
+    auto services = serviceResult.Services();
+    std::vector<IAsyncOperation<GattCharacteristicsResult>>
+        characteristicOperations;
+    characteristicOperations.reserve(services.Size());
+    for (auto s : services) {
+      bluetoothDeviceAgent.AddService(s);
+      bluetoothDeviceAgent.gattRequests++;
+      characteristicOperations.push_back(
+          cacheMode ? s.GetCharacteristicsAsync(mode)
+                    : s.GetCharacteristicsAsync());
+    }
+    bluetoothDeviceAgent.MarkServicesEnumerated();
+
+    // Descriptor enumerations start as soon as their service has answered,
+    // overlapping with the services still outstanding.
+    GattLayout layout;
+    bool layoutComplete = true;
+    std::vector<IAsyncOperation<GattDescriptorsResult>> descriptorOperations;
+    for (uint32_t i = 0; i < services.Size(); ++i) {
+      auto serviceUuid = to_bleuuid(services.GetAt(i).Uuid());
+      auto characteristicResult =
+          co_await within(characteristicOperations[i], deadline,
+                          GattOperation::DiscoverServices);
+      countCacheResult(characteristicResult.Status());
+      layout.services.push_back({serviceUuid, {}});
+      if (characteristicResult.Status() != GattCommunicationStatus::Success) {
+        layoutComplete = false;
+        continue;
+      }
+      for (auto c : characteristicResult.Characteristics()) {
+        bluetoothDeviceAgent.AddCharacteristic(serviceUuid, c);
+        layout.services.back().characteristics.push_back(
+            {to_bleuuid(c.Uuid()), c.AttributeHandle(),
+             (uint32_t)c.CharacteristicProperties(), {}});
+        bluetoothDeviceAgent.gattRequests++;
+        descriptorOperations.push_back(cacheMode ? c.GetDescriptorsAsync(mode)
+                                                 : c.GetDescriptorsAsync());
+      }
+      bluetoothDeviceAgent.MarkEnumerated(serviceUuid);
+    }
+
+    auto descriptorOperation = descriptorOperations.begin();
+    for (auto &service : layout.services) {
+      for (auto &characteristic : service.characteristics) {
+        auto descriptorResult = co_await within(
+            *descriptorOperation++, deadline, GattOperation::DiscoverServices);
+        countCacheResult(descriptorResult.Status());
+        if (descriptorResult.Status() != GattCommunicationStatus::Success) {
+          layoutComplete = false;
+          continue;
+        }
+        for (auto d : descriptorResult.Descriptors()) {
+          characteristic.descriptors.push_back(to_bleuuid(d.Uuid()));
         }
-        msg.insert({"characteristics", characteristics});
       }
-      message_connector_->Send(msg);
     }
+
+    SendGattTree(bluetoothDeviceAgent, layout);
+    if (layoutComplete && bluetoothDeviceAgent.layoutCache) {
+      bluetoothDeviceAgent.layoutCache->Store(
+          bluetoothDeviceAgent.device.BluetoothAddress(), layout);
+    }
+  } catch (const GattTimeout &ex) {
+    OutputDebugString((L"DiscoverServicesAsync: " +
+                       winrt::to_hstring(ex.what()) + L"\n")
+                          .c_str());
+    SendConnectorMessage(EncodableMap{
+        {"deviceId",
+         std::to_string(bluetoothDeviceAgent.device.BluetoothAddress())},
+        {"ServiceState", "discovered"},
+        {"error", "Timeout"}});
   } catch (const winrt::hresult_error &ex) {
     OutputDebugString((L"DiscoverServicesAsync exception: " + ex.message() +
                        L", code: " + winrt::to_hstring(ex.code()) + L"\n")
                           .c_str());
-    message_connector_->Send(EncodableMap{
+    SendConnectorMessage(EncodableMap{
         {"deviceId",
          std::to_string(bluetoothDeviceAgent.device.BluetoothAddress())},
         {"ServiceState", "discovered"}});
@@ -743,79 +2926,148 @@ winrt::fire_and_forget QuickBlueWindowsPlugin::DiscoverServicesAsync(
     OutputDebugString((L"DiscoverServicesAsync std exception: " +
                        winrt::to_hstring(ex.what()) + L"\n")
                           .c_str());
-    message_connector_->Send(EncodableMap{
+    SendConnectorMessage(EncodableMap{
         {"deviceId",
          std::to_string(bluetoothDeviceAgent.device.BluetoothAddress())},
         {"ServiceState", "discovered"}});
   } catch (...) {
     OutputDebugString(L"DiscoverServicesAsync unknown exception\n");
-    message_connector_->Send(EncodableMap{
+    SendConnectorMessage(EncodableMap{
         {"deviceId",
          std::to_string(bluetoothDeviceAgent.device.BluetoothAddress())},
         {"ServiceState", "discovered"}});
   }
 }
 
+// Reports the whole GATT tree of a device in one message.
+void QuickBlueWindowsPlugin::SendGattTree(
+    BluetoothDeviceAgent &bluetoothDeviceAgent, const GattLayout &layout) {
+  EncodableMap msg;
+  msg[EncodableValue("deviceId")] = EncodableValue(
+      std::to_string(bluetoothDeviceAgent.device.BluetoothAddress()));
+  msg[EncodableValue("ServiceState")] = EncodableValue("discovered");
+  msg[EncodableValue("services")] =
+      EncodableValue(to_gatt_tree(bluetoothDeviceAgent, layout));
+  SendConnectorMessage(EncodableValue(std::move(msg)));
+}
+
+uint64_t QuickBlueWindowsPlugin::AddPendingOperation(
+    BluetoothDeviceAgent &bluetoothDeviceAgent,
+    std::unique_ptr<flutter::MethodResult<EncodableValue>> result) {
+  return pendingOperations.Add(bluetoothDeviceAgent.device.BluetoothAddress(),
+                               std::move(result));
+}
+
+// Answers request |requestId| unless it was answered already, e.g. failed
+// by a disconnect.
+void QuickBlueWindowsPlugin::CompleteOperation(uint64_t requestId,
+                                               const EncodableValue &value) {
+  if (auto operation = pendingOperations.Take(requestId)) {
+    PostSuccess(std::move(operation->value), value);
+  }
+}
+
+void QuickBlueWindowsPlugin::FailOperation(uint64_t requestId,
+                                           const std::string &code,
+                                           const std::string &message,
+                                           const EncodableValue &details) {
+  if (auto operation = pendingOperations.Take(requestId)) {
+    PostError(std::move(operation->value), code, message, details);
+  }
+}
+
 winrt::fire_and_forget QuickBlueWindowsPlugin::RequestMtuAsync(
-    BluetoothDeviceAgent &bluetoothDeviceAgent, uint64_t expectedMtu) {
+    std::shared_ptr<BluetoothDeviceAgent> deviceAgent, uint64_t expectedMtu,
+    uint64_t requestId, GattScheduler::Clock::time_point deadline) {
+  auto &bluetoothDeviceAgent = *deviceAgent;
   try {
-    if (!bluetoothDeviceAgent.device) {
+    if (bluetoothDeviceAgent.disconnected) {
       OutputDebugString(L"RequestMtuAsync: Device is null or disconnected\n");
+      FailOperation(requestId, "IllegalArgument", "Unknown device");
+      co_return;
+    }
+    auto slot =
+        co_await bluetoothDeviceAgent.Schedule(GattPriority::Control, deadline);
+    if (!slot) {
+      FailOperation(requestId, to_errorcode(slot.GetState()),
+                    "MTU request not started");
       co_return;
     }
 
     OutputDebugString((L"RequestMtuAsync expectedMtu: " +
                        winrt::to_hstring(expectedMtu) + L"\n")
                           .c_str());
-    auto gattSession = co_await GattSession::FromDeviceIdAsync(
-        bluetoothDeviceAgent.device.BluetoothDeviceId());
+    auto gattSession = co_await within(
+        GattSession::FromDeviceIdAsync(
+            bluetoothDeviceAgent.device.BluetoothDeviceId()),
+        operationTimeouts.DeadlineOf(GattOperation::RequestMtu, deadline),
+        GattOperation::RequestMtu);
 
     if (!gattSession) {
       OutputDebugString(L"RequestMtuAsync: Failed to get GattSession\n");
+      FailOperation(requestId, "MtuFailed", "No GATT session");
       co_return;
     }
 
-    message_connector_->Send(EncodableMap{
-        {"mtuConfig", (int64_t)gattSession.MaxPduSize()},
-    });
+    // Windows negotiates the MTU itself; report what it settled on
+    CompleteOperation(requestId,
+                      EncodableValue((int64_t)gattSession.MaxPduSize()));
+  } catch (const GattTimeout &ex) {
+    OutputDebugString(
+        (L"RequestMtuAsync: " + winrt::to_hstring(ex.what()) + L"\n").c_str());
+    FailOperation(requestId, "Timeout", ex.what(), to_timeoutdetails(ex));
   } catch (const winrt::hresult_error &ex) {
     OutputDebugString((L"RequestMtuAsync exception: " + ex.message() +
                        L", code: " + winrt::to_hstring(ex.code()) + L"\n")
                           .c_str());
+    FailOperation(requestId, "MtuFailed", winrt::to_string(ex.message()));
   } catch (const std::exception &ex) {
     OutputDebugString((L"RequestMtuAsync std exception: " +
                        winrt::to_hstring(ex.what()) + L"\n")
                           .c_str());
+    FailOperation(requestId, "MtuFailed", ex.what());
   } catch (...) {
     OutputDebugString(L"RequestMtuAsync unknown exception\n");
+    FailOperation(requestId, "MtuFailed", "Unknown exception");
   }
 }
 
 winrt::fire_and_forget QuickBlueWindowsPlugin::SetNotifiableAsync(
-    BluetoothDeviceAgent &bluetoothDeviceAgent, std::string service,
-    std::string characteristic, std::string bleInputProperty) {
+    std::shared_ptr<BluetoothDeviceAgent> deviceAgent,
+    CharacteristicRef characteristic, std::string bleInputProperty) {
+  auto &bluetoothDeviceAgent = *deviceAgent;
   try {
     // Critical section - first check if device is still valid and connected
-    if (!bluetoothDeviceAgent.device || !bluetoothDeviceAgent.IsConnected()) {
+    if (!bluetoothDeviceAgent.IsConnected()) {
       OutputDebugString(
           L"SetNotifiableAsync: Device is null or disconnected\n");
       co_return;
     }
+    auto slot =
+        co_await bluetoothDeviceAgent.Schedule(GattPriority::Subscription);
+    if (!slot) {
+      OutputDebugString(L"SetNotifiableAsync: Device disconnected\n");
+      co_return;
+    }
+    auto deadline = operationTimeouts.DeadlineOf(GattOperation::SetNotifiable);
 
     OutputDebugString((L"SetNotifiableAsync: Starting for characteristic: " +
-                       winrt::to_hstring(characteristic) + L", property: " +
-                       winrt::to_hstring(bleInputProperty) + L"\n")
+                       winrt::to_hstring(to_refstr(characteristic)) +
+                       L", property: " + winrt::to_hstring(bleInputProperty) +
+                       L"\n")
                           .c_str());
 
     // Get the characteristic
+    auto characteristicHandle = co_await within(
+        bluetoothDeviceAgent.ResolveCharacteristicAsync(characteristic),
+        deadline, GattOperation::SetNotifiable);
     auto gattCharacteristic =
-        co_await bluetoothDeviceAgent.GetCharacteristicAsync(service,
-                                                             characteristic);
+        bluetoothDeviceAgent.Characteristic(characteristicHandle);
 
     // Check if the characteristic was found
     if (!gattCharacteristic) {
       OutputDebugString((L"SetNotifiableAsync: Characteristic not found: " +
-                         winrt::to_hstring(characteristic) + L"\n")
+                         winrt::to_hstring(to_refstr(characteristic)) + L"\n")
                             .c_str());
       co_return;
     }
@@ -823,15 +3075,14 @@ winrt::fire_and_forget QuickBlueWindowsPlugin::SetNotifiableAsync(
     // If we're disabling notifications, remove the value changed handler first
     if (bleInputProperty == "disabled") {
       // Check if we have a token for this characteristic
-      if (bluetoothDeviceAgent.valueChangedTokens.count(characteristic) > 0) {
+      if (auto token =
+              bluetoothDeviceAgent.TakeSubscription(characteristicHandle)) {
         try {
           // Remove the event handler
-          auto token = bluetoothDeviceAgent.valueChangedTokens[characteristic];
-          gattCharacteristic.ValueChanged(token);
-          bluetoothDeviceAgent.valueChangedTokens.erase(characteristic);
+          gattCharacteristic.ValueChanged(*token);
           OutputDebugString(
               (L"SetNotifiableAsync: Removed notification handler for: " +
-               winrt::to_hstring(characteristic) + L"\n")
+               winrt::to_hstring(to_refstr(characteristic)) + L"\n")
                   .c_str());
         } catch (const std::exception &ex) {
           OutputDebugString(
@@ -852,13 +3103,15 @@ winrt::fire_and_forget QuickBlueWindowsPlugin::SetNotifiableAsync(
 
     // Write the descriptor
     OutputDebugString((L"SetNotifiableAsync: Writing descriptor for: " +
-                       winrt::to_hstring(characteristic) + L"\n")
+                       winrt::to_hstring(to_refstr(characteristic)) + L"\n")
                           .c_str());
 
-    auto writeDescriptorStatus =
-        co_await gattCharacteristic
+    auto writeDescriptor =
+        gattCharacteristic
             .WriteClientCharacteristicConfigurationDescriptorAsync(
                 descriptorValue);
+    auto writeDescriptorStatus = co_await within(
+        writeDescriptor, deadline, GattOperation::SetNotifiable);
 
     if (writeDescriptorStatus != GattCommunicationStatus::Success) {
       OutputDebugString(
@@ -867,15 +3120,19 @@ winrt::fire_and_forget QuickBlueWindowsPlugin::SetNotifiableAsync(
               .c_str());
       co_return;
     }
+    if (bluetoothDeviceAgent.disconnected) {
+      // Handlers registered now would outlive the connection
+      OutputDebugString(L"SetNotifiableAsync: Device disconnected\n");
+      co_return;
+    }
 
     // If we're enabling notifications, add a value changed handler
     if (bleInputProperty != "disabled") {
       // Remove any existing handler first
-      if (bluetoothDeviceAgent.valueChangedTokens.count(characteristic) > 0) {
+      if (auto token =
+              bluetoothDeviceAgent.TakeSubscription(characteristicHandle)) {
         try {
-          auto token = bluetoothDeviceAgent.valueChangedTokens[characteristic];
-          gattCharacteristic.ValueChanged(token);
-          bluetoothDeviceAgent.valueChangedTokens.erase(characteristic);
+          gattCharacteristic.ValueChanged(*token);
         } catch (...) {
           OutputDebugString(L"SetNotifiableAsync: Error removing existing "
                             L"notification handler\n");
@@ -884,12 +3141,14 @@ winrt::fire_and_forget QuickBlueWindowsPlugin::SetNotifiableAsync(
 
       // Add the new handler
       try {
-        auto token = gattCharacteristic.ValueChanged(
-            {this, &QuickBlueWindowsPlugin::GattCharacteristic_ValueChanged});
-        bluetoothDeviceAgent.valueChangedTokens[characteristic] = token;
+        bluetoothDeviceAgent.AddSubscription(
+            characteristicHandle,
+            SubscribeValueChanged(bluetoothDeviceAgent, characteristicHandle,
+                                  gattCharacteristic),
+            descriptorValue);
         OutputDebugString(
             (L"SetNotifiableAsync: Added notification handler for: " +
-             winrt::to_hstring(characteristic) + L"\n")
+             winrt::to_hstring(to_refstr(characteristic)) + L"\n")
                 .c_str());
       } catch (const std::exception &ex) {
         OutputDebugString(
@@ -900,7 +3159,11 @@ winrt::fire_and_forget QuickBlueWindowsPlugin::SetNotifiableAsync(
     }
 
     OutputDebugString((L"SetNotifiableAsync: Successfully set property for: " +
-                       winrt::to_hstring(characteristic) + L"\n")
+                       winrt::to_hstring(to_refstr(characteristic)) + L"\n")
+                          .c_str());
+  } catch (const GattTimeout &ex) {
+    OutputDebugString((L"SetNotifiableAsync: " + winrt::to_hstring(ex.what()) +
+                       L"\n")
                           .c_str());
   } catch (const winrt::hresult_error &ex) {
     OutputDebugString((L"SetNotifiableAsync exception: " + ex.message() +
@@ -916,138 +3179,626 @@ winrt::fire_and_forget QuickBlueWindowsPlugin::SetNotifiableAsync(
 }
 
 winrt::fire_and_forget QuickBlueWindowsPlugin::ReadValueAsync(
-    BluetoothDeviceAgent &bluetoothDeviceAgent, std::string service,
-    std::string characteristic) {
+    std::shared_ptr<BluetoothDeviceAgent> deviceAgent,
+    CharacteristicRef characteristic, std::optional<GattCacheMode> cacheMode,
+    uint64_t requestId, GattScheduler::Clock::time_point deadline) {
+  auto &bluetoothDeviceAgent = *deviceAgent;
   try {
-    if (!bluetoothDeviceAgent.device) {
+    if (bluetoothDeviceAgent.disconnected) {
       OutputDebugString(L"ReadValueAsync: Device is null or disconnected\n");
+      FailOperation(requestId, "IllegalArgument", "Unknown device");
+      co_return;
+    }
+    auto slot =
+        co_await bluetoothDeviceAgent.Schedule(GattPriority::Read, deadline);
+    if (!slot) {
+      FailOperation(requestId, to_errorcode(slot.GetState()),
+                    "Read not started");
       co_return;
     }
+    auto readDeadline =
+        operationTimeouts.DeadlineOf(GattOperation::ReadValue, deadline);
 
+    auto characteristicHandle = co_await within(
+        bluetoothDeviceAgent.ResolveCharacteristicAsync(characteristic),
+        readDeadline, GattOperation::ReadValue);
     auto gattCharacteristic =
-        co_await bluetoothDeviceAgent.GetCharacteristicAsync(service,
-                                                             characteristic);
+        bluetoothDeviceAgent.Characteristic(characteristicHandle);
 
     if (!gattCharacteristic) {
       OutputDebugString((L"ReadValueAsync: Characteristic not found: " +
-                         winrt::to_hstring(characteristic) + L"\n")
+                         winrt::to_hstring(to_refstr(characteristic)) + L"\n")
                             .c_str());
+      FailOperation(requestId, "IllegalArgument", "Invalid characteristic");
       co_return;
     }
 
-    auto readValueResult = co_await gattCharacteristic.ReadValueAsync();
+    auto mode = cacheMode ? *cacheMode
+                          : readCachePolicy.Mode(
+                                to_bleuuid(gattCharacteristic.Uuid()));
+    auto readValueResult =
+        co_await within(gattCharacteristic.ReadValueAsync(to_cachemode(mode)),
+                        readDeadline, GattOperation::ReadValue);
+    bluetoothDeviceAgent.CountCacheResult(mode, readValueResult.Status());
+    if (mode == GattCacheMode::Cached &&
+        readValueResult.Status() != GattCommunicationStatus::Success) {
+      // Nothing usable in the cache, ask the device
+      readValueResult = co_await within(
+          gattCharacteristic.ReadValueAsync(BluetoothCacheMode::Uncached),
+          readDeadline, GattOperation::ReadValue);
+    }
 
     if (readValueResult.Status() != GattCommunicationStatus::Success) {
       OutputDebugString((L"ReadValueAsync failed with status: " +
                          winrt::to_hstring((int32_t)readValueResult.Status()) +
                          L"\n")
                             .c_str());
+      FailOperation(requestId, "ReadFailed",
+                    "Read failed with status " +
+                        std::to_string((int32_t)readValueResult.Status()),
+                    to_statusdetails(readValueResult.Status(),
+                                     readValueResult.ProtocolError()));
       co_return;
     }
 
     auto bytes = to_bytevc(readValueResult.Value());
-    OutputDebugString((L"ReadValueAsync " + winrt::to_hstring(characteristic) +
-                       L", " + winrt::to_hstring(to_hexstring(bytes)) + L"\n")
+    OutputDebugString((L"ReadValueAsync " +
+                       winrt::to_hstring(to_refstr(characteristic)) + L", " +
+                       winrt::to_hstring(to_hexstring(bytes)) + L"\n")
                           .c_str());
-    message_connector_->Send(EncodableMap{
+    SendConnectorMessage(EncodableMap{
         {"deviceId",
          std::to_string(
              gattCharacteristic.Service().Device().BluetoothAddress())},
         {"characteristicValue",
          EncodableMap{
-             {"characteristic", characteristic},
+             {"characteristic", to_uuidstr(gattCharacteristic.Uuid())},
+             {"characteristicHandle", (int64_t)characteristicHandle},
              {"value", bytes},
          }},
     });
+    CompleteOperation(requestId, EncodableValue(std::move(bytes)));
+  } catch (const GattTimeout &ex) {
+    OutputDebugString(
+        (L"ReadValueAsync: " + winrt::to_hstring(ex.what()) + L"\n").c_str());
+    FailOperation(requestId, "Timeout", ex.what(), to_timeoutdetails(ex));
   } catch (const winrt::hresult_error &ex) {
     OutputDebugString((L"ReadValueAsync exception: " + ex.message() +
                        L", code: " + winrt::to_hstring(ex.code()) + L"\n")
                           .c_str());
+    FailOperation(requestId, "ReadFailed", winrt::to_string(ex.message()));
   } catch (const std::exception &ex) {
     OutputDebugString((L"ReadValueAsync std exception: " +
                        winrt::to_hstring(ex.what()) + L"\n")
                           .c_str());
+    FailOperation(requestId, "ReadFailed", ex.what());
   } catch (...) {
     OutputDebugString(L"ReadValueAsync unknown exception\n");
+    FailOperation(requestId, "ReadFailed", "Unknown exception");
   }
 }
 
-// Add a new method to safely get a characteristic and handle nulls
+// Resolves a characteristic that is not registered yet, then queues the
+// write to it.
 winrt::fire_and_forget QuickBlueWindowsPlugin::WriteValueAsync(
-    BluetoothDeviceAgent &bluetoothDeviceAgent, std::string service,
-    std::string characteristic, std::vector<uint8_t> value,
-    std::string bleOutputProperty) {
+    std::shared_ptr<BluetoothDeviceAgent> deviceAgent,
+    CharacteristicRef characteristic, WritePipeline::Write write) {
+  auto &bluetoothDeviceAgent = *deviceAgent;
+  auto requestId = write.tag;
   try {
     // Critical section - first check if device is still valid
-    if (!bluetoothDeviceAgent.device ||
-        bluetoothDeviceAgent.device.ConnectionStatus() !=
-            BluetoothConnectionStatus::Connected) {
+    if (!bluetoothDeviceAgent.IsConnected()) {
       OutputDebugString(L"WriteValueAsync: Device is null or disconnected\n");
+      FailOperation(requestId, "IllegalArgument", "Unknown device");
+      co_return;
+    }
+
+    // Resolving takes GATT requests, which go ahead of queued writes
+    auto slot = co_await bluetoothDeviceAgent.Schedule(GattPriority::Control,
+                                                       write.deadline);
+    if (!slot) {
+      FailOperation(requestId, to_errorcode(slot.GetState()),
+                    "Write not started");
+      co_return;
+    }
+    auto characteristicHandle = co_await within(
+        bluetoothDeviceAgent.ResolveCharacteristicAsync(characteristic),
+        operationTimeouts.DeadlineOf(GattOperation::WriteValue,
+                                     write.deadline),
+        GattOperation::WriteValue);
+    slot.Release();
+
+    // Check if the characteristic was found
+    if (!bluetoothDeviceAgent.Characteristic(characteristicHandle)) {
+      OutputDebugString((L"WriteValueAsync: Characteristic not found: " +
+                         winrt::to_hstring(to_refstr(characteristic)) + L"\n")
+                            .c_str());
+      FailOperation(requestId, "IllegalArgument", "Invalid characteristic");
       co_return;
     }
 
-    OutputDebugString((L"WriteValueAsync: Starting for characteristic: " +
-                       winrt::to_hstring(characteristic) + L", value size: " +
-                       winrt::to_hstring(value.size()) + L"\n")
+    QueueWrite(deviceAgent, characteristicHandle, std::move(write));
+  } catch (const GattTimeout &ex) {
+    OutputDebugString(
+        (L"WriteValueAsync: " + winrt::to_hstring(ex.what()) + L"\n").c_str());
+    FailOperation(requestId, "Timeout", ex.what(), to_timeoutdetails(ex));
+  } catch (const winrt::hresult_error &ex) {
+    OutputDebugString((L"WriteValueAsync exception: " + ex.message() +
+                       L", code: " + winrt::to_hstring(ex.code()) + L"\n")
+                          .c_str());
+    FailOperation(requestId, "WriteFailed", winrt::to_string(ex.message()));
+  } catch (const std::exception &ex) {
+    OutputDebugString((L"WriteValueAsync std exception: " +
+                       winrt::to_hstring(ex.what()) + L"\n")
                           .c_str());
+    FailOperation(requestId, "WriteFailed", ex.what());
+  } catch (...) {
+    OutputDebugString(L"WriteValueAsync unknown exception\n");
+    FailOperation(requestId, "WriteFailed", "Unknown exception");
+  }
+}
 
-    // Create a copy of the vector to avoid potential memory issues
-    auto valueCopy = std::vector<uint8_t>(value);
+// Appends |write| to the pipeline of the characteristic. Its request fails
+// with QueueFull if the queue has no room, and completes otherwise once the
+// write has been carried out.
+void QuickBlueWindowsPlugin::QueueWrite(
+    std::shared_ptr<BluetoothDeviceAgent> deviceAgent,
+    uint32_t characteristicHandle, WritePipeline::Write write) {
+  auto requestId = write.tag;
+  auto pipeline = deviceAgent->WritePipelineOf(characteristicHandle);
+  if (!pipeline->Push(std::move(write))) {
+    FailOperation(requestId, "QueueFull",
+                  "Write queue of characteristic #" +
+                      std::to_string(characteristicHandle) + " is full");
+    return;
+  }
+  DrainWritesAsync(deviceAgent, characteristicHandle);
+}
 
-    // Get the characteristic
+// Fetches the GATT object of a characteristic registered from the layout
+// cache, then drains its pipeline.
+winrt::fire_and_forget QuickBlueWindowsPlugin::DrainWritesAsync(
+    std::shared_ptr<BluetoothDeviceAgent> deviceAgent,
+    uint32_t characteristicHandle) {
+  auto &bluetoothDeviceAgent = *deviceAgent;
+  auto pipeline = bluetoothDeviceAgent.WritePipelineOf(characteristicHandle);
+  try {
     auto gattCharacteristic =
-        co_await bluetoothDeviceAgent.GetCharacteristicAsync(service,
-                                                             characteristic);
-
-    // Check if the characteristic was found
+        bluetoothDeviceAgent.Characteristic(characteristicHandle);
     if (!gattCharacteristic) {
-      OutputDebugString((L"WriteValueAsync: Characteristic not found: " +
-                         winrt::to_hstring(characteristic) + L"\n")
+      // Fetching it takes GATT requests, which go ahead of queued writes
+      auto slot = co_await bluetoothDeviceAgent.Schedule(GattPriority::Control);
+      if (!slot) {
+        for (auto &write : pipeline->Clear()) {
+          FailOperation(write.tag, to_errorcode(slot.GetState()),
+                        "Write not started");
+        }
+        co_return;
+      }
+      CharacteristicRef ref;
+      ref.handle = characteristicHandle;
+      co_await within(bluetoothDeviceAgent.ResolveCharacteristicAsync(ref),
+                      operationTimeouts.DeadlineOf(GattOperation::WriteValue),
+                      GattOperation::WriteValue);
+      gattCharacteristic =
+          bluetoothDeviceAgent.Characteristic(characteristicHandle);
+    }
+    if (!gattCharacteristic) {
+      auto dropped = pipeline->Clear();
+      OutputDebugString((L"DrainWritesAsync: Characteristic not found: #" +
+                         winrt::to_hstring(characteristicHandle) +
+                         L", dropped writes: " +
+                         winrt::to_hstring(dropped.size()) + L"\n")
                             .c_str());
+      for (auto &write : dropped) {
+        FailOperation(write.tag, "IllegalArgument", "Invalid characteristic");
+      }
       co_return;
     }
+    DrainWrites(pipeline, gattCharacteristic, bluetoothDeviceAgent.scheduler);
+  } catch (const GattTimeout &ex) {
+    auto dropped = pipeline->Clear();
+    OutputDebugString((L"DrainWritesAsync: " + winrt::to_hstring(ex.what()) +
+                       L", dropped writes: " +
+                       winrt::to_hstring(dropped.size()) + L"\n")
+                          .c_str());
+    for (auto &write : dropped) {
+      FailOperation(write.tag, "Timeout", ex.what(), to_timeoutdetails(ex));
+    }
+  } catch (const winrt::hresult_error &ex) {
+    OutputDebugString((L"DrainWritesAsync exception: " + ex.message() +
+                       L", code: " + winrt::to_hstring(ex.code()) + L"\n")
+                          .c_str());
+  } catch (...) {
+    OutputDebugString(L"DrainWritesAsync unknown exception\n");
+  }
+}
 
-    // Prepare write option
-    auto writeOption = bleOutputProperty.compare("withoutResponse") == 0
-                           ? GattWriteOption::WriteWithoutResponse
-                           : GattWriteOption::WriteWithResponse;
-
-    // Create buffer from value
-    auto buffer = from_bytevc(valueCopy);
+// Issues the writes |pipeline| lets through. Each waits for a slot of the
+// device's scheduler on its own, so reads and control requests overtake a
+// long queue of writes.
+void QuickBlueWindowsPlugin::DrainWrites(
+    std::shared_ptr<WritePipeline> pipeline, GattCharacteristic characteristic,
+    std::shared_ptr<GattScheduler> scheduler) {
+  pipeline->Drain([this, &pipeline, &characteristic,
+                   &scheduler](WritePipeline::Write write) {
+    auto deadline = write.deadline;
+    auto queued = std::make_shared<WritePipeline::Write>(std::move(write));
+    auto ticket = scheduler->Submit(
+        GattPriority::BulkWrite, deadline,
+        [this, pipeline, characteristic, scheduler,
+         queued](uint64_t ticketId, GattScheduler::State state) {
+          IssueWrite(pipeline, characteristic, scheduler, ticketId, state,
+                     std::move(*queued));
+        });
+    if (ticket.state != GattScheduler::State::Queued) {
+      IssueWrite(pipeline, characteristic, scheduler, ticket.id, ticket.state,
+                 std::move(*queued));
+      return;
+    }
+    expireAt(scheduler, ticket.id, deadline);
+  });
+}
 
-    OutputDebugString((L"WriteValueAsync: About to write to characteristic: " +
-                       winrt::to_hstring(characteristic) + L"\n")
+// Carries out |write| once the scheduler has decided on it. The write is
+// settled once, by its completion or by its timeout, whichever comes first:
+// that answers the request, frees the scheduler slot and the pipeline
+// window slot, and drains again. On a timeout the write is cancelled, and
+// its completion, if it ever comes, does nothing.
+void QuickBlueWindowsPlugin::IssueWrite(
+    std::shared_ptr<WritePipeline> pipeline, GattCharacteristic characteristic,
+    std::shared_ptr<GattScheduler> scheduler, uint64_t ticketId,
+    GattScheduler::State state, WritePipeline::Write write) {
+  auto requestId = write.tag;
+  if (state != GattScheduler::State::Granted) {
+    FailOperation(requestId, to_errorcode(state), "Write not started");
+    pipeline->Complete(false);
+    DrainWrites(pipeline, characteristic, scheduler);
+    return;
+  }
+  try {
+    auto operation = characteristic.WriteValueWithResultAsync(
+        from_bytevc(write.value),
+        write.withResponse ? GattWriteOption::WriteWithResponse
+                           : GattWriteOption::WriteWithoutResponse);
+    auto race = std::make_shared<TimeoutRace>();
+    auto timeout = ThreadPoolTimer{nullptr};
+    auto deadline =
+        operationTimeouts.DeadlineOf(GattOperation::WriteValue, write.deadline);
+    if (deadline != GattScheduler::kNoDeadline) {
+      timeout = ThreadPoolTimer::CreateTimer(
+          [this, operation, race, pipeline, characteristic, scheduler,
+           ticketId, requestId](ThreadPoolTimer const &) {
+            if (!race->Settle()) {
+              return;
+            }
+            operation.Cancel();
+            scheduler->Release(ticketId);
+            OutputDebugString(L"WriteValueAsync: writeValue timed out\n");
+            FailOperation(requestId, "Timeout", "writeValue timed out",
+                          EncodableMap{{"operation", "writeValue"}});
+            pipeline->Complete(false);
+            DrainWrites(pipeline, characteristic, scheduler);
+          },
+          std::max(std::chrono::duration_cast<TimeSpan>(
+                       deadline - GattScheduler::Clock::now()),
+                   TimeSpan::zero()));
+    }
+    operation.Completed([this, pipeline, characteristic, scheduler, ticketId,
+                         requestId, race, timeout](
+                            IAsyncOperation<GattWriteResult> const &operation,
+                            AsyncStatus status) {
+      if (timeout) {
+        timeout.Cancel();
+      }
+      if (!race->Settle()) {
+        return;
+      }
+      scheduler->Release(ticketId);
+      auto writeResult =
+          status == AsyncStatus::Completed ? operation.GetResults() : nullptr;
+      auto writeStatus = writeResult ? writeResult.Status()
+                                     : GattCommunicationStatus::Unreachable;
+      if (writeStatus == GattCommunicationStatus::Success) {
+        CompleteOperation(requestId);
+      } else {
+        OutputDebugString((L"WriteValueAsync failed with status: " +
+                           winrt::to_hstring((int32_t)writeStatus) + L"\n")
+                              .c_str());
+        FailOperation(requestId, "WriteFailed",
+                      "Write failed with status " +
+                          std::to_string((int32_t)writeStatus),
+                      to_statusdetails(writeStatus,
+                                       writeResult
+                                           ? writeResult.ProtocolError()
+                                           : nullptr));
+      }
+      pipeline->Complete(writeStatus == GattCommunicationStatus::Success);
+      DrainWrites(pipeline, characteristic, scheduler);
+    });
+  } catch (const winrt::hresult_error &ex) {
+    OutputDebugString((L"WriteValueAsync exception: " + ex.message() +
+                       L", code: " + winrt::to_hstring(ex.code()) + L"\n")
                           .c_str());
+    scheduler->Release(ticketId);
+    FailOperation(requestId, "WriteFailed", winrt::to_string(ex.message()));
+    pipeline->Complete(false);
+    DrainWrites(pipeline, characteristic, scheduler);
+  }
+}
 
-    // Write value to characteristic
-    auto writeValueStatus =
-        co_await gattCharacteristic.WriteValueAsync(buffer, writeOption);
+// Writes all of |writes| in one GattReliableWriteTransaction: the device
+// queues the values and applies them together on commit, or none of them.
+// The method call completes once, with the outcome of the commit.
+winrt::fire_and_forget QuickBlueWindowsPlugin::WriteReliableAsync(
+    std::shared_ptr<BluetoothDeviceAgent> deviceAgent,
+    std::vector<std::pair<CharacteristicRef, std::vector<uint8_t>>> writes,
+    GattScheduler::Clock::time_point deadline,
+    std::unique_ptr<flutter::MethodResult<EncodableValue>> result) {
+  auto &bluetoothDeviceAgent = *deviceAgent;
+  try {
+    if (!bluetoothDeviceAgent.IsConnected()) {
+      OutputDebugString(
+          L"WriteReliableAsync: Device is null or disconnected\n");
+      PostError(std::move(result), "IllegalArgument", "Unknown device");
+      co_return;
+    }
+    auto slot = co_await bluetoothDeviceAgent.Schedule(GattPriority::BulkWrite,
+                                                       deadline);
+    if (!slot) {
+      PostError(std::move(result), to_errorcode(slot.GetState()),
+                "Reliable write not started");
+      co_return;
+    }
+    auto writeDeadline =
+        operationTimeouts.DeadlineOf(GattOperation::WriteValue, deadline);
+
+    GattReliableWriteTransaction transaction;
+    for (const auto &write : writes) {
+      const auto &characteristic = write.first;
+      auto characteristicHandle = co_await within(
+          bluetoothDeviceAgent.ResolveCharacteristicAsync(characteristic),
+          writeDeadline, GattOperation::WriteValue);
+      auto gattCharacteristic =
+          bluetoothDeviceAgent.Characteristic(characteristicHandle);
+      if (!gattCharacteristic) {
+        OutputDebugString((L"WriteReliableAsync: Characteristic not found: " +
+                           winrt::to_hstring(to_refstr(characteristic)) +
+                           L"\n")
+                              .c_str());
+        PostError(std::move(result), "IllegalArgument",
+                  "Invalid characteristic " + to_refstr(characteristic));
+        co_return;
+      }
+      transaction.WriteValue(gattCharacteristic, from_bytevc(write.second));
+    }
 
-    OutputDebugString((L"WriteValueAsync: Completed with status: " +
-                       winrt::to_hstring((int32_t)writeValueStatus) + L"\n")
+    auto writeResult =
+        co_await within(transaction.CommitWithResultAsync(), writeDeadline,
+                        GattOperation::WriteValue);
+    if (writeResult.Status() != GattCommunicationStatus::Success) {
+      OutputDebugString((L"WriteReliableAsync failed with status: " +
+                         winrt::to_hstring((int32_t)writeResult.Status()) +
+                         L"\n")
+                            .c_str());
+      PostError(
+          std::move(result), "WriteFailed",
+          "Reliable write failed with status " +
+              std::to_string((int32_t)writeResult.Status()),
+          to_statusdetails(writeResult.Status(), writeResult.ProtocolError()));
+      co_return;
+    }
+    PostSuccess(std::move(result));
+  } catch (const GattTimeout &ex) {
+    OutputDebugString((L"WriteReliableAsync: " + winrt::to_hstring(ex.what()) +
+                       L"\n")
                           .c_str());
+    PostError(std::move(result), "Timeout", ex.what(), to_timeoutdetails(ex));
+  } catch (const winrt::hresult_error &ex) {
+    OutputDebugString((L"WriteReliableAsync exception: " + ex.message() +
+                       L", code: " + winrt::to_hstring(ex.code()) + L"\n")
+                          .c_str());
+    PostError(std::move(result), "WriteFailed", winrt::to_string(ex.message()));
+  } catch (const std::exception &ex) {
+    OutputDebugString((L"WriteReliableAsync std exception: " +
+                       winrt::to_hstring(ex.what()) + L"\n")
+                          .c_str());
+    PostError(std::move(result), "WriteFailed", ex.what());
+  } catch (...) {
+    OutputDebugString(L"WriteReliableAsync unknown exception\n");
+    PostError(std::move(result), "WriteFailed", "Unknown exception");
+  }
+}
 
-    // Notify the caller of the write status
-    if (writeValueStatus != GattCommunicationStatus::Success) {
-      OutputDebugString((L"WriteValueAsync failed with status: " +
-                         winrt::to_hstring((int32_t)writeValueStatus) + L"\n")
+// Writes |stream| in chunks of the ATT MTU less the write header, keeping up
+// to |window| chunks in flight. Chunks are issued in order from this one
+// coroutine. Progress is reported at most once per interval and when done;
+// the method call completes once, after the last chunk or the first failed
+// one. Writes queued by writeValue to the same characteristic are not
+// ordered against the chunks. Each chunk takes a slot of the device's
+// scheduler, so more urgent operations get in between chunks.
+winrt::fire_and_forget QuickBlueWindowsPlugin::WriteStreamAsync(
+    std::shared_ptr<BluetoothDeviceAgent> deviceAgent,
+    CharacteristicRef characteristic, StreamWrite stream,
+    std::unique_ptr<flutter::MethodResult<EncodableValue>> result) {
+  auto &bluetoothDeviceAgent = *deviceAgent;
+  try {
+    if (!bluetoothDeviceAgent.IsConnected()) {
+      OutputDebugString(L"WriteStreamAsync: Device is null or disconnected\n");
+      PostError(std::move(result), "IllegalArgument", "Unknown device");
+      co_return;
+    }
+    auto deviceAddress = bluetoothDeviceAgent.device.BluetoothAddress();
+    auto scheduler = bluetoothDeviceAgent.scheduler;
+    auto setupDeadline = operationTimeouts.DeadlineOf(GattOperation::WriteValue,
+                                                      stream.deadline);
+    // The session and characteristic are set up as one control operation,
+    // ahead of queued writes
+    auto setupSlot = co_await bluetoothDeviceAgent.Schedule(
+        GattPriority::Control, stream.deadline);
+    if (!setupSlot) {
+      PostError(std::move(result), to_errorcode(setupSlot.GetState()),
+                "Write not started");
+      co_return;
+    }
+    auto gattSession = co_await within(
+        GattSession::FromDeviceIdAsync(
+            bluetoothDeviceAgent.device.BluetoothDeviceId()),
+        setupDeadline, GattOperation::WriteValue);
+    auto characteristicHandle = co_await within(
+        bluetoothDeviceAgent.ResolveCharacteristicAsync(characteristic),
+        setupDeadline, GattOperation::WriteValue);
+    auto gattCharacteristic =
+        bluetoothDeviceAgent.Characteristic(characteristicHandle);
+    if (!gattCharacteristic) {
+      OutputDebugString((L"WriteStreamAsync: Characteristic not found: " +
+                         winrt::to_hstring(to_refstr(characteristic)) + L"\n")
                             .c_str());
+      PostError(std::move(result), "IllegalArgument", "Invalid characteristic");
+      co_return;
+    }
+
+    // A Write Request or Write Command spends 3 bytes of the PDU on the
+    // opcode and attribute handle. 23 is the default ATT MTU.
+    size_t maxPduSize = gattSession ? gattSession.MaxPduSize() : 23;
+    setupSlot.Release();
+    auto chunkSize = std::max<size_t>(maxPduSize, 23) - 3;
+    if (stream.maxChunkSize > 0) {
+      chunkSize = std::min(chunkSize, stream.maxChunkSize);
+    }
+    auto writeOption = stream.withResponse
+                           ? GattWriteOption::WriteWithResponse
+                           : GattWriteOption::WriteWithoutResponse;
+
+    auto total = stream.value.size();
+    auto sendProgress = [&](size_t written) {
+      SendConnectorMessage(
+          EncodableMap{
+              {"deviceId", std::to_string(deviceAddress)},
+              {"writeStreamProgress",
+               EncodableMap{
+                   {"transferId", stream.transferId},
+                   {"bytesWritten", (int64_t)written},
+                   {"totalBytes", (int64_t)total},
+               }},
+          },
+          true);
+    };
+
+    // A chunk in flight, the offset it ends at and when it times out. Its
+    // slot is held by the operation until the write completes, so a chunk
+    // left behind by a failure or timeout keeps it while still running.
+    struct Chunk {
+      IAsyncOperation<GattCommunicationStatus> operation;
+      size_t end;
+      GattScheduler::Clock::time_point deadline;
+    };
+    std::deque<Chunk> inFlight;
+    // Stops the chunks after a failed or timed out one
+    auto cancelInFlight = [&inFlight]() {
+      for (auto &chunk : inFlight) {
+        chunk.operation.Cancel();
+      }
+    };
+    size_t offset = 0;
+    size_t written = 0;
+    size_t chunks = 0;
+    auto started = std::chrono::steady_clock::now();
+    auto lastProgress = started;
+    while (offset < total || !inFlight.empty()) {
+      if (offset < total && inFlight.size() < stream.window) {
+        // Only wait for a slot while holding none, so that transfers cannot
+        // deadlock holding slots the other needs
+        GattScheduler::Slot slot;
+        if (inFlight.empty()) {
+          slot = co_await GattSlotAwaiter{scheduler, GattPriority::BulkWrite,
+                                          stream.deadline};
+          if (!slot) {
+            PostError(std::move(result), to_errorcode(slot.GetState()),
+                      "Write stopped at byte " + std::to_string(written));
+            co_return;
+          }
+        } else {
+          slot = scheduler->TryAcquire();
+        }
+        if (slot) {
+          auto size = std::min(chunkSize, total - offset);
+          inFlight.push_back(Chunk{
+              holding(std::move(slot),
+                      gattCharacteristic.WriteValueAsync(
+                          from_bytes(stream.value.data() + offset, size),
+                          writeOption)),
+              offset + size,
+              operationTimeouts.DeadlineOf(GattOperation::WriteValue)});
+          offset += size;
+          chunks++;
+          continue;
+        }
+      }
+      GattCommunicationStatus status;
+      try {
+        status = co_await within(inFlight.front().operation,
+                                 inFlight.front().deadline,
+                                 GattOperation::WriteValue);
+      } catch (...) {
+        cancelInFlight();
+        throw;
+      }
+      if (status != GattCommunicationStatus::Success) {
+        inFlight.pop_front();
+        cancelInFlight();
+        OutputDebugString((L"WriteStreamAsync failed at byte " +
+                           winrt::to_hstring(written) + L" with status: " +
+                           winrt::to_hstring((int32_t)status) + L"\n")
+                              .c_str());
+        PostError(std::move(result), "WriteFailed",
+                  "Write failed at byte " + std::to_string(written) +
+                      " with status " + std::to_string((int32_t)status));
+        co_return;
+      }
+      written = inFlight.front().end;
+      inFlight.pop_front();
+      auto now = std::chrono::steady_clock::now();
+      if (now - lastProgress >= stream.progressInterval) {
+        lastProgress = now;
+        sendProgress(written);
+      }
     }
+    sendProgress(total);
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - started);
+    PostSuccess(std::move(result),
+                EncodableMap{
+                    {"bytesWritten", (int64_t)total},
+                    {"chunks", (int64_t)chunks},
+                    {"chunkSize", (int64_t)chunkSize},
+                    {"elapsedUs", (int64_t)elapsed.count()},
+                });
+  } catch (const GattTimeout &ex) {
+    OutputDebugString(
+        (L"WriteStreamAsync: " + winrt::to_hstring(ex.what()) + L"\n").c_str());
+    PostError(std::move(result), "Timeout", ex.what(), to_timeoutdetails(ex));
   } catch (const winrt::hresult_error &ex) {
-    OutputDebugString((L"WriteValueAsync exception: " + ex.message() +
+    OutputDebugString((L"WriteStreamAsync exception: " + ex.message() +
                        L", code: " + winrt::to_hstring(ex.code()) + L"\n")
                           .c_str());
+    PostError(std::move(result), "WriteFailed", winrt::to_string(ex.message()));
   } catch (const std::exception &ex) {
-    OutputDebugString((L"WriteValueAsync std exception: " +
+    OutputDebugString((L"WriteStreamAsync std exception: " +
                        winrt::to_hstring(ex.what()) + L"\n")
                           .c_str());
+    PostError(std::move(result), "WriteFailed", ex.what());
   } catch (...) {
-    OutputDebugString(L"WriteValueAsync unknown exception\n");
+    OutputDebugString(L"WriteStreamAsync unknown exception\n");
+    PostError(std::move(result), "WriteFailed", "Unknown exception");
   }
 }
 
 void QuickBlueWindowsPlugin::GattCharacteristic_ValueChanged(
-    GattCharacteristic sender, GattValueChangedEventArgs args) {
+    uint64_t deviceAddress, uint64_t deviceHandle,
+    uint32_t characteristicHandle, GattCharacteristic sender,
+    GattValueChangedEventArgs args) {
   try {
     if (!sender) {
       OutputDebugString(L"GattCharacteristic_ValueChanged: Sender is null\n");
@@ -1059,13 +3810,6 @@ void QuickBlueWindowsPlugin::GattCharacteristic_ValueChanged(
       return;
     }
 
-    auto uuid = to_uuidstr(sender.Uuid());
-
-    OutputDebugString(
-        (L"GattCharacteristic_ValueChanged: Event for characteristic: " +
-         winrt::to_hstring(uuid) + L"\n")
-            .c_str());
-
     // Get the value from the arguments
     auto value = args.CharacteristicValue();
     if (!value) {
@@ -1074,48 +3818,101 @@ void QuickBlueWindowsPlugin::GattCharacteristic_ValueChanged(
       return;
     }
 
-    auto bytes = to_bytevc(value);
-
-    // Get device address
-    uint64_t deviceAddress = 0;
-    try {
-      auto service = sender.Service();
-      if (!service) {
-        OutputDebugString(
-            L"GattCharacteristic_ValueChanged: Service is null\n");
-        return;
+    auto length = (size_t)value.Length();
+    notificationsReceived.fetch_add(1, std::memory_order_relaxed);
+    notificationBytesReceived.fetch_add(length, std::memory_order_relaxed);
+
+    std::shared_ptr<NotificationBatching> batching;
+    bool binary;
+    {
+      std::lock_guard<std::mutex> lock(notificationOptionsMutex);
+      auto it = notificationBatching.find(deviceAddress);
+      if (it != notificationBatching.end()) {
+        batching = it->second;
       }
-
-      auto device = service.Device();
-      if (!device) {
-        OutputDebugString(L"GattCharacteristic_ValueChanged: Device is null\n");
-        return;
+      binary = binaryNotificationDevices.count(deviceAddress) > 0;
+      auto pending = pendingFirstNotification.find(deviceAddress);
+      if (pending != pendingFirstNotification.end()) {
+        auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() -
+            pending->second.connectStarted);
+        (pending->second.warm ? firstNotificationLatencyWarmUs
+                              : firstNotificationLatencyColdUs)
+            .store(latency.count());
+        pendingFirstNotification.erase(pending);
       }
-
-      deviceAddress = device.BluetoothAddress();
-    } catch (const std::exception &ex) {
-      OutputDebugString(
-          (L"GattCharacteristic_ValueChanged: Error getting device address: " +
-           winrt::to_hstring(ex.what()) + L"\n")
-              .c_str());
+    }
+    auto timestampUs =
+        (int64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+            winrt::clock::to_sys(args.Timestamp()).time_since_epoch())
+            .count();
+
+    if (binary && !NotificationFrame::Fits(characteristicHandle, length)) {
+      // The length cannot exceed a frame with ATT's 512 byte limit, but the
+      // handle can once refreshes grew the handle table. A frame must cut
+      // neither short: the value goes out as a regular message.
+      notificationsOversized.fetch_add(1, std::memory_order_relaxed);
+      binary = false;
+    }
+    if (binary) {
+      // The payload is read in place and copied once, into the frame.
+      auto frame = NotificationFrame{
+          deviceHandle,
+          (uint16_t)characteristicHandle,
+          timestampUs,
+          buffer_data(value),
+          (uint16_t)length,
+      };
+      auto message = notificationBuffers.Acquire(frame.EncodedSize());
+      frame.WriteTo(message.data());
+      outbound.Post(
+          [this, message = std::move(message)]() mutable {
+            messenger->Send(kBinaryNotificationChannel, message.data(),
+                            message.size());
+            notificationBuffers.Release(std::move(message));
+          },
+          true);
       return;
     }
 
-    OutputDebugString((L"GattCharacteristic_ValueChanged: Received " +
-                       winrt::to_hstring(bytes.size()) +
-                       L" bytes from device " +
-                       winrt::to_hstring(deviceAddress) + L"\n")
-                          .c_str());
+    auto bytes = to_bytevc(value, notificationBuffers);
+    if (batching) {
+      // Built without an initializer list, which would copy the payload.
+      EncodableList entry;
+      entry.reserve(3);
+      entry.emplace_back((int64_t)characteristicHandle);
+      entry.emplace_back(timestampUs);
+      entry.emplace_back(std::move(bytes));
+      auto batch = batching->batcher.Add(std::move(entry));
+      if (!batch.empty()) {
+        SendNotificationBatch(deviceAddress, std::move(batch));
+      }
+      return;
+    }
 
-    // Send the value back to Dart
-    message_connector_->Send(EncodableMap{
-        {"deviceId", std::to_string(deviceAddress)},
-        {"characteristicValue",
-         EncodableMap{
-             {"characteristic", uuid},
-             {"value", bytes},
-         }},
-    });
+    // Send the value back to Dart. The message is assembled by moving, as
+    // initializer lists would copy the payload, and its storage is returned
+    // to the pool once sent from the platform thread.
+    EncodableMap characteristicValue;
+    characteristicValue[EncodableValue("characteristicHandle")] =
+        EncodableValue((int64_t)characteristicHandle);
+    characteristicValue[EncodableValue("value")] =
+        EncodableValue(std::move(bytes));
+    EncodableMap fields;
+    fields[EncodableValue("deviceId")] =
+        EncodableValue(std::to_string(deviceAddress));
+    fields[EncodableValue("characteristicValue")] =
+        EncodableValue(std::move(characteristicValue));
+    outbound.Post(
+        [this, message = EncodableValue(std::move(fields))]() mutable {
+          message_connector_->Send(message);
+          auto &sent = std::get<EncodableMap>(std::get<EncodableMap>(
+              message)[EncodableValue("characteristicValue")]);
+          auto &sentValue = sent[EncodableValue("value")];
+          notificationBuffers.Release(
+              std::move(std::get<std::vector<uint8_t>>(sentValue)));
+        },
+        true);
   } catch (const winrt::hresult_error &ex) {
     OutputDebugString((L"GattCharacteristic_ValueChanged exception: " +
                        ex.message() + L", code: " +
@@ -1130,6 +3927,55 @@ void QuickBlueWindowsPlugin::GattCharacteristic_ValueChanged(
   }
 }
 
+void QuickBlueWindowsPlugin::SetNotificationBatching(uint64_t bluetoothAddress,
+                                                     int64_t intervalMs,
+                                                     size_t maxEntries) {
+  std::shared_ptr<NotificationBatching> previous;
+  {
+    std::lock_guard<std::mutex> lock(notificationOptionsMutex);
+    auto it = notificationBatching.find(bluetoothAddress);
+    if (it != notificationBatching.end()) {
+      previous = it->second;
+      notificationBatching.erase(it);
+    }
+    if (intervalMs > 0) {
+      auto batching = std::make_shared<NotificationBatching>(maxEntries);
+      batching->flushTimer = ThreadPoolTimer::CreatePeriodicTimer(
+          [this, bluetoothAddress, guard = timerGuard,
+           weak = std::weak_ptr<NotificationBatching>(batching)](
+              ThreadPoolTimer const &) {
+            auto scope = guard->Enter();
+            if (!scope) {
+              return;
+            }
+            if (auto batching = weak.lock()) {
+              SendNotificationBatch(bluetoothAddress,
+                                    batching->batcher.Drain());
+            }
+          },
+          std::chrono::milliseconds(intervalMs));
+      notificationBatching.insert({bluetoothAddress, batching});
+    }
+  }
+  if (previous) {
+    previous->flushTimer.Cancel();
+    SendNotificationBatch(bluetoothAddress, previous->batcher.Drain());
+  }
+}
+
+void QuickBlueWindowsPlugin::SendNotificationBatch(
+    uint64_t bluetoothAddress, std::vector<EncodableValue> batch) {
+  if (batch.empty()) {
+    return;
+  }
+  SendConnectorMessage(
+      EncodableMap{
+          {"deviceId", std::to_string(bluetoothAddress)},
+          {"characteristicValues", EncodableList(std::move(batch))},
+      },
+      true);
+}
+
 extern "C" __declspec(dllexport) void QuickBlueWindowsPluginRegisterWithRegistrar(
     FlutterDesktopPluginRegistrarRef registrar) {
   QuickBlueWindowsPlugin::RegisterWithRegistrar(
@@ -0,0 +1,157 @@
+#ifndef QUICK_BLUE_WINDOWS_SCAN_DEVICE_TABLE_H_
+#define QUICK_BLUE_WINDOWS_SCAN_DEVICE_TABLE_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+namespace quick_blue {
+
+// Per-address cache of device names seen while scanning. Opening a device to
+// read its name is expensive, so every address is resolved at most once per
+// TTL and later advertisements are answered from the table. The table never
+// grows beyond |capacity|; while it is full of resolves in flight, new
+// addresses are refused instead of resolved.
+class ScanDeviceTable {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  enum class NameStatus {
+    // |name| holds the cached result of a previous resolve.
+    kCached,
+    // The caller has to resolve the name and report it with StoreName.
+    kResolve,
+    // Another caller is resolving; |name| holds a stale result, if any.
+    kPending,
+    // The table is full of resolves in flight, so none is started. The caller
+    // should fall back to the advertised name.
+    kFull,
+  };
+
+  struct NameLookup {
+    NameStatus status;
+    // Empty if the device had no name of its own.
+    std::optional<std::string> name;
+  };
+
+  explicit ScanDeviceTable(Clock::duration nameTtl = std::chrono::minutes(5),
+                           size_t capacity = 1024)
+      : nameTtl(nameTtl), capacity(capacity) {}
+
+  NameLookup LookupName(uint64_t address, Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(address);
+    if (it != entries.end()) {
+      auto &entry = it->second;
+      if (entry.resolved && now - entry.resolvedAt < nameTtl) {
+        ++lookupsAvoided;
+        return {NameStatus::kCached, entry.name};
+      }
+      if (entry.pending) {
+        ++lookupsAvoided;
+        return {NameStatus::kPending, entry.name};
+      }
+    } else {
+      if (entries.size() >= capacity) {
+        EvictLocked(now);
+      }
+      if (entries.size() >= capacity) {
+        ++lookupsRefused;
+        return {NameStatus::kFull, std::nullopt};
+      }
+      it = entries.emplace(address, Entry{}).first;
+    }
+    it->second.pending = true;
+    ++lookupsIssued;
+    return {NameStatus::kResolve, it->second.name};
+  }
+
+  // Completes a resolve started by a kResolve lookup. Results for entries
+  // dropped by Clear() in the meantime are discarded.
+  void StoreName(uint64_t address, std::optional<std::string> name,
+                 Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(address);
+    if (it == entries.end()) {
+      return;
+    }
+    auto &entry = it->second;
+    entry.name = std::move(name);
+    entry.resolved = true;
+    entry.pending = false;
+    entry.resolvedAt = now;
+  }
+
+  void Clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+  }
+
+  size_t Size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+  }
+
+  uint64_t LookupsAvoided() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return lookupsAvoided;
+  }
+
+  uint64_t LookupsIssued() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return lookupsIssued;
+  }
+
+  // Number of lookups answered with kFull.
+  uint64_t LookupsRefused() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return lookupsRefused;
+  }
+
+private:
+  struct Entry {
+    std::optional<std::string> name;
+    bool resolved = false;
+    bool pending = false;
+    Clock::time_point resolvedAt;
+  };
+
+  // Drops expired entries, or the oldest resolved one if none has expired.
+  // Pending entries are kept so their resolve can still be stored.
+  void EvictLocked(Clock::time_point now) {
+    auto oldest = entries.end();
+    for (auto it = entries.begin(); it != entries.end();) {
+      auto &entry = it->second;
+      if (!entry.pending && now - entry.resolvedAt >= nameTtl) {
+        it = entries.erase(it);
+        continue;
+      }
+      if (!entry.pending &&
+          (oldest == entries.end() ||
+           entry.resolvedAt < oldest->second.resolvedAt)) {
+        oldest = it;
+      }
+      ++it;
+    }
+    if (entries.size() >= capacity && oldest != entries.end()) {
+      entries.erase(oldest);
+    }
+  }
+
+  Clock::duration nameTtl;
+  size_t capacity;
+
+  mutable std::mutex mutex;
+  std::unordered_map<uint64_t, Entry> entries;
+  uint64_t lookupsAvoided = 0;
+  uint64_t lookupsIssued = 0;
+  uint64_t lookupsRefused = 0;
+};
+
+} // namespace quick_blue
+
+#endif // QUICK_BLUE_WINDOWS_SCAN_DEVICE_TABLE_H_
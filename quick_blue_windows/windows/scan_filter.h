@@ -0,0 +1,64 @@
+#ifndef QUICK_BLUE_WINDOWS_SCAN_FILTER_H_
+#define QUICK_BLUE_WINDOWS_SCAN_FILTER_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "advertisement_source.h"
+#include "ble_uuid.h"
+
+namespace quick_blue {
+
+// Predicate chain applied to advertisements before they are forwarded.
+// Every configured criterion has to match; within a criterion any of the
+// listed values is enough. An empty filter accepts everything.
+struct ScanFilter {
+  std::vector<BleUuid> serviceUuids;
+  std::vector<uint16_t> companyIds;
+  std::optional<int16_t> minRssi;
+  std::vector<std::string> namePrefixes;
+
+  bool IsEmpty() const {
+    return serviceUuids.empty() && companyIds.empty() && !minRssi &&
+           namePrefixes.empty();
+  }
+
+  // Checks everything except the name, which may only be known after the
+  // device has been resolved.
+  bool MatchesAdvertisement(const Advertisement &advertisement) const {
+    if (minRssi && advertisement.rssi < *minRssi) {
+      return false;
+    }
+    const auto &data = advertisement.data;
+    if (!companyIds.empty() &&
+        std::none_of(companyIds.begin(), companyIds.end(),
+                     [&data](uint16_t id) { return data.HasCompanyId(id); })) {
+      return false;
+    }
+    if (!serviceUuids.empty() &&
+        std::none_of(serviceUuids.begin(), serviceUuids.end(),
+                     [&data](const BleUuid &uuid) {
+                       return data.HasServiceUuid(uuid);
+                     })) {
+      return false;
+    }
+    return true;
+  }
+
+  bool MatchesName(const std::string &name) const {
+    if (namePrefixes.empty()) {
+      return true;
+    }
+    return std::any_of(namePrefixes.begin(), namePrefixes.end(),
+                       [&name](const std::string &prefix) {
+                         return name.compare(0, prefix.size(), prefix) == 0;
+                       });
+  }
+};
+
+} // namespace quick_blue
+
+#endif // QUICK_BLUE_WINDOWS_SCAN_FILTER_H_
@@ -0,0 +1,76 @@
+// Parse cost of a legacy 31-byte advertisement and of a large extended one.
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "advertisement_parser.h"
+#include "test_support.h"
+
+using quick_blue::ParsedAdvertisement;
+using quick_blue::test::Clock;
+
+namespace {
+
+using Blob = std::vector<uint8_t>;
+
+void AddStructure(Blob &blob, uint8_t type, const Blob &data) {
+  blob.push_back(uint8_t(data.size() + 1));
+  blob.push_back(type);
+  blob.insert(blob.end(), data.begin(), data.end());
+}
+
+// iBeacon: flags and one manufacturer section, 30 bytes.
+Blob LegacyBlob() {
+  Blob blob;
+  AddStructure(blob, ParsedAdvertisement::kFlags, {0x06});
+  Blob beacon{0x4C, 0x00, 0x02, 0x15};
+  beacon.resize(25, 0x11);
+  AddStructure(blob, ParsedAdvertisement::kManufacturerSpecificData, beacon);
+  return blob;
+}
+
+// Extended advertisement with a name, services and several data sections.
+Blob ExtendedBlob() {
+  Blob blob;
+  AddStructure(blob, ParsedAdvertisement::kFlags, {0x06});
+  AddStructure(blob, ParsedAdvertisement::kCompleteLocalName,
+               Blob(24, 'n'));
+  AddStructure(blob, ParsedAdvertisement::kComplete16BitUuids,
+               {0x0D, 0x18, 0x0F, 0x18, 0x0A, 0x18});
+  AddStructure(blob, ParsedAdvertisement::kComplete128BitUuids,
+               Blob(16, 0x42));
+  for (uint8_t i = 0; i < 3; ++i) {
+    Blob data{i, 0x00};
+    data.resize(60, i);
+    AddStructure(blob, ParsedAdvertisement::kManufacturerSpecificData, data);
+  }
+  AddStructure(blob, ParsedAdvertisement::kServiceData16BitUuid,
+               Blob(40, 0x0F));
+  return blob;
+}
+
+void Measure(const char *label, const Blob &blob, int iterations) {
+  ParsedAdvertisement parsed;
+  // Keeps the parse from being optimized away.
+  volatile uint64_t sink = 0;
+  auto start = Clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    parsed.Parse(blob.data(), blob.size());
+    sink = sink + parsed.PayloadHash();
+  }
+  auto seconds = quick_blue::test::SecondsSince(start);
+  std::printf("%-9s %4zu bytes %8.1f ns/parse %8.1f MB/s\n", label,
+              blob.size(), seconds * 1e9 / iterations,
+              blob.size() * double(iterations) / seconds / 1e6);
+  CHECK_EQ(parsed.Truncated(), 0u);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  int iterations = quick_blue::test::QuickRun(argc, argv) ? 10000 : 5000000;
+  Measure("legacy", LegacyBlob(), iterations);
+  Measure("extended", ExtendedBlob(), iterations);
+  return quick_blue::test::Result();
+}
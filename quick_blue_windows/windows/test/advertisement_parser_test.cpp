@@ -0,0 +1,245 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "advertisement_parser.h"
+#include "ble_uuid.h"
+#include "test_support.h"
+
+using quick_blue::BleUuid;
+using quick_blue::ParsedAdvertisement;
+using quick_blue::test::Random;
+
+namespace {
+
+using Blob = std::vector<uint8_t>;
+
+void AddStructure(Blob &blob, uint8_t type, const Blob &data) {
+  blob.push_back(uint8_t(data.size() + 1));
+  blob.push_back(type);
+  blob.insert(blob.end(), data.begin(), data.end());
+}
+
+Blob Bytes(const std::string &text) { return Blob(text.begin(), text.end()); }
+
+// Heart rate sensor with two manufacturer sections, a 128-bit service and
+// service data, the fields the scan message carries.
+Blob SampleBlob() {
+  Blob blob;
+  AddStructure(blob, ParsedAdvertisement::kFlags, {0x06});
+  AddStructure(blob, ParsedAdvertisement::kShortenedLocalName, Bytes("HR"));
+  AddStructure(blob, ParsedAdvertisement::kCompleteLocalName,
+               Bytes("HR Sensor"));
+  AddStructure(blob, ParsedAdvertisement::kComplete16BitUuids,
+               {0x0D, 0x18, 0x0F, 0x18});
+  Blob uuid128(16);
+  for (uint8_t i = 0; i < 16; ++i) {
+    uuid128[i] = i;
+  }
+  AddStructure(blob, ParsedAdvertisement::kComplete128BitUuids, uuid128);
+  AddStructure(blob, ParsedAdvertisement::kTxPowerLevel, {0xF4});
+  AddStructure(blob, ParsedAdvertisement::kServiceData16BitUuid,
+               {0x0F, 0x18, 0x5A});
+  AddStructure(blob, ParsedAdvertisement::kManufacturerSpecificData,
+               {0x4C, 0x00, 0x02, 0x15});
+  AddStructure(blob, ParsedAdvertisement::kManufacturerSpecificData,
+               {0x59, 0x00, 0xAA});
+  return blob;
+}
+
+void DecodesAllFields() {
+  auto blob = SampleBlob();
+  ParsedAdvertisement parsed;
+  CHECK(parsed.Parse(blob.data(), blob.size()));
+
+  CHECK(parsed.HasFlags());
+  CHECK_EQ(parsed.Flags(), 0x06);
+  CHECK(parsed.HasTxPower());
+  CHECK_EQ(parsed.TxPower(), -12);
+  // The complete name wins over the shortened one.
+  CHECK(parsed.LocalName() == "HR Sensor");
+
+  CHECK_EQ(parsed.ServiceUuidCount(), 3u);
+  CHECK(parsed.ServiceUuidAt(0) == BleUuid::FromShort(0x180D));
+  CHECK(parsed.ServiceUuidAt(1) == BleUuid::FromShort(0x180F));
+  CHECK(parsed.HasServiceUuid(BleUuid::FromShort(0x180F)));
+  CHECK(!parsed.HasServiceUuid(BleUuid::FromShort(0x1810)));
+
+  CHECK_EQ(parsed.ServiceDataCount(), 1u);
+  CHECK(parsed.ServiceDataAt(0).uuid == BleUuid::FromShort(0x180F));
+  auto serviceData = parsed.ServiceDataBytes(0);
+  CHECK_EQ(serviceData.size, 1u);
+  CHECK_EQ(serviceData.data[0], 0x5A);
+
+  CHECK_EQ(parsed.ManufacturerDataCount(), 2u);
+  CHECK_EQ(parsed.ManufacturerDataAt(0).companyId, 0x004C);
+  CHECK_EQ(parsed.ManufacturerDataAt(1).companyId, 0x0059);
+  CHECK(parsed.HasCompanyId(0x0059));
+  auto section = parsed.ManufacturerSection(0);
+  CHECK(Blob(section.data, section.data + section.size) ==
+        Blob({0x4C, 0x00, 0x02, 0x15}));
+  CHECK_EQ(parsed.Truncated(), 0u);
+}
+
+// Parsing a blob and re-parsing its stored payload, or rebuilding it with
+// Append, gives the same bytes and fingerprint.
+void RoundTrips() {
+  auto blob = SampleBlob();
+  ParsedAdvertisement parsed;
+  CHECK(parsed.Parse(blob.data(), blob.size()));
+  auto payload = parsed.Payload();
+  CHECK(Blob(payload.data, payload.data + payload.size) == blob);
+
+  ParsedAdvertisement reparsed;
+  CHECK(reparsed.Parse(payload.data, payload.size));
+  CHECK_EQ(reparsed.PayloadHash(), parsed.PayloadHash());
+
+  ParsedAdvertisement appended;
+  for (size_t position = 0; position < blob.size();
+       position += 1 + blob[position]) {
+    CHECK(appended.Append(blob[position + 1], blob.data() + position + 2,
+                          blob[position] - 1));
+  }
+  auto appendedPayload = appended.Payload();
+  CHECK(Blob(appendedPayload.data,
+             appendedPayload.data + appendedPayload.size) == blob);
+  CHECK_EQ(appended.PayloadHash(), parsed.PayloadHash());
+}
+
+void HashIgnoresNameAndRssiFields() {
+  Blob a;
+  AddStructure(a, ParsedAdvertisement::kCompleteLocalName, Bytes("A"));
+  AddStructure(a, ParsedAdvertisement::kManufacturerSpecificData,
+               {0x4C, 0x00, 0x01});
+  Blob b;
+  AddStructure(b, ParsedAdvertisement::kCompleteLocalName, Bytes("B"));
+  AddStructure(b, ParsedAdvertisement::kManufacturerSpecificData,
+               {0x4C, 0x00, 0x01});
+  Blob c;
+  AddStructure(c, ParsedAdvertisement::kManufacturerSpecificData,
+               {0x4C, 0x00, 0x02});
+
+  ParsedAdvertisement pa, pb, pc;
+  pa.Parse(a.data(), a.size());
+  pb.Parse(b.data(), b.size());
+  pc.Parse(c.data(), c.size());
+  CHECK_EQ(pa.PayloadHash(), pb.PayloadHash());
+  CHECK(pa.PayloadHash() != pc.PayloadHash());
+}
+
+void CountsTruncatedEntries() {
+  Blob blob;
+  for (uint8_t i = 0; i < 6; ++i) {
+    AddStructure(blob, ParsedAdvertisement::kManufacturerSpecificData,
+                 {i, 0x00, 0x01});
+  }
+  ParsedAdvertisement parsed;
+  CHECK(parsed.Parse(blob.data(), blob.size()));
+  CHECK_EQ(parsed.ManufacturerDataCount(),
+           ParsedAdvertisement::kMaxManufacturerData);
+  CHECK_EQ(parsed.Truncated(), 6 - ParsedAdvertisement::kMaxManufacturerData);
+}
+
+void RejectsMalformedBlobs() {
+  ParsedAdvertisement parsed;
+  // Length runs past the end.
+  Blob overrun{0x05, ParsedAdvertisement::kFlags, 0x06};
+  CHECK(!parsed.Parse(overrun.data(), overrun.size()));
+
+  // A zero length ends the significant part; the padding is ignored.
+  Blob padded;
+  AddStructure(padded, ParsedAdvertisement::kFlags, {0x06});
+  padded.insert(padded.end(), {0x00, 0xFF, 0xFF});
+  CHECK(parsed.Parse(padded.data(), padded.size()));
+  CHECK(parsed.HasFlags());
+
+  // Extended advertisements larger than the inline buffer are cut off.
+  Blob large;
+  while (large.size() < ParsedAdvertisement::kMaxPayload + 100) {
+    AddStructure(large, 0x30, Blob(200, 0xAB));
+  }
+  CHECK(!parsed.Parse(large.data(), large.size()));
+  CHECK(parsed.Payload().size <= ParsedAdvertisement::kMaxPayload);
+  CHECK(parsed.Truncated() > 0);
+}
+
+// Every index handed out has to stay inside the payload buffer.
+void CheckInvariants(const ParsedAdvertisement &parsed) {
+  auto payload = parsed.Payload();
+  CHECK(payload.size <= ParsedAdvertisement::kMaxPayload);
+  auto inside = [&payload](const uint8_t *data, size_t size) {
+    return data >= payload.data && data + size <= payload.data + payload.size;
+  };
+  auto name = parsed.LocalName();
+  CHECK(name.empty() ||
+        inside(reinterpret_cast<const uint8_t *>(name.data()), name.size()));
+  CHECK(parsed.ManufacturerDataCount() <=
+        ParsedAdvertisement::kMaxManufacturerData);
+  for (size_t i = 0; i < parsed.ManufacturerDataCount(); ++i) {
+    auto section = parsed.ManufacturerSection(i);
+    CHECK(section.size >= 2 && inside(section.data, section.size));
+  }
+  CHECK(parsed.ServiceUuidCount() <= ParsedAdvertisement::kMaxServiceUuids);
+  CHECK(parsed.ServiceDataCount() <= ParsedAdvertisement::kMaxServiceData);
+  for (size_t i = 0; i < parsed.ServiceDataCount(); ++i) {
+    auto data = parsed.ServiceDataBytes(i);
+    CHECK(data.size == 0 || inside(data.data, data.size));
+  }
+}
+
+// Random bytes mostly fail early, so half of the inputs are well-formed
+// structures of the interesting types with random contents and lengths.
+void FuzzesRandomBlobs() {
+  const uint8_t kTypes[] = {
+      ParsedAdvertisement::kFlags,
+      ParsedAdvertisement::kIncomplete16BitUuids,
+      ParsedAdvertisement::kComplete32BitUuids,
+      ParsedAdvertisement::kComplete128BitUuids,
+      ParsedAdvertisement::kShortenedLocalName,
+      ParsedAdvertisement::kCompleteLocalName,
+      ParsedAdvertisement::kTxPowerLevel,
+      ParsedAdvertisement::kServiceData16BitUuid,
+      ParsedAdvertisement::kServiceData32BitUuid,
+      ParsedAdvertisement::kServiceData128BitUuid,
+      ParsedAdvertisement::kManufacturerSpecificData,
+  };
+  Random random(0x5eed);
+  ParsedAdvertisement parsed;
+  for (int iteration = 0; iteration < 100000; ++iteration) {
+    Blob blob;
+    if (iteration % 2 == 0) {
+      blob.resize(random.Below(64));
+      for (auto &byte : blob) {
+        byte = uint8_t(random.Next());
+      }
+    } else {
+      auto structures = random.Below(40);
+      for (uint64_t i = 0; i < structures; ++i) {
+        Blob data(random.Below(40));
+        for (auto &byte : data) {
+          byte = uint8_t(random.Next());
+        }
+        AddStructure(blob, kTypes[random.Below(sizeof(kTypes))], data);
+      }
+      // Occasionally corrupt one length byte.
+      if (!blob.empty() && random.Below(4) == 0) {
+        blob[random.Below(blob.size())] = uint8_t(random.Next());
+      }
+    }
+    parsed.Parse(blob.data(), blob.size());
+    CheckInvariants(parsed);
+  }
+}
+
+} // namespace
+
+int main() {
+  quick_blue::test::Run("DecodesAllFields", DecodesAllFields);
+  quick_blue::test::Run("RoundTrips", RoundTrips);
+  quick_blue::test::Run("HashIgnoresNameAndRssiFields",
+                        HashIgnoresNameAndRssiFields);
+  quick_blue::test::Run("CountsTruncatedEntries", CountsTruncatedEntries);
+  quick_blue::test::Run("RejectsMalformedBlobs", RejectsMalformedBlobs);
+  quick_blue::test::Run("FuzzesRandomBlobs", FuzzesRandomBlobs);
+  return quick_blue::test::Result();
+}
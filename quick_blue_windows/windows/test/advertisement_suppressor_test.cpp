@@ -0,0 +1,164 @@
+#include <chrono>
+#include <cstdint>
+
+#include "advertisement_suppressor.h"
+#include "test_support.h"
+
+using quick_blue::AdvertisementSuppressor;
+using Options = AdvertisementSuppressor::Options;
+
+namespace {
+
+const auto kStart =
+    AdvertisementSuppressor::Clock::time_point{} + std::chrono::hours(1);
+
+AdvertisementSuppressor::Clock::time_point At(int milliseconds) {
+  return kStart + std::chrono::milliseconds(milliseconds);
+}
+
+// Heartbeat and TTL far off unless a test is about them.
+Options Quiet() {
+  Options options;
+  options.heartbeat = std::chrono::hours(1);
+  options.ttl = std::chrono::hours(2);
+  return options;
+}
+
+void ForwardsFirstSightingAndPayloadChanges() {
+  AdvertisementSuppressor suppressor;
+  suppressor.Configure(Quiet());
+  CHECK(suppressor.ShouldForward(1, 0xAA, -60, At(0)));
+  CHECK(!suppressor.ShouldForward(1, 0xAA, -60, At(10)));
+  CHECK(suppressor.ShouldForward(1, 0xBB, -60, At(20)));
+  CHECK(!suppressor.ShouldForward(1, 0xBB, -60, At(30)));
+  // Other advertisers are tracked on their own.
+  CHECK(suppressor.ShouldForward(2, 0xBB, -60, At(40)));
+  CHECK_EQ(suppressor.Size(), 2u);
+}
+
+void ForwardsRssiMovesOfAtLeastTheDelta() {
+  AdvertisementSuppressor suppressor;
+  auto options = Quiet();
+  suppressor.Configure(options);
+  CHECK(suppressor.ShouldForward(1, 0xAA, -60, At(0)));
+  // Without a delta RSSI alone never forwards.
+  CHECK(!suppressor.ShouldForward(1, 0xAA, -90, At(10)));
+
+  options.rssiDelta = 5;
+  suppressor.Configure(options);
+  CHECK(suppressor.ShouldForward(1, 0xAA, -60, At(20)));
+  CHECK(!suppressor.ShouldForward(1, 0xAA, -64, At(30)));
+  CHECK(!suppressor.ShouldForward(1, 0xAA, -56, At(40)));
+  CHECK(suppressor.ShouldForward(1, 0xAA, -65, At(50)));
+  // The delta is measured from what was last forwarded, -65 now.
+  CHECK(!suppressor.ShouldForward(1, 0xAA, -61, At(60)));
+  CHECK(suppressor.ShouldForward(1, 0xAA, -70, At(70)));
+}
+
+void ForwardsOnTheHeartbeat() {
+  AdvertisementSuppressor suppressor;
+  auto options = Quiet();
+  options.heartbeat = std::chrono::seconds(1);
+  suppressor.Configure(options);
+  CHECK(suppressor.ShouldForward(1, 0xAA, -60, At(0)));
+  CHECK(!suppressor.ShouldForward(1, 0xAA, -60, At(500)));
+  CHECK(!suppressor.ShouldForward(1, 0xAA, -60, At(999)));
+  CHECK(suppressor.ShouldForward(1, 0xAA, -60, At(1000)));
+  // Counted from the last forward, not the last sighting.
+  CHECK(!suppressor.ShouldForward(1, 0xAA, -60, At(1999)));
+  CHECK(suppressor.ShouldForward(1, 0xAA, -60, At(2000)));
+}
+
+// Evicts the least recently seen record, which then counts as new.
+void EvictsLeastRecentlySeenOverCapacity() {
+  AdvertisementSuppressor suppressor;
+  auto options = Quiet();
+  options.capacity = 2;
+  suppressor.Configure(options);
+  CHECK(suppressor.ShouldForward(1, 0xAA, -60, At(0)));
+  CHECK(suppressor.ShouldForward(2, 0xAA, -60, At(10)));
+  // Seeing 1 again makes 2 the oldest, even though 1 is suppressed.
+  CHECK(!suppressor.ShouldForward(1, 0xAA, -60, At(20)));
+  CHECK(suppressor.ShouldForward(3, 0xAA, -60, At(30)));
+  CHECK_EQ(suppressor.Size(), 2u);
+
+  CHECK(!suppressor.ShouldForward(1, 0xAA, -60, At(40)));
+  CHECK(!suppressor.ShouldForward(3, 0xAA, -60, At(50)));
+  CHECK(suppressor.ShouldForward(2, 0xAA, -60, At(60)));
+  CHECK_EQ(suppressor.Size(), 2u);
+}
+
+void DropsRecordsUnseenForTheTtl() {
+  AdvertisementSuppressor suppressor;
+  auto options = Quiet();
+  options.ttl = std::chrono::seconds(10);
+  suppressor.Configure(options);
+  CHECK(suppressor.ShouldForward(1, 0xAA, -60, At(0)));
+  CHECK(suppressor.ShouldForward(2, 0xAA, -60, At(5000)));
+  CHECK(!suppressor.ShouldForward(2, 0xAA, -60, At(9999)));
+  CHECK_EQ(suppressor.Size(), 2u);
+
+  // Any sighting expires what is older than the TTL; 2 was seen just now.
+  CHECK(!suppressor.ShouldForward(2, 0xAA, -60, At(10000)));
+  CHECK_EQ(suppressor.Size(), 1u);
+  CHECK(suppressor.ShouldForward(1, 0xAA, -60, At(10001)));
+  CHECK_EQ(suppressor.Size(), 2u);
+}
+
+// A zero TTL or capacity evicts the record just updated; the answer is still
+// the one for the advertisement seen.
+void EvictsTheUpdatedRecordSafely() {
+  for (auto zeroTtl : {true, false}) {
+    AdvertisementSuppressor suppressor;
+    auto options = Quiet();
+    if (zeroTtl) {
+      options.ttl = std::chrono::seconds(0);
+    } else {
+      options.capacity = 0;
+    }
+    suppressor.Configure(options);
+    CHECK(suppressor.ShouldForward(1, 0xAA, -60, At(0)));
+    CHECK_EQ(suppressor.Size(), 0u);
+    CHECK(suppressor.ShouldForward(1, 0xAA, -60, At(10)));
+    CHECK(suppressor.ShouldForward(2, 0xBB, -60, At(20)));
+    CHECK_EQ(suppressor.Size(), 0u);
+    CHECK_EQ(suppressor.Forwarded(), 3u);
+    CHECK_EQ(suppressor.Suppressed(), 0u);
+  }
+}
+
+void CountsForwardedAndSuppressed() {
+  AdvertisementSuppressor suppressor;
+  suppressor.Configure(Quiet());
+  for (int i = 0; i < 10; ++i) {
+    suppressor.ShouldForward(1, i < 5 ? 0xAA : 0xBB, -60, At(i));
+  }
+  CHECK_EQ(suppressor.Forwarded(), 2u);
+  CHECK_EQ(suppressor.Suppressed(), 8u);
+
+  // Configure() forgets the records but keeps counting.
+  suppressor.Configure(Quiet());
+  CHECK_EQ(suppressor.Size(), 0u);
+  CHECK(suppressor.ShouldForward(1, 0xBB, -60, At(20)));
+  CHECK_EQ(suppressor.Forwarded(), 3u);
+  CHECK_EQ(suppressor.Suppressed(), 8u);
+}
+
+} // namespace
+
+int main() {
+  quick_blue::test::Run("ForwardsFirstSightingAndPayloadChanges",
+                        ForwardsFirstSightingAndPayloadChanges);
+  quick_blue::test::Run("ForwardsRssiMovesOfAtLeastTheDelta",
+                        ForwardsRssiMovesOfAtLeastTheDelta);
+  quick_blue::test::Run("ForwardsOnTheHeartbeat", ForwardsOnTheHeartbeat);
+  quick_blue::test::Run("EvictsLeastRecentlySeenOverCapacity",
+                        EvictsLeastRecentlySeenOverCapacity);
+  quick_blue::test::Run("DropsRecordsUnseenForTheTtl",
+                        DropsRecordsUnseenForTheTtl);
+  quick_blue::test::Run("EvictsTheUpdatedRecordSafely",
+                        EvictsTheUpdatedRecordSafely);
+  quick_blue::test::Run("CountsForwardedAndSuppressed",
+                        CountsForwardedAndSuppressed);
+  return quick_blue::test::Result();
+}
@@ -0,0 +1,139 @@
+// Compares batched and unbatched scan-result delivery under a synthetic
+// advertisement flood. Producers build each result the way SendScanResult
+// does; the platform thread encodes every message with the standard codec,
+// one list per batch or one map per result, and the time it spends on that
+// is measured. What batching saves beyond the encoding, one channel crossing
+// into the engine per message, cannot be measured without the engine and
+// shows only in messages/s.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "batcher.h"
+#include "test_support.h"
+
+using quick_blue::Batcher;
+using quick_blue::test::Clock;
+using quick_blue::test::EncodableList;
+using quick_blue::test::EncodableMap;
+using quick_blue::test::EncodableValue;
+using quick_blue::test::SimulatedPlatformThread;
+
+namespace {
+
+struct Report {
+  double seconds;
+  uint64_t messages;
+  uint64_t delivered;
+  double busySeconds;
+  uint64_t bytes;
+};
+
+// A scan result as SendScanResult builds it, for a beacon with manufacturer
+// data and one service.
+EncodableValue MakeResult(uint64_t i) {
+  auto manufacturerData = std::vector<uint8_t>(20, uint8_t(i));
+  return EncodableMap{
+      {"name", "Beacon" + std::to_string(i % 64)},
+      {"deviceId", std::to_string(0xC0FFEE000000ull + i % 64)},
+      {"manufacturerDataHead", manufacturerData},
+      {"manufacturerSpecificData",
+       EncodableMap{{int32_t(0x004C),
+                     std::vector<uint8_t>(manufacturerData.begin() + 2,
+                                          manufacturerData.end())}}},
+      {"serviceUuids",
+       EncodableList{"0000feaa-0000-1000-8000-00805f9b34fb"}},
+      {"serviceData", EncodableMap{}},
+      {"rssi", int32_t(-40 - int(i % 50))},
+      {"txPowerLevel", int32_t(-59)},
+  };
+}
+
+Report Flood(size_t producers, uint64_t perProducer, size_t batchSize,
+             std::chrono::milliseconds interval) {
+  SimulatedPlatformThread platform;
+  Batcher<EncodableValue> batcher(batchSize);
+  std::atomic<uint64_t> delivered{0};
+  // FlushScanResults
+  auto flush = [&](std::vector<EncodableValue> batch) {
+    if (batch.empty()) {
+      return;
+    }
+    delivered += batch.size();
+    platform.Send(EncodableList(std::move(batch)));
+  };
+  std::atomic<bool> flooding{true};
+  std::thread flusher;
+  if (batchSize > 1) {
+    flusher = std::thread([&] {
+      while (flooding) {
+        std::this_thread::sleep_for(interval);
+        flush(batcher.Drain());
+      }
+    });
+  }
+
+  auto start = Clock::now();
+  std::vector<std::thread> threads;
+  for (size_t p = 0; p < producers; ++p) {
+    threads.emplace_back([&, p] {
+      for (uint64_t i = 0; i < perProducer; ++i) {
+        auto result = MakeResult(p * perProducer + i);
+        if (batchSize > 1) {
+          flush(batcher.Add(std::move(result)));
+        } else {
+          delivered++;
+          platform.Send(result);
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  // Not counting the last interval the flusher sleeps through.
+  auto seconds = quick_blue::test::SecondsSince(start);
+  flooding = false;
+  if (flusher.joinable()) {
+    flusher.join();
+  }
+  flush(batcher.Drain());
+  return Report{seconds, platform.Messages(), delivered.load(),
+                platform.BusySeconds(), platform.Bytes()};
+}
+
+void Print(const char *mode, const Report &report) {
+  std::printf("%-10s %10.0f results/s %9.0f messages/s %8.2f us encoding "
+              "%6.1f bytes/result\n",
+              mode, report.delivered / report.seconds,
+              report.messages / report.seconds,
+              report.busySeconds * 1e6 / report.delivered,
+              double(report.bytes) / report.delivered);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  bool quick = quick_blue::test::QuickRun(argc, argv);
+  const size_t kProducers = 4;
+  const uint64_t kPerProducer = quick ? 500 : 20000;
+
+  auto unbatched = Flood(kProducers, kPerProducer, 1,
+                         std::chrono::milliseconds(0));
+  auto batched = Flood(kProducers, kPerProducer, 64,
+                       std::chrono::milliseconds(100));
+  Print("unbatched", unbatched);
+  Print("batched", batched);
+
+  CHECK_EQ(unbatched.delivered, kProducers * kPerProducer);
+  CHECK_EQ(batched.delivered, kProducers * kPerProducer);
+  CHECK_EQ(unbatched.messages, unbatched.delivered);
+  CHECK(batched.messages < unbatched.messages);
+  CHECK(batched.bytes < unbatched.bytes);
+  return quick_blue::test::Result();
+}
@@ -0,0 +1,202 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "bounded_executor.h"
+#include "fake_advertisement_source.h"
+#include "scan_filter.h"
+#include "test_support.h"
+
+using quick_blue::Advertisement;
+using quick_blue::BoundedExecutor;
+using quick_blue::ScanFilter;
+using quick_blue::test::FakeAdvertisementSource;
+using quick_blue::test::MakeAdvertisement;
+
+namespace {
+
+// Waits until every posted task either ran or was dropped.
+void WaitUntilSettled(const BoundedExecutor &executor, uint64_t posted) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+  while (executor.Executed() + executor.Dropped() < posted &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+// Blocks tasks until released, to fill the queue deterministically.
+class Gate {
+public:
+  void Wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    opened.wait(lock, [this] { return open; });
+  }
+  void Open() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      open = true;
+    }
+    opened.notify_all();
+  }
+
+private:
+  std::mutex mutex;
+  std::condition_variable opened;
+  bool open = false;
+};
+
+void RunsTasksOfOneKeyInPostingOrder() {
+  const uint64_t kKeys = 64;
+  const uint64_t kPerKey = 500;
+  BoundedExecutor executor({8, kKeys * kPerKey, nullptr, nullptr});
+  std::vector<uint64_t> last(kKeys, 0);
+  std::atomic<uint64_t> outOfOrder{0};
+  for (uint64_t sequence = 1; sequence <= kPerKey; ++sequence) {
+    for (uint64_t key = 0; key < kKeys; ++key) {
+      executor.Post(key, [&, key, sequence] {
+        // Tasks of one key never overlap, so this slot is not shared.
+        if (last[key] + 1 != sequence) {
+          outOfOrder.fetch_add(1);
+        }
+        last[key] = sequence;
+      });
+    }
+  }
+  WaitUntilSettled(executor, kKeys * kPerKey);
+  CHECK_EQ(executor.Executed(), kKeys * kPerKey);
+  CHECK_EQ(executor.Dropped(), 0u);
+  CHECK_EQ(outOfOrder.load(), 0u);
+}
+
+void DropsOldestWhenFull() {
+  BoundedExecutor executor({1, 8, nullptr, nullptr});
+  Gate gate;
+  std::atomic<bool> blocked{false};
+  executor.Post(0, [&] {
+    blocked = true;
+    gate.Wait();
+  });
+  while (!blocked) {
+    std::this_thread::yield();
+  }
+
+  std::mutex ranMutex;
+  std::vector<int> ran;
+  int accepted = 0;
+  for (int i = 0; i < 18; ++i) {
+    accepted += executor.Post(1 + i, [&, i] {
+      std::lock_guard<std::mutex> lock(ranMutex);
+      ran.push_back(i);
+    });
+  }
+  CHECK_EQ(accepted, 8);
+  CHECK_EQ(executor.Dropped(), 10u);
+  CHECK_EQ(executor.QueueDepth(), 8u);
+  CHECK_EQ(executor.MaxQueueDepth(), 8u);
+
+  gate.Open();
+  WaitUntilSettled(executor, 19);
+  // Only the newest tasks survive.
+  CHECK_EQ(ran, (std::vector<int>{10, 11, 12, 13, 14, 15, 16, 17}));
+}
+
+void ClearDiscardsQueuedTasks() {
+  BoundedExecutor executor({1, 16, nullptr, nullptr});
+  Gate gate;
+  std::atomic<bool> blocked{false};
+  executor.Post(0, [&] {
+    blocked = true;
+    gate.Wait();
+  });
+  while (!blocked) {
+    std::this_thread::yield();
+  }
+  std::atomic<int> ran{0};
+  for (int i = 0; i < 10; ++i) {
+    executor.Post(1, [&ran] { ran.fetch_add(1); });
+  }
+  executor.Clear();
+  gate.Open();
+  WaitUntilSettled(executor, 1);
+  CHECK_EQ(executor.QueueDepth(), 0u);
+  CHECK_EQ(ran.load(), 0);
+}
+
+// The scan path under a flood: a synthetic generator delivers advertisements
+// of 64 devices from several threads into a small queue while the filter is
+// swapped underneath the workers, as startScan does on a restart.
+void SurvivesAdvertisementFlood() {
+  const uint64_t kDevices = 64;
+  std::vector<Advertisement> advertisements;
+  for (uint64_t address = 1; address <= kDevices; ++address) {
+    advertisements.push_back(MakeAdvertisement(
+        address, int16_t(-30 - int(address)), "Device",
+        address % 2 ? 0x004C : 0x0059, uint8_t(address)));
+  }
+
+  BoundedExecutor executor({4, 32, nullptr, nullptr});
+  std::shared_ptr<const ScanFilter> current =
+      std::make_shared<const ScanFilter>();
+  std::vector<std::atomic<int>> running(kDevices + 1);
+  std::atomic<uint64_t> overlapping{0};
+  std::atomic<uint64_t> posted{0};
+  std::atomic<uint64_t> matched{0};
+  std::atomic<uint64_t> retired{0};
+
+  FakeAdvertisementSource source(advertisements, 4, 400);
+  source.Start([&](const Advertisement &advertisement) {
+    auto filter = std::atomic_load(&current);
+    posted.fetch_add(1);
+    executor.Post(advertisement.address, [&, advertisement, filter] {
+      if (running[advertisement.address].fetch_add(1) != 0) {
+        overlapping.fetch_add(1);
+      }
+      if (std::atomic_load(&current) != filter) {
+        retired.fetch_add(1);
+      } else if (filter->MatchesAdvertisement(advertisement)) {
+        matched.fetch_add(1);
+      }
+      running[advertisement.address].fetch_sub(1);
+    });
+  });
+
+  for (int i = 0; i < 200; ++i) {
+    auto next = std::make_shared<ScanFilter>();
+    next->companyIds = {uint16_t(i % 2 ? 0x004C : 0x0059)};
+    next->minRssi = int16_t(-60 - i % 40);
+    std::atomic_store(&current,
+                      std::shared_ptr<const ScanFilter>(std::move(next)));
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+  }
+  source.Wait();
+  WaitUntilSettled(executor, posted.load());
+
+  CHECK_EQ(source.Delivered(), kDevices * 4 * 400);
+  CHECK_EQ(posted.load(), source.Delivered());
+  CHECK_EQ(executor.Executed() + executor.Dropped(), posted.load());
+  CHECK(executor.MaxQueueDepth() <= 32u);
+  CHECK_EQ(overlapping.load(), 0u);
+  CHECK(matched.load() + retired.load() <= executor.Executed());
+  std::printf("  posted %llu, executed %llu, dropped %llu, max depth %zu\n",
+              (unsigned long long)posted.load(),
+              (unsigned long long)executor.Executed(),
+              (unsigned long long)executor.Dropped(),
+              executor.MaxQueueDepth());
+}
+
+} // namespace
+
+int main() {
+  quick_blue::test::Run("RunsTasksOfOneKeyInPostingOrder",
+                        RunsTasksOfOneKeyInPostingOrder);
+  quick_blue::test::Run("DropsOldestWhenFull", DropsOldestWhenFull);
+  quick_blue::test::Run("ClearDiscardsQueuedTasks", ClearDiscardsQueuedTasks);
+  quick_blue::test::Run("SurvivesAdvertisementFlood",
+                        SurvivesAdvertisementFlood);
+  return quick_blue::test::Result();
+}
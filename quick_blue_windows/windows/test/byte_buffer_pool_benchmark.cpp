@@ -0,0 +1,95 @@
+// Bytes/s and heap allocations per notification of the notification copy
+// path. "reader" is the former path: the OS buffer is read into a temporary
+// vector, then copied into a fresh one for the message. "pooled" copies once
+// from the OS buffer into storage from a ByteBufferPool, which is returned
+// after the message was sent.
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#include "byte_buffer_pool.h"
+#include "test_support.h"
+
+using quick_blue::ByteBufferPool;
+using quick_blue::test::Clock;
+
+namespace {
+std::atomic<uint64_t> heapAllocations{0};
+} // namespace
+
+void *operator new(std::size_t size) {
+  heapAllocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+// Stands in for the engine, which only reads the message.
+uint64_t Send(const std::vector<uint8_t> &message) {
+  return message.front() + message.back() + message.size();
+}
+
+uint64_t ReaderPath(const uint8_t *os, size_t size, ByteBufferPool &) {
+  std::vector<uint8_t> read(size);
+  std::memcpy(read.data(), os, size);
+  std::vector<uint8_t> message(read.begin(), read.end());
+  return Send(message);
+}
+
+uint64_t PooledPath(const uint8_t *os, size_t size, ByteBufferPool &pool) {
+  auto message = pool.Acquire(size);
+  std::memcpy(message.data(), os, size);
+  auto sent = Send(message);
+  pool.Release(std::move(message));
+  return sent;
+}
+
+template <typename Path>
+void Measure(const char *label, Path path, size_t size, int iterations) {
+  std::vector<uint8_t> os(size, 0x5A);
+  ByteBufferPool pool;
+  uint64_t checksum = 0;
+  auto allocationsBefore = heapAllocations.load();
+  auto start = Clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    checksum += path(os.data(), os.size(), pool);
+  }
+  auto seconds = quick_blue::test::SecondsSince(start);
+  auto allocations = heapAllocations.load() - allocationsBefore;
+  std::printf("%-7s %4zu bytes %9.1f MB/s %6.3f allocations/notification\n",
+              label, size, size * double(iterations) / seconds / 1e6,
+              double(allocations) / iterations);
+  CHECK(checksum > 0);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  int iterations = quick_blue::test::QuickRun(argc, argv) ? 10000 : 5000000;
+  for (size_t size : {20, 244, 512}) {
+    Measure("reader", ReaderPath, size, iterations);
+    Measure("pooled", PooledPath, size, iterations);
+  }
+
+  // Steady state of the pooled path allocates nothing.
+  ByteBufferPool pool;
+  std::vector<uint8_t> os(244, 1);
+  PooledPath(os.data(), os.size(), pool);
+  auto before = heapAllocations.load();
+  for (int i = 0; i < 1000; ++i) {
+    PooledPath(os.data(), os.size(), pool);
+  }
+  CHECK_EQ(heapAllocations.load(), before);
+  return quick_blue::test::Result();
+}
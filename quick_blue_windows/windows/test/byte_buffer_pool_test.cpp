@@ -0,0 +1,95 @@
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "byte_buffer_pool.h"
+#include "test_support.h"
+
+using quick_blue::ByteBufferPool;
+
+namespace {
+
+void ReusesReleasedStorage() {
+  ByteBufferPool pool;
+  auto first = pool.Acquire(20);
+  CHECK_EQ(first.size(), 20u);
+  auto storage = first.data();
+  pool.Release(std::move(first));
+
+  auto second = pool.Acquire(16);
+  CHECK_EQ(second.size(), 16u);
+  CHECK(second.data() == storage);
+  CHECK_EQ(pool.Allocations(), 1u);
+  CHECK_EQ(pool.Reuses(), 1u);
+}
+
+void GrowsSmallBuffers() {
+  ByteBufferPool pool;
+  pool.Release(pool.Acquire(8));
+  auto larger = pool.Acquire(100);
+  CHECK_EQ(larger.size(), 100u);
+  CHECK_EQ(pool.Allocations(), 2u);
+}
+
+void DropsOversizedAndSurplusBuffers() {
+  ByteBufferPool pool(2, 64);
+  pool.Release(pool.Acquire(1000));
+  auto fresh = pool.Acquire(10);
+  // The oversized buffer was not kept.
+  CHECK_EQ(pool.Allocations(), 2u);
+
+  std::vector<std::vector<uint8_t>> held;
+  for (int i = 0; i < 4; ++i) {
+    held.push_back(pool.Acquire(10));
+  }
+  for (auto &buffer : held) {
+    pool.Release(std::move(buffer));
+  }
+  // Only two buffers are pooled, so the third acquire allocates.
+  auto before = pool.Allocations();
+  auto a = pool.Acquire(10);
+  auto b = pool.Acquire(10);
+  CHECK_EQ(pool.Allocations(), before);
+  auto c = pool.Acquire(10);
+  CHECK_EQ(pool.Allocations(), before + 1);
+}
+
+void IsSafeAcrossThreads() {
+  ByteBufferPool pool(16, 4096);
+  std::atomic<uint64_t> mismatches{0};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&pool, &mismatches, t] {
+      for (int i = 0; i < 20000; ++i) {
+        auto buffer = pool.Acquire(size_t(1 + (i + t) % 244));
+        for (auto &byte : buffer) {
+          byte = uint8_t(t);
+        }
+        for (auto byte : buffer) {
+          if (byte != uint8_t(t)) {
+            mismatches.fetch_add(1);
+          }
+        }
+        pool.Release(std::move(buffer));
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  CHECK_EQ(mismatches.load(), 0u);
+  CHECK_EQ(pool.Allocations() + pool.Reuses(), 8u * 20000u);
+  CHECK(pool.Reuses() > pool.Allocations());
+}
+
+} // namespace
+
+int main() {
+  quick_blue::test::Run("ReusesReleasedStorage", ReusesReleasedStorage);
+  quick_blue::test::Run("GrowsSmallBuffers", GrowsSmallBuffers);
+  quick_blue::test::Run("DropsOversizedAndSurplusBuffers",
+                        DropsOversizedAndSurplusBuffers);
+  quick_blue::test::Run("IsSafeAcrossThreads", IsSafeAcrossThreads);
+  return quick_blue::test::Result();
+}
@@ -0,0 +1,113 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "callback_guard.h"
+#include "test_support.h"
+
+using quick_blue::CallbackGuard;
+
+namespace {
+
+void AdmitsCallbacksUntilClosed() {
+  CallbackGuard guard;
+  {
+    auto scope = guard.Enter();
+    CHECK(scope);
+    // Scopes nest, e.g. a timer that fires while another one still runs.
+    auto nested = guard.Enter();
+    CHECK(nested);
+  }
+  guard.Close();
+  CHECK(!guard.Enter());
+  // Closing again does not wait for anything.
+  guard.Close();
+  CHECK(!guard.Enter());
+}
+
+// Close() returns only after the callback that was already running left its
+// scope.
+void CloseWaitsForRunningCallbacks() {
+  CallbackGuard guard;
+  std::atomic<bool> entered{false};
+  std::atomic<bool> release{false};
+  std::atomic<bool> finished{false};
+  std::thread callback([&] {
+    auto scope = guard.Enter();
+    CHECK(scope);
+    entered = true;
+    while (!release.load()) {
+      std::this_thread::yield();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    finished = true;
+  });
+  while (!entered.load()) {
+    std::this_thread::yield();
+  }
+  std::atomic<bool> closed{false};
+  std::thread owner([&] {
+    guard.Close();
+    closed = true;
+    CHECK(finished.load());
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  CHECK(!closed.load());
+  release = true;
+  owner.join();
+  callback.join();
+  CHECK(closed.load());
+}
+
+// Periodic callbacks on several threads use the owner until it is closed
+// and destroyed; none may touch it afterwards.
+void NoCallbackOutlivesTheOwner() {
+  const size_t kTimers = 4;
+  for (int round = 0; round < 20; ++round) {
+    auto guard = std::make_shared<CallbackGuard>();
+    auto owner = std::make_unique<std::vector<int>>(64, round);
+    auto *ownerPointer = owner.get();
+    std::atomic<bool> destroyed{false};
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> runs{0};
+    std::vector<std::thread> timers;
+    for (size_t t = 0; t < kTimers; ++t) {
+      timers.emplace_back([&, guard] {
+        while (!stop.load()) {
+          auto scope = guard->Enter();
+          if (!scope) {
+            continue;
+          }
+          CHECK(!destroyed.load());
+          CHECK_EQ((*ownerPointer)[round % 64], round);
+          runs++;
+        }
+      });
+    }
+    while (runs.load() < 100) {
+      std::this_thread::yield();
+    }
+    guard->Close();
+    destroyed = true;
+    owner.reset();
+    stop = true;
+    for (auto &timer : timers) {
+      timer.join();
+    }
+  }
+}
+
+} // namespace
+
+int main() {
+  quick_blue::test::Run("AdmitsCallbacksUntilClosed",
+                        AdmitsCallbacksUntilClosed);
+  quick_blue::test::Run("CloseWaitsForRunningCallbacks",
+                        CloseWaitsForRunningCallbacks);
+  quick_blue::test::Run("NoCallbackOutlivesTheOwner",
+                        NoCallbackOutlivesTheOwner);
+  return quick_blue::test::Result();
+}
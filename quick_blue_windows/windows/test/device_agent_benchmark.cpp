@@ -0,0 +1,233 @@
+// Lookups per second of the platform thread while 64 devices connect and
+// disconnect over and over. Connector threads register devices, discover
+// their characteristics and drop them again; refresher threads invalidate
+// and re-register services of connected devices, as GattServicesChanged
+// does. The platform thread meanwhile resolves characteristic references,
+// fetches write pipelines and collects statistics, through the agent tables
+// and the locking of BluetoothDeviceAgent. Every value read must belong to
+// the handle it was read for.
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ble_uuid.h"
+#include "device_registry.h"
+#include "handle_table.h"
+#include "test_support.h"
+#include "write_pipeline.h"
+
+using quick_blue::BleUuid;
+using quick_blue::DeviceRegistry;
+using quick_blue::GattHandleTable;
+using quick_blue::kInvalidHandle;
+using quick_blue::WritePipeline;
+using quick_blue::test::Clock;
+using quick_blue::test::Random;
+
+namespace {
+
+const size_t kDevices = 64;
+const size_t kServices = 5;
+const size_t kCharacteristics = 6;
+const size_t kConnectors = 4;
+const size_t kRefreshers = 2;
+
+BleUuid ServiceUuid(size_t s) {
+  return BleUuid::FromShort(uint32_t(0x1800 + s));
+}
+
+BleUuid CharacteristicUuid(size_t c) {
+  return BleUuid::FromShort(uint32_t(0x2A00 + c));
+}
+
+// Stands in for a GattCharacteristic: a reference-counted object that knows
+// which characteristic it is.
+struct Characteristic {
+  BleUuid service;
+  BleUuid uuid;
+};
+
+// The tables of BluetoothDeviceAgent with the same locking: every access
+// takes |mutex|, and what is read is copied out.
+struct Agent {
+  std::mutex mutex;
+  GattHandleTable<std::shared_ptr<const Characteristic>> characteristics;
+  std::map<uint32_t, std::shared_ptr<WritePipeline>> writePipelines;
+
+  std::shared_ptr<const Characteristic> Find(uint32_t handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto entry = characteristics.Get(handle);
+    return entry ? entry->value : nullptr;
+  }
+
+  uint32_t FindHandle(const BleUuid &service, const BleUuid &uuid) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return characteristics.Find(service, uuid);
+  }
+
+  uint32_t Add(size_t s, size_t c) {
+    auto characteristic = std::make_shared<const Characteristic>(
+        Characteristic{ServiceUuid(s), CharacteristicUuid(c)});
+    std::lock_guard<std::mutex> lock(mutex);
+    return characteristics.Insert(characteristic->service,
+                                  characteristic->uuid, uint16_t(c),
+                                  characteristic);
+  }
+
+  void Invalidate(const BleUuid &service) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &entry : characteristics) {
+      if (entry.service == service) {
+        entry.value = nullptr;
+      }
+    }
+  }
+
+  std::shared_ptr<WritePipeline> WritePipelineOf(uint32_t handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto &pipeline = writePipelines[handle];
+    if (!pipeline) {
+      pipeline = std::make_shared<WritePipeline>(WritePipeline::Options{});
+    }
+    return pipeline;
+  }
+
+  std::vector<std::shared_ptr<WritePipeline>> WritePipelines() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::shared_ptr<WritePipeline>> pipelines;
+    for (auto &pipeline : writePipelines) {
+      pipelines.push_back(pipeline.second);
+    }
+    return pipelines;
+  }
+};
+
+uint64_t Address(size_t device) { return 0xC0FFEE000000ull + device; }
+
+// Connects, discovers and disconnects the devices d with
+// d % kConnectors == |connector| until |stop| is set.
+void Connect(DeviceRegistry<Agent> &registry, size_t connector,
+             const std::atomic<bool> &stop, std::atomic<uint64_t> &cycles) {
+  Random random(connector + 1);
+  while (!stop.load()) {
+    for (size_t d = connector; d < kDevices; d += kConnectors) {
+      auto agent = std::make_shared<Agent>();
+      CHECK(registry.Insert(Address(d), registry.NextGeneration(), agent));
+      // Discovery registers characteristics one at a time, so lookups see
+      // the table grow and reallocate under them.
+      for (size_t s = 0; s < kServices; ++s) {
+        for (size_t c = 0; c < kCharacteristics; ++c) {
+          agent->Add(s, c);
+        }
+      }
+    }
+    for (size_t d = connector; d < kDevices; d += kConnectors) {
+      if (random.Below(4) == 0) {
+        std::this_thread::yield();
+      }
+      auto agent = registry.Remove(Address(d));
+      CHECK(agent != nullptr);
+      // CleanConnection
+      for (auto &pipeline : agent->WritePipelines()) {
+        pipeline->Clear();
+      }
+    }
+    cycles++;
+  }
+}
+
+// Invalidates and registers services again, like RefreshGattServicesAsync.
+void Refresh(DeviceRegistry<Agent> &registry, size_t refresher,
+             const std::atomic<bool> &stop) {
+  Random random(100 + refresher);
+  while (!stop.load()) {
+    auto agent = registry.Find(Address(random.Below(kDevices)));
+    if (!agent) {
+      continue;
+    }
+    auto s = random.Below(kServices);
+    agent->Invalidate(ServiceUuid(s));
+    for (size_t c = 0; c < kCharacteristics; ++c) {
+      agent->Add(s, c);
+    }
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  auto duration = quick_blue::test::QuickRun(argc, argv) ? 0.3 : 3.0;
+
+  DeviceRegistry<Agent> registry;
+  std::atomic<bool> stop{false};
+  std::atomic<uint64_t> cycles{0};
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < kConnectors; ++i) {
+    threads.emplace_back(Connect, std::ref(registry), i, std::cref(stop),
+                         std::ref(cycles));
+  }
+  for (size_t i = 0; i < kRefreshers; ++i) {
+    threads.emplace_back(Refresh, std::ref(registry), i, std::cref(stop));
+  }
+
+  // The platform thread: method calls resolve a characteristic and its
+  // write pipeline, and now and then statistics walk every device.
+  Random random(7);
+  uint64_t lookups = 0;
+  uint64_t found = 0;
+  uint64_t statistics = 0;
+  auto start = Clock::now();
+  while (quick_blue::test::SecondsSince(start) < duration) {
+    for (int i = 0; i < 1000; ++i) {
+      lookups++;
+      auto agent = registry.Find(Address(random.Below(kDevices)));
+      if (!agent) {
+        continue;
+      }
+      auto s = random.Below(kServices);
+      auto c = random.Below(kCharacteristics);
+      auto handle = agent->FindHandle(ServiceUuid(s), CharacteristicUuid(c));
+      if (handle == kInvalidHandle) {
+        continue;
+      }
+      if (auto characteristic = agent->Find(handle)) {
+        CHECK(characteristic->service == ServiceUuid(s));
+        CHECK(characteristic->uuid == CharacteristicUuid(c));
+        found++;
+      }
+      CHECK(agent->WritePipelineOf(handle) == agent->WritePipelineOf(handle));
+    }
+    uint64_t queued = 0;
+    auto devices = registry.Snapshot();
+    for (auto &device : *devices) {
+      for (auto &pipeline : device.second.agent->WritePipelines()) {
+        queued += pipeline->GetCounters().queued;
+      }
+    }
+    CHECK_EQ(queued, 0u);
+    statistics++;
+  }
+  auto seconds = quick_blue::test::SecondsSince(start);
+  stop.store(true);
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  std::printf("%zu devices, %zu connector and %zu refresher threads\n",
+              kDevices, kConnectors, kRefreshers);
+  std::printf("connect/disconnect %8.0f devices/s\n",
+              double(cycles.load()) * kDevices / kConnectors / seconds);
+  std::printf("lookups            %8.0f /s (%.0f%% found)\n",
+              lookups / seconds, 100.0 * found / lookups);
+  std::printf("statistics         %8.0f /s\n", statistics / seconds);
+  CHECK(found > 0);
+  CHECK(cycles.load() > 0);
+  return quick_blue::test::Result();
+}
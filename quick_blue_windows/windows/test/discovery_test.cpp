@@ -0,0 +1,62 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+#include "gatt_layout_cache.h"
+#include "simulated_peripheral.h"
+#include "test_support.h"
+
+using quick_blue::GattLayout;
+using quick_blue::test::Clock;
+using quick_blue::test::SimulatedPeripheral;
+
+namespace {
+
+void FindsTheSameLayoutEitherWay() {
+  auto layout = quick_blue::test::MakeLayout(12, 4);
+  layout.services[2].characteristics.clear();
+  layout.services[7].characteristics[0].descriptors.clear();
+  SimulatedPeripheral sequential(layout, std::chrono::microseconds(0));
+  SimulatedPeripheral concurrent(layout, std::chrono::microseconds(0));
+  CHECK(quick_blue::test::DiscoverSequentially(sequential) == layout);
+  CHECK(quick_blue::test::DiscoverConcurrently(concurrent) == layout);
+  CHECK_EQ(concurrent.Requests(), sequential.Requests());
+}
+
+// Sequential discovery of 12 services takes one round trip per request;
+// concurrent discovery takes about three: services, characteristics and
+// descriptors.
+void OverlapsRoundTrips() {
+  for (auto delay : {std::chrono::microseconds(2000),
+                     std::chrono::microseconds(10000)}) {
+    auto layout = quick_blue::test::MakeLayout(12, 4);
+    SimulatedPeripheral sequential(layout, delay);
+    auto start = Clock::now();
+    quick_blue::test::DiscoverSequentially(sequential);
+    auto sequentialSeconds = quick_blue::test::SecondsSince(start);
+
+    SimulatedPeripheral concurrent(layout, delay);
+    start = Clock::now();
+    quick_blue::test::DiscoverConcurrently(concurrent);
+    auto concurrentSeconds = quick_blue::test::SecondsSince(start);
+
+    std::printf("%5lld us per request: sequential %6.1f ms, concurrent "
+                "%6.1f ms, %llu requests\n",
+                static_cast<long long>(delay.count()), sequentialSeconds * 1e3,
+                concurrentSeconds * 1e3,
+                static_cast<unsigned long long>(concurrent.Requests()));
+    auto roundTrip = std::chrono::duration<double>(delay).count();
+    CHECK(sequentialSeconds >= 61 * roundTrip);
+    CHECK(concurrentSeconds >= 3 * roundTrip);
+    CHECK(concurrentSeconds * 4 < sequentialSeconds);
+  }
+}
+
+} // namespace
+
+int main() {
+  quick_blue::test::Run("FindsTheSameLayoutEitherWay",
+                        FindsTheSameLayoutEitherWay);
+  quick_blue::test::Run("OverlapsRoundTrips", OverlapsRoundTrips);
+  return quick_blue::test::Result();
+}
@@ -0,0 +1,107 @@
+#ifndef QUICK_BLUE_WINDOWS_TEST_FAKE_ADVERTISEMENT_SOURCE_H_
+#define QUICK_BLUE_WINDOWS_TEST_FAKE_ADVERTISEMENT_SOURCE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "advertisement_source.h"
+#include "scan_filter.h"
+
+namespace quick_blue {
+namespace test {
+
+// Builds an advertisement of |address| with a name and one manufacturer
+// data section, the shape most beacons send.
+inline Advertisement MakeAdvertisement(uint64_t address, int16_t rssi,
+                                       const std::string &name,
+                                       uint16_t companyId = 0x004C,
+                                       uint8_t counter = 0) {
+  Advertisement advertisement;
+  advertisement.address = address;
+  advertisement.rssi = rssi;
+  uint8_t flags = 0x06;
+  advertisement.data.Append(ParsedAdvertisement::kFlags, &flags, 1);
+  advertisement.data.Append(
+      ParsedAdvertisement::kCompleteLocalName,
+      reinterpret_cast<const uint8_t *>(name.data()), name.size());
+  uint8_t manufacturer[] = {uint8_t(companyId), uint8_t(companyId >> 8),
+                            counter, 0x42};
+  advertisement.data.Append(ParsedAdvertisement::kManufacturerSpecificData,
+                            manufacturer, sizeof(manufacturer));
+  return advertisement;
+}
+
+// Replays a fixed set of advertisements from |threads| threads at once,
+// |rounds| times each, the way the watcher calls back from the thread pool.
+class FakeAdvertisementSource : public AdvertisementSource {
+public:
+  FakeAdvertisementSource(std::vector<Advertisement> advertisements,
+                          size_t threads, size_t rounds)
+      : advertisements(std::move(advertisements)), threads(threads),
+        rounds(rounds) {}
+
+  ~FakeAdvertisementSource() override { Stop(); }
+
+  void Start(Handler handler) override {
+    Stop();
+    stopping = false;
+    for (size_t t = 0; t < threads; ++t) {
+      workers.emplace_back([this, handler, t] {
+        for (size_t round = 0; round < rounds && !stopping; ++round) {
+          // Each thread starts at a different offset so devices interleave.
+          for (size_t i = 0; i < advertisements.size() && !stopping; ++i) {
+            auto &advertisement =
+                advertisements[(i + t) % advertisements.size()];
+            if (filter.MatchesAdvertisement(advertisement)) {
+              handler(advertisement);
+            }
+            delivered.fetch_add(1, std::memory_order_relaxed);
+          }
+        }
+      });
+    }
+  }
+
+  void Stop() override {
+    stopping = true;
+    for (auto &worker : workers) {
+      worker.join();
+    }
+    workers.clear();
+  }
+
+  void SetFilter(const ScanFilter &scanFilter) override {
+    filter = scanFilter;
+  }
+
+  // Blocks until every thread delivered all of its rounds.
+  void Wait() {
+    for (auto &worker : workers) {
+      worker.join();
+    }
+    workers.clear();
+  }
+
+  uint64_t Delivered() const {
+    return delivered.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::vector<Advertisement> advertisements;
+  size_t threads;
+  size_t rounds;
+  ScanFilter filter;
+  std::atomic<bool> stopping{false};
+  std::atomic<uint64_t> delivered{0};
+  std::vector<std::thread> workers;
+};
+
+} // namespace test
+} // namespace quick_blue
+
+#endif // QUICK_BLUE_WINDOWS_TEST_FAKE_ADVERTISEMENT_SOURCE_H_
@@ -0,0 +1,114 @@
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "ble_uuid.h"
+#include "gatt_cache_policy.h"
+#include "test_support.h"
+
+using quick_blue::BleUuid;
+using quick_blue::GattCacheCounters;
+using quick_blue::GattCacheMode;
+using quick_blue::GattCachePolicy;
+using quick_blue::ParseGattCacheMode;
+
+namespace {
+
+const auto kManufacturerName = BleUuid::FromShort(0x2A29);
+const auto kHeartRate = BleUuid::FromShort(0x2A37);
+
+void CachesStaticDeviceInformation() {
+  GattCachePolicy policy;
+  for (uint16_t uuid : {0x2A01, 0x2A23, 0x2A24, 0x2A25, 0x2A26, 0x2A27,
+                        0x2A28, 0x2A29, 0x2A50}) {
+    CHECK(policy.Mode(BleUuid::FromShort(uuid)) == GattCacheMode::Cached);
+  }
+  // Values that change while connected are read live.
+  CHECK(policy.Mode(kHeartRate) == GattCacheMode::Uncached);
+  CHECK(policy.Mode(BleUuid::FromShort(0x2A19)) == GattCacheMode::Uncached);
+  CHECK(policy.Mode(*BleUuid::Parse("6e400003-b5a3-f393-e0a9-e50e24dcca9e")) ==
+        GattCacheMode::Uncached);
+}
+
+void SetsAndResetsPerCharacteristic() {
+  GattCachePolicy policy;
+  policy.Set(kHeartRate, GattCacheMode::Cached);
+  CHECK(policy.Mode(kHeartRate) == GattCacheMode::Cached);
+  policy.Set(kManufacturerName, GattCacheMode::Uncached);
+  CHECK(policy.Mode(kManufacturerName) == GattCacheMode::Uncached);
+
+  // Reset goes back to the default, not to the built-in entry.
+  policy.Reset(kHeartRate);
+  policy.Reset(kManufacturerName);
+  CHECK(policy.Mode(kHeartRate) == GattCacheMode::Uncached);
+  CHECK(policy.Mode(kManufacturerName) == GattCacheMode::Uncached);
+}
+
+void DefaultAppliesOnlyWithoutAnEntry() {
+  GattCachePolicy policy;
+  policy.Set(kHeartRate, GattCacheMode::Uncached);
+  policy.SetDefault(GattCacheMode::Cached);
+  CHECK(policy.Mode(BleUuid::FromShort(0x2A19)) == GattCacheMode::Cached);
+  CHECK(policy.Mode(kHeartRate) == GattCacheMode::Uncached);
+  policy.Reset(kHeartRate);
+  CHECK(policy.Mode(kHeartRate) == GattCacheMode::Cached);
+  policy.SetDefault(GattCacheMode::Uncached);
+  CHECK(policy.Mode(kHeartRate) == GattCacheMode::Uncached);
+  CHECK(policy.Mode(kManufacturerName) == GattCacheMode::Cached);
+}
+
+void ParsesCacheModes() {
+  CHECK(ParseGattCacheMode("cached") == GattCacheMode::Cached);
+  CHECK(ParseGattCacheMode("uncached") == GattCacheMode::Uncached);
+  CHECK(!ParseGattCacheMode(""));
+  CHECK(!ParseGattCacheMode("Cached"));
+  CHECK(!ParseGattCacheMode("uncached "));
+}
+
+void CountsHitsAndMisses() {
+  GattCacheCounters counters;
+  counters.Count(GattCacheMode::Cached, true);
+  counters.Count(GattCacheMode::Cached, true);
+  // A failed cached request went to the device.
+  counters.Count(GattCacheMode::Cached, false);
+  counters.Count(GattCacheMode::Uncached, true);
+  counters.Count(GattCacheMode::Uncached, false);
+  CHECK_EQ(counters.Hits(), 2u);
+  CHECK_EQ(counters.Misses(), 3u);
+}
+
+// Reads of one device complete on thread pool threads at once.
+void CountsFromManyThreads() {
+  const size_t kThreads = 4;
+  const size_t kPerThread = 10000;
+  GattCacheCounters counters;
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&counters, t] {
+      for (size_t i = 0; i < kPerThread; ++i) {
+        counters.Count(t % 2 ? GattCacheMode::Cached : GattCacheMode::Uncached,
+                       true);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  CHECK_EQ(counters.Hits(), kThreads / 2 * kPerThread);
+  CHECK_EQ(counters.Misses(), kThreads / 2 * kPerThread);
+}
+
+} // namespace
+
+int main() {
+  quick_blue::test::Run("CachesStaticDeviceInformation",
+                        CachesStaticDeviceInformation);
+  quick_blue::test::Run("SetsAndResetsPerCharacteristic",
+                        SetsAndResetsPerCharacteristic);
+  quick_blue::test::Run("DefaultAppliesOnlyWithoutAnEntry",
+                        DefaultAppliesOnlyWithoutAnEntry);
+  quick_blue::test::Run("ParsesCacheModes", ParsesCacheModes);
+  quick_blue::test::Run("CountsHitsAndMisses", CountsHitsAndMisses);
+  quick_blue::test::Run("CountsFromManyThreads", CountsFromManyThreads);
+  return quick_blue::test::Result();
+}
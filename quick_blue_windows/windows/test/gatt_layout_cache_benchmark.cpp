@@ -0,0 +1,95 @@
+// Connect-to-first-notification latency of a reconnect, cold and warm,
+// against a simulated peripheral of 12 services with 4 characteristics each
+// that answers every request after one connection interval. "cold"
+// enumerates the device as DiscoverServicesAsync does and stores the layout;
+// "warm" loads the stored layout instead. Both then subscribe and wait for
+// the first notification.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "gatt_layout_cache.h"
+#include "simulated_peripheral.h"
+#include "test_support.h"
+
+using quick_blue::GattLayout;
+using quick_blue::GattLayoutCache;
+using quick_blue::test::Clock;
+using quick_blue::test::SimulatedPeripheral;
+
+namespace {
+
+const uint64_t kAddress = 0xC0FFEE123456ull;
+
+struct Reconnect {
+  double milliseconds;
+  uint64_t requests;
+};
+
+Reconnect Cold(const GattLayout &layout, std::chrono::microseconds delay,
+               GattLayoutCache &cache) {
+  SimulatedPeripheral peripheral(layout, delay);
+  auto start = Clock::now();
+  auto discovered = quick_blue::test::DiscoverConcurrently(peripheral);
+  cache.Store(kAddress, discovered);
+  peripheral.FirstNotification().get();
+  auto milliseconds = quick_blue::test::SecondsSince(start) * 1e3;
+  CHECK(discovered == layout);
+  return {milliseconds, peripheral.Requests()};
+}
+
+Reconnect Warm(const GattLayout &layout, std::chrono::microseconds delay,
+               GattLayoutCache &cache) {
+  SimulatedPeripheral peripheral(layout, delay);
+  auto start = Clock::now();
+  auto loaded = cache.Load(kAddress);
+  peripheral.FirstNotification().get();
+  auto milliseconds = quick_blue::test::SecondsSince(start) * 1e3;
+  CHECK(loaded && *loaded == layout);
+  return {milliseconds, peripheral.Requests()};
+}
+
+template <typename Path>
+void Measure(const char *label, Path path, const GattLayout &layout,
+             std::chrono::microseconds delay, GattLayoutCache &cache,
+             int reconnects) {
+  std::vector<double> samples;
+  uint64_t requests = 0;
+  for (int i = 0; i < reconnects; ++i) {
+    auto reconnect = path(layout, delay, cache);
+    samples.push_back(reconnect.milliseconds);
+    requests = reconnect.requests;
+  }
+  auto p50 = quick_blue::test::Percentile(samples, 0.5);
+  auto p99 = quick_blue::test::Percentile(samples, 0.99);
+  std::printf("%-4s %3llu requests p50 %7.2f ms p99 %7.2f ms\n", label,
+              static_cast<unsigned long long>(requests), p50, p99);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  bool quick = quick_blue::test::QuickRun(argc, argv);
+  std::chrono::microseconds delay(quick ? 500 : 15000);
+  int reconnects = quick ? 3 : 20;
+  auto layout = quick_blue::test::MakeLayout(12, 4);
+
+  auto directory = std::filesystem::temp_directory_path() /
+                   "quick_blue_gatt_layout_cache_benchmark";
+  GattLayoutCache cache;
+  cache.SetDirectory(directory);
+  std::printf("%lld us per request\n",
+              static_cast<long long>(delay.count()));
+  Measure("cold", Cold, layout, delay, cache, reconnects);
+  Measure("warm", Warm, layout, delay, cache, reconnects);
+  CHECK_EQ(cache.Hits(), uint64_t(reconnects));
+
+  std::error_code error;
+  std::filesystem::remove_all(directory, error);
+  return quick_blue::test::Result();
+}
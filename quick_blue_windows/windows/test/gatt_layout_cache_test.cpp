@@ -0,0 +1,148 @@
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "fnv1a.h"
+#include "gatt_layout_cache.h"
+#include "simulated_peripheral.h"
+#include "test_support.h"
+
+using quick_blue::BleUuid;
+using quick_blue::GattLayout;
+using quick_blue::GattLayoutCache;
+
+namespace {
+
+const uint64_t kAddress = 0xC0FFEE123456ull;
+
+// A fresh directory under the system temporary directory, removed again
+// when the test is done.
+class TemporaryDirectory {
+public:
+  TemporaryDirectory() {
+    quick_blue::test::Random random(
+        uint64_t(quick_blue::test::Clock::now().time_since_epoch().count()));
+    path = std::filesystem::temp_directory_path() /
+           ("quick_blue_gatt_layout_cache_test_" +
+            std::to_string(random.Next()));
+  }
+
+  ~TemporaryDirectory() {
+    std::error_code error;
+    std::filesystem::remove_all(path, error);
+  }
+
+  std::filesystem::path path;
+};
+
+void RoundTripsLayouts() {
+  auto layout = quick_blue::test::MakeLayout(12, 4);
+  layout.services[3].characteristics[1].descriptors.push_back(
+      *BleUuid::Parse("6e400003-b5a3-f393-e0a9-e50e24dcca9e"));
+  layout.services[5].characteristics.clear();
+  auto data = layout.Serialize(kAddress);
+  auto loaded = GattLayout::Deserialize(data.data(), data.size(), kAddress);
+  CHECK(loaded.has_value());
+  CHECK(*loaded == layout);
+
+  GattLayout empty;
+  data = empty.Serialize(kAddress);
+  loaded = GattLayout::Deserialize(data.data(), data.size(), kAddress);
+  CHECK(loaded.has_value());
+  CHECK(loaded->services.empty());
+}
+
+void RejectsEveryCorruptedByte() {
+  auto data = quick_blue::test::MakeLayout(3, 2).Serialize(kAddress);
+  for (size_t i = 0; i < data.size(); ++i) {
+    auto corrupted = data;
+    corrupted[i] ^= 0x01;
+    CHECK(!GattLayout::Deserialize(corrupted.data(), corrupted.size(),
+                                   kAddress));
+  }
+}
+
+void RejectsTruncatedLayouts() {
+  auto data = quick_blue::test::MakeLayout(3, 2).Serialize(kAddress);
+  for (size_t length = 0; length < data.size(); ++length) {
+    CHECK(!GattLayout::Deserialize(data.data(), length, kAddress));
+  }
+}
+
+void RejectsOtherAddressesAndVersions() {
+  auto data = quick_blue::test::MakeLayout(2, 2).Serialize(kAddress);
+  CHECK(!GattLayout::Deserialize(data.data(), data.size(), kAddress + 1));
+
+  // An intact file of another version, checksum and all.
+  data[4] = uint8_t(GattLayout::kVersion + 1);
+  auto checksum = quick_blue::fnv1a(data.data(), data.size() - 8);
+  for (size_t i = 0; i < 8; ++i) {
+    data[data.size() - 8 + i] = uint8_t(checksum >> (8 * i));
+  }
+  CHECK(!GattLayout::Deserialize(data.data(), data.size(), kAddress));
+}
+
+void StoresLoadsAndRemovesLayouts() {
+  TemporaryDirectory directory;
+  GattLayoutCache cache;
+  auto layout = quick_blue::test::MakeLayout(4, 3);
+  CHECK(!cache.Enabled());
+  CHECK(!cache.Store(kAddress, layout));
+  CHECK(!cache.Load(kAddress));
+
+  cache.SetDirectory(directory.path);
+  CHECK(cache.Enabled());
+  CHECK(!cache.Load(kAddress));
+  CHECK(cache.Store(kAddress, layout));
+  auto loaded = cache.Load(kAddress);
+  CHECK(loaded && *loaded == layout);
+  CHECK(!cache.Load(kAddress + 1));
+  CHECK_EQ(cache.Hits(), 1u);
+  CHECK_EQ(cache.Misses(), 2u);
+
+  // Storing again replaces the layout.
+  layout.services.pop_back();
+  CHECK(cache.Store(kAddress, layout));
+  loaded = cache.Load(kAddress);
+  CHECK(loaded && *loaded == layout);
+
+  cache.Remove(kAddress);
+  CHECK(!cache.Load(kAddress));
+}
+
+void TreatsTornFilesAsMisses() {
+  TemporaryDirectory directory;
+  GattLayoutCache cache;
+  cache.SetDirectory(directory.path);
+  CHECK(cache.Store(kAddress, quick_blue::test::MakeLayout(4, 3)));
+  auto path = directory.path / "c0ffee123456.gatt";
+  CHECK(std::filesystem::exists(path));
+  auto size = std::filesystem::file_size(path);
+  std::filesystem::resize_file(path, size / 2);
+  CHECK(!cache.Load(kAddress));
+
+  // A write interrupted before the rename leaves the stored layout intact.
+  auto layout = quick_blue::test::MakeLayout(2, 2);
+  CHECK(cache.Store(kAddress, layout));
+  std::ofstream(directory.path / "c0ffee123456.gatt.tmp", std::ios::binary)
+      << "partial";
+  auto loaded = cache.Load(kAddress);
+  CHECK(loaded && *loaded == layout);
+}
+
+} // namespace
+
+int main() {
+  quick_blue::test::Run("RoundTripsLayouts", RoundTripsLayouts);
+  quick_blue::test::Run("RejectsEveryCorruptedByte", RejectsEveryCorruptedByte);
+  quick_blue::test::Run("RejectsTruncatedLayouts", RejectsTruncatedLayouts);
+  quick_blue::test::Run("RejectsOtherAddressesAndVersions",
+                        RejectsOtherAddressesAndVersions);
+  quick_blue::test::Run("StoresLoadsAndRemovesLayouts",
+                        StoresLoadsAndRemovesLayouts);
+  quick_blue::test::Run("TreatsTornFilesAsMisses", TreatsTornFilesAsMisses);
+  return quick_blue::test::Result();
+}
@@ -0,0 +1,331 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "gatt_scheduler.h"
+#include "test_support.h"
+
+using quick_blue::GattPriority;
+using quick_blue::GattScheduler;
+
+namespace {
+
+using State = GattScheduler::State;
+
+// Records the order in which queued operations of |scheduler| are decided,
+// keeping the granted slots so the test decides when they are released.
+struct Decisions {
+  explicit Decisions(std::shared_ptr<GattScheduler> scheduler)
+      : scheduler(scheduler) {}
+
+  // Turns the rest away first, so releasing the kept slots grants nothing.
+  ~Decisions() {
+    scheduler->Cancel();
+    std::vector<GattScheduler::Slot> held;
+    std::lock_guard<std::mutex> lock(mutex);
+    held.swap(slots);
+  }
+
+  GattScheduler::Callback For(int name) {
+    std::weak_ptr<GattScheduler> owner = scheduler;
+    return [this, owner, name](uint64_t id, State state) {
+      std::lock_guard<std::mutex> lock(mutex);
+      order.push_back(name);
+      states.push_back(state);
+      slots.emplace_back(owner.lock(), id, state);
+    };
+  }
+
+  std::shared_ptr<GattScheduler> scheduler;
+  std::mutex mutex;
+  std::vector<int> order;
+  std::vector<State> states;
+  std::vector<GattScheduler::Slot> slots;
+};
+
+GattScheduler::Slot Take(std::shared_ptr<GattScheduler> scheduler,
+                         GattPriority priority) {
+  auto ticket = scheduler->Submit(priority, GattScheduler::kNoDeadline,
+                                  nullptr);
+  CHECK(ticket.state == State::Granted);
+  return GattScheduler::Slot(scheduler, ticket.id, ticket.state);
+}
+
+void GrantsRightAwayUpToConcurrency() {
+  auto scheduler = std::make_shared<GattScheduler>(2);
+  auto a = Take(scheduler, GattPriority::Read);
+  auto b = Take(scheduler, GattPriority::Read);
+  auto ticket = scheduler->Submit(GattPriority::Control,
+                                  GattScheduler::kNoDeadline, nullptr);
+  CHECK(ticket.state == State::Queued);
+  auto counters = scheduler->GetCounters();
+  CHECK_EQ(counters.running, 2u);
+  CHECK_EQ(counters.queued, 1u);
+}
+
+// Control goes before subscriptions, reads and writes, whatever the order
+// they were submitted in, and equal priorities keep submission order.
+void GrantsByPriorityThenInOrder() {
+  auto scheduler = std::make_shared<GattScheduler>(1);
+  Decisions decisions(scheduler);
+  auto running = Take(scheduler, GattPriority::BulkWrite);
+  auto submit = [&](GattPriority priority, int name) {
+    scheduler->Submit(priority, GattScheduler::kNoDeadline,
+                      decisions.For(name));
+  };
+  submit(GattPriority::BulkWrite, 1);
+  submit(GattPriority::Read, 2);
+  submit(GattPriority::BulkWrite, 3);
+  submit(GattPriority::Subscription, 4);
+  submit(GattPriority::Control, 5);
+  submit(GattPriority::Read, 6);
+  submit(GattPriority::Control, 7);
+
+  running.Release();
+  // Each release grants the next one; only one runs at a time.
+  for (size_t i = 0; i < 7; ++i) {
+    GattScheduler::Slot slot;
+    {
+      std::lock_guard<std::mutex> lock(decisions.mutex);
+      CHECK_EQ(decisions.slots.size(), i + 1);
+      slot = std::move(decisions.slots.back());
+    }
+    CHECK_EQ(scheduler->GetCounters().running, 1u);
+    slot.Release();
+  }
+  CHECK(decisions.order == std::vector<int>({5, 7, 4, 2, 6, 1, 3}));
+  for (auto state : decisions.states) {
+    CHECK(state == State::Granted);
+  }
+}
+
+// A write queued behind a long burst is overtaken by a control operation
+// submitted later, so a busy link still answers MTU and discovery quickly.
+void ControlOvertakesQueuedWrites() {
+  auto scheduler = std::make_shared<GattScheduler>(2);
+  Decisions decisions(scheduler);
+  auto a = Take(scheduler, GattPriority::BulkWrite);
+  auto b = Take(scheduler, GattPriority::BulkWrite);
+  for (int i = 0; i < 100; ++i) {
+    scheduler->Submit(GattPriority::BulkWrite, GattScheduler::kNoDeadline,
+                      decisions.For(i));
+  }
+  scheduler->Submit(GattPriority::Control, GattScheduler::kNoDeadline,
+                    decisions.For(-1));
+  a.Release();
+  std::lock_guard<std::mutex> lock(decisions.mutex);
+  CHECK(decisions.order == std::vector<int>({-1}));
+  CHECK_EQ(scheduler->GetCounters().maxQueueDepth, 101u);
+}
+
+void ExpiresAtTheDeadline() {
+  auto scheduler = std::make_shared<GattScheduler>(1);
+  Decisions decisions(scheduler);
+  auto running = Take(scheduler, GattPriority::Read);
+  auto now = GattScheduler::Clock::now();
+
+  // Already past its deadline: turned away without queueing.
+  auto late = scheduler->Submit(GattPriority::Read,
+                                now - std::chrono::milliseconds(1), nullptr);
+  CHECK(late.state == State::Expired);
+
+  // Expired by its timer while queued.
+  auto timed = scheduler->Submit(GattPriority::Read,
+                                 now + std::chrono::hours(1),
+                                 decisions.For(1));
+  // Overdue by the time a slot frees up.
+  scheduler->Submit(GattPriority::Read, now + std::chrono::milliseconds(5),
+                    decisions.For(2));
+  scheduler->Submit(GattPriority::Read, GattScheduler::kNoDeadline,
+                    decisions.For(3));
+  scheduler->Expire(timed.id);
+  // Expiring it twice, or a granted one, does nothing.
+  scheduler->Expire(timed.id);
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  running.Release();
+
+  std::lock_guard<std::mutex> lock(decisions.mutex);
+  CHECK(decisions.order == std::vector<int>({1, 2, 3}));
+  CHECK(decisions.states == std::vector<State>({State::Expired,
+                                                State::Expired,
+                                                State::Granted}));
+  // Only the granted slot holds anything.
+  CHECK(!decisions.slots[0]);
+  CHECK(decisions.slots[2]);
+  CHECK_EQ(scheduler->GetCounters().expired, 3u);
+}
+
+void CancelsQueuedAndLaterOperations() {
+  auto scheduler = std::make_shared<GattScheduler>(1);
+  Decisions decisions(scheduler);
+  auto running = Take(scheduler, GattPriority::Read);
+  scheduler->Submit(GattPriority::Read, GattScheduler::kNoDeadline,
+                    decisions.For(1));
+  scheduler->Submit(GattPriority::Control, GattScheduler::kNoDeadline,
+                    decisions.For(2));
+  scheduler->Cancel();
+  {
+    std::lock_guard<std::mutex> lock(decisions.mutex);
+    CHECK_EQ(decisions.states.size(), 2u);
+    for (auto state : decisions.states) {
+      CHECK(state == State::Cancelled);
+    }
+  }
+  // The running operation is not interrupted, but nothing new starts.
+  CHECK(running);
+  CHECK(scheduler->Submit(GattPriority::Control, GattScheduler::kNoDeadline,
+                          nullptr)
+            .state == State::Cancelled);
+  running.Release();
+  CHECK(!scheduler->TryAcquire());
+  CHECK_EQ(scheduler->GetCounters().cancelled, 3u);
+}
+
+void TryAcquireNeverJumpsTheQueue() {
+  auto scheduler = std::make_shared<GattScheduler>(2);
+  Decisions decisions(scheduler);
+  auto a = Take(scheduler, GattPriority::Read);
+  auto b = scheduler->TryAcquire();
+  CHECK(b);
+  CHECK(!scheduler->TryAcquire());
+  scheduler->Submit(GattPriority::Read, GattScheduler::kNoDeadline,
+                    decisions.For(1));
+  b.Release();
+  // The free slot went to the queued operation, not to TryAcquire.
+  CHECK(!scheduler->TryAcquire());
+  std::lock_guard<std::mutex> lock(decisions.mutex);
+  CHECK_EQ(decisions.order.size(), 1u);
+}
+
+void SlotsReleaseOnceWhenMovedOrDestroyed() {
+  auto scheduler = std::make_shared<GattScheduler>(1);
+  {
+    auto slot = Take(scheduler, GattPriority::Read);
+    GattScheduler::Slot moved(std::move(slot));
+    CHECK(!slot);
+    CHECK(moved);
+    slot.Release();
+    CHECK_EQ(scheduler->GetCounters().running, 1u);
+  }
+  CHECK_EQ(scheduler->GetCounters().running, 0u);
+  // Assigning over a granted slot releases it.
+  auto slot = Take(scheduler, GattPriority::Read);
+  slot = GattScheduler::Slot();
+  CHECK_EQ(scheduler->GetCounters().running, 0u);
+}
+
+void RaisingConcurrencyGrantsQueuedOperations() {
+  auto scheduler = std::make_shared<GattScheduler>(1);
+  Decisions decisions(scheduler);
+  auto running = Take(scheduler, GattPriority::Read);
+  for (int i = 0; i < 3; ++i) {
+    scheduler->Submit(GattPriority::Read, GattScheduler::kNoDeadline,
+                      decisions.For(i));
+  }
+  scheduler->SetConcurrency(3);
+  CHECK_EQ(scheduler->Concurrency(), 3u);
+  std::lock_guard<std::mutex> lock(decisions.mutex);
+  CHECK(decisions.order == std::vector<int>({0, 1}));
+}
+
+void MeasuresQueueWaitAndServiceTime() {
+  auto scheduler = std::make_shared<GattScheduler>(1);
+  Decisions decisions(scheduler);
+  auto running = Take(scheduler, GattPriority::Read);
+  scheduler->Submit(GattPriority::Read, GattScheduler::kNoDeadline,
+                    decisions.For(1));
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  running.Release();
+  {
+    std::lock_guard<std::mutex> lock(decisions.mutex);
+    decisions.slots.clear();
+  }
+  CHECK_EQ(scheduler->QueueWait().Count(), 2u);
+  CHECK(scheduler->QueueWait().Max() >= std::chrono::milliseconds(4));
+  CHECK_EQ(scheduler->ServiceTime().Count(), 2u);
+  CHECK(scheduler->ServiceTime().Max() >= std::chrono::milliseconds(4));
+}
+
+// Operations submitted, expired and released from many threads never run
+// more than |concurrency| at once, and each is decided exactly once.
+void HoldsConcurrencyAcrossThreads() {
+  const size_t kConcurrency = 3;
+  const int kThreads = 8;
+  const int kOperations = 2000;
+  auto scheduler = std::make_shared<GattScheduler>(kConcurrency);
+  std::atomic<int> running{0};
+  std::atomic<int> maxRunning{0};
+  std::atomic<int> decided{0};
+  auto run = [&](GattScheduler::Slot slot) {
+    if (slot) {
+      auto now = running.fetch_add(1) + 1;
+      auto seen = maxRunning.load();
+      while (now > seen && !maxRunning.compare_exchange_weak(seen, now)) {
+      }
+      std::this_thread::yield();
+      running.fetch_sub(1);
+    }
+    decided.fetch_add(1);
+  };
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t] {
+      quick_blue::test::Random random(uint64_t(t + 1));
+      for (int i = 0; i < kOperations; ++i) {
+        auto priority = GattPriority(random.Below(4));
+        auto deadline = random.Below(4) == 0
+                            ? GattScheduler::Clock::now() +
+                                  std::chrono::microseconds(random.Below(50))
+                            : GattScheduler::kNoDeadline;
+        auto ticket = scheduler->Submit(
+            priority, deadline, [&, scheduler](uint64_t id, State state) {
+              run(GattScheduler::Slot(scheduler, id, state));
+            });
+        if (ticket.state != State::Queued) {
+          run(GattScheduler::Slot(scheduler, ticket.id, ticket.state));
+        } else if (random.Below(8) == 0) {
+          scheduler->Expire(ticket.id);
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  CHECK_EQ(decided.load(), kThreads * kOperations);
+  CHECK(maxRunning.load() <= int(kConcurrency));
+  auto counters = scheduler->GetCounters();
+  CHECK_EQ(counters.running, 0u);
+  CHECK_EQ(counters.queued, 0u);
+  CHECK_EQ(counters.granted + counters.expired,
+           uint64_t(kThreads * kOperations));
+}
+
+} // namespace
+
+int main() {
+  quick_blue::test::Run("GrantsRightAwayUpToConcurrency",
+                        GrantsRightAwayUpToConcurrency);
+  quick_blue::test::Run("GrantsByPriorityThenInOrder",
+                        GrantsByPriorityThenInOrder);
+  quick_blue::test::Run("ControlOvertakesQueuedWrites",
+                        ControlOvertakesQueuedWrites);
+  quick_blue::test::Run("ExpiresAtTheDeadline", ExpiresAtTheDeadline);
+  quick_blue::test::Run("CancelsQueuedAndLaterOperations",
+                        CancelsQueuedAndLaterOperations);
+  quick_blue::test::Run("TryAcquireNeverJumpsTheQueue",
+                        TryAcquireNeverJumpsTheQueue);
+  quick_blue::test::Run("SlotsReleaseOnceWhenMovedOrDestroyed",
+                        SlotsReleaseOnceWhenMovedOrDestroyed);
+  quick_blue::test::Run("RaisingConcurrencyGrantsQueuedOperations",
+                        RaisingConcurrencyGrantsQueuedOperations);
+  quick_blue::test::Run("MeasuresQueueWaitAndServiceTime",
+                        MeasuresQueueWaitAndServiceTime);
+  quick_blue::test::Run("HoldsConcurrencyAcrossThreads",
+                        HoldsConcurrencyAcrossThreads);
+  return quick_blue::test::Result();
+}
@@ -0,0 +1,116 @@
+// Cost of routing a method call to its characteristic with 100 connected
+// devices of 30 characteristics each. "strings" is the former path: the
+// decimal `deviceId` is parsed and looked up in an ordered map, then the
+// characteristic in a map keyed by UUID string. "handles" resolves a device
+// handle and a characteristic handle; "uuids" resolves the device handle and
+// finds the characteristic by UUID pair, as a call without handles does.
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ble_uuid.h"
+#include "handle_table.h"
+#include "test_support.h"
+
+using quick_blue::BleUuid;
+using quick_blue::DeviceHandleTable;
+using quick_blue::GattHandleTable;
+using quick_blue::test::Clock;
+using quick_blue::test::Random;
+
+namespace {
+
+const size_t kDevices = 100;
+const size_t kCharacteristics = 30;
+
+struct Device {
+  std::map<std::string, int> byUuidString;
+  GattHandleTable<int> table;
+};
+
+struct Call {
+  std::string deviceId;
+  uint64_t deviceHandle;
+  BleUuid service;
+  BleUuid characteristic;
+  std::string characteristicUuid;
+  uint32_t characteristicHandle;
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+  int iterations = quick_blue::test::QuickRun(argc, argv) ? 100000 : 10000000;
+
+  DeviceHandleTable deviceHandles;
+  std::map<uint64_t, std::unique_ptr<Device>> byAddress;
+  std::unordered_map<uint64_t, Device *> registry;
+  std::vector<Call> calls;
+  Random random(42);
+  for (size_t d = 0; d < kDevices; ++d) {
+    uint64_t address = 0xC0FFEE000000ull + random.Below(1 << 24);
+    auto device = std::make_unique<Device>();
+    auto deviceHandle = deviceHandles.Acquire(address);
+    for (size_t c = 0; c < kCharacteristics; ++c) {
+      auto service = BleUuid::FromShort(uint32_t(0x1800 + c / 6));
+      auto characteristic = BleUuid::FromShort(uint32_t(0x2A00 + c));
+      auto uuid = characteristic.ToString();
+      device->byUuidString[uuid] = int(c);
+      auto handle =
+          device->table.Insert(service, characteristic, uint16_t(c), int(c));
+      calls.push_back(Call{std::to_string(address), deviceHandle, service,
+                           characteristic, uuid, handle});
+    }
+    registry[address] = device.get();
+    byAddress[address] = std::move(device);
+  }
+
+  std::vector<size_t> order(iterations);
+  for (auto &index : order) {
+    index = random.Below(calls.size());
+  }
+
+  uint64_t sum = 0;
+  auto start = Clock::now();
+  for (auto index : order) {
+    auto &call = calls[index];
+    auto &device = *byAddress.find(std::stoull(call.deviceId))->second;
+    sum += device.byUuidString.find(call.characteristicUuid)->second;
+  }
+  double strings = quick_blue::test::SecondsSince(start);
+
+  uint64_t handleSum = 0;
+  start = Clock::now();
+  for (auto index : order) {
+    auto &call = calls[index];
+    auto address = deviceHandles.Address(call.deviceHandle);
+    auto &device = *registry.find(*address)->second;
+    handleSum += device.table.Get(call.characteristicHandle)->value;
+  }
+  double handles = quick_blue::test::SecondsSince(start);
+
+  uint64_t uuidSum = 0;
+  start = Clock::now();
+  for (auto index : order) {
+    auto &call = calls[index];
+    auto address = deviceHandles.Address(call.deviceHandle);
+    auto &device = *registry.find(*address)->second;
+    auto handle = device.table.Find(call.service, call.characteristic);
+    uuidSum += device.table.Get(handle)->value;
+  }
+  double uuids = quick_blue::test::SecondsSince(start);
+
+  std::printf("%zu devices x %zu characteristics\n", kDevices,
+              kCharacteristics);
+  std::printf("strings %6.1f ns/lookup\n", strings * 1e9 / iterations);
+  std::printf("handles %6.1f ns/lookup\n", handles * 1e9 / iterations);
+  std::printf("uuids   %6.1f ns/lookup\n", uuids * 1e9 / iterations);
+  CHECK_EQ(sum, handleSum);
+  CHECK_EQ(sum, uuidSum);
+  return quick_blue::test::Result();
+}
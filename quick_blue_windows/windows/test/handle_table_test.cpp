@@ -0,0 +1,204 @@
+#include <cstdint>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "ble_uuid.h"
+#include "handle_table.h"
+#include "test_support.h"
+
+using quick_blue::BleUuid;
+using quick_blue::DeviceHandleTable;
+using quick_blue::GattHandleTable;
+using quick_blue::kInvalidHandle;
+
+namespace {
+
+const auto kBattery = BleUuid::FromShort(0x180F);
+const auto kCustomA = *BleUuid::Parse("6e400001-b5a3-f393-e0a9-e50e24dcca9e");
+const auto kCustomB = *BleUuid::Parse("6e400001-b5a3-f393-e0a9-e50e24dcca9f");
+const auto kLevel = BleUuid::FromShort(0x2A19);
+const auto kData = *BleUuid::Parse("6e400003-b5a3-f393-e0a9-e50e24dcca9e");
+
+struct Attribute {
+  BleUuid service;
+  BleUuid characteristic;
+  uint16_t instance;
+  std::string name;
+};
+
+// A GATT database where UUIDs collide: the battery level characteristic
+// appears under three services, and one service has two instances of the
+// same data characteristic.
+std::vector<Attribute> SyntheticDatabase() {
+  return {
+      {kBattery, kLevel, 0x0003, "battery level"},
+      {kCustomA, kLevel, 0x0010, "custom A level"},
+      {kCustomA, kData, 0x0013, "custom A data 1"},
+      {kCustomA, kData, 0x0016, "custom A data 2"},
+      {kCustomB, kLevel, 0x0020, "custom B level"},
+      {kCustomB, kData, 0x0023, "custom B data"},
+  };
+}
+
+void KeepsDuplicateUuidsApart() {
+  GattHandleTable<std::string> table;
+  std::vector<uint32_t> handles;
+  for (auto &attribute : SyntheticDatabase()) {
+    handles.push_back(table.Insert(attribute.service, attribute.characteristic,
+                                   attribute.instance, attribute.name));
+  }
+  CHECK_EQ(table.Size(), 6u);
+  CHECK_EQ(std::set<uint32_t>(handles.begin(), handles.end()).size(), 6u);
+
+  auto database = SyntheticDatabase();
+  for (size_t i = 0; i < database.size(); ++i) {
+    auto &attribute = database[i];
+    auto handle = table.Find(attribute.service, attribute.characteristic,
+                             attribute.instance);
+    CHECK_EQ(handle, handles[i]);
+    CHECK(table.Get(handle)->value == attribute.name);
+  }
+}
+
+void FindsFirstInstanceWithoutAttributeHandle() {
+  GattHandleTable<std::string> table;
+  for (auto &attribute : SyntheticDatabase()) {
+    table.Insert(attribute.service, attribute.characteristic,
+                 attribute.instance, attribute.name);
+  }
+  CHECK(table.Get(table.Find(kCustomA, kData))->value == "custom A data 1");
+  CHECK(table.Get(table.Find(kCustomB, kLevel))->value == "custom B level");
+  CHECK(table.Get(table.Find(kBattery, kLevel))->value == "battery level");
+  CHECK_EQ(table.Find(kBattery, kData), kInvalidHandle);
+  CHECK_EQ(table.Find(kCustomA, kData, 0x0099), kInvalidHandle);
+  CHECK(!table.Get(kInvalidHandle));
+  CHECK(!table.Contains(kInvalidHandle));
+}
+
+void ReplacesValueOfExistingKey() {
+  GattHandleTable<std::string> table;
+  auto handle = table.Insert(kCustomA, kData, 0x0013, "old");
+  CHECK_EQ(table.Insert(kCustomA, kData, 0x0013, "new"), handle);
+  CHECK_EQ(table.Size(), 1u);
+  CHECK(table.Get(handle)->value == "new");
+}
+
+void KeepsHandlesAcrossGrowth() {
+  GattHandleTable<int> table;
+  const int kCount = 500;
+  for (int i = 0; i < kCount; ++i) {
+    // Every characteristic shares one UUID pair; only instances differ.
+    CHECK_EQ(table.Insert(kCustomA, kData, uint16_t(i), i), uint32_t(i));
+  }
+  for (int i = 0; i < kCount; ++i) {
+    auto handle = table.Find(kCustomA, kData, uint16_t(i));
+    CHECK_EQ(handle, uint32_t(i));
+    CHECK_EQ(table.Get(handle)->value, i);
+  }
+  CHECK_EQ(table.Find(kCustomA, kData), 0u);
+  table.Clear();
+  CHECK_EQ(table.Size(), 0u);
+  CHECK_EQ(table.Find(kCustomA, kData), kInvalidHandle);
+}
+
+// Entries move when the table grows; what Get() returned must not.
+void GetsCopiesThatOutliveGrowth() {
+  GattHandleTable<std::string> table;
+  auto handle = table.Insert(kCustomA, kData, 0, "first");
+  auto entry = table.Get(handle);
+  for (int i = 1; i < 100; ++i) {
+    table.Insert(kCustomA, kData, uint16_t(i), std::to_string(i));
+  }
+  CHECK(entry && entry->value == "first");
+  CHECK(entry->service == kCustomA);
+  CHECK(table.Contains(handle));
+  table.Clear();
+  CHECK(entry->value == "first");
+  CHECK(!table.Contains(handle));
+}
+
+void ResolvesLiveHandles() {
+  DeviceHandleTable table;
+  auto a = table.Acquire(0xAA);
+  auto b = table.Acquire(0xBB);
+  CHECK(a != b);
+  CHECK_EQ(table.Acquire(0xAA), a);
+  CHECK(table.Address(a) == uint64_t(0xAA));
+  CHECK(table.Address(b) == uint64_t(0xBB));
+  CHECK_EQ(table.Handle(0xBB), b);
+  CHECK_EQ(table.Handle(0xCC), DeviceHandleTable::kInvalidHandle);
+  CHECK(!table.Address(DeviceHandleTable::kInvalidHandle));
+}
+
+void RejectsReleasedHandles() {
+  DeviceHandleTable table;
+  auto handle = table.Acquire(0xAA);
+  table.Release(0xAA);
+  CHECK(!table.Address(handle));
+  CHECK_EQ(table.Handle(0xAA), DeviceHandleTable::kInvalidHandle);
+  // Releasing twice is harmless.
+  table.Release(0xAA);
+}
+
+// The slot of a disconnected device goes to the next one, but a handle kept
+// from before must not resolve to it.
+void RejectsStaleHandlesAfterSlotReuse() {
+  DeviceHandleTable table;
+  auto first = table.Acquire(0xAA);
+  table.Release(0xAA);
+  auto second = table.Acquire(0xBB);
+  CHECK_EQ(uint32_t(first), uint32_t(second));
+  CHECK(first != second);
+  CHECK(!table.Address(first));
+  CHECK(table.Address(second) == uint64_t(0xBB));
+
+  // Reconnecting the first device hands out yet another handle.
+  table.Release(0xBB);
+  auto third = table.Acquire(0xAA);
+  CHECK(third != first);
+  CHECK(!table.Address(first));
+  CHECK(!table.Address(second));
+  CHECK(table.Address(third) == uint64_t(0xAA));
+}
+
+void RejectsHandlesWithoutGeneration() {
+  DeviceHandleTable table;
+  auto handle = table.Acquire(0xAA);
+  // The bare slot index, as a 32-bit handle would have been.
+  CHECK(!table.Address(uint32_t(handle)));
+  CHECK(!table.Address(handle + (uint64_t(1) << 32)));
+}
+
+void KeepsHandlesPositiveAcrossManyReuses() {
+  DeviceHandleTable table;
+  std::set<uint64_t> seen;
+  for (uint64_t i = 0; i < 100000; ++i) {
+    auto handle = table.Acquire(i);
+    CHECK(handle < (uint64_t(1) << 63));
+    CHECK(seen.insert(handle).second);
+    table.Release(i);
+  }
+}
+
+} // namespace
+
+int main() {
+  quick_blue::test::Run("KeepsDuplicateUuidsApart", KeepsDuplicateUuidsApart);
+  quick_blue::test::Run("FindsFirstInstanceWithoutAttributeHandle",
+                        FindsFirstInstanceWithoutAttributeHandle);
+  quick_blue::test::Run("ReplacesValueOfExistingKey",
+                        ReplacesValueOfExistingKey);
+  quick_blue::test::Run("KeepsHandlesAcrossGrowth", KeepsHandlesAcrossGrowth);
+  quick_blue::test::Run("GetsCopiesThatOutliveGrowth",
+                        GetsCopiesThatOutliveGrowth);
+  quick_blue::test::Run("ResolvesLiveHandles", ResolvesLiveHandles);
+  quick_blue::test::Run("RejectsReleasedHandles", RejectsReleasedHandles);
+  quick_blue::test::Run("RejectsStaleHandlesAfterSlotReuse",
+                        RejectsStaleHandlesAfterSlotReuse);
+  quick_blue::test::Run("RejectsHandlesWithoutGeneration",
+                        RejectsHandlesWithoutGeneration);
+  quick_blue::test::Run("KeepsHandlesPositiveAcrossManyReuses",
+                        KeepsHandlesPositiveAcrossManyReuses);
+  return quick_blue::test::Result();
+}
@@ -0,0 +1,135 @@
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+#include "nearest_devices.h"
+#include "test_support.h"
+
+using quick_blue::NearestDevices;
+using Options = NearestDevices::Options;
+
+namespace {
+
+const auto kStart = NearestDevices::Clock::time_point{} + std::chrono::hours(1);
+
+NearestDevices::Clock::time_point At(int milliseconds) {
+  return kStart + std::chrono::milliseconds(milliseconds);
+}
+
+bool Near(double a, double b) { return std::fabs(a - b) < 1e-9; }
+
+void SmoothsRssiWithAMovingAverage() {
+  NearestDevices devices;
+  Options options;
+  options.smoothing = 0.5;
+  devices.Configure(options);
+  // The first sample is taken as is.
+  devices.Update(1, -80, "Tag", At(0));
+  CHECK(Near(devices.Snapshot(At(0))[0].rssi, -80));
+  devices.Update(1, -60, "Tag", At(10));
+  CHECK(Near(devices.Snapshot(At(10))[0].rssi, -70));
+  devices.Update(1, -60, "Tag", At(20));
+  CHECK(Near(devices.Snapshot(At(20))[0].rssi, -65));
+
+  // Smoothing is clamped to (0, 1]; 1 follows the last sample.
+  options.smoothing = 4;
+  devices.Configure(options);
+  devices.Update(1, -80, "Tag", At(30));
+  devices.Update(1, -40, "Renamed", At(40));
+  auto snapshot = devices.Snapshot(At(40));
+  CHECK_EQ(snapshot.size(), 1u);
+  CHECK(Near(snapshot[0].rssi, -40));
+  CHECK(snapshot[0].name == "Renamed");
+  CHECK(snapshot[0].lastSeen == At(40));
+}
+
+void RanksTheStrongestFirst() {
+  NearestDevices devices;
+  Options options;
+  options.topK = 3;
+  options.smoothing = 1;
+  devices.Configure(options);
+  const int16_t rssi[] = {-70, -50, -90, -40, -60, -80};
+  for (uint64_t address = 0; address < 6; ++address) {
+    devices.Update(address, rssi[address], std::string(), At(0));
+  }
+  auto snapshot = devices.Snapshot(At(0));
+  CHECK_EQ(snapshot.size(), 3u);
+  if (snapshot.size() == 3) {
+    CHECK_EQ(snapshot[0].address, 3u);
+    CHECK_EQ(snapshot[1].address, 1u);
+    CHECK_EQ(snapshot[2].address, 4u);
+  }
+  // Devices outside the top K stay in the table.
+  CHECK_EQ(devices.Size(), 6u);
+
+  // A device that comes closer moves up.
+  devices.Update(2, -30, std::string(), At(10));
+  snapshot = devices.Snapshot(At(10));
+  CHECK_EQ(snapshot.size(), 3u);
+  if (snapshot.size() == 3) {
+    CHECK_EQ(snapshot[0].address, 2u);
+    CHECK_EQ(snapshot[1].address, 3u);
+    CHECK_EQ(snapshot[2].address, 1u);
+  }
+}
+
+void ReturnsAtMostKDevices() {
+  NearestDevices devices;
+  Options options;
+  options.topK = 10;
+  devices.Configure(options);
+  devices.Update(1, -70, std::string(), At(0));
+  devices.Update(2, -50, std::string(), At(0));
+  devices.Update(3, -60, std::string(), At(0));
+  auto snapshot = devices.Snapshot(At(0));
+  CHECK_EQ(snapshot.size(), 3u);
+  for (size_t i = 1; i < snapshot.size(); ++i) {
+    CHECK(snapshot[i - 1].rssi >= snapshot[i].rssi);
+  }
+
+  options.topK = 0;
+  devices.Configure(options);
+  devices.Update(1, -70, std::string(), At(0));
+  CHECK(devices.Snapshot(At(0)).empty());
+}
+
+void DropsExpiredDevicesInSnapshot() {
+  NearestDevices devices;
+  Options options;
+  options.ttl = std::chrono::seconds(5);
+  devices.Configure(options);
+  devices.Update(1, -40, std::string(), At(0));
+  devices.Update(2, -60, std::string(), At(3000));
+  CHECK_EQ(devices.Snapshot(At(4999)).size(), 2u);
+
+  // Expired devices are dropped even if they would rank first.
+  auto snapshot = devices.Snapshot(At(5000));
+  CHECK_EQ(snapshot.size(), 1u);
+  if (snapshot.size() == 1) {
+    CHECK_EQ(snapshot[0].address, 2u);
+  }
+  CHECK_EQ(devices.Size(), 1u);
+
+  // A device heard again after expiring starts over.
+  devices.Update(1, -90, std::string(), At(6000));
+  snapshot = devices.Snapshot(At(6000));
+  CHECK_EQ(snapshot.size(), 2u);
+  if (snapshot.size() == 2) {
+    CHECK_EQ(snapshot[1].address, 1u);
+    CHECK(Near(snapshot[1].rssi, -90));
+  }
+}
+
+} // namespace
+
+int main() {
+  quick_blue::test::Run("SmoothsRssiWithAMovingAverage",
+                        SmoothsRssiWithAMovingAverage);
+  quick_blue::test::Run("RanksTheStrongestFirst", RanksTheStrongestFirst);
+  quick_blue::test::Run("ReturnsAtMostKDevices", ReturnsAtMostKDevices);
+  quick_blue::test::Run("DropsExpiredDevicesInSnapshot",
+                        DropsExpiredDevicesInSnapshot);
+  return quick_blue::test::Result();
+}
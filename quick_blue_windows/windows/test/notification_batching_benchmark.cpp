@@ -0,0 +1,224 @@
+// Sustained notification rate and delivery latency with and without
+// per-device batching. A simulated peripheral notifies on several
+// characteristics of several devices; each notification becomes an entry of
+// a batch or a message of its own, built as GattCharacteristic_ValueChanged
+// does, and the platform thread encodes every message with the standard
+// codec. Latency is measured from the notification until the platform thread
+// has encoded the message holding it. The channel crossing into the engine
+// is not part of it, see SimulatedPlatformThread.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "batcher.h"
+#include "latency_histogram.h"
+#include "test_support.h"
+
+using quick_blue::Batcher;
+using quick_blue::LatencyHistogram;
+using quick_blue::test::Clock;
+using quick_blue::test::EncodableList;
+using quick_blue::test::EncodableMap;
+using quick_blue::test::EncodableValue;
+using quick_blue::test::SimulatedPlatformThread;
+
+namespace {
+
+int64_t ToMicroseconds(Clock::time_point time) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             time.time_since_epoch())
+      .count();
+}
+
+// Sends notifications from the platform thread and records the latency of
+// each once the message holding it was sent. Thread-safe.
+class Delivery {
+public:
+  // A batch entry as GattCharacteristic_ValueChanged builds it.
+  static EncodableValue Entry(int64_t characteristicHandle,
+                              Clock::time_point timestamp,
+                              std::vector<uint8_t> value) {
+    EncodableList entry;
+    entry.reserve(3);
+    entry.emplace_back(characteristicHandle);
+    entry.emplace_back(ToMicroseconds(timestamp));
+    entry.emplace_back(std::move(value));
+    return entry;
+  }
+
+  // SendNotificationBatch
+  void SendBatch(uint64_t address, std::vector<EncodableValue> batch) {
+    if (batch.empty()) {
+      return;
+    }
+    std::vector<int64_t> timestamps;
+    timestamps.reserve(batch.size());
+    for (auto &entry : batch) {
+      timestamps.push_back(
+          std::get<int64_t>(std::get<EncodableList>(entry)[1]));
+    }
+    auto sent = platform.Send(EncodableMap{
+        {"deviceId", std::to_string(address)},
+        {"characteristicValues", EncodableList(std::move(batch))},
+    });
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto timestamp : timestamps) {
+      latency.Record(std::chrono::microseconds(ToMicroseconds(sent) -
+                                               timestamp));
+    }
+  }
+
+  // The regular message of one notification.
+  void Send(uint64_t address, int64_t characteristicHandle,
+            Clock::time_point timestamp, std::vector<uint8_t> value) {
+    EncodableMap characteristicValue;
+    characteristicValue[EncodableValue("characteristicHandle")] =
+        EncodableValue(characteristicHandle);
+    characteristicValue[EncodableValue("value")] =
+        EncodableValue(std::move(value));
+    EncodableMap fields;
+    fields[EncodableValue("deviceId")] =
+        EncodableValue(std::to_string(address));
+    fields[EncodableValue("characteristicValue")] =
+        EncodableValue(std::move(characteristicValue));
+    auto sent = platform.Send(fields);
+    std::lock_guard<std::mutex> lock(mutex);
+    latency.Record(std::chrono::duration_cast<std::chrono::microseconds>(
+        sent - timestamp));
+  }
+
+  SimulatedPlatformThread platform;
+  std::mutex mutex;
+  LatencyHistogram latency;
+};
+
+struct Peripheral {
+  size_t devices;
+  size_t characteristics;
+  // Notifications per second and characteristic; 0 floods.
+  int rateHz;
+};
+
+struct Result {
+  double seconds;
+  uint64_t notifications;
+  uint64_t messages;
+  double busySeconds;
+  LatencyHistogram latency;
+};
+
+Result Run(const Peripheral &peripheral, Clock::duration duration,
+           std::chrono::milliseconds batchInterval, size_t maxEntries) {
+  Delivery delivery;
+  bool batching = batchInterval.count() > 0;
+  std::vector<std::unique_ptr<Batcher<EncodableValue>>> batchers;
+  for (size_t d = 0; d < peripheral.devices; ++d) {
+    batchers.push_back(std::make_unique<Batcher<EncodableValue>>(maxEntries));
+  }
+
+  std::atomic<bool> running{true};
+  std::thread flusher;
+  if (batching) {
+    flusher = std::thread([&] {
+      while (running) {
+        std::this_thread::sleep_for(batchInterval);
+        for (size_t d = 0; d < batchers.size(); ++d) {
+          delivery.SendBatch(d, batchers[d]->Drain());
+        }
+      }
+    });
+  }
+
+  std::atomic<uint64_t> notifications{0};
+  auto start = Clock::now();
+  auto end = start + duration;
+  std::vector<std::thread> devices;
+  for (size_t d = 0; d < peripheral.devices; ++d) {
+    devices.emplace_back([&, d] {
+      auto period = peripheral.rateHz > 0
+                        ? std::chrono::microseconds(1000000 / peripheral.rateHz)
+                        : std::chrono::microseconds(0);
+      auto next = start;
+      uint8_t counter = 0;
+      while (Clock::now() < end) {
+        for (size_t c = 0; c < peripheral.characteristics; ++c) {
+          auto timestamp = Clock::now();
+          std::vector<uint8_t> value(20, counter++);
+          notifications.fetch_add(1, std::memory_order_relaxed);
+          if (batching) {
+            auto entry =
+                Delivery::Entry(int64_t(c), timestamp, std::move(value));
+            delivery.SendBatch(d, batchers[d]->Add(std::move(entry)));
+          } else {
+            delivery.Send(d, int64_t(c), timestamp, std::move(value));
+          }
+        }
+        if (period.count() > 0) {
+          next += period;
+          std::this_thread::sleep_until(next);
+        }
+      }
+    });
+  }
+  for (auto &device : devices) {
+    device.join();
+  }
+  auto seconds = quick_blue::test::SecondsSince(start);
+  running = false;
+  if (flusher.joinable()) {
+    flusher.join();
+  }
+  for (size_t d = 0; d < batchers.size(); ++d) {
+    delivery.SendBatch(d, batchers[d]->Drain());
+  }
+  return Result{seconds, notifications.load(), delivery.platform.Messages(),
+                delivery.platform.BusySeconds(), delivery.latency};
+}
+
+void Print(const char *label, const Result &result) {
+  std::printf("%-22s %9.0f notifications/s %8.0f messages/s %6.2f us "
+              "encoding  p50 %6lld us  p99 %6lld us\n",
+              label, result.latency.Count() / result.seconds,
+              result.messages / result.seconds,
+              result.busySeconds * 1e6 / result.latency.Count(),
+              (long long)result.latency.Quantile(0.5).count(),
+              (long long)result.latency.Quantile(0.99).count());
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  bool quick = quick_blue::test::QuickRun(argc, argv);
+  auto duration = quick ? std::chrono::milliseconds(200)
+                        : std::chrono::milliseconds(2000);
+  const auto kInterval = std::chrono::milliseconds(10);
+
+  // IMU sensors: 8 devices, 3 characteristics each at 200 Hz.
+  Peripheral imu{8, 3, 200};
+  auto pacedUnbatched = Run(imu, duration, std::chrono::milliseconds(0), 1);
+  auto pacedBatched = Run(imu, duration, kInterval, 64);
+  // The same peripheral notifying as fast as it can.
+  Peripheral flood{8, 3, 0};
+  auto floodUnbatched = Run(flood, duration, std::chrono::milliseconds(0), 1);
+  auto floodBatched = Run(flood, duration, kInterval, 64);
+
+  Print("200 Hz unbatched", pacedUnbatched);
+  Print("200 Hz batched 10 ms", pacedBatched);
+  Print("flood unbatched", floodUnbatched);
+  Print("flood batched 10 ms", floodBatched);
+
+  for (auto *result :
+       {&pacedUnbatched, &pacedBatched, &floodUnbatched, &floodBatched}) {
+    CHECK_EQ(result->latency.Count(), result->notifications);
+  }
+  CHECK(pacedBatched.messages < pacedUnbatched.messages);
+  CHECK(floodBatched.latency.Count() > floodUnbatched.latency.Count());
+  return quick_blue::test::Result();
+}
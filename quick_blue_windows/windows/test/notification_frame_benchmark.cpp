@@ -0,0 +1,227 @@
+// Encode and decode cost of a 20-byte notification as a packed
+// NotificationFrame and as the map message of the regular channel. The map
+// path is modelled on StandardMessageCodec: the message is built from
+// string keys with the decimal address and the UUID string, serialized with
+// the codec's type tags and size prefixes, and read back field by field.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "notification_frame.h"
+#include "test_support.h"
+
+using quick_blue::NotificationFrame;
+using quick_blue::test::Clock;
+
+namespace {
+
+struct Value;
+using Map = std::vector<std::pair<Value, Value>>;
+struct Value {
+  std::variant<std::monostate, int64_t, std::string, std::vector<uint8_t>,
+               Map>
+      data;
+};
+
+// Type tags of StandardMessageCodec.
+enum Tag : uint8_t {
+  kNull = 0,
+  kInt64 = 4,
+  kString = 7,
+  kUint8List = 8,
+  kMap = 13,
+};
+
+class Writer {
+public:
+  explicit Writer(std::vector<uint8_t> &out) : out(out) {}
+
+  void Write(const Value &value) {
+    if (auto integer = std::get_if<int64_t>(&value.data)) {
+      out.push_back(kInt64);
+      Raw(integer, 8);
+    } else if (auto text = std::get_if<std::string>(&value.data)) {
+      out.push_back(kString);
+      Size(text->size());
+      Raw(text->data(), text->size());
+    } else if (auto bytes = std::get_if<std::vector<uint8_t>>(&value.data)) {
+      out.push_back(kUint8List);
+      Size(bytes->size());
+      Raw(bytes->data(), bytes->size());
+    } else if (auto map = std::get_if<Map>(&value.data)) {
+      out.push_back(kMap);
+      Size(map->size());
+      for (auto &entry : *map) {
+        Write(entry.first);
+        Write(entry.second);
+      }
+    } else {
+      out.push_back(kNull);
+    }
+  }
+
+private:
+  void Size(size_t size) {
+    if (size < 254) {
+      out.push_back(uint8_t(size));
+    } else {
+      out.push_back(254);
+      uint16_t value = uint16_t(size);
+      Raw(&value, 2);
+    }
+  }
+
+  void Raw(const void *data, size_t size) {
+    auto bytes = static_cast<const uint8_t *>(data);
+    out.insert(out.end(), bytes, bytes + size);
+  }
+
+  std::vector<uint8_t> &out;
+};
+
+class Reader {
+public:
+  Reader(const uint8_t *data, size_t size) : data(data), size(size) {}
+
+  Value Read() {
+    Value value;
+    if (position >= size) {
+      return value;
+    }
+    switch (data[position++]) {
+    case kInt64: {
+      int64_t integer;
+      std::memcpy(&integer, data + position, 8);
+      position += 8;
+      value.data = integer;
+      break;
+    }
+    case kString: {
+      auto length = Size();
+      value.data = std::string(reinterpret_cast<const char *>(data) + position,
+                               length);
+      position += length;
+      break;
+    }
+    case kUint8List: {
+      auto length = Size();
+      value.data =
+          std::vector<uint8_t>(data + position, data + position + length);
+      position += length;
+      break;
+    }
+    case kMap: {
+      Map map;
+      auto length = Size();
+      for (size_t i = 0; i < length; ++i) {
+        auto key = Read();
+        map.emplace_back(std::move(key), Read());
+      }
+      value.data = std::move(map);
+      break;
+    }
+    default:
+      break;
+    }
+    return value;
+  }
+
+private:
+  size_t Size() {
+    size_t length = data[position++];
+    if (length == 254) {
+      uint16_t value;
+      std::memcpy(&value, data + position, 2);
+      position += 2;
+      length = value;
+    }
+    return length;
+  }
+
+  const uint8_t *data;
+  size_t size;
+  size_t position = 0;
+};
+
+Value Text(const char *text) { return Value{std::string(text)}; }
+
+const Value *Find(const Value &map, const char *key) {
+  for (auto &entry : std::get<Map>(map.data)) {
+    if (std::get<std::string>(entry.first.data) == key) {
+      return &entry.second;
+    }
+  }
+  return nullptr;
+}
+
+const uint64_t kAddress = 0xC0FFEE123456ull;
+const char *kUuid = "0000fff1-0000-1000-8000-00805f9b34fb";
+
+// Builds, encodes and decodes the map message; returns its encoded size.
+size_t MapRoundTrip(const std::vector<uint8_t> &payload,
+                    std::vector<uint8_t> &buffer, uint64_t &checksum) {
+  Map characteristicValue;
+  characteristicValue.emplace_back(Text("characteristic"), Text(kUuid));
+  characteristicValue.emplace_back(Text("characteristicHandle"),
+                                   Value{int64_t(7)});
+  characteristicValue.emplace_back(Text("value"), Value{payload});
+  Map fields;
+  fields.emplace_back(Text("deviceId"), Value{std::to_string(kAddress)});
+  fields.emplace_back(Text("characteristicValue"),
+                      Value{std::move(characteristicValue)});
+
+  buffer.clear();
+  Writer(buffer).Write(Value{std::move(fields)});
+
+  auto decoded = Reader(buffer.data(), buffer.size()).Read();
+  auto &deviceId = std::get<std::string>(Find(decoded, "deviceId")->data);
+  auto &inner = *Find(decoded, "characteristicValue");
+  auto &uuid = std::get<std::string>(Find(inner, "characteristic")->data);
+  auto &value = std::get<std::vector<uint8_t>>(Find(inner, "value")->data);
+  checksum += std::stoull(deviceId) + uuid.size() + value[0];
+  return buffer.size();
+}
+
+size_t FrameRoundTrip(const std::vector<uint8_t> &payload,
+                      std::vector<uint8_t> &buffer, uint64_t &checksum) {
+  buffer.clear();
+  NotificationFrame{3, 7, 1234567, payload.data(), uint16_t(payload.size())}
+      .EncodeTo(buffer);
+
+  size_t offset = 0;
+  NotificationFrame frame;
+  NotificationFrame::DecodeFrom(buffer.data(), buffer.size(), offset, frame);
+  checksum += frame.deviceHandle + frame.characteristicHandle +
+              frame.payload[0];
+  return buffer.size();
+}
+
+template <typename RoundTrip>
+void Measure(const char *label, RoundTrip roundTrip, int iterations) {
+  std::vector<uint8_t> payload(20, 0x42);
+  std::vector<uint8_t> buffer;
+  uint64_t checksum = 0;
+  size_t size = 0;
+  auto start = Clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    size = roundTrip(payload, buffer, checksum);
+  }
+  auto seconds = quick_blue::test::SecondsSince(start);
+  std::printf("%-6s %3zu bytes/message %8.1f ns encode+decode\n", label, size,
+              seconds * 1e9 / iterations);
+  CHECK(checksum > 0);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  int iterations = quick_blue::test::QuickRun(argc, argv) ? 10000 : 2000000;
+  Measure("map", MapRoundTrip, iterations);
+  Measure("frame", FrameRoundTrip, iterations);
+  return quick_blue::test::Result();
+}
@@ -0,0 +1,99 @@
+#include <cstdint>
+#include <vector>
+
+#include "notification_frame.h"
+#include "test_support.h"
+
+using quick_blue::NotificationFrame;
+
+namespace {
+
+void EncodesLittleEndianHeader() {
+  std::vector<uint8_t> payload{0xDE, 0xAD};
+  NotificationFrame frame{0x0102030405060708ull, 0x0A0B, 0x1122334455667788ll,
+                          payload.data(), uint16_t(payload.size())};
+  std::vector<uint8_t> out;
+  frame.EncodeTo(out);
+  CHECK_EQ(out.size(), NotificationFrame::kHeaderSize + 2);
+  CHECK(out == (std::vector<uint8_t>{
+                   0x08, 0x07, 0x06, 0x05, 0x04, 0x03, 0x02, 0x01, // device
+                   0x0B, 0x0A,                                     // char
+                   0x02, 0x00,                                     // length
+                   0x88, 0x77, 0x66, 0x55, 0x44, 0x33, 0x22, 0x11, // time
+                   0xDE, 0xAD}));
+}
+
+void RoundTripsSeveralFrames() {
+  std::vector<std::vector<uint8_t>> payloads{
+      {}, {1}, std::vector<uint8_t>(20, 7), std::vector<uint8_t>(512, 9)};
+  std::vector<uint8_t> message;
+  for (size_t i = 0; i < payloads.size(); ++i) {
+    NotificationFrame{i + 1, uint16_t(100 + i), -int64_t(i),
+                      payloads[i].data(), uint16_t(payloads[i].size())}
+        .EncodeTo(message);
+  }
+
+  size_t offset = 0;
+  NotificationFrame frame;
+  for (size_t i = 0; i < payloads.size(); ++i) {
+    CHECK(NotificationFrame::DecodeFrom(message.data(), message.size(), offset,
+                                        frame));
+    CHECK_EQ(frame.deviceHandle, i + 1);
+    CHECK_EQ(frame.characteristicHandle, 100 + i);
+    CHECK_EQ(frame.timestampUs, -int64_t(i));
+    CHECK(std::vector<uint8_t>(frame.payload,
+                               frame.payload + frame.payloadLength) ==
+          payloads[i]);
+  }
+  CHECK_EQ(offset, message.size());
+  CHECK(!NotificationFrame::DecodeFrom(message.data(), message.size(), offset,
+                                       frame));
+}
+
+void RejectsIncompleteFrames() {
+  std::vector<uint8_t> payload(10, 3);
+  std::vector<uint8_t> message;
+  NotificationFrame{1, 2, 3, payload.data(), uint16_t(payload.size())}
+      .EncodeTo(message);
+  NotificationFrame frame;
+  for (size_t length = 0; length < message.size(); ++length) {
+    size_t offset = 0;
+    CHECK(!NotificationFrame::DecodeFrom(message.data(), length, offset,
+                                         frame));
+    CHECK_EQ(offset, 0u);
+  }
+}
+
+void HoldsTheLargestPayload() {
+  std::vector<uint8_t> payload(NotificationFrame::kMaxPayload, 0x5A);
+  NotificationFrame encoded{1, 2, 3, payload.data(),
+                            uint16_t(payload.size())};
+  std::vector<uint8_t> message;
+  encoded.EncodeTo(message);
+  size_t offset = 0;
+  NotificationFrame frame;
+  CHECK(NotificationFrame::DecodeFrom(message.data(), message.size(), offset,
+                                      frame));
+  CHECK_EQ(frame.payloadLength, NotificationFrame::kMaxPayload);
+}
+
+// Handles grow past 16 bits once a device was refreshed often enough; such
+// values must go out as regular messages.
+void RejectsWhatDoesNotFit() {
+  CHECK(NotificationFrame::Fits(0, 0));
+  CHECK(NotificationFrame::Fits(0xFFFF, NotificationFrame::kMaxPayload));
+  CHECK(!NotificationFrame::Fits(0x10000, 20));
+  CHECK(!NotificationFrame::Fits(0xFFFFFFFF, 20));
+  CHECK(!NotificationFrame::Fits(1, NotificationFrame::kMaxPayload + 1));
+}
+
+} // namespace
+
+int main() {
+  quick_blue::test::Run("EncodesLittleEndianHeader", EncodesLittleEndianHeader);
+  quick_blue::test::Run("RoundTripsSeveralFrames", RoundTripsSeveralFrames);
+  quick_blue::test::Run("RejectsIncompleteFrames", RejectsIncompleteFrames);
+  quick_blue::test::Run("HoldsTheLargestPayload", HoldsTheLargestPayload);
+  quick_blue::test::Run("RejectsWhatDoesNotFit", RejectsWhatDoesNotFit);
+  return quick_blue::test::Result();
+}
@@ -0,0 +1,113 @@
+// Cost of the outbound queue with the capacity and batch size of the
+// plugin. "enqueue" is the time a producer spends in Post() while other
+// producers post at once and the loop thread drains, per percentile.
+// "drain" is how many messages per second the loop thread runs: messages
+// are queued while there is no window, then the window comes and the loop
+// drains them in batches, waking itself between batches.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "outbound_dispatcher.h"
+#include "simulated_message_loop.h"
+#include "test_support.h"
+
+using quick_blue::OutboundDispatcher;
+using quick_blue::test::Clock;
+using quick_blue::test::SimulatedMessageLoop;
+
+namespace {
+
+const size_t kCapacity = 4096;
+const size_t kBatch = 256;
+
+void WaitUntilSettled(OutboundDispatcher &dispatcher) {
+  while (true) {
+    auto counters = dispatcher.GetCounters();
+    if (counters.sent + counters.dropped == counters.posted) {
+      return;
+    }
+    std::this_thread::yield();
+  }
+}
+
+void MeasureEnqueue(size_t producers, size_t perProducer, bool droppable) {
+  SimulatedMessageLoop loop(kCapacity, kBatch);
+  loop.Attach();
+  std::atomic<uint64_t> ran{0};
+  std::vector<std::vector<double>> latencies(producers);
+  std::vector<std::thread> threads;
+  for (size_t p = 0; p < producers; ++p) {
+    threads.emplace_back([&, p] {
+      auto &samples = latencies[p];
+      samples.reserve(perProducer);
+      for (size_t i = 0; i < perProducer; ++i) {
+        auto start = Clock::now();
+        loop.Dispatcher().Post(
+            [&ran] { ran.fetch_add(1, std::memory_order_relaxed); },
+            droppable);
+        samples.push_back(
+            std::chrono::duration<double, std::nano>(Clock::now() - start)
+                .count());
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  WaitUntilSettled(loop.Dispatcher());
+  std::vector<double> samples;
+  for (auto &producer : latencies) {
+    samples.insert(samples.end(), producer.begin(), producer.end());
+  }
+  auto counters = loop.Dispatcher().GetCounters();
+  std::printf("enqueue %-9s %zu producers  p50 %6.0f ns  p99 %6.0f ns  "
+              "p99.9 %7.0f ns  dropped %5.1f%%\n",
+              droppable ? "droppable" : "essential", producers,
+              quick_blue::test::Percentile(samples, 0.5),
+              quick_blue::test::Percentile(samples, 0.99),
+              quick_blue::test::Percentile(samples, 0.999),
+              100.0 * counters.dropped / counters.posted);
+  CHECK_EQ(counters.posted, producers * perProducer);
+  CHECK_EQ(counters.sent + counters.dropped, counters.posted);
+  if (!droppable) {
+    CHECK_EQ(counters.dropped, 0u);
+  }
+}
+
+void MeasureDrain(size_t messages) {
+  SimulatedMessageLoop loop(kCapacity, kBatch);
+  auto &dispatcher = loop.Dispatcher();
+  uint64_t ran = 0;
+  for (size_t i = 0; i < messages; ++i) {
+    dispatcher.Post([&ran] { ran++; }, false);
+  }
+  auto start = Clock::now();
+  loop.Attach();
+  WaitUntilSettled(dispatcher);
+  auto seconds = quick_blue::test::SecondsSince(start);
+  auto counters = dispatcher.GetCounters();
+  std::printf("drain   %zu messages  %6.1f M/s  %llu batches\n", messages,
+              messages / seconds / 1e6,
+              (unsigned long long)counters.batches);
+  CHECK_EQ(counters.sent, messages);
+  CHECK(counters.maxBatch <= kBatch);
+  CHECK(counters.wakesMissed > 0);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  auto quick = quick_blue::test::QuickRun(argc, argv);
+  size_t perProducer = quick ? 2000 : 200000;
+  for (size_t producers : {1, 4, 8}) {
+    MeasureEnqueue(producers, perProducer, false);
+    MeasureEnqueue(producers, perProducer, true);
+  }
+  MeasureDrain(quick ? 20000 : 2000000);
+  return quick_blue::test::Result();
+}
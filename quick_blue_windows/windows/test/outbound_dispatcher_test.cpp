@@ -0,0 +1,223 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "mpsc_queue.h"
+#include "outbound_dispatcher.h"
+#include "simulated_message_loop.h"
+#include "test_support.h"
+
+using quick_blue::MpscQueue;
+using quick_blue::OutboundDispatcher;
+using quick_blue::OverflowPolicy;
+using quick_blue::test::SimulatedMessageLoop;
+
+namespace {
+
+const size_t kProducers = 8;
+
+// What the messages of a run saw on the loop thread: per producer, the
+// sequence numbers in the order they ran.
+class Received {
+public:
+  explicit Received(SimulatedMessageLoop &loop)
+      : loop(loop), sequences(kProducers) {}
+
+  // A message of |producer| that records |sequence| when it runs.
+  std::function<void()> Message(size_t producer, uint64_t sequence) {
+    return [this, producer, sequence] {
+      offLoop += loop.OnLoopThread() ? 0 : 1;
+      std::lock_guard<std::mutex> lock(mutex);
+      sequences[producer].push_back(sequence);
+    };
+  }
+
+  size_t Count() {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t count = 0;
+    for (auto &producer : sequences) {
+      count += producer.size();
+    }
+    return count;
+  }
+
+  // Every producer's messages ran in the order posted, and all of them
+  // unless |gaps| allows some to be dropped.
+  void CheckOrder(size_t perProducer, bool gaps) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &producer : sequences) {
+      if (!gaps) {
+        CHECK_EQ(producer.size(), perProducer);
+      }
+      for (size_t i = 1; i < producer.size(); ++i) {
+        CHECK(producer[i] > producer[i - 1]);
+      }
+    }
+    CHECK_EQ(offLoop.load(), 0u);
+  }
+
+private:
+  SimulatedMessageLoop &loop;
+  std::mutex mutex;
+  std::vector<std::vector<uint64_t>> sequences;
+  std::atomic<uint64_t> offLoop{0};
+};
+
+// Waits until every message posted was sent or dropped, or ten seconds
+// passed. The counters are relaxed, so what the messages recorded is read
+// under the lock of Received afterwards.
+void WaitUntilSettled(OutboundDispatcher &dispatcher) {
+  auto start = quick_blue::test::Clock::now();
+  while (quick_blue::test::SecondsSince(start) < 10) {
+    auto counters = dispatcher.GetCounters();
+    if (counters.sent + counters.dropped == counters.posted) {
+      return;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+// Posts |perProducer| messages from each of kProducers threads at once.
+// Every |droppableEvery|th message is droppable, none if 0.
+void Flood(SimulatedMessageLoop &loop, Received &received,
+           size_t perProducer, size_t droppableEvery) {
+  std::vector<std::thread> producers;
+  for (size_t p = 0; p < kProducers; ++p) {
+    producers.emplace_back([&, p] {
+      for (size_t i = 0; i < perProducer; ++i) {
+        auto droppable = droppableEvery && i % droppableEvery == 0;
+        loop.Dispatcher().Post(received.Message(p, i), droppable);
+      }
+    });
+  }
+  for (auto &producer : producers) {
+    producer.join();
+  }
+}
+
+void PassesEveryEntryOnceThroughTheRing() {
+  const size_t kPerProducer = 50000;
+  MpscQueue<uint64_t> queue(64);
+  std::atomic<size_t> done{0};
+  std::vector<std::thread> producers;
+  for (size_t p = 0; p < kProducers; ++p) {
+    producers.emplace_back([&, p] {
+      for (uint64_t i = 0; i < kPerProducer; ++i) {
+        auto value = (uint64_t(p) << 32) | i;
+        while (!queue.TryPush(value)) {
+          std::this_thread::yield();
+        }
+      }
+      done++;
+    });
+  }
+  std::vector<uint64_t> next(kProducers, 0);
+  size_t popped = 0;
+  uint64_t value;
+  while (popped < kProducers * kPerProducer) {
+    if (!queue.TryPop(value)) {
+      std::this_thread::yield();
+      continue;
+    }
+    auto producer = size_t(value >> 32);
+    CHECK(producer < kProducers);
+    CHECK_EQ(value & 0xFFFFFFFF, next[producer]);
+    next[producer] = (value & 0xFFFFFFFF) + 1;
+    popped++;
+  }
+  for (auto &producer : producers) {
+    producer.join();
+  }
+  CHECK_EQ(done.load(), kProducers);
+  CHECK(!queue.TryPop(value));
+  CHECK_EQ(queue.Size(), 0u);
+}
+
+// Essential messages overflow the ring into the side list; none may be lost
+// or run out of order, and all run on the loop thread.
+void RunsEssentialMessagesInOrderOnTheLoop() {
+  const size_t kPerProducer = 20000;
+  SimulatedMessageLoop loop(64, 32);
+  loop.Attach();
+  Received received(loop);
+  Flood(loop, received, kPerProducer, 0);
+  WaitUntilSettled(loop.Dispatcher());
+  received.CheckOrder(kPerProducer, false);
+  auto counters = loop.Dispatcher().GetCounters();
+  CHECK_EQ(counters.posted, kProducers * kPerProducer);
+  CHECK_EQ(counters.sent, counters.posted);
+  CHECK_EQ(counters.dropped, 0u);
+  CHECK(counters.maxBatch <= 32);
+  CHECK_EQ(counters.wakesMissed, 0u);
+}
+
+void CountsEveryDroppedMessage() {
+  const size_t kPerProducer = 20000;
+  for (auto policy :
+       {OverflowPolicy::DropNewest, OverflowPolicy::DropOldest}) {
+    SimulatedMessageLoop loop(64, 16);
+    auto &dispatcher = loop.Dispatcher();
+    dispatcher.SetOverflowPolicy(policy);
+    loop.Attach();
+    Received received(loop);
+    Flood(loop, received, kPerProducer, 2);
+    WaitUntilSettled(dispatcher);
+    received.CheckOrder(kPerProducer, true);
+    auto counters = dispatcher.GetCounters();
+    CHECK_EQ(counters.posted, kProducers * kPerProducer);
+    CHECK_EQ(counters.sent + counters.dropped, counters.posted);
+    CHECK_EQ(received.Count(), counters.sent);
+    // Only droppable messages, half of them, may be lost.
+    CHECK(counters.dropped <= counters.posted / 2);
+  }
+}
+
+// Without a window nothing is drained, on the loop thread or elsewhere.
+// Essential messages wait, droppable ones fill the ring and the rest is
+// dropped and counted, until the window comes.
+void KeepsMessagesQueuedWithoutAWindow() {
+  const size_t kPerProducer = 1000;
+  SimulatedMessageLoop loop(64, 32);
+  Received received(loop);
+  Flood(loop, received, kPerProducer, 2);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  auto &dispatcher = loop.Dispatcher();
+  auto counters = dispatcher.GetCounters();
+  CHECK_EQ(received.Count(), 0u);
+  CHECK_EQ(counters.sent, 0u);
+  CHECK(counters.wakesMissed > 0);
+  CHECK_EQ(loop.WakesPosted(), 0u);
+  CHECK_EQ(counters.dropped, kProducers * kPerProducer / 2 - 64);
+
+  loop.Attach();
+  auto essential = kProducers * kPerProducer / 2;
+  WaitUntilSettled(dispatcher);
+  counters = dispatcher.GetCounters();
+  CHECK_EQ(counters.sent, essential + 64);
+  CHECK_EQ(dispatcher.QueueDepth(), 0u);
+  received.CheckOrder(kPerProducer, true);
+
+  // Once attached, posts wake the loop again.
+  dispatcher.Post(received.Message(0, kPerProducer), false);
+  WaitUntilSettled(dispatcher);
+  CHECK_EQ(dispatcher.GetCounters().sent, essential + 65);
+  CHECK_EQ(received.Count(), essential + 65);
+  CHECK(loop.WakesPosted() > 0);
+}
+
+} // namespace
+
+int main() {
+  quick_blue::test::Run("PassesEveryEntryOnceThroughTheRing",
+                        PassesEveryEntryOnceThroughTheRing);
+  quick_blue::test::Run("RunsEssentialMessagesInOrderOnTheLoop",
+                        RunsEssentialMessagesInOrderOnTheLoop);
+  quick_blue::test::Run("CountsEveryDroppedMessage", CountsEveryDroppedMessage);
+  quick_blue::test::Run("KeepsMessagesQueuedWithoutAWindow",
+                        KeepsMessagesQueuedWithoutAWindow);
+  return quick_blue::test::Result();
+}
@@ -0,0 +1,177 @@
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "fake_advertisement_source.h"
+#include "scan_device_table.h"
+#include "test_support.h"
+
+using quick_blue::Advertisement;
+using quick_blue::ScanDeviceTable;
+using quick_blue::ScanFilter;
+using quick_blue::test::FakeAdvertisementSource;
+using quick_blue::test::MakeAdvertisement;
+using NameStatus = ScanDeviceTable::NameStatus;
+
+namespace {
+
+const auto kStart =
+    ScanDeviceTable::Clock::time_point{} + std::chrono::hours(1);
+
+void ResolvesOnceThenServesFromCache() {
+  ScanDeviceTable table(std::chrono::minutes(5), 16);
+  auto first = table.LookupName(1, kStart);
+  CHECK(first.status == NameStatus::kResolve);
+  CHECK(!first.name);
+
+  auto concurrent = table.LookupName(1, kStart);
+  CHECK(concurrent.status == NameStatus::kPending);
+
+  table.StoreName(1, std::string("Thermometer"), kStart);
+  auto cached = table.LookupName(1, kStart + std::chrono::seconds(1));
+  CHECK(cached.status == NameStatus::kCached);
+  CHECK(cached.name == std::string("Thermometer"));
+
+  CHECK_EQ(table.LookupsIssued(), 1u);
+  CHECK_EQ(table.LookupsAvoided(), 2u);
+}
+
+void ResolvesAgainAfterTtl() {
+  ScanDeviceTable table(std::chrono::seconds(10), 16);
+  table.LookupName(1, kStart);
+  table.StoreName(1, std::string("Old"), kStart);
+
+  auto expired = table.LookupName(1, kStart + std::chrono::seconds(10));
+  CHECK(expired.status == NameStatus::kResolve);
+  // The stale name is still handed out while the new resolve runs.
+  CHECK(expired.name == std::string("Old"));
+}
+
+void EvictsOldestResolvedEntry() {
+  ScanDeviceTable table(std::chrono::minutes(5), 3);
+  for (uint64_t address = 1; address <= 3; ++address) {
+    auto now = kStart + std::chrono::seconds(address);
+    table.LookupName(address, now);
+    table.StoreName(address, std::nullopt, now);
+  }
+  auto fourth = table.LookupName(4, kStart + std::chrono::seconds(4));
+  CHECK(fourth.status == NameStatus::kResolve);
+  CHECK_EQ(table.Size(), 3u);
+  CHECK(table.LookupName(2, kStart + std::chrono::seconds(5)).status ==
+        NameStatus::kCached);
+  CHECK(table.LookupName(3, kStart + std::chrono::seconds(5)).status ==
+        NameStatus::kCached);
+  // Address 1 was resolved first and had to make room.
+  CHECK(table.LookupName(1, kStart + std::chrono::seconds(5)).status ==
+        NameStatus::kResolve);
+}
+
+void RefusesNewAddressesWhileFullOfPendingResolves() {
+  ScanDeviceTable table(std::chrono::minutes(5), 4);
+  for (uint64_t address = 1; address <= 4; ++address) {
+    CHECK(table.LookupName(address, kStart).status == NameStatus::kResolve);
+  }
+  for (uint64_t address = 5; address <= 100; ++address) {
+    auto lookup = table.LookupName(address, kStart);
+    CHECK(lookup.status == NameStatus::kFull);
+    CHECK(!lookup.name);
+  }
+  CHECK_EQ(table.Size(), 4u);
+  CHECK_EQ(table.LookupsIssued(), 4u);
+  CHECK_EQ(table.LookupsRefused(), 96u);
+
+  // Once a resolve completes its entry can make room again.
+  table.StoreName(2, std::string("Done"), kStart);
+  CHECK(table.LookupName(5, kStart).status == NameStatus::kResolve);
+  CHECK_EQ(table.Size(), 4u);
+}
+
+void DiscardsResultsAfterClear() {
+  ScanDeviceTable table(std::chrono::minutes(5), 4);
+  table.LookupName(1, kStart);
+  table.Clear();
+  table.StoreName(1, std::string("Late"), kStart);
+  CHECK_EQ(table.Size(), 0u);
+}
+
+// Drives the table the way OnAdvertisement does, with a fake source calling
+// back from several threads at once.
+void FakeSourceResolvesEachAddressOnce() {
+  const uint64_t kDevices = 40;
+  std::vector<Advertisement> advertisements;
+  for (uint64_t address = 1; address <= kDevices; ++address) {
+    auto rssi = int16_t(-40 - int(address));
+    advertisements.push_back(
+        MakeAdvertisement(address, rssi, "Beacon" + std::to_string(address)));
+  }
+
+  ScanDeviceTable table(std::chrono::minutes(5), 1024);
+  FakeAdvertisementSource source(advertisements, 4, 50);
+  std::mutex resolvedMutex;
+  std::multiset<uint64_t> resolved;
+  std::atomic<uint64_t> forwarded{0};
+  source.Start([&](const Advertisement &advertisement) {
+    auto now = ScanDeviceTable::Clock::now();
+    auto lookup = table.LookupName(advertisement.address, now);
+    if (lookup.status == NameStatus::kResolve) {
+      {
+        std::lock_guard<std::mutex> lock(resolvedMutex);
+        resolved.insert(advertisement.address);
+      }
+      table.StoreName(advertisement.address,
+                      std::string(advertisement.data.LocalName()),
+                      ScanDeviceTable::Clock::now());
+    }
+    forwarded.fetch_add(1);
+  });
+  source.Wait();
+
+  CHECK_EQ(source.Delivered(), kDevices * 4 * 50);
+  CHECK_EQ(forwarded.load(), kDevices * 4 * 50);
+  CHECK_EQ(resolved.size(), kDevices);
+  for (uint64_t address = 1; address <= kDevices; ++address) {
+    CHECK_EQ(resolved.count(address), 1u);
+  }
+  CHECK_EQ(table.LookupsIssued(), kDevices);
+  CHECK_EQ(table.LookupsAvoided(), kDevices * 4 * 50 - kDevices);
+}
+
+void FakeSourceAppliesFilterHint() {
+  std::vector<Advertisement> advertisements{
+      MakeAdvertisement(1, -50, "Near", 0x004C),
+      MakeAdvertisement(2, -90, "Far", 0x004C),
+      MakeAdvertisement(3, -50, "Other", 0x0059),
+  };
+  ScanFilter filter;
+  filter.companyIds = {0x004C};
+  filter.minRssi = -70;
+
+  FakeAdvertisementSource source(advertisements, 1, 1);
+  source.SetFilter(filter);
+  std::vector<uint64_t> seen;
+  source.Start([&seen](const Advertisement &advertisement) {
+    seen.push_back(advertisement.address);
+  });
+  source.Wait();
+  CHECK_EQ(seen, std::vector<uint64_t>{1});
+}
+
+} // namespace
+
+int main() {
+  quick_blue::test::Run("ResolvesOnceThenServesFromCache",
+                        ResolvesOnceThenServesFromCache);
+  quick_blue::test::Run("ResolvesAgainAfterTtl", ResolvesAgainAfterTtl);
+  quick_blue::test::Run("EvictsOldestResolvedEntry", EvictsOldestResolvedEntry);
+  quick_blue::test::Run("RefusesNewAddressesWhileFullOfPendingResolves",
+                        RefusesNewAddressesWhileFullOfPendingResolves);
+  quick_blue::test::Run("DiscardsResultsAfterClear", DiscardsResultsAfterClear);
+  quick_blue::test::Run("FakeSourceResolvesEachAddressOnce",
+                        FakeSourceResolvesEachAddressOnce);
+  quick_blue::test::Run("FakeSourceAppliesFilterHint",
+                        FakeSourceAppliesFilterHint);
+  return quick_blue::test::Result();
+}
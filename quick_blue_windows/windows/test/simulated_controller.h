@@ -0,0 +1,103 @@
+#ifndef QUICK_BLUE_WINDOWS_TEST_SIMULATED_CONTROLLER_H_
+#define QUICK_BLUE_WINDOWS_TEST_SIMULATED_CONTROLLER_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace quick_blue {
+namespace test {
+
+// The Bluetooth controller of a link as seen by writes without response:
+// a buffer of |capacity| packets, of which up to |packetsPerEvent| go out at
+// each connection event, one per |interval|. A write completes once its
+// packet has been sent. One submitted while the buffer is full is dropped
+// and completes as failed, the way an overrun stack loses it. Completions
+// run on the controller's thread. Thread-safe.
+class SimulatedController {
+public:
+  using Completion = std::function<void(bool sent)>;
+
+  SimulatedController(size_t capacity, size_t packetsPerEvent,
+                      std::chrono::microseconds interval)
+      : capacity(capacity), packetsPerEvent(packetsPerEvent),
+        interval(interval), transmitter([this] { Transmit(); }) {}
+
+  ~SimulatedController() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    transmitter.join();
+  }
+
+  void Submit(size_t bytes, Completion completion) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      if (buffer.size() < capacity) {
+        buffer.push_back({bytes, std::move(completion)});
+        return;
+      }
+    }
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    completion(false);
+  }
+
+  uint64_t BytesSent() const { return bytesSent.load(); }
+  uint64_t PacketsDropped() const { return dropped.load(); }
+
+private:
+  struct Packet {
+    size_t bytes;
+    Completion completion;
+  };
+
+  void Transmit() {
+    auto event = std::chrono::steady_clock::now();
+    std::vector<Packet> sent;
+    while (true) {
+      event += interval;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait_until(lock, event, [this] { return stopping; });
+        if (stopping) {
+          return;
+        }
+        while (!buffer.empty() && sent.size() < packetsPerEvent) {
+          sent.push_back(std::move(buffer.front()));
+          buffer.pop_front();
+        }
+      }
+      for (auto &packet : sent) {
+        bytesSent.fetch_add(packet.bytes, std::memory_order_relaxed);
+        packet.completion(true);
+      }
+      sent.clear();
+    }
+  }
+
+  const size_t capacity;
+  const size_t packetsPerEvent;
+  const std::chrono::microseconds interval;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::deque<Packet> buffer;
+  bool stopping = false;
+  std::atomic<uint64_t> bytesSent{0};
+  std::atomic<uint64_t> dropped{0};
+  std::thread transmitter;
+};
+
+} // namespace test
+} // namespace quick_blue
+
+#endif // QUICK_BLUE_WINDOWS_TEST_SIMULATED_CONTROLLER_H_
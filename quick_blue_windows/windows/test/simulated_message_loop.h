@@ -0,0 +1,106 @@
+#ifndef QUICK_BLUE_WINDOWS_TEST_SIMULATED_MESSAGE_LOOP_H_
+#define QUICK_BLUE_WINDOWS_TEST_SIMULATED_MESSAGE_LOOP_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "outbound_dispatcher.h"
+
+namespace quick_blue {
+namespace test {
+
+// The platform thread of the plugin with the message loop of its window.
+// Wakes of |dispatcher| post a message to the loop, like PostMessage, and
+// the loop drains a batch for each. Until Attach() there is no window, and
+// wakes are missed as in WakePlatformThread. Thread-safe.
+class SimulatedMessageLoop {
+public:
+  SimulatedMessageLoop(size_t capacity, size_t batch)
+      : batch(batch), dispatcher(capacity, [this] { Wake(); }),
+        thread([this] { Loop(); }) {}
+
+  ~SimulatedMessageLoop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    changed.notify_one();
+    thread.join();
+    dispatcher.Clear();
+  }
+
+  // Creates the window, from the loop thread like AttachToWindow, and
+  // drains what was queued before.
+  void Attach() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      attachRequested = true;
+    }
+    changed.notify_one();
+  }
+
+  OutboundDispatcher &Dispatcher() { return dispatcher; }
+
+  // For messages to tell where they run.
+  bool OnLoopThread() const { return std::this_thread::get_id() == loopId; }
+
+  // Wake messages posted to the loop so far.
+  uint64_t WakesPosted() const { return wakesPosted.load(); }
+
+private:
+  void Wake() {
+    if (!attached.load()) {
+      dispatcher.WakeMissed();
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      wakes++;
+    }
+    wakesPosted++;
+    changed.notify_one();
+  }
+
+  void Loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    loopId = std::this_thread::get_id();
+    while (true) {
+      changed.wait(lock,
+                   [this] { return stopping || attachRequested || wakes > 0; });
+      if (stopping) {
+        return;
+      }
+      if (attachRequested) {
+        attachRequested = false;
+        attached.store(true);
+      } else {
+        wakes--;
+      }
+      lock.unlock();
+      dispatcher.Drain(batch);
+      lock.lock();
+    }
+  }
+
+  const size_t batch;
+  std::mutex mutex;
+  std::condition_variable changed;
+  size_t wakes = 0;
+  bool attachRequested = false;
+  bool stopping = false;
+  std::atomic<bool> attached{false};
+  std::atomic<uint64_t> wakesPosted{0};
+  std::thread::id loopId;
+  OutboundDispatcher dispatcher;
+  // Last, so that it starts once everything else is set up.
+  std::thread thread;
+};
+
+} // namespace test
+} // namespace quick_blue
+
+#endif // QUICK_BLUE_WINDOWS_TEST_SIMULATED_MESSAGE_LOOP_H_
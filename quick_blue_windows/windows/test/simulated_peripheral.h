@@ -0,0 +1,150 @@
+#ifndef QUICK_BLUE_WINDOWS_TEST_SIMULATED_PERIPHERAL_H_
+#define QUICK_BLUE_WINDOWS_TEST_SIMULATED_PERIPHERAL_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "ble_uuid.h"
+#include "gatt_layout_cache.h"
+
+namespace quick_blue {
+namespace test {
+
+// A GATT server that answers discovery requests after |delay|, each on its
+// own thread, the way WinRT operations run from the moment they are created
+// and complete on the thread pool. Thread-safe.
+class SimulatedPeripheral {
+public:
+  SimulatedPeripheral(GattLayout layout, std::chrono::microseconds delay)
+      : layout(std::move(layout)), delay(delay) {}
+
+  std::future<std::vector<BleUuid>> Services() {
+    return Request([this] {
+      std::vector<BleUuid> uuids;
+      for (const auto &service : layout.services) {
+        uuids.push_back(service.uuid);
+      }
+      return uuids;
+    });
+  }
+
+  // The characteristics of service |index|, without their descriptors.
+  std::future<std::vector<GattLayout::Characteristic>>
+  Characteristics(size_t index) {
+    return Request([this, index] {
+      auto characteristics = layout.services[index].characteristics;
+      for (auto &characteristic : characteristics) {
+        characteristic.descriptors.clear();
+      }
+      return characteristics;
+    });
+  }
+
+  std::future<std::vector<BleUuid>> Descriptors(size_t service,
+                                                size_t characteristic) {
+    return Request([this, service, characteristic] {
+      return layout.services[service]
+          .characteristics[characteristic]
+          .descriptors;
+    });
+  }
+
+  // Writes the CCCD of a characteristic and waits for its first
+  // notification, one round trip each.
+  std::future<void> FirstNotification() {
+    return std::async(std::launch::async, [this] {
+      requests.fetch_add(1, std::memory_order_relaxed);
+      std::this_thread::sleep_for(2 * delay);
+    });
+  }
+
+  uint64_t Requests() const { return requests.load(); }
+
+private:
+  template <typename Answer>
+  std::future<std::invoke_result_t<Answer>> Request(Answer answer) {
+    requests.fetch_add(1, std::memory_order_relaxed);
+    return std::async(std::launch::async, [this, answer] {
+      std::this_thread::sleep_for(delay);
+      return answer();
+    });
+  }
+
+  const GattLayout layout;
+  const std::chrono::microseconds delay;
+  std::atomic<uint64_t> requests{0};
+};
+
+// A layout of |services| services with |characteristics| characteristics of
+// one descriptor each, with UUIDs shared across services like real devices.
+inline GattLayout MakeLayout(size_t services, size_t characteristics) {
+  GattLayout layout;
+  uint16_t instance = 1;
+  for (size_t s = 0; s < services; ++s) {
+    GattLayout::Service service{BleUuid::FromShort(uint32_t(0x1800 + s)), {}};
+    for (size_t c = 0; c < characteristics; ++c) {
+      instance += 3;
+      service.characteristics.push_back(
+          {BleUuid::FromShort(uint32_t(0x2A00 + c)), instance,
+           uint32_t(0x12), {BleUuid::FromShort(0x2902)}});
+    }
+    layout.services.push_back(std::move(service));
+  }
+  return layout;
+}
+
+// Discovery the way DiscoverServicesAsync did it before: each request is
+// awaited before the next one is made.
+inline GattLayout DiscoverSequentially(SimulatedPeripheral &peripheral) {
+  GattLayout layout;
+  auto services = peripheral.Services().get();
+  for (size_t s = 0; s < services.size(); ++s) {
+    layout.services.push_back(
+        {services[s], peripheral.Characteristics(s).get()});
+    auto &characteristics = layout.services.back().characteristics;
+    for (size_t c = 0; c < characteristics.size(); ++c) {
+      characteristics[c].descriptors = peripheral.Descriptors(s, c).get();
+    }
+  }
+  return layout;
+}
+
+// Discovery the way DiscoverServicesAsync does it: every characteristic
+// enumeration starts before any is awaited, and descriptor enumerations
+// start as soon as their service has answered.
+inline GattLayout DiscoverConcurrently(SimulatedPeripheral &peripheral) {
+  GattLayout layout;
+  auto services = peripheral.Services().get();
+  std::vector<std::future<std::vector<GattLayout::Characteristic>>>
+      characteristicRequests;
+  for (size_t s = 0; s < services.size(); ++s) {
+    characteristicRequests.push_back(peripheral.Characteristics(s));
+  }
+  std::vector<std::future<std::vector<BleUuid>>> descriptorRequests;
+  for (size_t s = 0; s < services.size(); ++s) {
+    layout.services.push_back({services[s], characteristicRequests[s].get()});
+    auto &characteristics = layout.services.back().characteristics;
+    for (size_t c = 0; c < characteristics.size(); ++c) {
+      descriptorRequests.push_back(peripheral.Descriptors(s, c));
+    }
+  }
+  auto descriptorRequest = descriptorRequests.begin();
+  for (auto &service : layout.services) {
+    for (auto &characteristic : service.characteristics) {
+      characteristic.descriptors = (descriptorRequest++)->get();
+    }
+  }
+  return layout;
+}
+
+} // namespace test
+} // namespace quick_blue
+
+#endif // QUICK_BLUE_WINDOWS_TEST_SIMULATED_PERIPHERAL_H_
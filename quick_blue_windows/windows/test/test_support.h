@@ -0,0 +1,223 @@
+#ifndef QUICK_BLUE_WINDOWS_TEST_TEST_SUPPORT_H_
+#define QUICK_BLUE_WINDOWS_TEST_TEST_SUPPORT_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace quick_blue {
+namespace test {
+
+// Number of failed checks so far. Checks keep going after a failure so one
+// run reports everything that is broken.
+inline int &Failures() {
+  static int failures = 0;
+  return failures;
+}
+
+inline void Fail(const char *file, int line, const char *expression) {
+  std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expression);
+  ++Failures();
+}
+
+inline void Run(const char *name, const std::function<void()> &test) {
+  int before = Failures();
+  test();
+  std::printf("[%s] %s\n", Failures() == before ? "  OK  " : "FAILED", name);
+}
+
+// Exit code of a test binary.
+inline int Result() { return Failures() == 0 ? 0 : 1; }
+
+// True if the binary was started with --quick, which benchmarks use to run a
+// short smoke pass under ctest.
+inline bool QuickRun(int argc, char **argv) {
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--quick") == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+using Clock = std::chrono::steady_clock;
+
+inline double SecondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Percentile of |samples| in place, |p| in [0, 1].
+inline double Percentile(std::vector<double> &samples, double p) {
+  if (samples.empty()) {
+    return 0;
+  }
+  auto index = std::min(samples.size() - 1, size_t(p * samples.size()));
+  std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+  return samples[index];
+}
+
+// Deterministic xorshift generator, so fuzz and stress runs are repeatable.
+class Random {
+public:
+  explicit Random(uint64_t seed) : state(seed ? seed : 1) {}
+
+  uint64_t Next() {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+  }
+
+  // Uniform in [0, bound).
+  uint64_t Below(uint64_t bound) { return bound ? Next() % bound : 0; }
+
+private:
+  uint64_t state;
+};
+
+// Stand-ins for the flutter::EncodableValue types of the same name, so that
+// benchmarks build the messages of the plugin without the engine.
+class EncodableValue;
+using EncodableList = std::vector<EncodableValue>;
+using EncodableMap = std::map<EncodableValue, EncodableValue>;
+
+class EncodableValue
+    : public std::variant<std::monostate, bool, int32_t, int64_t, double,
+                          std::string, std::vector<uint8_t>, EncodableList,
+                          EncodableMap> {
+public:
+  using super =
+      std::variant<std::monostate, bool, int32_t, int64_t, double,
+                   std::string, std::vector<uint8_t>, EncodableList,
+                   EncodableMap>;
+  using super::super;
+
+  // Otherwise a string literal would become a bool.
+  EncodableValue(const char *string) : super(std::string(string)) {}
+};
+
+// Appends |value| to |out| in the format of flutter's StandardMessageCodec,
+// which the engine encodes every message to Dart with.
+inline void EncodeStandard(const EncodableValue &value,
+                           std::vector<uint8_t> &out) {
+  auto writeRaw = [&out](const void *data, size_t size) {
+    auto bytes = static_cast<const uint8_t *>(data);
+    out.insert(out.end(), bytes, bytes + size);
+  };
+  auto writeSize = [&](size_t size) {
+    if (size < 254) {
+      out.push_back(uint8_t(size));
+    } else if (size <= 0xFFFF) {
+      out.push_back(254);
+      auto size16 = uint16_t(size);
+      writeRaw(&size16, sizeof(size16));
+    } else {
+      out.push_back(255);
+      auto size32 = uint32_t(size);
+      writeRaw(&size32, sizeof(size32));
+    }
+  };
+  if (auto boolean = std::get_if<bool>(&value)) {
+    out.push_back(*boolean ? 1 : 2);
+  } else if (auto int32 = std::get_if<int32_t>(&value)) {
+    out.push_back(3);
+    writeRaw(int32, sizeof(*int32));
+  } else if (auto int64 = std::get_if<int64_t>(&value)) {
+    out.push_back(4);
+    writeRaw(int64, sizeof(*int64));
+  } else if (auto number = std::get_if<double>(&value)) {
+    out.push_back(6);
+    out.resize((out.size() + 7) / 8 * 8);
+    writeRaw(number, sizeof(*number));
+  } else if (auto string = std::get_if<std::string>(&value)) {
+    out.push_back(7);
+    writeSize(string->size());
+    writeRaw(string->data(), string->size());
+  } else if (auto bytes = std::get_if<std::vector<uint8_t>>(&value)) {
+    out.push_back(8);
+    writeSize(bytes->size());
+    writeRaw(bytes->data(), bytes->size());
+  } else if (auto list = std::get_if<EncodableList>(&value)) {
+    out.push_back(12);
+    writeSize(list->size());
+    for (auto &element : *list) {
+      EncodeStandard(element, out);
+    }
+  } else if (auto map = std::get_if<EncodableMap>(&value)) {
+    out.push_back(13);
+    writeSize(map->size());
+    for (auto &entry : *map) {
+      EncodeStandard(entry.first, out);
+      EncodeStandard(entry.second, out);
+    }
+  } else {
+    out.push_back(0);
+  }
+}
+
+// The platform thread of the plugin, which sends one message to Dart at a
+// time. Send() encodes the message as a success envelope, the work the
+// engine does on this thread for every message, and accounts for the time
+// it took. Handing the bytes to the engine is not part of it, so the cost
+// of a channel crossing beyond the encoding is not measured. Thread-safe.
+class SimulatedPlatformThread {
+public:
+  // Returns when the message was sent.
+  Clock::time_point Send(const EncodableValue &message) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto start = Clock::now();
+    buffer.clear();
+    buffer.push_back(0);
+    EncodeStandard(message, buffer);
+    auto sent = Clock::now();
+    busy += sent - start;
+    bytes += buffer.size();
+    ++messages;
+    return sent;
+  }
+
+  // Time spent sending so far.
+  double BusySeconds() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::chrono::duration<double>(busy).count();
+  }
+
+  uint64_t Messages() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return messages;
+  }
+
+  uint64_t Bytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return bytes;
+  }
+
+private:
+  mutable std::mutex mutex;
+  std::vector<uint8_t> buffer;
+  Clock::duration busy{};
+  uint64_t messages = 0;
+  uint64_t bytes = 0;
+};
+
+} // namespace test
+} // namespace quick_blue
+
+#define CHECK(condition)                                                       \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      quick_blue::test::Fail(__FILE__, __LINE__, #condition);                  \
+    }                                                                          \
+  } while (false)
+
+#define CHECK_EQ(a, b) CHECK((a) == (b))
+
+#endif // QUICK_BLUE_WINDOWS_TEST_TEST_SUPPORT_H_
@@ -0,0 +1,114 @@
+// Sustained bytes/s of a burst of 244-byte writes without response into a
+// simulated controller with a buffer of 8 packets, sending up to 4 packets
+// per connection event. "unpaced" is the former path: every write is issued
+// at once, and whatever overruns the controller is lost. "window N" queues
+// the writes in a WritePipeline with N in flight; a producer told QueueFull
+// retries after one connection interval, as Dart would.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "simulated_controller.h"
+#include "test_support.h"
+#include "write_pipeline.h"
+
+using quick_blue::WritePipeline;
+using quick_blue::test::Clock;
+using quick_blue::test::SimulatedController;
+
+namespace {
+
+const size_t kBufferPackets = 8;
+const size_t kPacketsPerEvent = 4;
+const size_t kWriteSize = 244;
+
+struct Outcome {
+  double seconds;
+  uint64_t bytesSent;
+  uint64_t lost;
+};
+
+void WaitFor(const std::atomic<uint64_t> &done, uint64_t writes) {
+  while (done.load() < writes) {
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+}
+
+Outcome Unpaced(uint64_t writes, std::chrono::microseconds interval,
+                size_t) {
+  SimulatedController controller(kBufferPackets, kPacketsPerEvent, interval);
+  std::atomic<uint64_t> done{0};
+  auto start = Clock::now();
+  for (uint64_t i = 0; i < writes; ++i) {
+    controller.Submit(kWriteSize, [&done](bool) { done.fetch_add(1); });
+  }
+  WaitFor(done, writes);
+  return {quick_blue::test::SecondsSince(start), controller.BytesSent(),
+          controller.PacketsDropped()};
+}
+
+Outcome Pipelined(uint64_t writes, std::chrono::microseconds interval,
+                  size_t window) {
+  auto controller = std::make_unique<SimulatedController>(
+      kBufferPackets, kPacketsPerEvent, interval);
+  WritePipeline pipeline({64, window});
+  std::atomic<uint64_t> done{0};
+  std::function<void(WritePipeline::Write)> issue =
+      [&](WritePipeline::Write write) {
+        controller->Submit(write.value.size(), [&](bool sent) {
+          pipeline.Complete(sent);
+          done.fetch_add(1);
+          pipeline.Drain(issue);
+        });
+      };
+  auto start = Clock::now();
+  for (uint64_t i = 0; i < writes;) {
+    if (pipeline.Push({std::vector<uint8_t>(kWriteSize), false, i})) {
+      ++i;
+    } else {
+      std::this_thread::sleep_for(interval);
+    }
+    pipeline.Drain(issue);
+  }
+  WaitFor(done, writes);
+  auto seconds = quick_blue::test::SecondsSince(start);
+  auto bytesSent = controller->BytesSent();
+  auto lost = controller->PacketsDropped();
+  controller.reset();
+  return {seconds, bytesSent, lost};
+}
+
+template <typename Path>
+void Measure(const char *label, Path path, size_t window, uint64_t writes,
+             std::chrono::microseconds interval) {
+  auto outcome = path(writes, interval, window);
+  std::printf("%-9s %8.1f KB/s sent %5.1f%% lost\n", label,
+              outcome.bytesSent / outcome.seconds / 1e3,
+              100.0 * outcome.lost / writes);
+  CHECK_EQ(outcome.bytesSent + outcome.lost * kWriteSize,
+           writes * kWriteSize);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  bool quick = quick_blue::test::QuickRun(argc, argv);
+  uint64_t writes = quick ? 400 : 8000;
+  std::chrono::microseconds interval(1000);
+  std::printf("%zu packet buffer, %zu packets per %lld us event, "
+              "%llu writes\n",
+              kBufferPackets, kPacketsPerEvent,
+              static_cast<long long>(interval.count()),
+              static_cast<unsigned long long>(writes));
+  Measure("unpaced", Unpaced, 0, writes, interval);
+  Measure("window 1", Pipelined, 1, writes, interval);
+  Measure("window 4", Pipelined, 4, writes, interval);
+  Measure("window 8", Pipelined, 8, writes, interval);
+  return quick_blue::test::Result();
+}
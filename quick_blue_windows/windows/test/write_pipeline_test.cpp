@@ -0,0 +1,160 @@
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "test_support.h"
+#include "write_pipeline.h"
+
+using quick_blue::WritePipeline;
+
+namespace {
+
+WritePipeline::Write Make(uint64_t tag, bool withResponse = false) {
+  return WritePipeline::Write{{uint8_t(tag)}, withResponse, tag};
+}
+
+std::vector<uint64_t> DrainTags(WritePipeline &pipeline) {
+  std::vector<uint64_t> tags;
+  pipeline.Drain([&tags](WritePipeline::Write write) {
+    tags.push_back(write.tag);
+  });
+  return tags;
+}
+
+void IssuesUpToTheWindowInOrder() {
+  WritePipeline pipeline({64, 3});
+  for (uint64_t i = 0; i < 5; ++i) {
+    CHECK(pipeline.Push(Make(i)));
+  }
+  CHECK(DrainTags(pipeline) == std::vector<uint64_t>({0, 1, 2}));
+  CHECK(DrainTags(pipeline).empty());
+  pipeline.Complete(true);
+  CHECK(DrainTags(pipeline) == std::vector<uint64_t>({3}));
+  pipeline.Complete(true);
+  CHECK(DrainTags(pipeline) == std::vector<uint64_t>({4}));
+}
+
+void IssuesWritesWithResponseAlone() {
+  WritePipeline pipeline({64, 4});
+  pipeline.Push(Make(0));
+  pipeline.Push(Make(1, true));
+  pipeline.Push(Make(2));
+  // The write with response waits for the one before it to complete.
+  CHECK(DrainTags(pipeline) == std::vector<uint64_t>({0}));
+  pipeline.Complete(true);
+  CHECK(DrainTags(pipeline) == std::vector<uint64_t>({1}));
+  // Nothing follows it until it has completed.
+  CHECK(DrainTags(pipeline).empty());
+  pipeline.Complete(false);
+  CHECK(DrainTags(pipeline) == std::vector<uint64_t>({2}));
+  pipeline.Complete(true);
+  auto counters = pipeline.GetCounters();
+  CHECK_EQ(counters.completed, 2u);
+  CHECK_EQ(counters.failed, 1u);
+}
+
+void RejectsWritesWhenFull() {
+  WritePipeline pipeline({2, 1});
+  CHECK(pipeline.Push(Make(0)));
+  CHECK(pipeline.Push(Make(1)));
+  CHECK(!pipeline.Push(Make(2)));
+  // An issued write no longer takes room in the queue.
+  CHECK(DrainTags(pipeline) == std::vector<uint64_t>({0}));
+  CHECK(pipeline.Push(Make(3)));
+  auto counters = pipeline.GetCounters();
+  CHECK_EQ(counters.queued, 3u);
+  CHECK_EQ(counters.rejected, 1u);
+  CHECK_EQ(counters.maxDepth, 2u);
+}
+
+void ClearsWritesNotIssuedYet() {
+  WritePipeline pipeline({64, 1});
+  for (uint64_t i = 0; i < 4; ++i) {
+    pipeline.Push(Make(i));
+  }
+  CHECK(DrainTags(pipeline) == std::vector<uint64_t>({0}));
+  auto dropped = pipeline.Clear();
+  CHECK_EQ(dropped.size(), 3u);
+  CHECK_EQ(dropped.front().tag, 1u);
+  pipeline.Complete(true);
+  CHECK(DrainTags(pipeline).empty());
+}
+
+// Writes pushed from several threads and completed from others are issued
+// once each, never more than the window at a time, and in push order.
+void KeepsOrderAcrossThreads() {
+  const size_t kWindow = 4;
+  const uint64_t kWrites = 20000;
+  WritePipeline pipeline({16, kWindow});
+  std::mutex issuedMutex;
+  std::vector<uint64_t> issued;
+  std::atomic<size_t> inFlight{0};
+  std::atomic<size_t> maxInFlight{0};
+  std::atomic<uint64_t> pending{0};
+  auto issue = [&](WritePipeline::Write write) {
+    std::lock_guard<std::mutex> lock(issuedMutex);
+    issued.push_back(write.tag);
+    auto now = inFlight.fetch_add(1) + 1;
+    if (now > maxInFlight.load()) {
+      maxInFlight.store(now);
+    }
+    pending.fetch_add(1);
+  };
+
+  std::thread producer([&] {
+    for (uint64_t i = 0; i < kWrites;) {
+      if (pipeline.Push(Make(i))) {
+        ++i;
+      } else {
+        std::this_thread::yield();
+      }
+      pipeline.Drain(issue);
+    }
+  });
+  std::vector<std::thread> completers;
+  std::atomic<uint64_t> completed{0};
+  for (int t = 0; t < 3; ++t) {
+    completers.emplace_back([&] {
+      while (completed.load() < kWrites) {
+        auto count = pending.load();
+        if (count == 0 ||
+            !pending.compare_exchange_weak(count, count - 1)) {
+          std::this_thread::yield();
+          continue;
+        }
+        inFlight.fetch_sub(1);
+        pipeline.Complete(true);
+        completed.fetch_add(1);
+        pipeline.Drain(issue);
+      }
+    });
+  }
+  producer.join();
+  for (auto &completer : completers) {
+    completer.join();
+  }
+
+  CHECK_EQ(issued.size(), size_t(kWrites));
+  bool ordered = true;
+  for (uint64_t i = 0; i < issued.size(); ++i) {
+    ordered = ordered && issued[i] == i;
+  }
+  CHECK(ordered);
+  CHECK(maxInFlight.load() <= kWindow);
+  CHECK_EQ(pipeline.GetCounters().completed, kWrites);
+}
+
+} // namespace
+
+int main() {
+  quick_blue::test::Run("IssuesUpToTheWindowInOrder",
+                        IssuesUpToTheWindowInOrder);
+  quick_blue::test::Run("IssuesWritesWithResponseAlone",
+                        IssuesWritesWithResponseAlone);
+  quick_blue::test::Run("RejectsWritesWhenFull", RejectsWritesWhenFull);
+  quick_blue::test::Run("ClearsWritesNotIssuedYet", ClearsWritesNotIssuedYet);
+  quick_blue::test::Run("KeepsOrderAcrossThreads", KeepsOrderAcrossThreads);
+  return quick_blue::test::Result();
+}
@@ -0,0 +1,130 @@
+// Transfer time of a firmware image over a simulated link: a controller with
+// a buffer of 8 packets sending up to 4 packets per 1 ms connection event,
+// writes without response. "per-chunk" is the former path: Dart awaits one
+// writeValue call per chunk, each paying a channel crossing both ways, at
+// the 20 bytes of the default MTU or the 244 of a negotiated one.
+// "writeStream" makes one call, and the plugin keeps 8 MTU-sized chunks in
+// flight.
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+
+#include "simulated_controller.h"
+#include "test_support.h"
+
+using quick_blue::test::Clock;
+using quick_blue::test::SimulatedController;
+
+namespace {
+
+const size_t kBufferPackets = 8;
+const size_t kPacketsPerEvent = 4;
+const auto kInterval = std::chrono::microseconds(1000);
+const auto kCrossingCost = std::chrono::microseconds(50);
+
+void Spin(Clock::duration duration) {
+  auto until = Clock::now() + duration;
+  while (Clock::now() < until) {
+  }
+}
+
+// Counts completed chunks and lets the transfer wait for them.
+class Completions {
+public:
+  void Add(bool sent) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      ++done;
+      failed += sent ? 0 : 1;
+    }
+    changed.notify_all();
+  }
+
+  void WaitFor(size_t count) {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this, count] { return done >= count; });
+  }
+
+  size_t Failed() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return failed;
+  }
+
+private:
+  std::mutex mutex;
+  std::condition_variable changed;
+  size_t done = 0;
+  size_t failed = 0;
+};
+
+struct Transfer {
+  double seconds;
+  size_t chunks;
+  size_t failed;
+};
+
+Transfer PerChunk(size_t imageSize, size_t chunkSize, size_t) {
+  SimulatedController controller(kBufferPackets, kPacketsPerEvent, kInterval);
+  Completions completions;
+  size_t chunks = 0;
+  auto start = Clock::now();
+  for (size_t offset = 0; offset < imageSize; offset += chunkSize) {
+    Spin(kCrossingCost);
+    auto size = std::min(chunkSize, imageSize - offset);
+    controller.Submit(size, [&completions](bool sent) {
+      completions.Add(sent);
+    });
+    completions.WaitFor(++chunks);
+    Spin(kCrossingCost);
+  }
+  return {quick_blue::test::SecondsSince(start), chunks, completions.Failed()};
+}
+
+Transfer Stream(size_t imageSize, size_t chunkSize, size_t window) {
+  SimulatedController controller(kBufferPackets, kPacketsPerEvent, kInterval);
+  Completions completions;
+  size_t chunks = 0;
+  auto start = Clock::now();
+  Spin(kCrossingCost);
+  for (size_t offset = 0; offset < imageSize; offset += chunkSize) {
+    if (chunks >= window) {
+      completions.WaitFor(chunks - window + 1);
+    }
+    auto size = std::min(chunkSize, imageSize - offset);
+    controller.Submit(size, [&completions](bool sent) {
+      completions.Add(sent);
+    });
+    ++chunks;
+  }
+  completions.WaitFor(chunks);
+  Spin(kCrossingCost);
+  return {quick_blue::test::SecondsSince(start), chunks, completions.Failed()};
+}
+
+template <typename Path>
+void Measure(const char *label, Path path, size_t imageSize,
+             size_t chunkSize, size_t window) {
+  auto transfer = path(imageSize, chunkSize, window);
+  std::printf("%-11s %3zu-byte chunks %6zu chunks %8.3f s %7.1f KB/s\n",
+              label, chunkSize, transfer.chunks, transfer.seconds,
+              imageSize / transfer.seconds / 1e3);
+  CHECK_EQ(transfer.chunks, (imageSize + chunkSize - 1) / chunkSize);
+  CHECK_EQ(transfer.failed, 0u);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t imageSize = quick_blue::test::QuickRun(argc, argv) ? 8 * 1024
+                                                             : 300 * 1024;
+  std::printf("%zu KB image\n", imageSize / 1024);
+  Measure("per-chunk", PerChunk, imageSize, 20, 1);
+  Measure("per-chunk", PerChunk, imageSize, 244, 1);
+  Measure("writeStream", Stream, imageSize, 244, 8);
+  return quick_blue::test::Result();
+}
@@ -0,0 +1,293 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "gatt_scheduler.h"
+#include "operation_timeouts.h"
+#include "pending_operations.h"
+#include "test_support.h"
+#include "write_pipeline.h"
+
+using quick_blue::GattPriority;
+using quick_blue::GattScheduler;
+using quick_blue::PendingOperations;
+using quick_blue::TimeoutRace;
+using quick_blue::WritePipeline;
+
+namespace {
+
+// A GATT backend whose writes complete only when the test finishes them,
+// or never, like a device that went silent.
+class SimulatedBackend {
+public:
+  using Completion = std::function<void(bool success)>;
+
+  size_t Start(Completion completion) {
+    std::lock_guard<std::mutex> lock(mutex);
+    completions.push_back(std::move(completion));
+    return completions.size() - 1;
+  }
+
+  void Cancel(size_t) { cancelled.fetch_add(1); }
+
+  // Completes write |index| now, however late that is.
+  void Finish(size_t index, bool success) {
+    Completion completion;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      std::swap(completion, completions[index]);
+    }
+    if (completion) {
+      completion(success);
+    }
+  }
+
+  size_t Started() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return completions.size();
+  }
+
+  std::atomic<size_t> cancelled{0};
+
+private:
+  std::mutex mutex;
+  std::vector<Completion> completions;
+};
+
+// The write path of the plugin around the simulated backend: writes queue
+// in a pipeline, wait for a scheduler slot, and are settled once by their
+// completion or their timeout, whichever comes first.
+class Writer {
+public:
+  Writer(SimulatedBackend &backend, size_t window,
+         std::chrono::milliseconds timeout)
+      : backend(backend), pipeline(std::make_shared<WritePipeline>(
+                              WritePipeline::Options{64, window})),
+        scheduler(std::make_shared<GattScheduler>(4)), timeout(timeout) {}
+
+  // Waits for every timer, including those a firing timer starts when it
+  // issues the next write.
+  ~Writer() {
+    while (true) {
+      std::vector<std::thread> fired;
+      {
+        std::lock_guard<std::mutex> lock(timersMutex);
+        if (timers.empty()) {
+          return;
+        }
+        std::swap(fired, timers);
+      }
+      for (auto &timer : fired) {
+        timer.join();
+      }
+    }
+  }
+
+  uint64_t Write() {
+    auto requestId = pending.Add(0, 0);
+    pipeline->Push({{0x01}, false, requestId});
+    Drain();
+    return requestId;
+  }
+
+  // The code each request was answered with, "" while unanswered.
+  std::string AnswerOf(uint64_t requestId) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = answers.find(requestId);
+    return it == answers.end() ? "" : it->second;
+  }
+
+  void WaitForAnswers(size_t count) {
+    while (true) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (answers.size() >= count) {
+          return;
+        }
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+private:
+  void Drain() {
+    pipeline->Drain([this](WritePipeline::Write write) {
+      auto ticket = scheduler->Submit(GattPriority::BulkWrite,
+                                      GattScheduler::kNoDeadline, nullptr);
+      Issue(ticket.id, write.tag);
+    });
+  }
+
+  void Issue(uint64_t ticketId, uint64_t requestId) {
+    auto race = std::make_shared<TimeoutRace>();
+    auto settle = [this, ticketId, requestId](const char *code,
+                                              bool success) {
+      scheduler->Release(ticketId);
+      Answer(requestId, code);
+      pipeline->Complete(success);
+      Drain();
+    };
+    auto index = backend.Start([race, settle](bool success) {
+      if (!race->Settle()) {
+        return;
+      }
+      settle(success ? "Success" : "WriteFailed", success);
+    });
+    std::lock_guard<std::mutex> lock(timersMutex);
+    timers.emplace_back([this, race, settle, index] {
+      std::this_thread::sleep_for(timeout);
+      if (!race->Settle()) {
+        return;
+      }
+      backend.Cancel(index);
+      settle("Timeout", false);
+    });
+  }
+
+  void Answer(uint64_t requestId, const char *code) {
+    if (!pending.Take(requestId)) {
+      lateAnswers.fetch_add(1);
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    answers[requestId] = code;
+  }
+
+  SimulatedBackend &backend;
+
+public:
+  std::shared_ptr<WritePipeline> pipeline;
+  std::shared_ptr<GattScheduler> scheduler;
+  std::atomic<size_t> lateAnswers{0};
+
+private:
+  std::chrono::milliseconds timeout;
+  PendingOperations<int> pending;
+  std::mutex mutex;
+  std::unordered_map<uint64_t, std::string> answers;
+  std::mutex timersMutex;
+  std::vector<std::thread> timers;
+};
+
+void NeverCompletingWritesTimeOut() {
+  SimulatedBackend backend;
+  Writer writer(backend, 1, std::chrono::milliseconds(20));
+  auto first = writer.Write();
+  auto second = writer.Write();
+  // The second write waits for the window slot the first one holds.
+  CHECK_EQ(backend.Started(), 1u);
+  writer.WaitForAnswers(2);
+  CHECK(writer.AnswerOf(first) == "Timeout");
+  CHECK(writer.AnswerOf(second) == "Timeout");
+  // Each timeout freed its slots, so the second write was issued.
+  CHECK_EQ(backend.Started(), 2u);
+  CHECK_EQ(backend.cancelled.load(), 2u);
+  CHECK_EQ(writer.scheduler->GetCounters().running, 0u);
+  auto counters = writer.pipeline->GetCounters();
+  CHECK_EQ(counters.failed, 2u);
+  CHECK_EQ(counters.completed, 0u);
+}
+
+void LateCompletionsDoNothing() {
+  SimulatedBackend backend;
+  Writer writer(backend, 1, std::chrono::milliseconds(10));
+  auto first = writer.Write();
+  writer.WaitForAnswers(1);
+  CHECK(writer.AnswerOf(first) == "Timeout");
+
+  // The device answers after all; the write is settled already.
+  backend.Finish(0, true);
+  CHECK(writer.AnswerOf(first) == "Timeout");
+  CHECK_EQ(writer.lateAnswers.load(), 0u);
+  auto counters = writer.pipeline->GetCounters();
+  CHECK_EQ(counters.failed, 1u);
+  CHECK_EQ(counters.completed, 0u);
+
+  // The window slot was freed once only: one write in flight at a time.
+  writer.Write();
+  writer.Write();
+  CHECK_EQ(backend.Started(), 2u);
+}
+
+void CompletionsBeforeTheTimeoutWin() {
+  SimulatedBackend backend;
+  Writer writer(backend, 2, std::chrono::milliseconds(20));
+  auto first = writer.Write();
+  auto second = writer.Write();
+  backend.Finish(0, true);
+  backend.Finish(1, false);
+  CHECK(writer.AnswerOf(first) == "Success");
+  CHECK(writer.AnswerOf(second) == "WriteFailed");
+  std::this_thread::sleep_for(std::chrono::milliseconds(40));
+  CHECK(writer.AnswerOf(first) == "Success");
+  CHECK_EQ(backend.cancelled.load(), 0u);
+  auto counters = writer.pipeline->GetCounters();
+  CHECK_EQ(counters.completed, 1u);
+  CHECK_EQ(counters.failed, 1u);
+}
+
+// Completions racing their timeouts from other threads settle every write
+// exactly once and leave no slot behind.
+void SettlesEachWriteOnceUnderRaces() {
+  const size_t kWrites = 200;
+  SimulatedBackend backend;
+  std::vector<uint64_t> requests;
+  {
+    Writer writer(backend, 4, std::chrono::milliseconds(2));
+    std::atomic<bool> done{false};
+    std::thread device([&] {
+      quick_blue::test::Random random(7);
+      size_t next = 0;
+      while (!done.load()) {
+        if (next < backend.Started()) {
+          std::this_thread::sleep_for(
+              std::chrono::microseconds(random.Below(4000)));
+          backend.Finish(next++, random.Below(4) != 0);
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+    for (size_t i = 0; i < kWrites; ++i) {
+      requests.push_back(writer.Write());
+      if (i % 32 == 31) {
+        writer.WaitForAnswers(i + 1);
+      }
+    }
+    writer.WaitForAnswers(kWrites);
+    done.store(true);
+    device.join();
+
+    size_t timeouts = 0;
+    for (auto request : requests) {
+      auto answer = writer.AnswerOf(request);
+      CHECK(!answer.empty());
+      timeouts += answer == "Timeout" ? 1 : 0;
+    }
+    auto counters = writer.pipeline->GetCounters();
+    CHECK_EQ(counters.completed + counters.failed, kWrites);
+    CHECK_EQ(writer.scheduler->GetCounters().running, 0u);
+    CHECK_EQ(writer.lateAnswers.load(), 0u);
+    CHECK_EQ(backend.cancelled.load(), timeouts);
+  }
+}
+
+} // namespace
+
+int main() {
+  quick_blue::test::Run("NeverCompletingWritesTimeOut",
+                        NeverCompletingWritesTimeOut);
+  quick_blue::test::Run("LateCompletionsDoNothing", LateCompletionsDoNothing);
+  quick_blue::test::Run("CompletionsBeforeTheTimeoutWin",
+                        CompletionsBeforeTheTimeoutWin);
+  quick_blue::test::Run("SettlesEachWriteOnceUnderRaces",
+                        SettlesEachWriteOnceUnderRaces);
+  return quick_blue::test::Result();
+}
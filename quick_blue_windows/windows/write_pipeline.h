@@ -0,0 +1,147 @@
+#ifndef QUICK_BLUE_WINDOWS_WRITE_PIPELINE_H_
+#define QUICK_BLUE_WINDOWS_WRITE_PIPELINE_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace quick_blue {
+
+// Ordered, bounded queue of writes to one characteristic. Up to |window|
+// writes without response are in flight at once, so the controller stays
+// busy without being flooded. A write with response is issued alone, after
+// everything before it has completed, and nothing follows it until it has
+// completed too. A full queue rejects writes instead of dropping them.
+// Thread-safe.
+class WritePipeline {
+public:
+  struct Write {
+    std::vector<uint8_t> value;
+    bool withResponse = false;
+    // Opaque to the pipeline, e.g. the request the write answers.
+    uint64_t tag = 0;
+    // Opaque to the pipeline too: when the write must have started by.
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::time_point::max();
+  };
+
+  struct Options {
+    size_t capacity = 64;
+    size_t window = 4;
+  };
+
+  explicit WritePipeline(Options options) : options(options) {}
+
+  void SetOptions(Options options) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->options = options;
+  }
+
+  // Queues |write|. Returns false, leaving the queue as is, if it is full.
+  bool Push(Write write) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (queue.size() >= options.capacity) {
+      rejected++;
+      return false;
+    }
+    queue.push_back(std::move(write));
+    queued++;
+    maxDepth = std::max<uint64_t>(maxDepth, queue.size());
+    return true;
+  }
+
+  // Hands the writes the window allows to |issue|, in queue order. Only one
+  // thread issues at a time; a call while another thread is issuing returns
+  // at once, and that thread picks up whatever became ready. |issue| may
+  // complete writes synchronously.
+  template <typename Issue> void Drain(Issue &&issue) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (draining) {
+        return;
+      }
+      draining = true;
+    }
+    while (true) {
+      Write write;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!CanIssue()) {
+          draining = false;
+          return;
+        }
+        write = std::move(queue.front());
+        queue.pop_front();
+        inFlight++;
+        barrier = write.withResponse;
+      }
+      issue(std::move(write));
+    }
+  }
+
+  // Marks the oldest issued write as completed.
+  void Complete(bool success) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (inFlight > 0) {
+      inFlight--;
+    }
+    if (inFlight == 0) {
+      barrier = false;
+    }
+    (success ? completed : failed)++;
+  }
+
+  // Drops and returns the writes not issued yet.
+  std::vector<Write> Clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<Write> dropped(std::make_move_iterator(queue.begin()),
+                               std::make_move_iterator(queue.end()));
+    queue.clear();
+    return dropped;
+  }
+
+  struct Counters {
+    uint64_t queued = 0;
+    uint64_t rejected = 0;
+    uint64_t completed = 0;
+    uint64_t failed = 0;
+    uint64_t maxDepth = 0;
+  };
+
+  Counters GetCounters() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return {queued, rejected, completed, failed, maxDepth};
+  }
+
+private:
+  bool CanIssue() const {
+    if (queue.empty() || barrier) {
+      return false;
+    }
+    return queue.front().withResponse ? inFlight == 0
+                                      : inFlight < options.window;
+  }
+
+  mutable std::mutex mutex;
+  Options options;
+  std::deque<Write> queue;
+  size_t inFlight = 0;
+  // Set while a write with response is in flight.
+  bool barrier = false;
+  bool draining = false;
+  uint64_t queued = 0;
+  uint64_t rejected = 0;
+  uint64_t completed = 0;
+  uint64_t failed = 0;
+  uint64_t maxDepth = 0;
+};
+
+} // namespace quick_blue
+
+#endif // QUICK_BLUE_WINDOWS_WRITE_PIPELINE_H_